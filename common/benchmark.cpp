@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+//--------------------------------------------------------------------------------------------------
+// Camera path
+//
+
+bool CameraPath::load(const std::string& filename)
+{
+  FILE* file = fopen(filename.c_str(), "r");
+  if(file == nullptr)
+    return false;
+
+  cameras.clear();
+  nvh::CameraManipulator::Camera camera;
+  while(fscanf(file, "%f %f %f %f %f %f %f %f %f %f", &camera.eye.x, &camera.eye.y, &camera.eye.z, &camera.ctr.x,
+                &camera.ctr.y, &camera.ctr.z, &camera.up.x, &camera.up.y, &camera.up.z, &camera.fov)
+        == 10)
+  {
+    cameras.push_back(camera);
+  }
+  fclose(file);
+  return !cameras.empty();
+}
+
+bool CameraPath::save(const std::string& filename) const
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == nullptr)
+    return false;
+
+  for(const auto& c : cameras)
+  {
+    fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", c.eye.x, c.eye.y, c.eye.z, c.ctr.x, c.ctr.y,
+            c.ctr.z, c.up.x, c.up.y, c.up.z, c.fov);
+  }
+  fclose(file);
+  return true;
+}
+
+void CameraPath::apply(uint32_t frame) const
+{
+  if(cameras.empty())
+    return;
+  const auto& camera = cameras[frame % cameras.size()];
+  CameraManip.setLookat(camera.eye, camera.ctr, camera.up, true);
+  CameraManip.setFov(camera.fov);
+}
+
+CameraPath CameraPath::orbit(const nvh::CameraManipulator::Camera& start, uint32_t frames)
+{
+  CameraPath path;
+  glm::vec3  offset = start.eye - start.ctr;
+  for(uint32_t i = 0; i < frames; i++)
+  {
+    float     angle  = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(frames);
+    glm::mat4 rotate = glm::rotate(glm::mat4(1), angle, start.up);
+
+    nvh::CameraManipulator::Camera camera = start;
+    camera.eye                            = start.ctr + glm::vec3(rotate * glm::vec4(offset, 0.f));
+    path.cameras.push_back(camera);
+  }
+  return path;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Benchmark
+//
+
+//--------------------------------------------------------------------------------------------------
+// Two timestamp queries per pass. Without timestamp support on the queue, only the CPU time of
+// the frames is measured.
+//
+void Benchmark::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t warmupFrames)
+{
+  m_device         = device;
+  m_physicalDevice = physicalDevice;
+  m_warmupFrames   = warmupFrames;
+  m_frame          = 0;
+  m_passes.clear();
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+  if(validBits == 0)
+    return;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_timestampPeriod = properties.limits.timestampPeriod;
+  m_timestampMask   = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo createInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  createInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+  createInfo.queryCount = 2 * MAX_PASSES;
+  vkCreateQueryPool(m_device, &createInfo, nullptr, &m_queryPool);
+}
+
+void Benchmark::deinit()
+{
+  if(m_queryPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+  m_queryPool = VK_NULL_HANDLE;
+}
+
+void Benchmark::beginFrame(VkCommandBuffer cmdBuf)
+{
+  cameraPath.apply(m_frame);
+  m_framePasses.clear();
+  m_openPass   = -1;
+  m_frameStart = std::chrono::steady_clock::now();
+  if(m_queryPool != VK_NULL_HANDLE)
+    vkCmdResetQueryPool(cmdBuf, m_queryPool, 0, 2 * MAX_PASSES);
+}
+
+void Benchmark::beginPass(VkCommandBuffer cmdBuf, const char* name)
+{
+  if(m_queryPool == VK_NULL_HANDLE || m_openPass >= 0 || m_framePasses.size() >= MAX_PASSES)
+    return;
+  m_openPass = static_cast<int>(m_framePasses.size());
+  m_framePasses.push_back(name);
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, 2 * m_openPass);
+}
+
+void Benchmark::endPass(VkCommandBuffer cmdBuf)
+{
+  if(m_openPass < 0)
+    return;
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2 * m_openPass + 1);
+  m_openPass = -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The frame was waited on: its timestamps are available. Warm-up frames are not recorded.
+//
+void Benchmark::endFrame()
+{
+  float cpuMs    = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_frameStart).count();
+  bool  measured = m_frame++ >= m_warmupFrames;
+  if(!measured)
+    return;
+
+  findPass("Frame", false).times.push_back(cpuMs);
+  if(m_framePasses.empty())
+    return;
+
+  std::vector<uint64_t> timestamps(2 * m_framePasses.size());
+  VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, 0, static_cast<uint32_t>(timestamps.size()),
+                                          timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+  if(result != VK_SUCCESS)
+    return;
+
+  for(size_t i = 0; i < m_framePasses.size(); i++)
+  {
+    uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & m_timestampMask;
+    float    ms    = static_cast<float>(static_cast<double>(ticks) * m_timestampPeriod * 1e-6);
+    findPass(m_framePasses[i], true).times.push_back(ms);
+  }
+}
+
+Benchmark::Pass& Benchmark::findPass(const std::string& name, bool gpu)
+{
+  for(auto& pass : m_passes)
+  {
+    if(pass.name == name && pass.gpu == gpu)
+      return pass;
+  }
+  m_passes.push_back({name, gpu, {}});
+  return m_passes.back();
+}
+
+// JSON string of any text: the device name and the file names come from outside the sample
+static std::string jsonString(const std::string& text)
+{
+  std::string quoted = "\"";
+  for(char c : text)
+  {
+    if(c == '"' || c == '\\')
+    {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if(static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+    }
+    else
+      quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void Benchmark::setInfo(const std::string& key, const std::string& value)
+{
+  m_info.emplace_back(key, jsonString(value));
+}
+
+void Benchmark::setInfo(const std::string& key, double value)
+{
+  char text[64];
+  snprintf(text, sizeof(text), "%.9g", value);
+  m_info.emplace_back(key, text);
+}
+
+//--------------------------------------------------------------------------------------------------
+// One entry per pass, with the statistics of its times over the measured frames. The percentile
+// is the nearest-rank one.
+//
+bool Benchmark::writeJson(const std::string& filename) const
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == nullptr)
+    return false;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"device\": %s,\n", jsonString(properties.deviceName).c_str());
+  fprintf(file, "  \"driverVersion\": %u,\n", properties.driverVersion);
+  fprintf(file, "  \"apiVersion\": \"%u.%u.%u\",\n", VK_API_VERSION_MAJOR(properties.apiVersion),
+          VK_API_VERSION_MINOR(properties.apiVersion), VK_API_VERSION_PATCH(properties.apiVersion));
+  fprintf(file, "  \"warmupFrames\": %u,\n", m_warmupFrames);
+  fprintf(file, "  \"measuredFrames\": %u,\n", measuredFrames());
+  for(const auto& info : m_info)
+    fprintf(file, "  %s: %s,\n", jsonString(info.first).c_str(), info.second.c_str());
+
+  fprintf(file, "  \"passes\": [");
+  for(size_t i = 0; i < m_passes.size(); i++)
+  {
+    std::vector<float> times = m_passes[i].times;
+    std::sort(times.begin(), times.end());
+    size_t count = times.size();
+    double sum   = 0;
+    for(float t : times)
+      sum += t;
+
+    auto percentile = [&](double p) {
+      size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(count)));
+      return times[std::clamp<size_t>(rank, 1, count) - 1];
+    };
+
+    fprintf(file, "%s\n    {\"name\": %s, \"timer\": \"%s\", \"count\": %zu", i > 0 ? "," : "",
+            jsonString(m_passes[i].name).c_str(), m_passes[i].gpu ? "gpu" : "cpu", count);
+    if(count > 0)
+    {
+      fprintf(file, ", \"minMs\": %.4f, \"medianMs\": %.4f, \"p99Ms\": %.4f, \"meanMs\": %.4f, \"maxMs\": %.4f",
+              times.front(), percentile(0.5), percentile(0.99), sum / static_cast<double>(count), times.back());
+    }
+    fprintf(file, "}");
+  }
+  fprintf(file, "\n  ]\n}\n");
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "nvh/cameramanipulator.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Camera path replayed by the benchmark: one camera per frame, looping. It can be recorded from
+// the UI, one line per frame with the eye, center, up and field of view.
+//
+struct CameraPath
+{
+  std::vector<nvh::CameraManipulator::Camera> cameras;
+
+  bool load(const std::string& filename);
+  bool save(const std::string& filename) const;
+
+  // Setting CameraManip to the camera of `frame`
+  void apply(uint32_t frame) const;
+
+  // A full turn around the center of `start`, in `frames` steps
+  static CameraPath orbit(const nvh::CameraManipulator::Camera& start, uint32_t frames);
+};
+
+//--------------------------------------------------------------------------------------------------
+// Deterministic benchmark: a camera path is replayed, the first frames warm up the caches and
+// the clocks, then every following frame records the GPU time of each pass (timestamp queries)
+// and the CPU time of the frame. The min, median and p99 of each are written to JSON.
+// Only ray_tracing_gltf runs it (--benchmark): it needs the headless mode of that sample.
+//
+// Frames must be waited on before the next one is recorded, as in headless mode:
+//   bench.beginFrame(cmdBuf);                // Camera of the frame, reset of the queries
+//   bench.beginPass(cmdBuf, "Ray trace");    // Outside of a render pass
+//   ...
+//   bench.endPass(cmdBuf);
+//   submit and wait
+//   bench.endFrame();                        // Reads the timestamps
+//
+class Benchmark
+{
+public:
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t warmupFrames);
+  void deinit();
+
+  void beginFrame(VkCommandBuffer cmdBuf);
+  void beginPass(VkCommandBuffer cmdBuf, const char* name);
+  void endPass(VkCommandBuffer cmdBuf);
+  void endFrame();
+
+  // Extra fields of the JSON file (scene, settings, ...)
+  void setInfo(const std::string& key, const std::string& value);
+  void setInfo(const std::string& key, double value);
+
+  bool writeJson(const std::string& filename) const;
+
+  CameraPath cameraPath;
+
+  uint32_t frame() const { return m_frame; }
+  uint32_t measuredFrames() const { return m_frame > m_warmupFrames ? m_frame - m_warmupFrames : 0; }
+
+private:
+  struct Pass
+  {
+    std::string        name;
+    bool               gpu{true};
+    std::vector<float> times;  // Milliseconds, one per measured frame
+  };
+  Pass& findPass(const std::string& name, bool gpu);
+
+  static constexpr uint32_t MAX_PASSES = 32;
+
+  VkDevice          m_device{VK_NULL_HANDLE};
+  VkPhysicalDevice  m_physicalDevice{VK_NULL_HANDLE};
+  VkQueryPool       m_queryPool{VK_NULL_HANDLE};
+  float             m_timestampPeriod{1.f};  // Nanoseconds per tick
+  uint64_t          m_timestampMask{~0ull};  // Valid bits of the timestamps
+  uint32_t          m_warmupFrames{0};
+  uint32_t          m_frame{0};
+  std::vector<Pass> m_passes;
+
+  // Passes of the frame being recorded, in the order of their queries
+  std::vector<std::string>              m_framePasses;
+  int                                   m_openPass{-1};
+  std::chrono::steady_clock::time_point m_frameStart;
+
+  std::vector<std::pair<std::string, std::string>> m_info;  // Key and JSON value
+};
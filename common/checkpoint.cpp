@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "nvh/nvprint.hpp"
+#include "nvvk/commands_vk.hpp"
+
+namespace {
+
+const char MAGIC[8] = "VKCKPT1";
+
+// The images follow the header and the state, aligned for vkCmdCopyImageToBuffer
+VkDeviceSize imagesOffset(size_t headerSize, size_t stateSize)
+{
+  return (headerSize + stateSize + 15) & ~VkDeviceSize(15);
+}
+
+bool writeFile(const std::string& filename, const uint8_t* data, size_t size)
+{
+  const std::string temporary = filename + ".tmp";
+  FILE*             file      = fopen(temporary.c_str(), "wb");
+  if(file == nullptr)
+    return false;
+  bool ok = fwrite(data, size, 1, file) == 1;
+  ok      = fclose(file) == 0 && ok;
+#ifdef _WIN32
+  ok = ok && (remove(filename.c_str()) == 0 || errno == ENOENT);  // rename() does not replace on Windows
+#endif
+  ok = ok && rename(temporary.c_str(), filename.c_str()) == 0;
+  if(!ok)
+    remove(temporary.c_str());
+  return ok;
+}
+
+}  // namespace
+
+
+void Checkpoint::setup(VkDevice device, nvvk::ResourceAllocator* allocator, uint32_t queueFamily)
+{
+  m_device      = device;
+  m_alloc       = allocator;
+  m_queueFamily = queueFamily;
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_cmdPool);
+
+  VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocInfo.commandPool        = m_cmdPool;
+  allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  vkAllocateCommandBuffers(m_device, &allocInfo, &m_cmdBuf);
+
+  VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  vkCreateFence(m_device, &fenceInfo, nullptr, &m_fence);
+}
+
+void Checkpoint::destroy()
+{
+  if(m_device == VK_NULL_HANDLE)
+    return;
+  flush();
+  if(m_data != nullptr)
+    m_alloc->unmap(m_buffer);
+  m_alloc->destroy(m_buffer);
+  m_data     = nullptr;
+  m_capacity = 0;
+  vkDestroyFence(m_device, m_fence, nullptr);
+  vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+  m_device = VK_NULL_HANDLE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The header and the state are written in the mapped buffer now, the images by the copy
+//
+bool Checkpoint::save(VkQueue                     queue,
+                      const std::string&          filename,
+                      const std::vector<VkImage>& images,
+                      const VkExtent2D&           size,
+                      uint64_t                    hash,
+                      const std::vector<uint8_t>& state)
+{
+  poll();
+  if(m_state != State::eFree)
+    return false;
+
+  const VkDeviceSize offset     = imagesOffset(sizeof(FileHeader), state.size());
+  const VkDeviceSize imageBytes = VkDeviceSize(size.width) * size.height * 4 * sizeof(float);
+  m_fileSize                    = offset + imageBytes * images.size();
+  if(m_fileSize > m_capacity)
+  {
+    if(m_data != nullptr)
+      m_alloc->unmap(m_buffer);
+    m_alloc->destroy(m_buffer);
+    m_buffer   = m_alloc->createBuffer(m_fileSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                           | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    m_data     = static_cast<uint8_t*>(m_alloc->map(m_buffer));
+    m_capacity = m_fileSize;
+  }
+
+  FileHeader header{};
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.hash       = hash;
+  header.width      = size.width;
+  header.height     = size.height;
+  header.imageCount = static_cast<uint32_t>(images.size());
+  header.stateSize  = static_cast<uint32_t>(state.size());
+  memset(m_data, 0, offset);
+  memcpy(m_data, &header, sizeof(header));
+  if(!state.empty())
+    memcpy(m_data + sizeof(header), state.data(), state.size());
+
+  vkResetCommandBuffer(m_cmdBuf, 0);
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(m_cmdBuf, &beginInfo);
+
+  // The images stay in the GENERAL layout, the writes of the previous submissions must be visible
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(m_cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+  for(size_t i = 0; i < images.size(); i++)
+  {
+    VkBufferImageCopy region{};
+    region.bufferOffset     = offset + imageBytes * i;
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent      = {size.width, size.height, 1};
+    vkCmdCopyImageToBuffer(m_cmdBuf, images[i], VK_IMAGE_LAYOUT_GENERAL, m_buffer.buffer, 1, &region);
+  }
+  // The following submissions keep accumulating in the images: they wait for the copy
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(m_cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+  vkEndCommandBuffer(m_cmdBuf);
+
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &m_cmdBuf;
+  vkResetFences(m_device, 1, &m_fence);
+  if(vkQueueSubmit(queue, 1, &submitInfo, m_fence) != VK_SUCCESS)
+    return false;
+
+  m_filename = filename;
+  m_state    = State::eCopying;
+  return true;
+}
+
+void Checkpoint::poll()
+{
+  if(m_state == State::eCopying && vkGetFenceStatus(m_device, m_fence) == VK_SUCCESS)
+  {
+    const uint8_t* data     = m_data;
+    size_t         fileSize = static_cast<size_t>(m_fileSize);
+    std::string    filename = m_filename;
+    m_writing = std::async(std::launch::async, [=]() { return writeFile(filename, data, fileSize); });
+    m_state   = State::eWriting;
+  }
+  if(m_state == State::eWriting && m_writing.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    finishWrite();
+}
+
+bool Checkpoint::flush()
+{
+  if(m_state == State::eCopying)
+    vkWaitForFences(m_device, 1, &m_fence, VK_TRUE, UINT64_MAX);
+  poll();
+  if(m_state == State::eWriting)
+  {
+    m_writing.wait();
+    return finishWrite();
+  }
+  return true;
+}
+
+bool Checkpoint::finishWrite()
+{
+  bool ok = m_writing.get();
+  if(ok)
+    m_saved++;
+  else
+  {
+    m_failed++;
+    LOGE("Could not write the checkpoint %s\n", m_filename.c_str());
+  }
+  m_state = State::eFree;
+  return ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The file is read in a staging buffer and copied to the images, waiting for the copy
+//
+Checkpoint::LoadResult Checkpoint::load(const std::string&          filename,
+                                        const std::vector<VkImage>& images,
+                                        const VkExtent2D&           size,
+                                        uint64_t                    hash,
+                                        std::vector<uint8_t>&       state)
+{
+  FILE* file = fopen(filename.c_str(), "rb");
+  if(file == nullptr)
+    return LoadResult::eMissing;
+
+  FileHeader header{};
+  if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+  {
+    fclose(file);
+    return LoadResult::eInvalid;
+  }
+  if(header.hash != hash || header.width != size.width || header.height != size.height || header.imageCount != images.size())
+  {
+    fclose(file);
+    return LoadResult::eMismatch;
+  }
+
+  const VkDeviceSize offset     = imagesOffset(sizeof(FileHeader), header.stateSize);
+  const VkDeviceSize imageBytes = VkDeviceSize(size.width) * size.height * 4 * sizeof(float);
+  const VkDeviceSize dataSize   = offset - sizeof(FileHeader) + imageBytes * images.size();
+
+  nvvk::Buffer staging = m_alloc->createBuffer(dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  uint8_t* data = static_cast<uint8_t*>(m_alloc->map(staging));
+  bool     ok   = fread(data, static_cast<size_t>(dataSize), 1, file) == 1;
+  fclose(file);
+  if(ok)
+    state.assign(data, data + header.stateSize);
+  m_alloc->unmap(staging);
+
+  if(ok)
+  {
+    nvvk::CommandPool cmdPool(m_device, m_queueFamily);
+    VkCommandBuffer   cmdBuf = cmdPool.createCommandBuffer();
+    for(size_t i = 0; i < images.size(); i++)
+    {
+      VkBufferImageCopy region{};
+      region.bufferOffset     = offset - sizeof(FileHeader) + imageBytes * i;
+      region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+      region.imageExtent      = {size.width, size.height, 1};
+      vkCmdCopyBufferToImage(cmdBuf, staging.buffer, images[i], VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    }
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0,
+                         nullptr, 0, nullptr);
+    cmdPool.submitAndWait(cmdBuf);
+  }
+  m_alloc->destroy(staging);
+  return ok ? LoadResult::eLoaded : LoadResult::eInvalid;
+}
+
+uint64_t Checkpoint::hashBytes(const void* data, size_t size, uint64_t hash)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for(size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
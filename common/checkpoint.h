@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <future>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "nvvk/resourceallocator_vk.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Saves a progressive accumulation to disk, to resume it after the process ended.
+//
+// A checkpoint holds RGBA32F images of the same size (the accumulation and its per-pixel
+// statistics), a block of host state (frame counter, seed), and a hash of everything the
+// accumulation depends on (scene, camera, settings). A checkpoint with another hash or size is
+// never loaded.
+//
+// save() copies the images after the work already on the queue, in its own submission, and
+// returns without waiting. poll() hands the copy, once its fence is signaled, to a thread which
+// writes a temporary file and renames it: a process killed while saving leaves the previous
+// checkpoint intact. Only one checkpoint is saved at a time.
+//
+// Usage:
+//   switch(checkpoint.load("render.ckpt", images, size, hash, state))  // At startup
+//   ...
+//   checkpoint.save(queue, "render.ckpt", images, size, hash, state);  // At intervals
+//   checkpoint.poll();                                                  // Every frame
+//   checkpoint.destroy();                                               // Waits for the file
+//
+class Checkpoint
+{
+public:
+  void setup(VkDevice device, nvvk::ResourceAllocator* allocator, uint32_t queueFamily);
+  void destroy();
+
+  // The images must be in the GENERAL layout. Returns false while the previous checkpoint is saved.
+  bool save(VkQueue                     queue,
+            const std::string&          filename,
+            const std::vector<VkImage>& images,
+            const VkExtent2D&           size,
+            uint64_t                    hash,
+            const std::vector<uint8_t>& state);
+  void poll();
+  bool flush();  // Waits until the last checkpoint is on disk, false if it could not be written
+
+  enum class LoadResult
+  {
+    eMissing,   // No file: starting from the beginning
+    eMismatch,  // Saved for another scene, camera, settings or size
+    eInvalid,   // Not a checkpoint, or truncated
+    eLoaded,
+  };
+  // Uploads the saved images in `images`, and returns the saved state
+  LoadResult load(const std::string&          filename,
+                  const std::vector<VkImage>& images,
+                  const VkExtent2D&           size,
+                  uint64_t                    hash,
+                  std::vector<uint8_t>&       state);
+
+  uint32_t getSavedCount() const { return m_saved; }
+  uint32_t getFailedCount() const { return m_failed; }
+
+  // FNV-1a, chained through `hash`
+  static uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
+  template <typename T>
+  static uint64_t hashValue(const T& value, uint64_t hash)
+  {
+    return hashBytes(&value, sizeof(T), hash);
+  }
+
+private:
+  enum class State
+  {
+    eFree,
+    eCopying,  // Submitted, fence not signaled yet
+    eWriting,  // Owned by the writing thread
+  };
+  struct FileHeader
+  {
+    char     magic[8];  // "VKCKPT1"
+    uint64_t hash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t imageCount;
+    uint32_t stateSize;
+  };
+
+  bool finishWrite();
+
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  uint32_t                 m_queueFamily{0};
+  VkCommandPool            m_cmdPool{VK_NULL_HANDLE};
+  VkCommandBuffer          m_cmdBuf{VK_NULL_HANDLE};
+  VkFence                  m_fence{VK_NULL_HANDLE};
+
+  nvvk::Buffer      m_buffer;  // Header, state and images, as in the file
+  uint8_t*          m_data{nullptr};
+  VkDeviceSize      m_capacity{0};
+  VkDeviceSize      m_fileSize{0};
+  std::string       m_filename;
+  State             m_state{State::eFree};
+  std::future<bool> m_writing;
+
+  uint32_t m_saved{0};
+  uint32_t m_failed{0};
+};
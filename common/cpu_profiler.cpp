@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "cpu_profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace {
+
+struct Zone
+{
+  const char* name;
+  int64_t     startNs;
+  int64_t     endNs;  // -1 while open
+};
+
+struct ThreadBuffer
+{
+  uint32_t            id{0};
+  std::string         name;
+  std::vector<Zone>   zones;
+  std::vector<size_t> stack;  // Open zones
+};
+
+// Origin of the times, taken when the program is loaded
+const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+// Buffers of all threads which recorded zones. They are kept after their thread ended.
+std::mutex                                 g_registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> g_registry;
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+ThreadBuffer& threadBuffer()
+{
+  if(t_buffer == nullptr)
+  {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->zones.reserve(1024);
+
+    std::lock_guard<std::mutex> lock(g_registryMutex);
+    buffer->id   = static_cast<uint32_t>(g_registry.size()) + 1;
+    buffer->name = buffer->id == 1 ? "Main thread" : "Thread " + std::to_string(buffer->id);
+    t_buffer     = buffer.get();
+    g_registry.push_back(std::move(buffer));
+  }
+  return *t_buffer;
+}
+
+int64_t nowNs()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+}  // namespace
+
+void CpuProfiler::begin(const char* name)
+{
+  ThreadBuffer& buffer = threadBuffer();
+  buffer.stack.push_back(buffer.zones.size());
+  buffer.zones.push_back({name, nowNs(), -1});
+}
+
+void CpuProfiler::end()
+{
+  ThreadBuffer& buffer = threadBuffer();
+  if(buffer.stack.empty())
+    return;
+  buffer.zones[buffer.stack.back()].endNs = nowNs();
+  buffer.stack.pop_back();
+}
+
+void CpuProfiler::setThreadName(const char* name)
+{
+  threadBuffer().name = name;
+}
+
+double CpuProfiler::elapsedMs()
+{
+  return static_cast<double>(nowNs()) * 1e-6;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Complete events ("ph": "X") on one track per thread. Nested zones become the levels of the
+// flame graph. Zones still open are left out.
+//
+bool CpuProfiler::writeChromeTrace(const std::string& filename)
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == nullptr)
+    return false;
+
+  std::lock_guard<std::mutex> lock(g_registryMutex);
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+  const char* separator = "\n";
+  for(const auto& buffer : g_registry)
+  {
+    fprintf(file, "%s  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+            separator, buffer->id, buffer->name.c_str());
+    separator = ",\n";
+    for(const auto& zone : buffer->zones)
+    {
+      if(zone.endNs < 0)
+        continue;
+      fprintf(file, ",\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", zone.name,
+              buffer->id, static_cast<double>(zone.startNs) * 1e-3, static_cast<double>(zone.endNs - zone.startNs) * 1e-3);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  return true;
+}
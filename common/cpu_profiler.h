@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <string>
+
+//--------------------------------------------------------------------------------------------------
+// Scoped CPU zones, to see the critical path of the startup (time to first frame) as a flame graph.
+//
+// Each thread appends its zones to its own buffer, without locking. A buffer is registered, under
+// a mutex, the first time its thread records a zone. Zone names must outlive the profiler (string
+// literals). writeChromeTrace() must be called while no thread is recording.
+//
+// Usage:
+//   void load()
+//   {
+//     CPU_ZONE("Load");
+//     ...
+//   }
+//   CpuProfiler::writeChromeTrace("startup_trace.json");  // chrome://tracing or Perfetto
+//
+class CpuProfiler
+{
+public:
+  static void begin(const char* name);
+  static void end();
+
+  // Name of the calling thread in the trace
+  static void setThreadName(const char* name);
+
+  // Milliseconds since the start of the program
+  static double elapsedMs();
+
+  static bool writeChromeTrace(const std::string& filename);
+};
+
+class CpuZone
+{
+public:
+  explicit CpuZone(const char* name) { CpuProfiler::begin(name); }
+  ~CpuZone() { CpuProfiler::end(); }
+  CpuZone(const CpuZone&) = delete;
+  CpuZone& operator=(const CpuZone&) = delete;
+};
+
+#define CPU_ZONE_CONCAT_(a, b) a##b
+#define CPU_ZONE_CONCAT(a, b) CPU_ZONE_CONCAT_(a, b)
+#define CPU_ZONE(name) CpuZone CPU_ZONE_CONCAT(cpuZone, __LINE__)(name)
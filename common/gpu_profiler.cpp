@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+//--------------------------------------------------------------------------------------------------
+// One range of MAX_QUERIES_PER_FRAME queries per frame in flight. Without timestamp support on the
+// queue, the labels are still forwarded to DebugUtil and CPU labels are still timed.
+//
+void GpuProfiler::init(VkDevice         device,
+                       VkPhysicalDevice physicalDevice,
+                       uint32_t         queueFamily,
+                       uint32_t         framesInFlight,
+                       nvvk::DebugUtil* debug,
+                       bool             useTimestamp2)
+{
+  m_device        = device;
+  m_debug         = debug;
+  m_useTimestamp2 = useTimestamp2;
+  m_slots.assign(framesInFlight, Slot());
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+  if(validBits == 0)
+    return;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_timestampPeriod = properties.limits.timestampPeriod;
+  m_timestampMask   = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo createInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  createInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+  createInfo.queryCount = MAX_QUERIES_PER_FRAME * framesInFlight;
+  vkCreateQueryPool(m_device, &createInfo, nullptr, &m_queryPool);
+}
+
+void GpuProfiler::deinit()
+{
+  if(m_queryPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+  m_queryPool = VK_NULL_HANDLE;
+  m_slots.clear();
+  m_history.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// The slot is free again: its last frame is resolved, then it starts recording the new one
+//
+void GpuProfiler::beginFrame(uint32_t slot)
+{
+  if(slot >= m_slots.size())
+    return;
+  m_slot = slot;
+  resolve(m_slots[slot], slot);
+
+  Slot& s = m_slots[slot];
+  s.sections.clear();
+  s.stack.clear();
+  s.queryCount = 0;
+  s.reset      = false;
+}
+
+void GpuProfiler::beginLabel(VkCommandBuffer cmdBuf, const char* name)
+{
+  if(m_debug != nullptr)
+    m_debug->beginLabel(cmdBuf, name);
+  if(m_slot >= m_slots.size())
+    return;
+
+  Slot&   s = m_slots[m_slot];
+  Section section;
+  section.name  = name;
+  section.depth = static_cast<int>(s.stack.size());
+  if(supported() && s.queryCount + 2 <= MAX_QUERIES_PER_FRAME)
+  {
+    // The whole range of the slot is reset once, by the first command buffer of the frame
+    if(!s.reset)
+    {
+      vkCmdResetQueryPool(cmdBuf, m_queryPool, m_slot * MAX_QUERIES_PER_FRAME, MAX_QUERIES_PER_FRAME);
+      s.reset = true;
+    }
+    section.query = m_slot * MAX_QUERIES_PER_FRAME + s.queryCount;
+    s.queryCount += 2;
+    writeTimestamp(cmdBuf, section.query, true);
+  }
+  s.stack.push_back(s.sections.size());
+  s.sections.push_back(section);
+}
+
+void GpuProfiler::endLabel(VkCommandBuffer cmdBuf)
+{
+  if(m_debug != nullptr)
+    m_debug->endLabel(cmdBuf);
+  if(m_slot >= m_slots.size() || m_slots[m_slot].stack.empty())
+    return;
+
+  Slot&    s       = m_slots[m_slot];
+  Section& section = s.sections[s.stack.back()];
+  s.stack.pop_back();
+  if(section.query != ~0u)
+    writeTimestamp(cmdBuf, section.query + 1, false);
+}
+
+void GpuProfiler::beginCpuLabel(const char* name)
+{
+  if(m_slot >= m_slots.size())
+    return;
+
+  Slot&   s = m_slots[m_slot];
+  Section section;
+  section.name       = name;
+  section.depth      = static_cast<int>(s.stack.size());
+  section.cpu        = true;
+  section.cpuStartMs = cpuNowMs();
+  s.stack.push_back(s.sections.size());
+  s.sections.push_back(section);
+}
+
+void GpuProfiler::endCpuLabel()
+{
+  if(m_slot >= m_slots.size() || m_slots[m_slot].stack.empty())
+    return;
+
+  Slot& s = m_slots[m_slot];
+  s.sections[s.stack.back()].cpuEndMs = cpuNowMs();
+  s.stack.pop_back();
+}
+
+//--------------------------------------------------------------------------------------------------
+// With synchronization2, both timestamps are written once the previous commands are done, so the
+// sections of consecutive passes do not overlap. Otherwise the start is taken at the top of the pipe.
+//
+void GpuProfiler::writeTimestamp(VkCommandBuffer cmdBuf, uint32_t query, bool begin)
+{
+  if(m_useTimestamp2)
+  {
+    vkCmdWriteTimestamp2KHR(cmdBuf, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR, m_queryPool, query);
+  }
+  else
+  {
+    VkPipelineStageFlagBits stage = begin ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdWriteTimestamp(cmdBuf, stage, m_queryPool, query);
+  }
+}
+
+double GpuProfiler::cpuNowMs() const
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_cpuEpoch).count();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reading the queries of the slot without waiting. When they are not all available (the slot was
+// never submitted), the previous timings are kept.
+//
+void GpuProfiler::resolve(Slot& slot, uint32_t slotIndex)
+{
+  if(slot.sections.empty())
+    return;
+
+  std::vector<uint64_t> timestamps(slot.queryCount);
+  if(slot.queryCount > 0)
+  {
+    VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, slotIndex * MAX_QUERIES_PER_FRAME, slot.queryCount,
+                                            timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT);
+    if(result != VK_SUCCESS)
+      return;
+  }
+
+  // Origins of the frame: first start of each timer
+  uint64_t gpuStart = ~0ull;
+  double   cpuStart = 0;
+  bool     hasCpu   = false;
+  for(const auto& section : slot.sections)
+  {
+    if(section.cpu)
+    {
+      cpuStart = hasCpu ? std::min(cpuStart, section.cpuStartMs) : section.cpuStartMs;
+      hasCpu   = true;
+    }
+    else if(section.query != ~0u)
+    {
+      gpuStart = std::min(gpuStart, timestamps[section.query - slotIndex * MAX_QUERIES_PER_FRAME]);
+    }
+  }
+  if(gpuStart != ~0ull && !m_hasGpuEpoch)
+  {
+    m_gpuEpoch    = gpuStart;
+    m_hasGpuEpoch = true;
+  }
+
+  auto ticksToMs = [&](uint64_t ticks) {
+    return static_cast<double>(ticks & m_timestampMask) * m_timestampPeriod * 1e-6;
+  };
+
+  m_timings.clear();
+  std::vector<TraceEvent>  events;
+  std::vector<std::string> path;  // Names of the parents, to average each node separately
+  for(const auto& section : slot.sections)
+  {
+    double startMs, durationMs, epochMs;
+    if(section.cpu)
+    {
+      startMs    = section.cpuStartMs - cpuStart;
+      durationMs = section.cpuEndMs - section.cpuStartMs;
+      epochMs    = section.cpuStartMs;
+    }
+    else if(section.query != ~0u)
+    {
+      uint32_t local = section.query - slotIndex * MAX_QUERIES_PER_FRAME;
+      startMs        = ticksToMs(timestamps[local] - gpuStart);
+      durationMs     = ticksToMs(timestamps[local + 1] - timestamps[local]);
+      epochMs        = ticksToMs(timestamps[local] - m_gpuEpoch);
+    }
+    else
+    {
+      continue;
+    }
+
+    path.resize(section.depth);
+    path.push_back(section.name);
+    std::string key;
+    for(const auto& name : path)
+      key += "/" + name;
+
+    auto  found = m_averages.find(key);
+    float avgMs = found == m_averages.end() ? static_cast<float>(durationMs) :
+                                              found->second + smoothing * (static_cast<float>(durationMs) - found->second);
+    m_averages[key] = avgMs;
+
+    m_timings.push_back({section.name, section.depth, section.cpu, static_cast<float>(startMs),
+                         static_cast<float>(durationMs), avgMs});
+    events.push_back({section.name, section.cpu, epochMs * 1000.0, durationMs * 1000.0});
+  }
+
+  m_history.push_back(std::move(events));
+  while(m_history.size() > static_cast<size_t>(std::max(historyFrames, 1)))
+    m_history.pop_front();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Complete events ("ph": "X"), GPU sections on one track and CPU sections on another. The two
+// timers have different origins, so the tracks are not aligned with each other.
+//
+bool GpuProfiler::writeChromeTrace(const std::string& filename) const
+{
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == nullptr)
+    return false;
+
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  fprintf(file, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"GPU\"}},\n");
+  fprintf(file, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \"CPU\"}}");
+  for(const auto& frame : m_history)
+  {
+    for(const auto& event : frame)
+    {
+      fprintf(file, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+              event.name.c_str(), event.cpu ? "cpu" : "gpu", event.cpu ? 2 : 1, event.startUs, event.durationUs);
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <chrono>
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "nvvk/debug_util_vk.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// GPU profiler on top of the debug labels: each label also writes a pair of timestamps, so the
+// passes seen in external tools are the ones timed in the application.
+//
+// The queries of each frame in flight live in their own range of the pool. They are read when the
+// frame slot comes back (its fence was waited on), without waiting, so the timings shown are those
+// of the last frame which used the slot. Labels can be nested and give a tree of passes.
+//
+// Work submitted by other objects in blocking calls (for example the acceleration structure
+// updates of nvvk::RaytracingBuilderKHR) can be timed on the host with CPU labels.
+//
+// Usage, for each frame in flight `slot`:
+//   profiler.beginFrame(slot);              // After the fence of the slot was waited on
+//   profiler.beginLabel(cmdBuf, "Pass");    // The first label of a frame must be outside of a render pass
+//   ...
+//   profiler.endLabel(cmdBuf);
+//
+class GpuProfiler
+{
+public:
+  // With `useTimestamp2`, queries are written with vkCmdWriteTimestamp2KHR (VK_KHR_synchronization2)
+  void init(VkDevice         device,
+            VkPhysicalDevice physicalDevice,
+            uint32_t         queueFamily,
+            uint32_t         framesInFlight,
+            nvvk::DebugUtil* debug,
+            bool             useTimestamp2);
+  void deinit();
+
+  void beginFrame(uint32_t slot);
+  void beginLabel(VkCommandBuffer cmdBuf, const char* name);
+  void endLabel(VkCommandBuffer cmdBuf);
+  void beginCpuLabel(const char* name);
+  void endCpuLabel();
+
+  bool supported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+  // Sections of the last resolved frame, in the order they started (depth-first)
+  struct Timing
+  {
+    std::string name;
+    int         depth{0};
+    bool        cpu{false};     // Timed on the host
+    float       startMs{0};     // From the start of the first section of the frame, of the same timer
+    float       durationMs{0};  // Last measured duration
+    float       avgMs{0};       // Moving average of the duration
+  };
+  const std::vector<Timing>& getTimings() const { return m_timings; }
+
+  // The last resolved frames in the Chrome trace event format (chrome://tracing, Perfetto)
+  bool writeChromeTrace(const std::string& filename) const;
+
+  float smoothing{0.05f};    // Weight of the new measurement in the moving averages
+  int   historyFrames{256};  // Frames kept for the trace
+
+private:
+  struct Section
+  {
+    std::string name;
+    int         depth{0};
+    bool        cpu{false};
+    uint32_t    query{~0u};  // First of the two queries, ~0u when out of queries
+    double      cpuStartMs{0};
+    double      cpuEndMs{0};
+  };
+  struct Slot
+  {
+    std::vector<Section> sections;
+    std::vector<size_t>  stack;  // Open sections
+    uint32_t             queryCount{0};
+    bool                 reset{false};  // Queries of the slot were reset in a command buffer
+  };
+  struct TraceEvent
+  {
+    std::string name;
+    bool        cpu{false};
+    double      startUs{0};  // From the first resolved frame, of the same timer
+    double      durationUs{0};
+  };
+
+  void   resolve(Slot& slot, uint32_t slotIndex);
+  void   writeTimestamp(VkCommandBuffer cmdBuf, uint32_t query, bool begin);
+  double cpuNowMs() const;
+
+  static constexpr uint32_t MAX_QUERIES_PER_FRAME = 128;
+
+  VkDevice          m_device{VK_NULL_HANDLE};
+  VkQueryPool       m_queryPool{VK_NULL_HANDLE};
+  nvvk::DebugUtil*  m_debug{nullptr};
+  bool              m_useTimestamp2{false};
+  float             m_timestampPeriod{1.f};  // Nanoseconds per tick
+  uint64_t          m_timestampMask{~0ull};  // Valid bits of the timestamps
+  std::vector<Slot> m_slots;
+  uint32_t          m_slot{0};
+
+  std::vector<Timing>                    m_timings;
+  std::unordered_map<std::string, float> m_averages;  // Per path of the section in the tree
+
+  std::deque<std::vector<TraceEvent>>   m_history;
+  uint64_t                              m_gpuEpoch{0};  // First timestamp resolved, origin of the GPU trace
+  bool                                  m_hasGpuEpoch{false};
+  std::chrono::steady_clock::time_point m_cpuEpoch{std::chrono::steady_clock::now()};
+};
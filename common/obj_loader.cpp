@@ -20,16 +20,22 @@
 // This file exist only to do the implementation of tiny obj loader
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "obj_loader.h"
-#include "nvh/nvprint.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include "cpu_profiler.h"
 
 
 void ObjLoader::loadModel(const std::string& filename)
 {
+  CPU_ZONE("ObjLoader::loadModel");
+
   tinyobj::ObjReader reader;
   reader.ParseFromFile(filename);
   if(!reader.Valid())
   {
-    LOGE("Cannot load %s: %s", filename.c_str(), reader.Error().c_str());
+    // Plain stderr: the offline baker loads the models too, without nvpro_core
+    fprintf(stderr, "Cannot load %s: %s\n", filename.c_str(), reader.Error().c_str());
     assert(reader.Valid());
   }
 
@@ -119,4 +125,20 @@ void ObjLoader::loadModel(const std::string& filename)
       v2.nrm      = n;
     }
   }
+
+  // Bounding sphere around the center of the bounding box
+  if(!m_vertices.empty())
+  {
+    glm::vec3 bmin = m_vertices[0].pos;
+    glm::vec3 bmax = m_vertices[0].pos;
+    for(const auto& v : m_vertices)
+    {
+      bmin = glm::min(bmin, v.pos);
+      bmax = glm::max(bmax, v.pos);
+    }
+    m_boundsCenter = (bmin + bmax) * 0.5f;
+    m_boundsRadius = 0.f;
+    for(const auto& v : m_vertices)
+      m_boundsRadius = std::max(m_boundsRadius, glm::length(v.pos - m_boundsCenter));
+  }
 }
@@ -69,4 +69,8 @@ public:
   std::vector<MaterialObj> m_materials;
   std::vector<std::string> m_textures;
   std::vector<int32_t>     m_matIndx;
+
+  // Bounding sphere of all vertices, computed at load time
+  glm::vec3 m_boundsCenter{0.f};
+  float     m_boundsRadius{0.f};
 };
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ray_budget.h"
+
+#include <algorithm>
+#include <cmath>
+
+//--------------------------------------------------------------------------------------------------
+// Creating two timestamp queries per frame in flight. Without timestamp support on the queue, the
+// controller stays disabled and update() returns the current sample count.
+//
+void RayBudget::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight)
+{
+  m_device = device;
+  m_slots.assign(framesInFlight, Slot());
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+  uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+  if(validBits == 0)
+    return;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_timestampPeriod = properties.limits.timestampPeriod;
+  m_timestampMask   = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  VkQueryPoolCreateInfo createInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  createInfo.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+  createInfo.queryCount = 2 * framesInFlight;
+  vkCreateQueryPool(m_device, &createInfo, nullptr, &m_queryPool);
+}
+
+void RayBudget::deinit()
+{
+  if(m_queryPool != VK_NULL_HANDLE)
+    vkDestroyQueryPool(m_device, m_queryPool, nullptr);
+  m_queryPool = VK_NULL_HANDLE;
+  m_slots.clear();
+}
+
+void RayBudget::reset()
+{
+  avgMs       = 0;
+  avgSampleMs = 0;
+  for(auto& slot : m_slots)
+    slot.written = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reading back the timestamps of the slot and choosing the sample count of the next frame
+//
+int RayBudget::update(uint32_t slot)
+{
+  if(!supported() || slot >= m_slots.size() || !m_slots[slot].written)
+    return samples;
+
+  // The fence of the slot was waited on, the results are available
+  uint64_t timestamps[2] = {0, 0};
+  VkResult result = vkGetQueryPoolResults(m_device, m_queryPool, 2 * slot, 2, sizeof(timestamps), timestamps,
+                                          sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  m_slots[slot].written = false;
+  if(result != VK_SUCCESS || m_slots[slot].samples <= 0)
+    return samples;
+
+  uint64_t ticks = (timestamps[1] - timestamps[0]) & m_timestampMask;
+  lastMs         = static_cast<float>(static_cast<double>(ticks) * m_timestampPeriod * 1e-6);
+  float sampleMs = lastMs / static_cast<float>(m_slots[slot].samples);
+
+  // The first measurement initializes the averages
+  avgMs       = avgMs > 0 ? avgMs + smoothing * (lastMs - avgMs) : lastMs;
+  avgSampleMs = avgSampleMs > 0 ? avgSampleMs + smoothing * (sampleMs - avgSampleMs) : sampleMs;
+
+  if(!enabled || avgSampleMs <= 0)
+    return samples;
+
+  // Inside the band: keeping the sample count. Outside: jumping toward the count meeting the
+  // target, limited to a factor 2 since the average lags behind the change.
+  if(avgMs > targetMs * (1.f + hysteresis) || avgMs < targetMs * (1.f - hysteresis))
+  {
+    int wanted = static_cast<int>(std::floor(targetMs / avgSampleMs));
+    wanted     = std::clamp(wanted, std::max(samples / 2, 1), samples * 2);
+    samples    = std::clamp(wanted, minSamples, maxSamples);
+  }
+  return samples;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Timestamps around the passes, which trace `samples` samples per pixel
+//
+void RayBudget::begin(VkCommandBuffer cmdBuf, uint32_t slot)
+{
+  if(!supported() || slot >= m_slots.size())
+    return;
+  vkCmdResetQueryPool(cmdBuf, m_queryPool, 2 * slot, 2);
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, 2 * slot);
+  m_slots[slot].samples = samples;
+}
+
+void RayBudget::end(VkCommandBuffer cmdBuf, uint32_t slot)
+{
+  if(!supported() || slot >= m_slots.size())
+    return;
+  vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2 * slot + 1);
+  m_slots[slot].written = true;
+}
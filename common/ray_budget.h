@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+//--------------------------------------------------------------------------------------------------
+// Feedback controller of the number of samples traced per frame, from the GPU time of the passes.
+//
+// A pair of timestamps brackets the ray tracing passes of each frame in flight. When the frame slot
+// comes back (its fence was waited on), its time gives the cost of one sample, smoothed with a moving
+// average. The sample count only changes when the smoothed time leaves the band `targetMs ± hysteresis`,
+// and by at most a factor 2 per frame, so it settles instead of oscillating on noisy timings.
+//
+// Usage, for each frame in flight `slot`:
+//   budget.update(slot);          // After the fence of the slot was waited on
+//   if(!budget.enabled)           // Otherwise budget.samples is the count to trace
+//     budget.samples = uiSamples;
+//   budget.begin(cmdBuf, slot);   // Outside of a render pass
+//   ... passes tracing `samples` samples per pixel ...
+//   budget.end(cmdBuf, slot);
+//
+class RayBudget
+{
+public:
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t framesInFlight);
+  void deinit();
+
+  // Reads the time of the last frame which used `slot`, returns the samples per pixel to trace
+  // (unchanged when disabled)
+  int  update(uint32_t slot);
+  void begin(VkCommandBuffer cmdBuf, uint32_t slot);
+  void end(VkCommandBuffer cmdBuf, uint32_t slot);
+
+  // Restarts the averages, when the work per sample changed (resolution, scene, settings)
+  void reset();
+
+  bool supported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+  // Settings
+  bool  enabled{false};
+  float targetMs{8.f};     // GPU time budget of the passes
+  float hysteresis{0.1f};  // Relative band around the target in which the sample count stays
+  float smoothing{0.1f};   // Weight of the new measurement in the moving averages
+  int   minSamples{1};
+  int   maxSamples{64};
+
+  // State, for display
+  int   samples{1};      // Current samples per pixel
+  float avgMs{0};        // Moving average of the GPU time of the passes
+  float avgSampleMs{0};  // Moving average of the GPU time of one sample per pixel
+  float lastMs{0};       // Last measured GPU time
+
+private:
+  struct Slot
+  {
+    bool written{false};  // Timestamps were recorded and not read yet
+    int  samples{0};      // Samples traced in that frame
+  };
+
+  VkDevice          m_device{VK_NULL_HANDLE};
+  VkQueryPool       m_queryPool{VK_NULL_HANDLE};
+  float             m_timestampPeriod{1.f};  // Nanoseconds per tick
+  uint64_t          m_timestampMask{~0ull};  // Valid bits of the timestamps
+  std::vector<Slot> m_slots;
+};
@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+namespace {
+
+// Same functions as in shaders/sampler.glsl
+uint32_t hash(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+uint32_t reverseBits(uint32_t x)
+{
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+  x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+  x = reverseBits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverseBits(x);
+}
+
+const uint32_t s_weyl[8] = {0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+                            0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u};
+
+float toFloat(uint32_t x)
+{
+  return static_cast<float>(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// Same as tea() of random.glsl, used by the samples to seed the random sampler
+uint32_t tea(uint32_t v0, uint32_t v1)
+{
+  uint32_t s0 = 0;
+  for(uint32_t n = 0; n < 16; n++)
+  {
+    s0 += 0x9e3779b9;
+    v0 += ((v1 << 4) + 0xa341316c) ^ (v1 + s0) ^ ((v1 >> 5) + 0xc8013ea4);
+    v1 += ((v0 << 4) + 0xad90777d) ^ (v0 + s0) ^ ((v0 >> 5) + 0x7e95761e);
+  }
+  return v0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Primitive polynomials and initial direction numbers of dimensions 2 to 8, from
+// S. Joe and F. Y. Kuo, "Constructing Sobol sequences with better two-dimensional projections" (new-joe-kuo-6.21201)
+//
+struct SobolPolynomial
+{
+  uint32_t s;     // Degree
+  uint32_t a;     // Coefficients
+  uint32_t m[5];  // Initial direction numbers
+};
+
+const SobolPolynomial s_sobolPolynomials[SOBOL_DIMENSIONS - 1] = {
+    {1, 0, {1}},          {2, 1, {1, 3}},        {3, 1, {1, 3, 1}},        {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}}, {4, 4, {1, 3, 5, 13}}, {5, 2, {1, 1, 5, 5, 17}},
+};
+
+std::vector<uint32_t> makeSobolDirections()
+{
+  std::vector<uint32_t> directions(SOBOL_DIMENSIONS * SOBOL_BITS);
+
+  // First dimension: van der Corput sequence
+  for(uint32_t i = 0; i < SOBOL_BITS; i++)
+    directions[i] = 1u << (31 - i);
+
+  for(uint32_t dim = 1; dim < SOBOL_DIMENSIONS; dim++)
+  {
+    const SobolPolynomial& poly = s_sobolPolynomials[dim - 1];
+    uint32_t*              v    = &directions[dim * SOBOL_BITS];
+    for(uint32_t i = 0; i < SOBOL_BITS; i++)
+    {
+      if(i < poly.s)
+      {
+        v[i] = poly.m[i] << (31 - i);
+        continue;
+      }
+      v[i] = v[i - poly.s] ^ (v[i - poly.s] >> poly.s);
+      for(uint32_t k = 1; k < poly.s; k++)
+        v[i] ^= ((poly.a >> (poly.s - 1 - k)) & 1) * v[i - k];
+    }
+  }
+  return directions;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Void-and-cluster (Ulichney 1993) on a toroidal tile. The energy of a pixel is the sum of a
+// Gaussian of the distance to all set pixels; the tightest cluster is the set pixel of highest
+// energy and the largest void the empty pixel of lowest energy. Pixels are ranked by the order
+// in which they are removed from the initial pattern, then added to it; the rank is the noise value.
+//
+std::vector<float> makeBlueNoise(uint32_t seed)
+{
+  const int   size  = BLUE_NOISE_SIZE;
+  const int   count = size * size;
+  const float sigma = 1.5f;
+
+  std::vector<float> gaussian(count);
+  for(int y = 0; y < size; y++)
+  {
+    for(int x = 0; x < size; x++)
+    {
+      float dx               = static_cast<float>(std::min(x, size - x));
+      float dy               = static_cast<float>(std::min(y, size - y));
+      gaussian[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+    }
+  }
+
+  std::vector<uint8_t> pattern(count, 0);
+  std::vector<float>   energy(count, 0.f);
+
+  auto setPixel = [&](int p, bool value) {
+    pattern[p] = value ? 1 : 0;
+    float sign = value ? 1.f : -1.f;
+    int   px   = p % size;
+    int   py   = p / size;
+    for(int y = 0; y < size; y++)
+    {
+      const float* g = &gaussian[((y - py + size) % size) * size];
+      for(int x = 0; x < size; x++)
+        energy[y * size + x] += sign * g[(x - px + size) % size];
+    }
+  };
+  auto tightestCluster = [&]() {
+    int   best = 0;
+    float e    = -std::numeric_limits<float>::max();
+    for(int i = 0; i < count; i++)
+    {
+      if(pattern[i] && energy[i] > e)
+      {
+        e    = energy[i];
+        best = i;
+      }
+    }
+    return best;
+  };
+  auto largestVoid = [&]() {
+    int   best = 0;
+    float e    = std::numeric_limits<float>::max();
+    for(int i = 0; i < count; i++)
+    {
+      if(!pattern[i] && energy[i] < e)
+      {
+        e    = energy[i];
+        best = i;
+      }
+    }
+    return best;
+  };
+
+  // Initial pattern: 10% of random pixels, spread out by moving the tightest cluster to the
+  // largest void until it does not change anymore
+  std::mt19937 rng(seed);
+  const int    ones = count / 10;
+  for(int placed = 0; placed < ones;)
+  {
+    int p = static_cast<int>(rng() % count);
+    if(!pattern[p])
+    {
+      setPixel(p, true);
+      placed++;
+    }
+  }
+  for(int iter = 0; iter < count; iter++)
+  {
+    int cluster = tightestCluster();
+    setPixel(cluster, false);
+    int hole = largestVoid();
+    setPixel(hole, true);
+    if(hole == cluster)
+      break;
+  }
+
+  std::vector<int>     rank(count);
+  std::vector<uint8_t> initialPattern = pattern;
+  std::vector<float>   initialEnergy  = energy;
+
+  // Ranks of the initial pattern, removing the tightest clusters first
+  for(int r = ones - 1; r >= 0; r--)
+  {
+    int cluster = tightestCluster();
+    setPixel(cluster, false);
+    rank[cluster] = r;
+  }
+
+  // Ranks of the other pixels, filling the largest voids first. The energy of the empty pixels
+  // is the complement of the energy of the set ones, so this also covers the second half, where
+  // Ulichney looks for the tightest cluster of empty pixels.
+  pattern = initialPattern;
+  energy  = initialEnergy;
+  for(int r = ones; r < count; r++)
+  {
+    int hole = largestVoid();
+    setPixel(hole, true);
+    rank[hole] = r;
+  }
+
+  std::vector<float> noise(count);
+  for(int i = 0; i < count; i++)
+    noise[i] = (static_cast<float>(rank[i]) + 0.5f) / static_cast<float>(count);
+  return noise;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Integrands of the convergence tests
+//
+float disk(float x, float y, float cx, float cy)
+{
+  return (x - cx) * (x - cx) + (y - cy) * (y - cy) < 0.16f ? 1.f : 0.f;
+}
+
+// Visibility of a cosine-weighted direction (sampled as in ao.comp) against a half-space occluder
+float hemisphereVisibility(float r1, float r2, float nx, float nz)
+{
+  float sq  = std::sqrt(1.f - r2);
+  float phi = 2.f * 3.14159265f * r1;
+  float x   = std::cos(phi) * sq;
+  float z   = std::sqrt(r2);
+  return x * nx + z * nz > 0.5f ? 0.f : 1.f;
+}
+
+uint32_t testDimensions(ConvergenceTest test)
+{
+  switch(test)
+  {
+    case ConvergenceTest::eMotion:
+      return 3;
+    case ConvergenceTest::ePath:
+      return 4;
+    default:
+      return 2;
+  }
+}
+
+float evaluate(ConvergenceTest test, const float* u)
+{
+  switch(test)
+  {
+    case ConvergenceTest::ePixelFootprint:
+      return disk(u[0], u[1], 0.3f, 0.55f);
+    case ConvergenceTest::eHemisphere:
+      return hemisphereVisibility(u[0], u[1], 0.8f, 0.6f);
+    case ConvergenceTest::eMotion:
+      return disk(u[0], u[1], 0.1f + 0.6f * u[2], 0.5f);
+    case ConvergenceTest::ePath:
+      return hemisphereVisibility(u[0], u[1], 0.8f, 0.6f) * hemisphereVisibility(u[2], u[3], -0.6f, 0.8f);
+  }
+  return 0.f;
+}
+
+// Reference value with a midpoint rule: 2048² for 2D, 256³ for 3D. The path test is the product
+// of two independent 2D integrals.
+double referenceIntegral(ConvergenceTest test)
+{
+  if(test == ConvergenceTest::ePath)
+  {
+    const int res = 2048;
+    double    a   = 0;
+    double    b   = 0;
+    for(int j = 0; j < res; j++)
+    {
+      for(int i = 0; i < res; i++)
+      {
+        float u = (i + 0.5f) / res;
+        float v = (j + 0.5f) / res;
+        a += hemisphereVisibility(u, v, 0.8f, 0.6f);
+        b += hemisphereVisibility(u, v, -0.6f, 0.8f);
+      }
+    }
+    return (a / (double(res) * res)) * (b / (double(res) * res));
+  }
+
+  const uint32_t dims = testDimensions(test);
+  const int      res  = dims == 2 ? 2048 : 256;
+  double         sum  = 0;
+  uint64_t       n    = 1;
+  for(uint32_t d = 0; d < dims; d++)
+    n *= res;
+  for(uint64_t k = 0; k < n; k++)
+  {
+    float    u[3];
+    uint64_t rem = k;
+    for(uint32_t d = 0; d < dims; d++)
+    {
+      u[d] = (static_cast<float>(rem % res) + 0.5f) / res;
+      rem /= res;
+    }
+    sum += evaluate(test, u);
+  }
+  return sum / static_cast<double>(n);
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void SamplerTables::generate(uint32_t seed)
+{
+  m_sobolDirections = makeSobolDirections();
+  m_blueNoise       = makeBlueNoise(seed);
+}
+
+std::vector<uint32_t> SamplerTables::pack() const
+{
+  std::vector<uint32_t> data(m_sobolDirections);
+  data.resize(m_sobolDirections.size() + m_blueNoise.size());
+  memcpy(&data[m_sobolDirections.size()], m_blueNoise.data(), m_blueNoise.size() * sizeof(float));
+  return data;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+HostSampler::HostSampler(const SamplerTables& tables, uint32_t type, uint32_t pixelX, uint32_t pixelY, uint32_t seed, uint32_t index)
+    : m_tables(tables)
+    , m_type(type)
+    , m_seed(type == SAMPLER_RANDOM ? seed : hash(pixelX ^ hash(pixelY)))
+    , m_index(index)
+    , m_pixelX(pixelX)
+    , m_pixelY(pixelY)
+{
+}
+
+float HostSampler::next()
+{
+  uint32_t dim = m_dim++;
+
+  if(m_type == SAMPLER_SOBOL)
+  {
+    uint32_t group     = dim / SOBOL_DIMENSIONS;
+    uint32_t sobolDim  = dim % SOBOL_DIMENSIONS;
+    uint32_t groupSeed = hash(m_seed ^ hash(group));
+    uint32_t index     = nestedUniformScramble(m_index, groupSeed);
+    uint32_t x         = 0;
+    for(uint32_t bit = 0; index != 0; bit++, index >>= 1)
+    {
+      if(index & 1)
+        x ^= m_tables.m_sobolDirections[sobolDim * SOBOL_BITS + bit];
+    }
+    return toFloat(nestedUniformScramble(x, hash(groupSeed + sobolDim + 1)));
+  }
+
+  if(m_type == SAMPLER_BLUE_NOISE)
+  {
+    float    fx      = static_cast<float>(dim) * 0.7548776662f;
+    float    fy      = static_cast<float>(dim) * 0.5698402910f;
+    uint32_t offsetX = static_cast<uint32_t>((fx - std::floor(fx)) * static_cast<float>(BLUE_NOISE_SIZE));
+    uint32_t offsetY = static_cast<uint32_t>((fy - std::floor(fy)) * static_cast<float>(BLUE_NOISE_SIZE));
+    uint32_t x       = (m_pixelX + offsetX) % BLUE_NOISE_SIZE;
+    uint32_t y       = (m_pixelY + offsetY) % BLUE_NOISE_SIZE;
+    float    noise   = m_tables.m_blueNoise[y * BLUE_NOISE_SIZE + x];
+    return toFloat(static_cast<uint32_t>(noise * 4294967040.0f) + m_index * s_weyl[dim % 8]);
+  }
+
+  m_seed = 1664525u * m_seed + 1013904223u;
+  return static_cast<float>(m_seed & 0x00FFFFFF) / static_cast<float>(0x01000000);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Each pixel estimates the integral with the samples of its own sequence, as on the GPU. The
+// squared error is accumulated at each power of two and averaged over all pixels.
+//
+SamplerConvergence measureSamplerConvergence(const SamplerTables& tables, ConvergenceTest test, uint32_t maxSamples, uint32_t pixels)
+{
+  SamplerConvergence result;
+  for(uint32_t n = 1; n <= maxSamples; n *= 2)
+    result.sampleCounts.push_back(n);
+
+  const double   reference = referenceIntegral(test);
+  const uint32_t dims      = testDimensions(test);
+
+  for(uint32_t type = 0; type < SAMPLER_COUNT; type++)
+  {
+    std::vector<double> squaredError(result.sampleCounts.size(), 0.0);
+    for(uint32_t p = 0; p < pixels; p++)
+    {
+      uint32_t pixelX = p % 256;
+      uint32_t pixelY = p / 256;
+      double   sum    = 0;
+      size_t   k      = 0;
+      for(uint32_t i = 0; i < result.sampleCounts.back(); i++)
+      {
+        HostSampler sampler(tables, type, pixelX, pixelY, tea(p, i), i);
+        float       u[4];
+        for(uint32_t d = 0; d < dims; d++)
+          u[d] = sampler.next();
+        sum += evaluate(test, u);
+
+        if(i + 1 == result.sampleCounts[k])
+        {
+          double error = sum / (i + 1) - reference;
+          squaredError[k++] += error * error;
+        }
+      }
+    }
+
+    for(double e : squaredError)
+      result.rmse[type].push_back(static_cast<float>(std::sqrt(e / pixels)));
+  }
+
+  return result;
+}
+
+const char* samplerName(uint32_t type)
+{
+  switch(type)
+  {
+    case SAMPLER_RANDOM:
+      return "Random";
+    case SAMPLER_SOBOL:
+      return "Sobol (Owen)";
+    case SAMPLER_BLUE_NOISE:
+      return "Blue noise";
+  }
+  return "Unknown";
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <array>
+#include <stdint.h>
+#include <vector>
+
+#include "shaders/sampler_host_device.h"
+
+//--------------------------------------------------------------------------------------------------
+// Tables of the GPU samplers (shaders/sampler.glsl):
+// - Sobol direction numbers of the first SOBOL_DIMENSIONS dimensions (Joe and Kuo)
+// - a BLUE_NOISE_SIZE² blue-noise tile made with the void-and-cluster method (Ulichney)
+//
+class SamplerTables
+{
+public:
+  void generate(uint32_t seed = 0);
+
+  // Content of the `SamplerTables` buffer reference, to be uploaded in a storage buffer
+  std::vector<uint32_t> pack() const;
+
+  std::vector<uint32_t> m_sobolDirections;  // SOBOL_DIMENSIONS * SOBOL_BITS
+  std::vector<float>    m_blueNoise;        // BLUE_NOISE_SIZE * BLUE_NOISE_SIZE, values in (0, 1)
+};
+
+//--------------------------------------------------------------------------------------------------
+// CPU version of the GPU sampler, returning the same values, used to measure convergence
+//
+class HostSampler
+{
+public:
+  HostSampler(const SamplerTables& tables, uint32_t type, uint32_t pixelX, uint32_t pixelY, uint32_t seed, uint32_t index);
+  float next();
+
+private:
+  const SamplerTables& m_tables;
+  uint32_t             m_type;
+  uint32_t             m_seed;
+  uint32_t             m_index;
+  uint32_t             m_dim{0};
+  uint32_t             m_pixelX;
+  uint32_t             m_pixelY;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Convergence benchmark: RMSE of the estimate of an integral with a known value, over many pixels,
+// as a function of the number of samples. Each test mimics how a sample consumes its dimensions.
+//
+enum class ConvergenceTest
+{
+  ePixelFootprint,  // 2D: sub-pixel jitter over a disk edge (jitter camera)
+  eHemisphere,      // 2D: cosine-weighted directions against a tilted occluder (ambient occlusion)
+  eMotion,          // 3D: jitter and time over a moving disk edge (motion blur)
+  ePath,            // 4D: two bounces of cosine-weighted directions (path tracer)
+};
+
+struct SamplerConvergence
+{
+  std::vector<uint32_t>                         sampleCounts;  // 1, 2, 4, ... maxSamples
+  std::array<std::vector<float>, SAMPLER_COUNT> rmse;          // Per sampler type, per sample count
+};
+
+SamplerConvergence measureSamplerConvergence(const SamplerTables& tables,
+                                             ConvergenceTest      test,
+                                             uint32_t             maxSamples = 256,
+                                             uint32_t             pixels     = 1024);
+
+// Name of a SAMPLER_ type, for the UI and logs
+const char* samplerName(uint32_t type);
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//-------------------------------------------------------------------------------------------------
+// Per-pixel statistics of the adaptive sampling, shared by the samples. A pixel keeps a vec4 in a
+// storage image: x the number of samples, y their mean, z the sum of squared differences to the
+// mean (M2), w unused.
+//
+// Usage:
+//   vec4 stats = imageLoad(varianceImage, pixel);
+//   if(isConverged(stats, threshold, minSamples))
+//     return;
+//   ... value of the new sample ...
+//   imageStore(varianceImage, pixel, welfordUpdate(stats, value));
+//-------------------------------------------------------------------------------------------------
+
+#ifndef ADAPTIVE_SAMPLING_GLSL
+#define ADAPTIVE_SAMPLING_GLSL
+
+// Adds a sample to the running statistics of a pixel (Welford's online algorithm)
+vec4 welfordUpdate(vec4 stats, float value)
+{
+  float n     = stats.x + 1.0;
+  float delta = value - stats.y;
+  float mean  = stats.y + delta / n;
+  return vec4(n, mean, stats.z + delta * (value - mean), 0);
+}
+
+// A pixel is converged when the standard error of its mean is below `threshold` times the mean.
+// The mean is clamped to avoid requiring an absolute precision on very dark pixels.
+bool isConverged(vec4 stats, float threshold, int minSamples)
+{
+  float n = stats.x;
+  if(n < max(float(minSamples), 2.0))
+    return false;
+  float variance = stats.z / (n - 1.0);
+  return sqrt(variance / n) <= threshold * max(stats.y, 0.01);
+}
+
+#endif  // ADAPTIVE_SAMPLING_GLSL
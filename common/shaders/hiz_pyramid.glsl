@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+
+//-------------------------------------------------------------------------------------------------
+// Layout of a depth pyramid (Hi-Z) stored in a buffer, shared by the samples. Level 0 has one texel
+// per pixel of `screen`, and each level halves the previous one, rounding up, until 1x1: a texel of
+// level L covers 2^L x 2^L pixels. The levels are stored one after another in row-major order; what
+// a texel holds is up to the sample.
+//
+// Usage:
+//   ivec2 size  = hizLevelSize(level, screen);
+//   T     value = pyramid[hizTexelIndex(level, texel, screen)];
+//-------------------------------------------------------------------------------------------------
+
+#ifndef HIZ_PYRAMID_GLSL
+#define HIZ_PYRAMID_GLSL
+
+ivec2 hizLevelSize(int level, ivec2 screen)
+{
+  return max(ivec2(1), (screen + (1 << level) - 1) >> level);
+}
+
+// Index of the first texel of `level`
+int hizLevelOffset(int level, ivec2 screen)
+{
+  int offset = 0;
+  for(int l = 0; l < level; l++)
+  {
+    ivec2 size = hizLevelSize(l, screen);
+    offset += size.x * size.y;
+  }
+  return offset;
+}
+
+int hizTexelIndex(int level, ivec2 texel, ivec2 screen)
+{
+  return hizLevelOffset(level, screen) + texel.y * hizLevelSize(level, screen).x + texel.x;
+}
+
+#endif  // HIZ_PYRAMID_GLSL
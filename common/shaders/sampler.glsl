@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//-------------------------------------------------------------------------------------------------
+// Sampler shared by the samples: random (LCG), Owen-scrambled Sobol or blue noise, selected at
+// runtime. The tables are generated on the host (common/sampler.cpp) and accessed by address.
+//
+// The including shader must enable:
+//   GL_EXT_buffer_reference2, GL_EXT_scalar_block_layout, GL_EXT_shader_explicit_arithmetic_types_int64
+//
+// Usage:
+//   SamplerState s = samplerInit(type, tablesAddress, pixel, seed, sampleIndex);
+//   float u1 = samplerNext(s);  // dimension 0
+//   vec2  u2 = samplerNext2D(s);  // dimensions 1 and 2
+//
+// Every sample index of a pixel must consume the dimensions in the same order.
+//-------------------------------------------------------------------------------------------------
+
+#ifndef SAMPLER_GLSL
+#define SAMPLER_GLSL
+
+#include "sampler_host_device.h"
+
+layout(buffer_reference, scalar) readonly buffer SamplerTables
+{
+  uint  sobolDirections[SOBOL_DIMENSIONS * SOBOL_BITS];
+  float blueNoise[BLUE_NOISE_SIZE * BLUE_NOISE_SIZE];
+};
+
+struct SamplerState
+{
+  uint     type;    // SAMPLER_RANDOM, SAMPLER_SOBOL or SAMPLER_BLUE_NOISE
+  uint     seed;    // LCG state (random), or per-pixel scrambling seed
+  uint     index;   // Sample index in the pixel
+  uint     dim;     // Next dimension
+  uvec2    pixel;   // Pixel coordinates, for the blue-noise tile
+  uint64_t tables;  // Address of the SamplerTables buffer
+};
+
+// Integer hash with good avalanche (lowbias32, from Chris Wellons' hash prospector)
+uint samplerHash(uint x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+// Owen scrambling of the bits of x, in the hash-based form of Burley,
+// "Practical Hash-based Owen Scrambling", JCGT 2020
+uint samplerNestedUniformScramble(uint x, uint seed)
+{
+  x = bitfieldReverse(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return bitfieldReverse(x);
+}
+
+// Unscrambled Sobol point `index` in dimension `dim`, as 32-bit fixed point
+uint samplerSobol(SamplerTables tables, uint index, uint dim)
+{
+  uint x = 0;
+  for(uint bit = 0; index != 0; bit++, index >>= 1)
+  {
+    if((index & 1) != 0)
+      x ^= tables.sobolDirections[dim * SOBOL_BITS + bit];
+  }
+  return x;
+}
+
+// Fractional parts of the square roots of the first primes (32-bit fixed point): the increments
+// of a Kronecker sequence which is low discrepancy in all dimensions jointly
+const uint samplerWeyl[8] = uint[](0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+                                   0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u);
+
+// 32-bit fixed point to float in [0, 1)
+float samplerToFloat(uint x)
+{
+  return float(x >> 8) * (1.0 / 16777216.0);
+}
+
+// `seed` is only used by SAMPLER_RANDOM and should be different for each pixel and sample index
+SamplerState samplerInit(uint type, uint64_t tables, uvec2 pixel, uint seed, uint index)
+{
+  SamplerState s;
+  s.type   = type;
+  s.seed   = type == SAMPLER_RANDOM ? seed : samplerHash(pixel.x ^ samplerHash(pixel.y));
+  s.index  = index;
+  s.dim    = 0;
+  s.pixel  = pixel;
+  s.tables = tables;
+  return s;
+}
+
+float samplerNext(inout SamplerState s)
+{
+  uint dim = s.dim++;
+
+  if(s.type == SAMPLER_SOBOL)
+  {
+    // Dimensions past the table reuse it, with the index shuffled differently for each group of
+    // dimensions, which decorrelates the groups while keeping each group stratified
+    uint group     = dim / SOBOL_DIMENSIONS;
+    uint sobolDim  = dim % SOBOL_DIMENSIONS;
+    uint groupSeed = samplerHash(s.seed ^ samplerHash(group));
+    uint index     = samplerNestedUniformScramble(s.index, groupSeed);
+    uint x         = samplerSobol(SamplerTables(s.tables), index, sobolDim);
+    return samplerToFloat(samplerNestedUniformScramble(x, samplerHash(groupSeed + sobolDim + 1)));
+  }
+
+  if(s.type == SAMPLER_BLUE_NOISE)
+  {
+    // Each dimension reads the tile at another toroidal offset (R2 sequence), and successive
+    // samples of the pixel follow a Kronecker sequence starting at the blue-noise value
+    uvec2 offset = uvec2(fract(vec2(dim) * vec2(0.7548776662, 0.5698402910)) * float(BLUE_NOISE_SIZE));
+    uvec2 p      = (s.pixel + offset) % uint(BLUE_NOISE_SIZE);
+    float noise  = SamplerTables(s.tables).blueNoise[p.y * BLUE_NOISE_SIZE + p.x];
+    return samplerToFloat(uint(noise * 4294967040.0) + s.index * samplerWeyl[dim % 8]);
+  }
+
+  // SAMPLER_RANDOM: Numerical Recipes LCG, same sequence as rnd()
+  s.seed = 1664525u * s.seed + 1013904223u;
+  return float(s.seed & 0x00FFFFFF) / float(0x01000000);
+}
+
+vec2 samplerNext2D(inout SamplerState s)
+{
+  float u1 = samplerNext(s);
+  float u2 = samplerNext(s);
+  return vec2(u1, u2);
+}
+
+#endif
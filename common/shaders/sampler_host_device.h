@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Constants shared by the host (sampler.h) and the shaders (sampler.glsl)
+
+#ifndef SAMPLER_HOST_DEVICE
+#define SAMPLER_HOST_DEVICE
+
+// Sampler selected with the `samplerType` push constant
+#define SAMPLER_RANDOM 0      // TEA seeding + LCG, the original behavior
+#define SAMPLER_SOBOL 1       // Owen-scrambled Sobol, padded by shuffling the index per group of dimensions
+#define SAMPLER_BLUE_NOISE 2  // Tiled blue noise, animated with the golden ratio
+#define SAMPLER_COUNT 3
+
+#define SOBOL_DIMENSIONS 8  // Dimensions with their own direction numbers
+#define SOBOL_BITS 32       // Direction numbers per dimension
+#define BLUE_NOISE_SIZE 64  // Width and height of the blue-noise tile
+
+#endif
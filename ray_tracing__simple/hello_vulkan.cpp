@@ -18,6 +18,7 @@
  */
 
 
+#include <algorithm>
 #include <sstream>
 
 
@@ -56,16 +57,25 @@ void HelloVulkan::setup(const VkInstance& instance, const VkDevice& device, cons
 //
 void HelloVulkan::updateUniformBuffer(const VkCommandBuffer& cmdBuf)
 {
-  // Prepare new UBO contents on host.
-  const float    aspectRatio = m_size.width / static_cast<float>(m_size.height);
-  GlobalUniforms hostUBO     = {};
-  const auto&    view        = CameraManip.getMatrix();
-  glm::mat4      proj        = glm::perspectiveRH_ZO(glm::radians(CameraManip.getFov()), aspectRatio, 0.1f, 1000.0f);
-  proj[1][1] *= -1;  // Inverting Y for Vulkan (not needed with perspectiveVK).
+  // Views to render, the camera when none was set
+  std::vector<View> views = m_views;
+  if(views.empty())
+  {
+    const float aspectRatio = m_size.width / static_cast<float>(m_size.height);
+    glm::mat4   proj        = glm::perspectiveRH_ZO(glm::radians(CameraManip.getFov()), aspectRatio, 0.1f, 1000.0f);
+    proj[1][1] *= -1;  // Inverting Y for Vulkan (not needed with perspectiveVK).
+    views.push_back({CameraManip.getMatrix(), proj});
+  }
 
-  hostUBO.viewProj    = proj * view;
-  hostUBO.viewInverse = glm::inverse(view);
-  hostUBO.projInverse = glm::inverse(proj);
+  // Prepare new UBO contents on host.
+  std::vector<GlobalUniforms> hostUBO(views.size());
+  for(size_t i = 0; i < views.size(); i++)
+  {
+    hostUBO[i].viewProj    = views[i].proj * views[i].view;
+    hostUBO[i].viewInverse = glm::inverse(views[i].view);
+    hostUBO[i].projInverse = glm::inverse(views[i].proj);
+  }
+  const VkDeviceSize uboSize = sizeof(GlobalUniforms) * hostUBO.size();
 
   // UBO on the device, and what stages access it.
   VkBuffer deviceUBO      = m_bGlobals.buffer;
@@ -77,14 +87,14 @@ void HelloVulkan::updateUniformBuffer(const VkCommandBuffer& cmdBuf)
   beforeBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
   beforeBarrier.buffer        = deviceUBO;
   beforeBarrier.offset        = 0;
-  beforeBarrier.size          = sizeof(hostUBO);
+  beforeBarrier.size          = uboSize;
   vkCmdPipelineBarrier(cmdBuf, uboUsageStages, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_DEVICE_GROUP_BIT, 0,
                        nullptr, 1, &beforeBarrier, 0, nullptr);
 
 
   // Schedule the host-to-device upload. (hostUBO is copied into the cmd
   // buffer so it is okay to deallocate when the function returns).
-  vkCmdUpdateBuffer(cmdBuf, m_bGlobals.buffer, 0, sizeof(GlobalUniforms), &hostUBO);
+  vkCmdUpdateBuffer(cmdBuf, m_bGlobals.buffer, 0, uboSize, hostUBO.data());
 
   // Making sure the updated UBO will be visible.
   VkBufferMemoryBarrier afterBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
@@ -92,7 +102,7 @@ void HelloVulkan::updateUniformBuffer(const VkCommandBuffer& cmdBuf)
   afterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
   afterBarrier.buffer        = deviceUBO;
   afterBarrier.offset        = 0;
-  afterBarrier.size          = sizeof(hostUBO);
+  afterBarrier.size          = uboSize;
   vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, uboUsageStages, VK_DEPENDENCY_DEVICE_GROUP_BIT, 0,
                        nullptr, 1, &afterBarrier, 0, nullptr);
 }
@@ -247,10 +257,11 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
 //--------------------------------------------------------------------------------------------------
 // Creating the uniform buffer holding the camera matrices
 // - Buffer is host visible
+// - Sized for MAX_VIEWS, the views rendered by the ray tracer
 //
 void HelloVulkan::createUniformBuffer()
 {
-  m_bGlobals = m_alloc.createBuffer(sizeof(GlobalUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+  m_bGlobals = m_alloc.createBuffer(sizeof(GlobalUniforms) * MAX_VIEWS, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
   m_debug.setObjectName(m_bGlobals.buffer, "Globals");
 }
@@ -449,15 +460,17 @@ void HelloVulkan::createOffscreenRender()
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_offscreenDepth);
 
-  // Creating the color image
+  // Creating the color image, one layer per view. The rasterizer renders in the first layer.
   {
     auto colorCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenColorFormat,
                                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
                                                            | VK_IMAGE_USAGE_STORAGE_BIT);
+    colorCreateInfo.arrayLayers = m_viewCount;
 
 
     nvvk::Image           image  = m_alloc.createImage(colorCreateInfo);
     VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, colorCreateInfo);
+    ivInfo.viewType              = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
     VkSamplerCreateInfo   sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
     m_offscreenColor                        = m_alloc.createTexture(image, ivInfo, sampler);
     m_offscreenColor.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -517,7 +530,7 @@ void HelloVulkan::createOffscreenRender()
 void HelloVulkan::createPostPipeline()
 {
   // Push constants in the fragment shader
-  VkPushConstantRange pushConstantRanges = {VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(float)};
+  VkPushConstantRange pushConstantRanges = {VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantPost)};
 
   // Creating the pipeline layout
   VkPipelineLayoutCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
@@ -566,10 +579,29 @@ void HelloVulkan::drawPost(VkCommandBuffer cmdBuf)
 {
   m_debug.beginLabel(cmdBuf, "Post");
 
-  setViewport(cmdBuf);
-
-  auto aspectRatio = static_cast<float>(m_size.width) / static_cast<float>(m_size.height);
-  vkCmdPushConstants(cmdBuf, m_postPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(float), &aspectRatio);
+  // Square views are shown undistorted, centered in the window
+  VkExtent2D traceSize = getTraceSize();
+  if(m_squareViews)
+  {
+    VkViewport viewport{};
+    viewport.x        = static_cast<float>(m_size.width - traceSize.width) * 0.5f;
+    viewport.y        = static_cast<float>(m_size.height - traceSize.height) * 0.5f;
+    viewport.width    = static_cast<float>(traceSize.width);
+    viewport.height   = static_cast<float>(traceSize.height);
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{{0, 0}, m_size};
+    vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
+    vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
+  }
+  else
+    setViewport(cmdBuf);
+
+  PushConstantPost pcPost{};
+  pcPost.aspectRatio = static_cast<float>(m_size.width) / static_cast<float>(m_size.height);
+  pcPost.view        = m_displayedView;
+  pcPost.uvScale     = {static_cast<float>(traceSize.width) / static_cast<float>(m_size.width),
+                        static_cast<float>(traceSize.height) / static_cast<float>(m_size.height)};
+  vkCmdPushConstants(cmdBuf, m_postPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantPost), &pcPost);
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_postPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_postPipelineLayout, 0, 1, &m_postDescSet, 0, nullptr);
   vkCmdDraw(cmdBuf, 3, 1, 0, 0);
@@ -929,8 +961,44 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
                      0, sizeof(PushConstantRay), &m_pcRay);
 
 
-  vkCmdTraceRaysKHR(cmdBuf, &m_rgenRegion, &m_missRegion, &m_hitRegion, &m_callRegion, m_size.width, m_size.height, 1);
+  // All the views at once, the depth of the launch selects the view
+  VkExtent2D traceSize = getTraceSize();
+  vkCmdTraceRaysKHR(cmdBuf, &m_rgenRegion, &m_missRegion, &m_hitRegion, &m_callRegion, traceSize.width,
+                    traceSize.height, m_viewCount);
 
 
   m_debug.endLabel(cmdBuf);
 }
+
+//--------------------------------------------------------------------------------------------------
+// Setting the views rendered by the ray tracer, at most MAX_VIEWS. With no views, the camera is used.
+// - Changing the number of views recreates the output image
+// - Square views (projections of aspect 1) are traced in the top-left square of each layer
+//
+void HelloVulkan::setViews(const std::vector<View>& views, bool square)
+{
+  m_views.assign(views.begin(), views.begin() + std::min<size_t>(views.size(), MAX_VIEWS));
+  m_squareViews = square;
+
+  uint32_t viewCount = std::max(1u, static_cast<uint32_t>(m_views.size()));
+  if(viewCount != m_viewCount)
+  {
+    vkDeviceWaitIdle(m_device);  // The output is used by the frames in flight
+    m_viewCount = viewCount;
+    createOffscreenRender();
+    updatePostDescriptorSet();
+    updateRtDescriptorSet();
+  }
+  m_displayedView = std::min(std::max(m_displayedView, 0), static_cast<int>(m_viewCount) - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Pixels traced in each layer of the output: all of it, or the largest square with square views
+//
+VkExtent2D HelloVulkan::getTraceSize() const
+{
+  if(!m_squareViews)
+    return m_size;
+  uint32_t side = std::min(m_size.width, m_size.height);
+  return {side, side};
+}
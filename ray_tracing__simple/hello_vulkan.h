@@ -153,4 +153,18 @@ public:
 
   // Push constant for ray tracer
   PushConstantRay m_pcRay{};
+
+  // #MultiView - Many cameras rendered by a single trace call, each in its own layer of the output
+  struct View
+  {
+    glm::mat4 view;  // World to camera
+    glm::mat4 proj;  // Projection, with Y inverted for Vulkan
+  };
+  void       setViews(const std::vector<View>& views, bool square = false);
+  VkExtent2D getTraceSize() const;
+
+  std::vector<View> m_views;               // Empty: the camera of CameraManip
+  uint32_t          m_viewCount{1};        // Layers of m_offscreenColor and depth of the trace call
+  int               m_displayedView{0};    // Layer shown by the post-processing
+  bool              m_squareViews{false};  // Traced in a square of the output, as the faces of a cube map
 };
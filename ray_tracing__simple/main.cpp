@@ -38,6 +38,9 @@
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/context_vk.hpp"
 
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
 
 //////////////////////////////////////////////////////////////////////////
 #define UNUSED(x) (void)(x)
@@ -53,8 +56,77 @@ static void onErrorCallback(int error, const char* description)
   fprintf(stderr, "GLFW Error %d: %s\n", error, description);
 }
 
+//--------------------------------------------------------------------------------------------------
+// #MultiView - Rigs of views following the camera, all rendered by the same trace call
+//
+enum ViewRig
+{
+  eRigCamera,  // The camera alone
+  eRigStereo,  // Left and right eyes, with parallel axes
+  eRigCube,    // The 6 faces of a cube map at the eye, as the layers of a cube map
+  eRigOrbit,   // Cameras on the circle around the point of interest
+};
+
+struct ViewSettings
+{
+  int   rig{eRigCamera};
+  float eyeSeparation{0.065f};
+  int   orbitCount{8};
+  int   displayedView{0};
+};
+
+static glm::mat4 makeProjection(float fovDeg, float aspectRatio)
+{
+  glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(fovDeg), aspectRatio, 0.1f, 1000.0f);
+  proj[1][1] *= -1;  // Inverting Y for Vulkan
+  return proj;
+}
+
+static std::vector<HelloVulkan::View> makeViews(const ViewSettings& settings, const VkExtent2D& size)
+{
+  const auto      camera      = CameraManip.getCamera();
+  const glm::mat4 view        = CameraManip.getMatrix();
+  const float     aspectRatio = size.width / static_cast<float>(size.height);
+
+  std::vector<HelloVulkan::View> views;
+  switch(settings.rig)
+  {
+    case eRigStereo: {
+      const glm::mat4 proj   = makeProjection(camera.fov, aspectRatio);
+      const glm::vec3 offset = glm::vec3(settings.eyeSeparation * 0.5f, 0, 0);
+      views.push_back({glm::translate(glm::mat4(1), offset) * view, proj});   // Left eye
+      views.push_back({glm::translate(glm::mat4(1), -offset) * view, proj});  // Right eye
+      break;
+    }
+    case eRigCube: {
+      // +X, -X, +Y, -Y, +Z, -Z, traced in a square (see setViews). Mirroring X gives the
+      // orientation of the faces of a Vulkan cube map.
+      const glm::vec3 dirs[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+      const glm::vec3 ups[6]  = {{0, 1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}, {0, 1, 0}, {0, 1, 0}};
+      glm::mat4       proj    = makeProjection(90.f, 1.f);
+      proj[0][0] *= -1;
+      for(int i = 0; i < 6; i++)
+        views.push_back({glm::lookAt(camera.eye, camera.eye + dirs[i], ups[i]), proj});
+      break;
+    }
+    case eRigOrbit: {
+      const glm::mat4 proj = makeProjection(camera.fov, aspectRatio);
+      for(int i = 0; i < settings.orbitCount; i++)
+      {
+        float     angle = glm::two_pi<float>() * static_cast<float>(i) / static_cast<float>(settings.orbitCount);
+        glm::vec4 arm   = glm::rotate(glm::mat4(1), angle, camera.up) * glm::vec4(camera.eye - camera.ctr, 0);
+        views.push_back({glm::lookAt(camera.ctr + glm::vec3(arm), camera.ctr, camera.up), proj});
+      }
+      break;
+    }
+    default:
+      break;  // No views: the camera
+  }
+  return views;
+}
+
 // Extra UI
-void renderUI(HelloVulkan& helloVk)
+void renderUI(HelloVulkan& helloVk, ViewSettings& viewSettings)
 {
   ImGuiH::CameraWidget();
   if(ImGui::CollapsingHeader("Light"))
@@ -66,6 +138,16 @@ void renderUI(HelloVulkan& helloVk)
     ImGui::SliderFloat3("Position", &helloVk.m_pcRaster.lightPosition.x, -20.f, 20.f);
     ImGui::SliderFloat("Intensity", &helloVk.m_pcRaster.lightIntensity, 0.f, 150.f);
   }
+  if(ImGui::CollapsingHeader("Views"))
+  {
+    ImGui::Combo("Rig", &viewSettings.rig, "Camera\0Stereo pair\0Cube map\0Orbit\0");
+    if(viewSettings.rig == eRigStereo)
+      ImGui::SliderFloat("Eye separation", &viewSettings.eyeSeparation, 0.f, 0.5f);
+    if(viewSettings.rig == eRigOrbit)
+      ImGui::SliderInt("View count", &viewSettings.orbitCount, 2, MAX_VIEWS);
+    ImGui::SliderInt("Displayed view", &viewSettings.displayedView, 0, static_cast<int>(helloVk.m_viewCount) - 1);
+    ImGui::Text("%u views in one trace call", helloVk.m_viewCount);
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -183,8 +265,9 @@ int main(int argc, char** argv)
   helloVk.updatePostDescriptorSet();
 
 
-  glm::vec4 clearColor   = glm::vec4(1, 1, 1, 1.00f);
-  bool      useRaytracer = true;
+  glm::vec4    clearColor   = glm::vec4(1, 1, 1, 1.00f);
+  bool         useRaytracer = true;
+  ViewSettings viewSettings;
 
 
   helloVk.setupGlfwCallbacks(window);
@@ -209,12 +292,17 @@ int main(int argc, char** argv)
       ImGui::ColorEdit3("Clear color", reinterpret_cast<float*>(&clearColor));
       ImGui::Checkbox("Ray Tracer mode", &useRaytracer);  // Switch between raster and ray tracing
 
-      renderUI(helloVk);
+      renderUI(helloVk, viewSettings);
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
       ImGuiH::Control::Info("", "", "(F10) Toggle Pane", ImGuiH::Control::Flags::Disabled);
       ImGuiH::Panel::End();
     }
 
+    // Views of the ray tracer, the rasterizer only renders the camera
+    helloVk.m_displayedView = useRaytracer ? viewSettings.displayedView : 0;
+    helloVk.setViews(useRaytracer ? makeViews(viewSettings, helloVk.getSize()) : std::vector<HelloVulkan::View>(),
+                     useRaytracer && viewSettings.rig == eRigCube);
+
     // Start rendering the scene
     helloVk.prepareFrame();
 
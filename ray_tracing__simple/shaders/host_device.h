@@ -52,6 +52,9 @@ START_BINDING(RtxBindings)
 END_BINDING();
 // clang-format on
 
+// Number of views the ray generation can render in one trace call, one per layer of the output.
+// 64 GlobalUniforms are 12 KB, below the 16 KB guaranteed for maxUniformBufferRange.
+#define MAX_VIEWS 64
 
 // Information of a obj model when referenced in a shader
 struct ObjDesc
@@ -63,7 +66,8 @@ struct ObjDesc
   uint64_t materialIndexAddress;  // Address of the triangle material index buffer
 };
 
-// Uniform buffer set at each frame
+// Uniform buffer set at each frame, one per view: the ray generation reads the view
+// gl_LaunchIDEXT.z, the rasterizer the first one
 struct GlobalUniforms
 {
   mat4 viewProj;     // Camera view * projection
@@ -91,6 +95,14 @@ struct PushConstantRay
   int   lightType;
 };
 
+// Push constant structure for the post-processing
+struct PushConstantPost
+{
+  float aspectRatio;
+  int   view;     // Layer of the output displayed
+  vec2  uvScale;  // Part of the layer which was traced, see HelloVulkan::getTraceSize()
+};
+
 struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for device
 {
   vec3 pos;
@@ -18,20 +18,24 @@
  */
 
 #version 450
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "host_device.h"
+
 layout(location = 0) in vec2 outUV;
 layout(location = 0) out vec4 fragColor;
 
-layout(set = 0, binding = 0) uniform sampler2D noisyTxt;
+layout(set = 0, binding = 0) uniform sampler2DArray noisyTxt;
 
-layout(push_constant) uniform shaderInformation
+layout(push_constant) uniform _PushConstantPost
 {
-  float aspectRatio;
-}
-pushc;
+  PushConstantPost pcPost;
+};
 
 void main()
 {
-  vec2  uv    = outUV;
+  vec2  uv    = outUV * pcPost.uvScale;
   float gamma = 1. / 2.2;
-  fragColor   = pow(texture(noisyTxt, uv).rgba, vec4(gamma));
+  fragColor   = pow(texture(noisyTxt, vec3(uv, pcPost.view)).rgba, vec4(gamma));
 }
@@ -398,9 +398,18 @@ void HelloVulkan::destroyResources()
   vkDestroyDescriptorPool(m_device, m_compDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_compDescSetLayout, nullptr);
 
+  m_profiler.deinit();
   m_alloc.deinit();
 }
 
+//--------------------------------------------------------------------------------------------------
+// One range of queries per image of the swapchain, which are the frames in flight
+//
+void HelloVulkan::initProfiler(bool useTimestamp2)
+{
+  m_profiler.init(m_device, m_physicalDevice, m_graphicsQueueIndex, m_swapChain.getImageCount(), &m_debug, useTimestamp2);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Drawing the scene in raster mode
 //
@@ -408,7 +417,7 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
 {
   VkDeviceSize offset{0};
 
-  m_debug.beginLabel(cmdBuf, "Rasterize");
+  m_profiler.beginLabel(cmdBuf, "Rasterize");
 
   // Dynamic Viewport
   setViewport(cmdBuf);
@@ -430,7 +439,7 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
     vkCmdBindIndexBuffer(cmdBuf, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
     vkCmdDrawIndexed(cmdBuf, model.nbIndices, 1, 0, 0, 0);
   }
-  m_debug.endLabel(cmdBuf);
+  m_profiler.endLabel(cmdBuf);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -572,7 +581,7 @@ void HelloVulkan::updatePostDescriptorSet()
 //
 void HelloVulkan::drawPost(VkCommandBuffer cmdBuf)
 {
-  m_debug.beginLabel(cmdBuf, "Post");
+  m_profiler.beginLabel(cmdBuf, "Post");
 
   setViewport(cmdBuf);
 
@@ -582,7 +591,7 @@ void HelloVulkan::drawPost(VkCommandBuffer cmdBuf)
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_postPipelineLayout, 0, 1, &m_postDescSet, 0, nullptr);
   vkCmdDraw(cmdBuf, 3, 1, 0, 0);
 
-  m_debug.endLabel(cmdBuf);
+  m_profiler.endLabel(cmdBuf);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -846,7 +855,7 @@ void HelloVulkan::createRtPipeline()
 //
 void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clearColor)
 {
-  m_debug.beginLabel(cmdBuf, "Ray trace");
+  m_profiler.beginLabel(cmdBuf, "Ray trace");
   // Initializing push constant values
   m_pcRay.clearColor     = clearColor;
   m_pcRay.lightPosition  = m_pcRaster.lightPosition;
@@ -866,7 +875,7 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
   auto& regions = m_sbtWrapper.getRegions();
   vkCmdTraceRaysKHR(cmdBuf, &regions[0], &regions[1], &regions[2], &regions[3], m_size.width, m_size.height, 1);
 
-  m_debug.endLabel(cmdBuf);
+  m_profiler.endLabel(cmdBuf);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -894,8 +903,11 @@ void HelloVulkan::animationInstances(float time)
     tinst.transform                           = nvvk::toTransformMatrixKHR(transform);
   }
 
-  // Updating the top level acceleration structure
+  // Updating the top level acceleration structure. The builder submits and waits on its own command
+  // buffer, the update is timed on the host.
+  m_profiler.beginCpuLabel("TLAS update");
   m_rtBuilder.buildTlas(m_tlas, m_rtFlags, true);
+  m_profiler.endCpuLabel();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -911,14 +923,18 @@ void HelloVulkan::animationObject(float time)
   nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
   VkCommandBuffer   cmdBuf = genCmdBuf.createCommandBuffer();
 
+  m_profiler.beginLabel(cmdBuf, "Vertex animation");
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_compPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_compPipelineLayout, 0, 1, &m_compDescSet, 0, nullptr);
   vkCmdPushConstants(cmdBuf, m_compPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float), &time);
   vkCmdDispatch(cmdBuf, model.nbVertices, 1, 1);
+  m_profiler.endLabel(cmdBuf);
 
   genCmdBuf.submitAndWait(cmdBuf);
+  m_profiler.beginCpuLabel("BLAS refit");
   m_rtBuilder.updateBlas(sphereId, m_blas[sphereId],
                          VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR);
+  m_profiler.endCpuLabel();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,7 @@
 #include "nvvk/descriptorsets_vk.hpp"
 #include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
+#include "gpu_profiler.h"
 #include "shaders/host_device.h"
 
 // #VKRay
@@ -100,8 +101,11 @@ public:
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
 
-  nvvk::ResourceAllocatorDma m_alloc;  // Allocator for buffer, images, acceleration structures
-  nvvk::DebugUtil            m_debug;  // Utility to name objects
+  nvvk::ResourceAllocatorDma m_alloc;     // Allocator for buffer, images, acceleration structures
+  nvvk::DebugUtil            m_debug;     // Utility to name objects
+  GpuProfiler                m_profiler;  // Times the passes delimited by debug labels
+
+  void initProfiler(bool useTimestamp2);
 
 
   // #Post - Draw the rendered image on a quad using a tonemapper
@@ -34,6 +34,7 @@
 #include "imgui/imgui_camera_widget.h"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/fileoperations.hpp"
+#include "nvh/nvprint.hpp"
 #include "nvpsystem.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/context_vk.hpp"
@@ -68,6 +69,25 @@ void renderUI(HelloVulkan& helloVk)
   }
 }
 
+// Tree of the passes timed by the profiler, from the last frame which came back
+void renderProfilerUI(GpuProfiler& profiler)
+{
+  if(!ImGui::CollapsingHeader("Profiler"))
+    return;
+  if(!profiler.supported())
+    ImGui::Text("No timestamp queries on this queue, only CPU sections are timed");
+
+  ImGui::Text("%-28s %9s %9s", "Section", "Last", "Average");
+  for(const auto& timing : profiler.getTimings())
+  {
+    int indent = 2 * timing.depth;
+    ImGui::Text("%*s%-*s %6.3f ms %6.3f ms%s", indent, "", 28 - indent, timing.name.c_str(), timing.durationMs,
+                timing.avgMs, timing.cpu ? " (CPU)" : "");
+  }
+  if(ImGui::Button("Export Chrome trace") && profiler.writeChromeTrace("profile_trace.json"))
+    LOGI("Wrote profile_trace.json\n");
+}
+
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
@@ -134,6 +154,10 @@ int main(int argc, char** argv)
   contextInfo.addDeviceExtension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, false, &rtPipelineFeature);  // To use vkCmdTraceRaysKHR
   contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);  // Required by ray tracing pipeline
 
+  // Optional, for vkCmdWriteTimestamp2KHR in the profiler
+  VkPhysicalDeviceSynchronization2FeaturesKHR sync2Feature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME, true, &sync2Feature);
+
   // Creating Vulkan base application
   nvvk::Context vkctx{};
   vkctx.initInstance(contextInfo);
@@ -159,6 +183,8 @@ int main(int argc, char** argv)
   // Setup Imgui
   helloVk.initGUI(0);  // Using sub-pass 0
 
+  helloVk.initProfiler(sync2Feature.synchronization2 == VK_TRUE);
+
   // Creation of the example
   helloVk.loadModel(nvh::findFile("media/scenes/plane.obj", defaultSearchPaths, true),
                     glm::scale(glm::mat4(1.f), glm::vec3(2.f, 1.f, 2.f)));
@@ -222,29 +248,35 @@ int main(int argc, char** argv)
       ImGui::Checkbox("Ray Tracer mode", &useRaytracer);  // Switch between raster and ray tracing
 
       renderUI(helloVk);
+      renderProfilerUI(helloVk.m_profiler);
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
       ImGuiH::Control::Info("", "", "(F10) Toggle Pane", ImGuiH::Control::Flags::Disabled);
       ImGuiH::Panel::End();
     }
 
+    // Start rendering the scene
+    helloVk.prepareFrame();
+
+    // The fence of this frame was waited on: the profiler reads its last timings and records the new ones
+    auto curFrame = helloVk.getCurFrame();
+    helloVk.m_profiler.beginFrame(curFrame);
+
     // #VK_animation
     std::chrono::duration<float> diff = std::chrono::system_clock::now() - start;
     helloVk.animationObject(diff.count());
     helloVk.animationInstances(diff.count());
 
-    // Start rendering the scene
-    helloVk.prepareFrame();
-
     // Start command buffer of this frame
-    auto                   curFrame = helloVk.getCurFrame();
-    const VkCommandBuffer& cmdBuf   = helloVk.getCommandBuffers()[curFrame];
+    const VkCommandBuffer& cmdBuf = helloVk.getCommandBuffers()[curFrame];
 
     VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     vkBeginCommandBuffer(cmdBuf, &beginInfo);
 
     // Updating camera buffer
+    helloVk.m_profiler.beginLabel(cmdBuf, "Uniforms");
     helloVk.updateUniformBuffer(cmdBuf);
+    helloVk.m_profiler.endLabel(cmdBuf);
 
     // Clearing screen
     std::array<VkClearValue, 2> clearValues{};
@@ -261,6 +293,7 @@ int main(int argc, char** argv)
       offscreenRenderPassBeginInfo.renderArea      = {{0, 0}, helloVk.getSize()};
 
       // Rendering Scene
+      helloVk.m_profiler.beginLabel(cmdBuf, "Scene");
       if(useRaytracer)
       {
         helloVk.raytrace(cmdBuf, clearColor);
@@ -271,6 +304,7 @@ int main(int argc, char** argv)
         helloVk.rasterize(cmdBuf);
         vkCmdEndRenderPass(cmdBuf);
       }
+      helloVk.m_profiler.endLabel(cmdBuf);
     }
 
     // 2nd rendering pass: tone mapper, UI
@@ -283,12 +317,16 @@ int main(int argc, char** argv)
       postRenderPassBeginInfo.renderArea      = {{0, 0}, helloVk.getSize()};
 
       // Rendering tonemapper
+      helloVk.m_profiler.beginLabel(cmdBuf, "Display");
       vkCmdBeginRenderPass(cmdBuf, &postRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
       helloVk.drawPost(cmdBuf);
       // Rendering UI
+      helloVk.m_profiler.beginLabel(cmdBuf, "UI");
       ImGui::Render();
       ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuf);
+      helloVk.m_profiler.endLabel(cmdBuf);
       vkCmdEndRenderPass(cmdBuf);
+      helloVk.m_profiler.endLabel(cmdBuf);
     }
 
     // Submit for display
@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2014-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "ao_baker.h"
+#include "sampler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <thread>
+
+#include <glm/gtc/constants.hpp>
+
+namespace {
+
+constexpr uint32_t kBins          = 12;  // SAH bins
+constexpr uint32_t kMaxSahDepth   = 64;  // Deeper nodes are split at the median, bounding the depth of the tree
+constexpr uint32_t kMaxStackDepth = kMaxSahDepth + 32;
+
+// Same as OffsetRay() in raycommon.glsl
+glm::vec3 offsetRay(const glm::vec3& p, const glm::vec3& n)
+{
+  const float intScale   = 256.0f;
+  const float floatScale = 1.0f / 65536.0f;
+  const float origin     = 1.0f / 32.0f;
+
+  glm::vec3 result;
+  for(int i = 0; i < 3; i++)
+  {
+    int32_t offset = static_cast<int32_t>(intScale * n[i]);
+    int32_t bits;
+    std::memcpy(&bits, &p[i], sizeof(bits));
+    bits += p[i] < 0 ? -offset : offset;
+    float offsetP;
+    std::memcpy(&offsetP, &bits, sizeof(offsetP));
+    result[i] = std::abs(p[i]) < origin ? p[i] + floatScale * n[i] : offsetP;
+  }
+  return result;
+}
+
+// Same as ComputeDefaultBasis() in raycommon.glsl
+void computeDefaultBasis(const glm::vec3& z, glm::vec3& x, glm::vec3& y)
+{
+  const float yz = -z.y * z.z;
+  y = glm::normalize(std::abs(z.z) > 0.99999f ? glm::vec3(-z.x * z.y, 1.0f - z.y * z.y, yz) :
+                                                glm::vec3(-z.x * z.z, yz, 1.0f - z.z * z.z));
+  x = glm::cross(y, z);
+}
+
+float halfArea(const glm::vec3& bmin, const glm::vec3& bmax)
+{
+  glm::vec3 e = bmax - bmin;
+  return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+// Entry distance of the ray in the box, FLT_MAX if it misses or enters after tMax
+float intersectBox(const glm::vec3& bmin, const glm::vec3& bmax, const glm::vec3& origin, const glm::vec3& invDir,
+                   float tMax)
+{
+  glm::vec3 t0     = (bmin - origin) * invDir;
+  glm::vec3 t1     = (bmax - origin) * invDir;
+  glm::vec3 tNear  = glm::min(t0, t1);
+  glm::vec3 tFar   = glm::max(t0, t1);
+  float     tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+  float     tExit  = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+  return tEnter <= tExit ? tEnter : FLT_MAX;
+}
+
+// Calling work(index) for all indices, distributed in chunks over the threads
+template <typename Work>
+void parallelFor(uint32_t count, uint32_t threads, const Work& work)
+{
+  const uint32_t        chunk = 16;
+  std::atomic<uint32_t> next{0};
+  auto                  worker = [&]() {
+    for(uint32_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+    {
+      for(uint32_t i = begin; i < std::min(begin + chunk, count); i++)
+        work(i);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for(uint32_t t = 1; t < threads; t++)
+    pool.emplace_back(worker);
+  worker();
+  for(auto& thread : pool)
+    thread.join();
+}
+
+struct BakedAoHeader
+{
+  char     magic[4];
+  uint32_t version;
+  uint32_t vertexCount;
+  uint32_t lightmapSize;
+  float    radius;
+  float    power;
+  uint32_t samples;
+  uint32_t distanceBased;
+};
+constexpr char     kBakedAoMagic[4] = {'A', 'O', 'B', 'K'};
+constexpr uint32_t kBakedAoVersion  = 1;
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Adding the triangles of a mesh, in world space
+//
+void AoBaker::addMesh(const ObjLoader& mesh, const glm::mat4& transform)
+{
+  for(size_t i = 0; i + 2 < mesh.m_indices.size(); i += 3)
+  {
+    Triangle triangle;
+    triangle.v0 = glm::vec3(transform * glm::vec4(mesh.m_vertices[mesh.m_indices[i + 0]].pos, 1));
+    triangle.v1 = glm::vec3(transform * glm::vec4(mesh.m_vertices[mesh.m_indices[i + 1]].pos, 1));
+    triangle.v2 = glm::vec3(transform * glm::vec4(mesh.m_vertices[mesh.m_indices[i + 2]].pos, 1));
+    m_triangles.push_back(triangle);
+  }
+}
+
+glm::vec3 AoBaker::centroid(uint32_t triangle) const
+{
+  const Triangle& t = m_triangles[triangle];
+  return (t.v0 + t.v1 + t.v2) * (1.f / 3.f);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Building the BVH with binned SAH
+//
+void AoBaker::build()
+{
+  m_triIndices.resize(m_triangles.size());
+  std::iota(m_triIndices.begin(), m_triIndices.end(), 0);
+  m_nodes.clear();
+  m_blocks.clear();
+  if(m_triangles.empty())
+    return;
+
+  m_nodes.reserve(m_triangles.size() / 2 + 1);
+  m_nodes.emplace_back();
+  subdivide(0, 0, static_cast<uint32_t>(m_triangles.size()), 0);
+}
+
+void AoBaker::subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+{
+  glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX), cmin(FLT_MAX), cmax(-FLT_MAX);
+  for(uint32_t i = first; i < first + count; i++)
+  {
+    const Triangle& t = m_triangles[m_triIndices[i]];
+    bmin              = glm::min(bmin, glm::min(t.v0, glm::min(t.v1, t.v2)));
+    bmax              = glm::max(bmax, glm::max(t.v0, glm::max(t.v1, t.v2)));
+    cmin              = glm::min(cmin, centroid(m_triIndices[i]));
+    cmax              = glm::max(cmax, centroid(m_triIndices[i]));
+  }
+  m_nodes[nodeIndex].bmin = bmin;
+  m_nodes[nodeIndex].bmax = bmax;
+
+  if(count <= 4)
+  {
+    m_nodes[nodeIndex].leftOrBlock = makeLeaf(first, count);
+    m_nodes[nodeIndex].count       = count;
+    return;
+  }
+
+  // Split on the axis with the largest extent of the centroids
+  glm::vec3 extent = cmax - cmin;
+  int       axis   = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+  uint32_t  mid    = first + count / 2;
+
+  if(extent[axis] > 0 && depth < kMaxSahDepth)
+  {
+    struct Bin
+    {
+      glm::vec3 bmin{FLT_MAX};
+      glm::vec3 bmax{-FLT_MAX};
+      uint32_t  count{0};
+    };
+    std::array<Bin, kBins> bins;
+    const float            scale = static_cast<float>(kBins) / extent[axis];
+    auto                   binOf = [&](uint32_t triangle) {
+      return std::min(kBins - 1, static_cast<uint32_t>((centroid(triangle)[axis] - cmin[axis]) * scale));
+    };
+    for(uint32_t i = first; i < first + count; i++)
+    {
+      const Triangle& t   = m_triangles[m_triIndices[i]];
+      Bin&            bin = bins[binOf(m_triIndices[i])];
+      bin.bmin            = glm::min(bin.bmin, glm::min(t.v0, glm::min(t.v1, t.v2)));
+      bin.bmax            = glm::max(bin.bmax, glm::max(t.v0, glm::max(t.v1, t.v2)));
+      bin.count++;
+    }
+
+    // Cost of the split after each bin: area * triangle count on both sides
+    std::array<float, kBins - 1> cost{};
+    Bin                          left, right;
+    for(uint32_t s = 0; s < kBins - 1; s++)
+    {
+      left.bmin = glm::min(left.bmin, bins[s].bmin);
+      left.bmax = glm::max(left.bmax, bins[s].bmax);
+      left.count += bins[s].count;
+      cost[s] = left.count > 0 ? halfArea(left.bmin, left.bmax) * left.count : FLT_MAX;
+    }
+    for(uint32_t s = kBins - 1; s > 0; s--)
+    {
+      right.bmin = glm::min(right.bmin, bins[s].bmin);
+      right.bmax = glm::max(right.bmax, bins[s].bmax);
+      right.count += bins[s].count;
+      if(right.count == 0 || cost[s - 1] == FLT_MAX)
+        cost[s - 1] = FLT_MAX;
+      else
+        cost[s - 1] += halfArea(right.bmin, right.bmax) * right.count;
+    }
+
+    uint32_t bestSplit = static_cast<uint32_t>(std::min_element(cost.begin(), cost.end()) - cost.begin());
+    if(cost[bestSplit] < FLT_MAX)
+    {
+      auto it = std::partition(m_triIndices.begin() + first, m_triIndices.begin() + first + count,
+                               [&](uint32_t triangle) { return binOf(triangle) <= bestSplit; });
+      mid     = static_cast<uint32_t>(it - m_triIndices.begin());
+    }
+  }
+
+  // All centroids in one bin: splitting in two halves
+  if(mid == first || mid == first + count)
+    mid = first + count / 2;
+
+  uint32_t leftChild = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.emplace_back();
+  m_nodes.emplace_back();
+  m_nodes[nodeIndex].leftOrBlock = leftChild;
+  m_nodes[nodeIndex].count       = 0;
+  subdivide(leftChild, first, mid - first, depth + 1);
+  subdivide(leftChild + 1, mid, first + count - mid, depth + 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Leaf block of up to 4 triangles; unused lanes are degenerate triangles, which are never hit
+//
+uint32_t AoBaker::makeLeaf(uint32_t first, uint32_t count)
+{
+  TriangleBlock block{};
+  for(uint32_t lane = 0; lane < count; lane++)
+  {
+    const Triangle& t = m_triangles[m_triIndices[first + lane]];
+    glm::vec3       e1 = t.v1 - t.v0;
+    glm::vec3       e2 = t.v2 - t.v0;
+    block.v0x[lane]    = t.v0.x;
+    block.v0y[lane]    = t.v0.y;
+    block.v0z[lane]    = t.v0.z;
+    block.e1x[lane]    = e1.x;
+    block.e1y[lane]    = e1.y;
+    block.e1z[lane]    = e1.z;
+    block.e2x[lane]    = e2.x;
+    block.e2y[lane]    = e2.y;
+    block.e2z[lane]    = e2.z;
+  }
+  m_blocks.push_back(block);
+  return static_cast<uint32_t>(m_blocks.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Closest (or any) hit, intersecting the 4 triangles of a leaf at once (Moller-Trumbore, two-sided)
+//
+float AoBaker::trace(const glm::vec3& origin, const glm::vec3& direction, float tMax, bool anyHit) const
+{
+  if(m_nodes.empty())
+    return -1.f;
+
+  glm::vec3 invDir;
+  for(int i = 0; i < 3; i++)
+    invDir[i] = std::abs(direction[i]) > 1e-20f ? 1.f / direction[i] : std::copysign(1e20f, direction[i]);
+
+  float    closest = tMax;
+  bool     hit     = false;
+  uint32_t stack[kMaxStackDepth];
+  uint32_t stackSize = 0;
+  uint32_t node      = 0;
+  for(;;)
+  {
+    const Node& n = m_nodes[node];
+    if(n.count > 0)
+    {
+      const TriangleBlock& b = m_blocks[n.leftOrBlock];
+      std::array<float, 4> t;
+      for(int i = 0; i < 4; i++)
+      {
+        float px  = direction.y * b.e2z[i] - direction.z * b.e2y[i];
+        float py  = direction.z * b.e2x[i] - direction.x * b.e2z[i];
+        float pz  = direction.x * b.e2y[i] - direction.y * b.e2x[i];
+        float det = b.e1x[i] * px + b.e1y[i] * py + b.e1z[i] * pz;
+        float inv = 1.f / (det != 0.f ? det : 1.f);
+        float sx  = origin.x - b.v0x[i];
+        float sy  = origin.y - b.v0y[i];
+        float sz  = origin.z - b.v0z[i];
+        float u   = (sx * px + sy * py + sz * pz) * inv;
+        float qx  = sy * b.e1z[i] - sz * b.e1y[i];
+        float qy  = sz * b.e1x[i] - sx * b.e1z[i];
+        float qz  = sx * b.e1y[i] - sy * b.e1x[i];
+        float v   = (direction.x * qx + direction.y * qy + direction.z * qz) * inv;
+        float d   = (b.e2x[i] * qx + b.e2y[i] * qy + b.e2z[i] * qz) * inv;
+        bool  ok  = std::abs(det) > 1e-12f && u >= 0.f && v >= 0.f && u + v <= 1.f && d > 0.f && d < closest;
+        t[i]      = ok ? d : closest;
+      }
+      float leafClosest = std::min(std::min(t[0], t[1]), std::min(t[2], t[3]));
+      if(leafClosest < closest)
+      {
+        closest = leafClosest;
+        hit     = true;
+        if(anyHit)
+          return closest;
+      }
+    }
+    else
+    {
+      // Visiting the nearest child first, the other one later if the ray enters it
+      uint32_t c0 = n.leftOrBlock;
+      uint32_t c1 = c0 + 1;
+      float    d0 = intersectBox(m_nodes[c0].bmin, m_nodes[c0].bmax, origin, invDir, closest);
+      float    d1 = intersectBox(m_nodes[c1].bmin, m_nodes[c1].bmax, origin, invDir, closest);
+      if(d1 < d0)
+      {
+        std::swap(c0, c1);
+        std::swap(d0, d1);
+      }
+      if(d0 < FLT_MAX)
+      {
+        if(d1 < FLT_MAX)
+          stack[stackSize++] = c1;
+        node = c0;
+        continue;
+      }
+    }
+
+    if(stackSize == 0)
+      break;
+    node = stack[--stackSize];
+  }
+  return hit ? closest : -1.f;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same computation as ao.comp, with the Owen-scrambled Sobol sequence of common/sampler.h
+//
+float AoBaker::occlusion(const SamplerTables&  tables,
+                         const glm::vec3&      position,
+                         const glm::vec3&      normal,
+                         uint32_t              pointIndex,
+                         const AoBakeSettings& settings) const
+{
+  glm::vec3 origin = offsetRay(position, normal);
+  glm::vec3 tangent, bitangent;
+  computeDefaultBasis(normal, tangent, bitangent);
+
+  float occluded = 0;
+  for(uint32_t i = 0; i < settings.samples; i++)
+  {
+    HostSampler rng(tables, SAMPLER_SOBOL, pointIndex & 0xFFFF, pointIndex >> 16, 0, i);
+    float       r1  = rng.next();
+    float       r2  = rng.next();
+    float       sq  = std::sqrt(1.f - r2);
+    float       phi = 2.f * glm::pi<float>() * r1;
+    glm::vec3   dir = std::cos(phi) * sq * tangent + std::sin(phi) * sq * bitangent + std::sqrt(r2) * normal;
+
+    float t = trace(origin, dir, settings.radius, !settings.distanceBased);
+    if(t >= 0.f)
+      occluded += settings.distanceBased ? 1.f - t / settings.radius : 1.f;
+  }
+
+  float ao = 1.f - occluded / static_cast<float>(std::max(settings.samples, 1u));
+  return std::pow(std::clamp(ao, 0.f, 1.f), settings.power);
+}
+
+//--------------------------------------------------------------------------------------------------
+// AO at each vertex of the mesh, and at each texel of the lightmap if requested
+//
+BakedAo AoBaker::bake(const ObjLoader&      mesh,
+                      const glm::mat4&      transform,
+                      const AoBakeSettings& settings,
+                      AoBakeStats&          stats) const
+{
+  SamplerTables tables;
+  tables.generate();
+
+  const uint32_t threads = settings.threads > 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+  const auto     start   = std::chrono::steady_clock::now();
+
+  BakedAo         baked;
+  const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+  const uint32_t  vertexCount  = static_cast<uint32_t>(mesh.m_vertices.size());
+  baked.vertexAo.resize(vertexCount);
+  parallelFor(vertexCount, threads, [&](uint32_t i) {
+    const VertexObj& v        = mesh.m_vertices[i];
+    glm::vec3        position = glm::vec3(transform * glm::vec4(v.pos, 1));
+    glm::vec3        normal   = glm::normalize(normalMatrix * v.nrm);
+    baked.vertexAo[i]         = occlusion(tables, position, normal, i, settings);
+  });
+
+  uint64_t points = vertexCount;
+  if(settings.lightmapSize > 0)
+    bakeLightmap(mesh, transform, tables, settings, threads, baked, points);
+
+  stats.rays    = points * settings.samples;
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats.threads = threads;
+  return baked;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Lightmap: the triangles are rasterized in texture space to find the surface point of each texel
+// center, then the empty texels around the covered ones are filled so the bilinear filtering does
+// not fetch them at the chart borders. Texture coordinates must be unique and within [0, 1].
+//
+void AoBaker::bakeLightmap(const ObjLoader&      mesh,
+                           const glm::mat4&      transform,
+                           const SamplerTables&  tables,
+                           const AoBakeSettings& settings,
+                           uint32_t              threads,
+                           BakedAo&              baked,
+                           uint64_t&             points) const
+{
+  struct TexelPoint
+  {
+    glm::vec3 position;
+    glm::vec3 normal;
+  };
+
+  const uint32_t          size         = settings.lightmapSize;
+  const glm::mat3         normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+  std::vector<TexelPoint> texelPoints;
+  std::vector<uint32_t>   texelIndices;  // Texel of each point
+  std::vector<int32_t>    texelPoint(size * size, -1);
+
+  for(size_t i = 0; i + 2 < mesh.m_indices.size(); i += 3)
+  {
+    const VertexObj* v[3] = {&mesh.m_vertices[mesh.m_indices[i]], &mesh.m_vertices[mesh.m_indices[i + 1]],
+                             &mesh.m_vertices[mesh.m_indices[i + 2]]};
+    glm::vec2        uv[3];
+    for(int k = 0; k < 3; k++)
+      uv[k] = v[k]->texCoord * static_cast<float>(size);
+
+    float area = (uv[1].x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (uv[1].y - uv[0].y);
+    if(std::abs(area) < 1e-12f)
+      continue;
+
+    glm::vec2 lo = glm::min(uv[0], glm::min(uv[1], uv[2]));
+    glm::vec2 hi = glm::max(uv[0], glm::max(uv[1], uv[2]));
+    int       x0 = std::max(0, static_cast<int>(std::floor(lo.x)));
+    int       y0 = std::max(0, static_cast<int>(std::floor(lo.y)));
+    int       x1 = std::min(static_cast<int>(size) - 1, static_cast<int>(std::ceil(hi.x)));
+    int       y1 = std::min(static_cast<int>(size) - 1, static_cast<int>(std::ceil(hi.y)));
+    for(int y = y0; y <= y1; y++)
+    {
+      for(int x = x0; x <= x1; x++)
+      {
+        // Barycentric coordinates of the texel center
+        glm::vec2 p(x + 0.5f, y + 0.5f);
+        float     b1 = ((p.x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[2].x - uv[0].x) * (p.y - uv[0].y)) / area;
+        float     b2 = ((uv[1].x - uv[0].x) * (p.y - uv[0].y) - (p.x - uv[0].x) * (uv[1].y - uv[0].y)) / area;
+        float     b0 = 1.f - b1 - b2;
+        if(b0 < 0.f || b1 < 0.f || b2 < 0.f)
+          continue;
+
+        TexelPoint point;
+        point.position = glm::vec3(transform * glm::vec4(b0 * v[0]->pos + b1 * v[1]->pos + b2 * v[2]->pos, 1));
+        point.normal   = glm::normalize(normalMatrix * (b0 * v[0]->nrm + b1 * v[1]->nrm + b2 * v[2]->nrm));
+
+        uint32_t texel = y * size + x;
+        if(texelPoint[texel] >= 0)
+        {
+          texelPoints[texelPoint[texel]] = point;  // Overlapping charts: the last triangle wins
+          continue;
+        }
+        texelPoint[texel] = static_cast<int32_t>(texelPoints.size());
+        texelPoints.push_back(point);
+        texelIndices.push_back(texel);
+      }
+    }
+  }
+
+  baked.lightmapSize = size;
+  baked.lightmap.assign(size * size, 1.f);
+  parallelFor(static_cast<uint32_t>(texelPoints.size()), threads, [&](uint32_t i) {
+    baked.lightmap[texelIndices[i]] = occlusion(tables, texelPoints[i].position, texelPoints[i].normal, i, settings);
+  });
+  points += texelPoints.size();
+
+  // Dilation: empty texels next to covered ones take the average of their covered neighbors
+  std::vector<bool> covered(size * size);
+  for(uint32_t t = 0; t < size * size; t++)
+    covered[t] = texelPoint[t] >= 0;
+  for(int pass = 0; pass < 2; pass++)
+  {
+    std::vector<bool>  nextCovered = covered;
+    std::vector<float> next        = baked.lightmap;
+    for(int y = 0; y < static_cast<int>(size); y++)
+    {
+      for(int x = 0; x < static_cast<int>(size); x++)
+      {
+        if(covered[y * size + x])
+          continue;
+        float sum   = 0;
+        int   count = 0;
+        for(int dy = -1; dy <= 1; dy++)
+        {
+          for(int dx = -1; dx <= 1; dx++)
+          {
+            int nx = x + dx;
+            int ny = y + dy;
+            if(nx < 0 || ny < 0 || nx >= static_cast<int>(size) || ny >= static_cast<int>(size)
+               || !covered[ny * size + nx])
+              continue;
+            sum += baked.lightmap[ny * size + nx];
+            count++;
+          }
+        }
+        if(count > 0)
+        {
+          next[y * size + x]        = sum / static_cast<float>(count);
+          nextCovered[y * size + x] = true;
+        }
+      }
+    }
+    baked.lightmap = std::move(next);
+    covered        = std::move(nextCovered);
+  }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Sidecar file: header, one float per vertex, then the lightmap texels
+//
+std::string bakedAoFilename(const std::string& objFilename)
+{
+  return objFilename + ".ao";
+}
+
+bool saveBakedAo(const std::string& filename, const BakedAo& baked, const AoBakeSettings& settings)
+{
+  std::ofstream file(filename, std::ios::binary);
+  if(!file)
+    return false;
+
+  BakedAoHeader header{};
+  std::memcpy(header.magic, kBakedAoMagic, sizeof(header.magic));
+  header.version       = kBakedAoVersion;
+  header.vertexCount   = static_cast<uint32_t>(baked.vertexAo.size());
+  header.lightmapSize  = baked.lightmapSize;
+  header.radius        = settings.radius;
+  header.power         = settings.power;
+  header.samples       = settings.samples;
+  header.distanceBased = settings.distanceBased ? 1 : 0;
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(baked.vertexAo.data()), baked.vertexAo.size() * sizeof(float));
+  file.write(reinterpret_cast<const char*>(baked.lightmap.data()), baked.lightmap.size() * sizeof(float));
+  return static_cast<bool>(file);
+}
+
+bool loadBakedAo(const std::string& filename, size_t vertexCount, BakedAo& baked)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if(!file)
+    return false;
+
+  BakedAoHeader header{};
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if(!file || std::memcmp(header.magic, kBakedAoMagic, sizeof(header.magic)) != 0 || header.version != kBakedAoVersion
+     || header.vertexCount != vertexCount)
+    return false;
+
+  baked.vertexAo.resize(header.vertexCount);
+  baked.lightmapSize = header.lightmapSize;
+  baked.lightmap.resize(static_cast<size_t>(header.lightmapSize) * header.lightmapSize);
+  file.read(reinterpret_cast<char*>(baked.vertexAo.data()), baked.vertexAo.size() * sizeof(float));
+  file.read(reinterpret_cast<char*>(baked.lightmap.data()), baked.lightmap.size() * sizeof(float));
+  return static_cast<bool>(file);
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2014-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <array>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "obj_loader.h"
+
+class SamplerTables;
+
+//--------------------------------------------------------------------------------------------------
+// Offline ambient occlusion of static OBJ scenes, traced on the CPU.
+//
+// The occlusion is the same as the one of ao.comp (cosine-weighted rays of length `radius`,
+// distance-based attenuation, `power`), at each vertex and optionally at each texel of a lightmap
+// addressed by the texture coordinates of the model. The result is saved next to the OBJ file and
+// loaded by HelloVulkan::loadModel(), so the raster can use it without tracing any ray.
+//
+
+struct AoBakeSettings
+{
+  float    radius{2.0f};         // Length of the rays, as AoControl::rtao_radius
+  float    power{3.0f};          // As AoControl::rtao_power
+  bool     distanceBased{true};  // As AoControl::rtao_distance_based
+  uint32_t samples{256};         // Rays per vertex or texel
+  uint32_t lightmapSize{0};      // Texels per side of the lightmap, 0 for per-vertex AO only
+  uint32_t threads{0};           // Worker threads, 0 for all hardware threads
+};
+
+struct AoBakeStats
+{
+  uint64_t rays{0};
+  double   seconds{0};
+  uint32_t threads{1};
+
+  double raysPerSecondPerCore() const { return seconds > 0 ? static_cast<double>(rays) / seconds / threads : 0; }
+};
+
+// Baked AO of one model
+struct BakedAo
+{
+  std::vector<float> vertexAo;         // One value per vertex of ObjLoader::m_vertices
+  uint32_t           lightmapSize{0};  // 0 if there is no lightmap
+  std::vector<float> lightmap;         // lightmapSize² texels, row major, v = 0 on the first row
+};
+
+//--------------------------------------------------------------------------------------------------
+// BVH over the triangles of all the meshes of the scene, in world space. Leaves hold one block of up
+// to 4 triangles stored as structure of arrays, so their intersection is written as 4-wide loops the
+// compiler vectorizes.
+//
+class AoBaker
+{
+public:
+  void addMesh(const ObjLoader& mesh, const glm::mat4& transform);
+  void build();
+
+  // AO of a mesh of the scene, placed with `transform`
+  BakedAo bake(const ObjLoader&      mesh,
+               const glm::mat4&      transform,
+               const AoBakeSettings& settings,
+               AoBakeStats&          stats) const;
+
+  // Distance to the closest hit before tMax, or to any hit if `anyHit`; negative if there is none
+  float trace(const glm::vec3& origin, const glm::vec3& direction, float tMax, bool anyHit) const;
+
+  size_t triangleCount() const { return m_triangles.size(); }
+
+private:
+  struct Node
+  {
+    glm::vec3 bmin;
+    uint32_t  leftOrBlock;  // Internal node: index of the left child (right is +1). Leaf: index of the block
+    glm::vec3 bmax;
+    uint32_t  count;        // Triangles in the leaf block, 0 for internal nodes
+  };
+
+  struct TriangleBlock
+  {
+    std::array<float, 4> v0x, v0y, v0z;  // First vertex
+    std::array<float, 4> e1x, e1y, e1z;  // Edge v1 - v0
+    std::array<float, 4> e2x, e2y, e2z;  // Edge v2 - v0
+  };
+
+  struct Triangle
+  {
+    glm::vec3 v0, v1, v2;
+  };
+
+  void      subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+  uint32_t  makeLeaf(uint32_t first, uint32_t count);
+  glm::vec3 centroid(uint32_t triangle) const;
+
+  // AO of a point (1 = open), the result of ao.comp for `settings.samples` rays
+  float occlusion(const SamplerTables&  tables,
+                  const glm::vec3&      position,
+                  const glm::vec3&      normal,
+                  uint32_t              pointIndex,
+                  const AoBakeSettings& settings) const;
+  void  bakeLightmap(const ObjLoader&      mesh,
+                     const glm::mat4&      transform,
+                     const SamplerTables&  tables,
+                     const AoBakeSettings& settings,
+                     uint32_t              threads,
+                     BakedAo&              baked,
+                     uint64_t&             points) const;
+
+  std::vector<Triangle>      m_triangles;
+  std::vector<uint32_t>      m_triIndices;  // Triangles ordered by the build
+  std::vector<Node>          m_nodes;
+  std::vector<TriangleBlock> m_blocks;
+};
+
+// Sidecar file of the baked AO of `objFilename`
+std::string bakedAoFilename(const std::string& objFilename);
+bool        saveBakedAo(const std::string& filename, const BakedAo& baked, const AoBakeSettings& settings);
+bool        loadBakedAo(const std::string& filename, size_t vertexCount, BakedAo& baked);
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2014-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//--------------------------------------------------------------------------------------------------
+// Offline AO baker: traces the ambient occlusion of the OBJ models on the CPU and writes it next to
+// each model (<model>.obj.ao), where the viewer loads it.
+//
+// Usage: vk_ray_tracing_ao_KHR_bake [options] [model.obj ...]
+//   --radius R                 Length of the AO rays (2.0)
+//   --power P                  Exponent applied to the AO (3.0)
+//   --no-distance              Binary occlusion instead of distance-based
+//   --samples N                Rays per vertex or texel (256)
+//   --lightmap S               Also bake a SxS lightmap for the models with few vertices
+//   --lightmap-max-vertices V  Models with more vertices only get per-vertex AO (1024)
+//   --threads T                Worker threads (all hardware threads)
+//
+// The models form one scene, all at the origin as in the viewer. Without models, the scene of the
+// viewer is baked.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ao_baker.h"
+
+
+//--------------------------------------------------------------------------------------------------
+// First of the search directories holding the file, empty if none does
+//
+static std::string findFile(const std::string& name, const std::vector<std::filesystem::path>& searchPaths)
+{
+  for(const auto& dir : searchPaths)
+  {
+    std::error_code       ec;
+    std::filesystem::path path = dir / name;
+    if(std::filesystem::is_regular_file(path, ec))
+      return path.string();
+  }
+  fprintf(stderr, "Cannot find %s\n", name.c_str());
+  return {};
+}
+
+
+int main(int argc, char** argv)
+{
+  AoBakeSettings           settings;
+  uint32_t                 lightmapMaxVertices = 1024;
+  std::vector<std::string> filenames;
+
+  for(int i = 1; i < argc; i++)
+  {
+    const char* arg     = argv[i];
+    const bool  hasNext = i + 1 < argc;
+    if(strcmp(arg, "--radius") == 0 && hasNext)
+      settings.radius = static_cast<float>(atof(argv[++i]));
+    else if(strcmp(arg, "--power") == 0 && hasNext)
+      settings.power = static_cast<float>(atof(argv[++i]));
+    else if(strcmp(arg, "--no-distance") == 0)
+      settings.distanceBased = false;
+    else if(strcmp(arg, "--samples") == 0 && hasNext)
+      settings.samples = static_cast<uint32_t>(atoi(argv[++i]));
+    else if(strcmp(arg, "--lightmap") == 0 && hasNext)
+      settings.lightmapSize = static_cast<uint32_t>(atoi(argv[++i]));
+    else if(strcmp(arg, "--lightmap-max-vertices") == 0 && hasNext)
+      lightmapMaxVertices = static_cast<uint32_t>(atoi(argv[++i]));
+    else if(strcmp(arg, "--threads") == 0 && hasNext)
+      settings.threads = static_cast<uint32_t>(atoi(argv[++i]));
+    else if(arg[0] == '-')
+    {
+      fprintf(stderr, "Unknown option %s\n", arg);
+      return 1;
+    }
+    else
+      filenames.push_back(arg);
+  }
+
+  if(filenames.empty())
+  {
+    // Same search as the viewer, relative to the executable
+    std::error_code                    ec;
+    const std::string                  exeDir      = std::filesystem::absolute(argv[0], ec).parent_path().string();
+    std::vector<std::filesystem::path> searchPaths = {
+        exeDir + "/" PROJECT_RELDIRECTORY,
+        exeDir + "/" PROJECT_RELDIRECTORY "..",
+        std::filesystem::path(PROJECT_NAME),
+    };
+    for(const char* scene : {"media/scenes/plane.obj", "media/scenes/Medieval_building.obj"})
+    {
+      filenames.push_back(findFile(scene, searchPaths));
+      if(filenames.back().empty())
+        return 1;
+    }
+  }
+
+  // The scene, with all the models
+  std::vector<ObjLoader> models(filenames.size());
+  AoBaker                baker;
+  for(size_t m = 0; m < filenames.size(); m++)
+  {
+    models[m].loadModel(filenames[m]);
+    baker.addMesh(models[m], glm::mat4(1));
+  }
+  baker.build();
+  printf("Scene: %zu models, %zu triangles\n", models.size(), baker.triangleCount());
+
+  AoBakeStats total;
+  for(size_t m = 0; m < filenames.size(); m++)
+  {
+    AoBakeSettings modelSettings = settings;
+    if(models[m].m_vertices.size() > lightmapMaxVertices)
+      modelSettings.lightmapSize = 0;
+
+    AoBakeStats stats;
+    BakedAo     baked    = baker.bake(models[m], glm::mat4(1), modelSettings, stats);
+    std::string filename = bakedAoFilename(filenames[m]);
+    if(!saveBakedAo(filename, baked, modelSettings))
+    {
+      fprintf(stderr, "Cannot write %s\n", filename.c_str());
+      return 1;
+    }
+    printf("%s: %zu vertices, lightmap %ux%u, %.2f M rays in %.2f s, %.2f M rays/s/core (%u threads)\n",
+           filename.c_str(), baked.vertexAo.size(), baked.lightmapSize, baked.lightmapSize, stats.rays * 1e-6,
+           stats.seconds, stats.raysPerSecondPerCore() * 1e-6, stats.threads);
+
+    total.rays += stats.rays;
+    total.seconds += stats.seconds;
+    total.threads = stats.threads;
+  }
+  printf("Total: %.2f M rays in %.2f s, %.2f M rays/s/core\n", total.rays * 1e-6, total.seconds,
+         total.raysPerSecondPerCore() * 1e-6);
+  return 0;
+}
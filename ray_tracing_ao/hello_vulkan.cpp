@@ -18,10 +18,13 @@
  */
 
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
 
 #define STB_IMAGE_IMPLEMENTATION
+#include "ao_baker.h"
 #include "obj_loader.h"
 #include "stb_image.h"
 
@@ -219,6 +222,21 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   // Creates all textures found and find the offset for this model
   auto txtOffset = static_cast<uint32_t>(m_textures.size());
   createTextureImages(cmdBuf, loader.m_textures);
+
+  // AO baked offline for this model, if the sidecar file exists and matches it
+  BakedAo baked;
+  int     aoTextureId = -1;
+  if(loadBakedAo(bakedAoFilename(filename), loader.m_vertices.size(), baked))
+  {
+    LOGI("Baked AO: %s (lightmap %ux%u)\n", bakedAoFilename(filename).c_str(), baked.lightmapSize, baked.lightmapSize);
+    model.bakedAoBuffer = m_alloc.createBuffer(cmdBuf, baked.vertexAo, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
+    if(baked.lightmapSize > 0)
+    {
+      aoTextureId = static_cast<int>(m_textures.size());
+      createBakedAoTexture(cmdBuf, baked);
+    }
+    m_hasBakedAo = true;
+  }
   cmdBufGet.submitAndWait(cmdBuf);
   m_alloc.finalizeAndReleaseStaging();
 
@@ -227,6 +245,8 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   m_debug.setObjectName(model.indexBuffer.buffer, (std::string("index_" + objNb)));
   m_debug.setObjectName(model.matColorBuffer.buffer, (std::string("mat_" + objNb)));
   m_debug.setObjectName(model.matIndexBuffer.buffer, (std::string("matIdx_" + objNb)));
+  if(model.bakedAoBuffer.buffer != VK_NULL_HANDLE)
+    m_debug.setObjectName(model.bakedAoBuffer.buffer, (std::string("bakedAo_" + objNb)));
 
   // Keeping transformation matrix of the instance
   ObjInstance instance;
@@ -241,6 +261,10 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   desc.indexAddress         = nvvk::getBufferDeviceAddress(m_device, model.indexBuffer.buffer);
   desc.materialAddress      = nvvk::getBufferDeviceAddress(m_device, model.matColorBuffer.buffer);
   desc.materialIndexAddress = nvvk::getBufferDeviceAddress(m_device, model.matIndexBuffer.buffer);
+  desc.aoTextureId          = aoTextureId;
+  desc.aoAddress            = 0;
+  if(model.bakedAoBuffer.buffer != VK_NULL_HANDLE)
+    desc.aoAddress = nvvk::getBufferDeviceAddress(m_device, model.bakedAoBuffer.buffer);
 
   // Keeping the obj host model and device description
   m_objModel.emplace_back(model);
@@ -276,6 +300,23 @@ void HelloVulkan::createObjDescriptionBuffer()
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Generating and uploading the tables of the low-discrepancy samplers, used for the AO directions
+//
+void HelloVulkan::createSamplerTables()
+{
+  m_samplerTables.generate();
+
+  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+
+  auto cmdBuf      = cmdGen.createCommandBuffer();
+  m_bSamplerTables = m_alloc.createBuffer(cmdBuf, m_samplerTables.pack(),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  cmdGen.submitAndWait(cmdBuf);
+  m_alloc.finalizeAndReleaseStaging();
+  m_debug.setObjectName(m_bSamplerTables.buffer, "SamplerTables");
+}
+
 //--------------------------------------------------------------------------------------------------
 // Creating all textures and samplers
 //
@@ -349,6 +390,40 @@ void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// Uploading the baked AO lightmap as a linear 8-bit texture, appended to m_textures
+//
+void HelloVulkan::createBakedAoTexture(const VkCommandBuffer& cmdBuf, const BakedAo& baked)
+{
+  VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  samplerCreateInfo.minFilter    = VK_FILTER_LINEAR;
+  samplerCreateInfo.magFilter    = VK_FILTER_LINEAR;
+  samplerCreateInfo.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerCreateInfo.maxLod       = FLT_MAX;
+
+  VkFormat             format = VK_FORMAT_R8G8B8A8_UNORM;
+  std::vector<uint8_t> pixels(baked.lightmap.size() * 4);
+  for(size_t i = 0; i < baked.lightmap.size(); i++)
+  {
+    auto value = static_cast<uint8_t>(std::clamp(baked.lightmap[i], 0.f, 1.f) * 255.f + 0.5f);
+    pixels[i * 4 + 0] = pixels[i * 4 + 1] = pixels[i * 4 + 2] = value;
+    pixels[i * 4 + 3]                                         = 255u;
+  }
+
+  auto imgSize         = VkExtent2D{baked.lightmapSize, baked.lightmapSize};
+  auto imageCreateInfo = nvvk::makeImage2DCreateInfo(imgSize, format, VK_IMAGE_USAGE_SAMPLED_BIT, true);
+
+  nvvk::Image image = m_alloc.createImage(cmdBuf, pixels.size(), pixels.data(), imageCreateInfo);
+  nvvk::cmdGenerateMipmaps(cmdBuf, image.image, format, imgSize, imageCreateInfo.mipLevels);
+  VkImageViewCreateInfo ivInfo  = nvvk::makeImageViewCreateInfo(image.image, imageCreateInfo);
+  nvvk::Texture         texture = m_alloc.createTexture(image, ivInfo, samplerCreateInfo);
+  m_debug.setObjectName(texture.image, "bakedAo");
+  m_textures.push_back(texture);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Destroying all allocations
 //
@@ -361,6 +436,7 @@ void HelloVulkan::destroyResources()
 
   m_alloc.destroy(m_bGlobals);
   m_alloc.destroy(m_bObjDesc);
+  m_alloc.destroy(m_bSamplerTables);
 
   for(auto& m : m_objModel)
   {
@@ -368,6 +444,7 @@ void HelloVulkan::destroyResources()
     m_alloc.destroy(m.indexBuffer);
     m_alloc.destroy(m.matColorBuffer);
     m_alloc.destroy(m.matIndexBuffer);
+    m_alloc.destroy(m.bakedAoBuffer);
   }
 
   for(auto& t : m_textures)
@@ -379,6 +456,12 @@ void HelloVulkan::destroyResources()
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_gBuffer);
   m_alloc.destroy(m_aoBuffer);
+  m_alloc.destroy(m_aoVariance);
+  m_alloc.destroy(m_aoHistory);
+  m_alloc.destroy(m_aoVarianceHistory);
+  m_alloc.destroy(m_gBufferPrev);
+  m_alloc.destroy(m_gBufferLow);
+  m_alloc.destroy(m_aoUpsampled);
   m_alloc.destroy(m_offscreenDepth);
   vkDestroyPipeline(m_device, m_postPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_postPipelineLayout, nullptr);
@@ -390,7 +473,12 @@ void HelloVulkan::destroyResources()
   // Compute
   vkDestroyPipeline(m_device, m_compPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_compPipelineLayout, nullptr);
+  vkDestroyPipeline(m_device, m_downsamplePipeline, nullptr);
+  vkDestroyPipeline(m_device, m_upsamplePipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_upsamplePipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_compDescPool, nullptr);
+  m_alloc.destroy(m_aoStats);
+  m_rayBudget.deinit();
   vkDestroyDescriptorSetLayout(m_device, m_compDescSetLayout, nullptr);
 
   // #VKRay
@@ -439,6 +527,7 @@ void HelloVulkan::onResize(int /*w*/, int /*h*/)
   updatePostDescriptorSet();
   updateCompDescriptors();
   resetFrame();
+  m_rayBudget.reset();  // The cost of a sample depends on the resolution
 }
 
 
@@ -455,9 +544,16 @@ void HelloVulkan::createOffscreenRender()
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_gBuffer);
   m_alloc.destroy(m_aoBuffer);
+  m_alloc.destroy(m_aoVariance);
+  m_alloc.destroy(m_aoHistory);
+  m_alloc.destroy(m_aoVarianceHistory);
+  m_alloc.destroy(m_gBufferPrev);
+  m_alloc.destroy(m_gBufferLow);
+  m_alloc.destroy(m_aoUpsampled);
   m_alloc.destroy(m_offscreenDepth);
 
   VkSamplerCreateInfo sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  VkExtent2D          aoSize = getAoSize();
 
   // Creating the color image
   {
@@ -477,7 +573,7 @@ void HelloVulkan::createOffscreenRender()
   {
     auto colorCreateInfo = nvvk::makeImage2DCreateInfo(m_size, VK_FORMAT_R32G32B32A32_SFLOAT,
                                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
-                                                           | VK_IMAGE_USAGE_STORAGE_BIT);
+                                                           | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 
 
     nvvk::Image           image      = m_alloc.createImage(colorCreateInfo);
@@ -487,11 +583,12 @@ void HelloVulkan::createOffscreenRender()
     m_debug.setObjectName(m_gBuffer.image, "G-Buffer");
   }
 
-  // The ambient occlusion result (r32)
+  // The ambient occlusion result (r32), at the AO resolution
   {
-    auto colorCreateInfo = nvvk::makeImage2DCreateInfo(m_size, VK_FORMAT_R32_SFLOAT,
+    auto colorCreateInfo = nvvk::makeImage2DCreateInfo(aoSize, VK_FORMAT_R32_SFLOAT,
                                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
-                                                           | VK_IMAGE_USAGE_STORAGE_BIT);
+                                                           | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+                                                           | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
 
     nvvk::Image           image       = m_alloc.createImage(colorCreateInfo);
@@ -501,6 +598,59 @@ void HelloVulkan::createOffscreenRender()
     m_debug.setObjectName(m_aoBuffer.image, "aoBuffer");
   }
 
+  // The AO sample statistics for adaptive sampling (rgba32: count, mean, M2)
+  {
+    auto varianceCreateInfo = nvvk::makeImage2DCreateInfo(aoSize, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                                          VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    nvvk::Image           image         = m_alloc.createImage(varianceCreateInfo);
+    VkImageViewCreateInfo ivInfo        = nvvk::makeImageViewCreateInfo(image.image, varianceCreateInfo);
+    m_aoVariance                        = m_alloc.createTexture(image, ivInfo, sampler);
+    m_aoVariance.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    m_debug.setObjectName(m_aoVariance.image, "aoVariance");
+  }
+
+  // Temporal reprojection: copies of the AO, its statistics and the G-Buffer of the last computed frame
+  {
+    auto createHistory = [&](VkFormat format, const char* name) {
+      auto                  historyCreateInfo = nvvk::makeImage2DCreateInfo(aoSize, format,
+                                                                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+      nvvk::Image           image             = m_alloc.createImage(historyCreateInfo);
+      VkImageViewCreateInfo ivInfo            = nvvk::makeImageViewCreateInfo(image.image, historyCreateInfo);
+      nvvk::Texture         texture           = m_alloc.createTexture(image, ivInfo, sampler);
+      texture.descriptor.imageLayout          = VK_IMAGE_LAYOUT_GENERAL;
+      m_debug.setObjectName(texture.image, name);
+      return texture;
+    };
+    m_aoHistory         = createHistory(VK_FORMAT_R32_SFLOAT, "aoHistory");
+    m_aoVarianceHistory = createHistory(VK_FORMAT_R32G32B32A32_SFLOAT, "aoVarianceHistory");
+    m_gBufferPrev       = createHistory(VK_FORMAT_R32G32B32A32_SFLOAT, "G-Buffer previous");
+  }
+
+  // Reduced resolution AO: the G-Buffer at the AO resolution and the upsampled AO.
+  // Always created, so the descriptors stay valid at full resolution.
+  {
+    auto lowCreateInfo = nvvk::makeImage2DCreateInfo(aoSize, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                                     VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    nvvk::Image           image         = m_alloc.createImage(lowCreateInfo);
+    VkImageViewCreateInfo ivInfo        = nvvk::makeImageViewCreateInfo(image.image, lowCreateInfo);
+    m_gBufferLow                        = m_alloc.createTexture(image, ivInfo, sampler);
+    m_gBufferLow.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    m_debug.setObjectName(m_gBufferLow.image, "G-Buffer low");
+  }
+  {
+    auto upCreateInfo = nvvk::makeImage2DCreateInfo(m_size, VK_FORMAT_R32_SFLOAT,
+                                                    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT
+                                                        | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+
+    nvvk::Image           image          = m_alloc.createImage(upCreateInfo);
+    VkImageViewCreateInfo ivInfo         = nvvk::makeImageViewCreateInfo(image.image, upCreateInfo);
+    m_aoUpsampled                        = m_alloc.createTexture(image, ivInfo, sampler);
+    m_aoUpsampled.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    m_debug.setObjectName(m_aoUpsampled.image, "aoUpsampled");
+  }
+
 
   // Creating the depth buffer
   auto depthCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
@@ -524,6 +674,12 @@ void HelloVulkan::createOffscreenRender()
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
     nvvk::cmdBarrierImageLayout(cmdBuf, m_gBuffer.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
     nvvk::cmdBarrierImageLayout(cmdBuf, m_aoBuffer.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_aoVariance.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_aoHistory.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_aoVarianceHistory.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_gBufferPrev.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_gBufferLow.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_aoUpsampled.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenDepth.image, VK_IMAGE_LAYOUT_UNDEFINED,
                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
 
@@ -599,7 +755,7 @@ void HelloVulkan::updatePostDescriptorSet()
 {
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(m_postDescSetLayoutBind.makeWrite(m_postDescSet, 0, &m_offscreenColor.descriptor));
-  writes.emplace_back(m_postDescSetLayoutBind.makeWrite(m_postDescSet, 1, &m_aoBuffer.descriptor));
+  writes.emplace_back(m_postDescSetLayoutBind.makeWrite(m_postDescSet, 1, &getAoOutput().descriptor));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -734,10 +890,31 @@ void HelloVulkan::createCompDescriptors()
   m_compDescSetLayoutBind.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [in] G-Buffer
   m_compDescSetLayoutBind.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [out] AO
   m_compDescSetLayoutBind.addBinding(2, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [in] TLAS
+  m_compDescSetLayoutBind.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [in/out] AO statistics
+  m_compDescSetLayoutBind.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [out] Active pixels
+  m_compDescSetLayoutBind.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [in] AO history
+  m_compDescSetLayoutBind.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [in] AO statistics history
+  m_compDescSetLayoutBind.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [in] Previous G-Buffer
+  m_compDescSetLayoutBind.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [in] Full resolution G-Buffer
+  m_compDescSetLayoutBind.addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);  // [out] Upsampled AO
 
   m_compDescSetLayout = m_compDescSetLayoutBind.createLayout(m_device);
   m_compDescPool      = m_compDescSetLayoutBind.createPool(m_device, 1);
   m_compDescSet       = nvvk::allocateDescriptorSet(m_device, m_compDescPool, m_compDescSetLayout);
+
+  // Counters are read back by the host, one per swapchain image to avoid waiting on the GPU
+  std::vector<uint32_t> activePixels(m_swapChain.getImageCount(), 0);
+  m_aoStats = m_alloc.createBuffer(activePixels.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_debug.setObjectName(m_aoStats.buffer, "aoStats");
+}
+
+//--------------------------------------------------------------------------------------------------
+// GPU time of the AO passes, one pair of timestamps per swapchain image
+//
+void HelloVulkan::createRayBudget()
+{
+  m_rayBudget.init(m_device, m_physicalDevice, m_graphicsQueueIndex, m_swapChain.getImageCount());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -746,8 +923,18 @@ void HelloVulkan::createCompDescriptors()
 void HelloVulkan::updateCompDescriptors()
 {
   std::vector<VkWriteDescriptorSet> writes;
-  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 0, &m_gBuffer.descriptor));
+  // The AO is computed on the downsampled G-Buffer at reduced resolution
+  const nvvk::Texture& aoGBuffer = m_upsampleControl.ao_scale > 1 ? m_gBufferLow : m_gBuffer;
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 0, &aoGBuffer.descriptor));
   writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 1, &m_aoBuffer.descriptor));
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 3, &m_aoVariance.descriptor));
+  VkDescriptorBufferInfo statsInfo{m_aoStats.buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 4, &statsInfo));
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 5, &m_aoHistory.descriptor));
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 6, &m_aoVarianceHistory.descriptor));
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 7, &m_gBufferPrev.descriptor));
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 8, &m_gBuffer.descriptor));
+  writes.emplace_back(m_compDescSetLayoutBind.makeWrite(m_compDescSet, 9, &m_aoUpsampled.descriptor));
 
   VkAccelerationStructureKHR tlas = m_rtBuilder.getAccelerationStructure();
   VkWriteDescriptorSetAccelerationStructureKHR descASInfo{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR};
@@ -780,6 +967,21 @@ void HelloVulkan::createCompPipelines()
   vkCreateComputePipelines(m_device, {}, 1, &cpCreateInfo, nullptr, &m_compPipeline);
 
   vkDestroyShaderModule(m_device, cpCreateInfo.stage.module, nullptr);
+
+  // Downsampling of the G-Buffer and upsampling of the AO, same descriptor set
+  push_constants.size = sizeof(UpsampleControl);
+  vkCreatePipelineLayout(m_device, &plCreateInfo, nullptr, &m_upsamplePipelineLayout);
+  cpCreateInfo.layout = m_upsamplePipelineLayout;
+
+  cpCreateInfo.stage = nvvk::createShaderStageInfo(m_device, nvh::loadFile("spv/ao_downsample.comp.spv", true, defaultSearchPaths, true),
+                                                   VK_SHADER_STAGE_COMPUTE_BIT);
+  vkCreateComputePipelines(m_device, {}, 1, &cpCreateInfo, nullptr, &m_downsamplePipeline);
+  vkDestroyShaderModule(m_device, cpCreateInfo.stage.module, nullptr);
+
+  cpCreateInfo.stage = nvvk::createShaderStageInfo(m_device, nvh::loadFile("spv/ao_upsample.comp.spv", true, defaultSearchPaths, true),
+                                                   VK_SHADER_STAGE_COMPUTE_BIT);
+  vkCreateComputePipelines(m_device, {}, 1, &cpCreateInfo, nullptr, &m_upsamplePipeline);
+  vkDestroyShaderModule(m_device, cpCreateInfo.stage.module, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -790,11 +992,51 @@ void HelloVulkan::runCompute(VkCommandBuffer cmdBuf, AoControl& aoControl)
 {
   updateFrame();
 
+  // Baked AO: the raster already applied it, no ray is traced and the AO image is kept white
+  if(m_pcRaster.useBakedAo != 0)
+  {
+    m_debug.beginLabel(cmdBuf, "Clear AO");
+    VkClearColorValue       white{{1.f, 1.f, 1.f, 1.f}};
+    VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdClearColorImage(cmdBuf, getAoOutput().image, VK_IMAGE_LAYOUT_GENERAL, &white, 1, &range);
+
+    VkImageMemoryBarrier clearBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    clearBarrier.srcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask    = VK_ACCESS_SHADER_READ_BIT;
+    clearBarrier.image            = getAoOutput().image;
+    clearBarrier.oldLayout        = VK_IMAGE_LAYOUT_GENERAL;
+    clearBarrier.newLayout        = VK_IMAGE_LAYOUT_GENERAL;
+    clearBarrier.subresourceRange = range;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &clearBarrier);
+    m_debug.endLabel(cmdBuf);
+    return;
+  }
+
+  // Ray budget: timing of the last frame which used this slot, then the rays per pixel of this frame
+  m_rayBudget.update(getCurFrame());
+  if(m_rayBudget.enabled)
+    aoControl.rtao_samples = m_rayBudget.samples;
+  else
+    m_rayBudget.samples = aoControl.rtao_samples;
+
   // Stop by default after 100'000 samples
-  if(m_frame * aoControl.rtao_samples > aoControl.max_samples)
+  if(m_sampleCount > m_maxSamples)
     return;
+  m_sampleCount += aoControl.rtao_samples;
 
   m_debug.beginLabel(cmdBuf, "Compute");
+  m_rayBudget.begin(cmdBuf, getCurFrame());
+
+  // Camera of this frame, same as in updateUniformBuffer()
+  const float aspectRatio = m_size.width / static_cast<float>(m_size.height);
+  glm::mat4   proj        = glm::perspectiveRH_ZO(glm::radians(CameraManip.getFov()), aspectRatio, 0.1f, 1000.0f);
+  proj[1][1] *= -1;
+  const glm::mat4 viewProj = proj * CameraManip.getMatrix();
+
+  const VkExtent2D     aoSize    = getAoSize();
+  const bool           upsample  = m_upsampleControl.ao_scale > 1;
+  const nvvk::Texture& aoGBuffer = upsample ? m_gBufferLow : m_gBuffer;
 
   // Adding a barrier to be sure the fragment has finished writing to the G-Buffer
   // before the compute shader is using the buffer
@@ -811,31 +1053,237 @@ void HelloVulkan::runCompute(VkCommandBuffer cmdBuf, AoControl& aoControl)
                        VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &imgMemBarrier);
 
 
+  // The camera moved: the accumulated AO and statistics are copied to the history images, from
+  // which the shader reprojects them
+  if(m_reproject)
+  {
+    std::array<VkImageMemoryBarrier, 2> toTransfer{imgMemBarrier, imgMemBarrier};
+    toTransfer[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    toTransfer[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer[0].image         = m_aoBuffer.image;
+    toTransfer[1]               = toTransfer[0];
+    toTransfer[1].image         = m_aoVariance.image;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(toTransfer.size()), toTransfer.data());
+
+    cmdCopyImage(cmdBuf, m_aoBuffer.image, m_aoHistory.image, aoSize);
+    cmdCopyImage(cmdBuf, m_aoVariance.image, m_aoVarianceHistory.image, aoSize);
+
+    std::array<VkImageMemoryBarrier, 2> toCompute{imgMemBarrier, imgMemBarrier};
+    toCompute[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    toCompute[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    toCompute[0].image         = m_aoHistory.image;
+    toCompute[1]               = toCompute[0];
+    toCompute[1].image         = m_aoVarianceHistory.image;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr,
+                         static_cast<uint32_t>(toCompute.size()), toCompute.data());
+  }
+
+
+  // Reduced resolution: picking one G-Buffer sample per block of ao_scale² pixels
+  m_upsampleControl.rtao_radius = aoControl.rtao_radius;
+  if(upsample)
+  {
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_downsamplePipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_upsamplePipelineLayout, 0, 1, &m_compDescSet, 0, nullptr);
+    vkCmdPushConstants(cmdBuf, m_upsamplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UpsampleControl), &m_upsampleControl);
+    vkCmdDispatch(cmdBuf, (aoSize.width + (GROUP_SIZE - 1)) / GROUP_SIZE, (aoSize.height + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+
+    imgMemBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    imgMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imgMemBarrier.image         = m_gBufferLow.image;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &imgMemBarrier);
+  }
+
+
   // Preparing for the compute shader
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_compPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_compPipelineLayout, 0, 1, &m_compDescSet, 0, nullptr);
 
 
+  // Reading the active pixel count of the last frame which used this slot; its fence was waited
+  // on in prepareFrame(), then resetting it for this frame
+  aoControl.stats_slot         = getCurFrame();
+  aoControl.adaptive_threshold = m_useAdaptive ? m_adaptiveThreshold : 0.f;
+  auto* activePixels           = static_cast<uint32_t*>(m_alloc.map(m_aoStats));
+  if(m_frame > 0)
+  {
+    m_activePixels   = activePixels[aoControl.stats_slot];
+    m_activeFraction = static_cast<float>(m_activePixels) / static_cast<float>(aoSize.width * aoSize.height);
+  }
+  activePixels[aoControl.stats_slot] = 0;
+  m_alloc.unmap(m_aoStats);
+
   // Sending the push constant information
-  aoControl.frame = m_frame;
+  aoControl.frame              = m_frame;
+  aoControl.seed_frame         = m_seedFrame++;
+  aoControl.sampler_tables     = nvvk::getBufferDeviceAddress(m_device, m_bSamplerTables.buffer);
+  aoControl.temporal_reproject = m_reproject ? 1 : 0;
+  aoControl.prev_view_proj     = m_prevViewProj;
   vkCmdPushConstants(cmdBuf, m_compPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(AoControl), &aoControl);
 
   // Dispatching the shader
-  vkCmdDispatch(cmdBuf, (m_size.width + (GROUP_SIZE - 1)) / GROUP_SIZE, (m_size.height + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+  vkCmdDispatch(cmdBuf, (aoSize.width + (GROUP_SIZE - 1)) / GROUP_SIZE, (aoSize.height + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+
+  // Reduced resolution: joint bilateral upsampling of the AO, guided by the full resolution G-Buffer
+  if(upsample)
+  {
+    imgMemBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    imgMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imgMemBarrier.image         = m_aoBuffer.image;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &imgMemBarrier);
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_upsamplePipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_upsamplePipelineLayout, 0, 1, &m_compDescSet, 0, nullptr);
+    vkCmdPushConstants(cmdBuf, m_upsamplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UpsampleControl), &m_upsampleControl);
+    vkCmdDispatch(cmdBuf, (m_size.width + (GROUP_SIZE - 1)) / GROUP_SIZE, (m_size.height + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+  }
 
 
   // Adding a barrier to be sure the compute shader has finished
   // writing to the AO buffer before the post shader is using it
   imgMemBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
   imgMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  imgMemBarrier.image         = m_aoBuffer.image;
+  imgMemBarrier.image         = getAoOutput().image;
   vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                        VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &imgMemBarrier);
 
+  // Keeping the G-Buffer and camera of this frame, to validate the reprojection after the next camera move
+  if(m_useTemporal)
+  {
+    imgMemBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    imgMemBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imgMemBarrier.image         = aoGBuffer.image;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &imgMemBarrier);
+
+    cmdCopyImage(cmdBuf, aoGBuffer.image, m_gBufferPrev.image, aoSize);
+
+    // The next frame rasterizes (or downsamples) in the G-Buffer, and its compute reads the copy
+    imgMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    imgMemBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &imgMemBarrier);
+    imgMemBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imgMemBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    imgMemBarrier.image         = m_gBufferPrev.image;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1, &imgMemBarrier);
+
+    m_prevViewProj = viewProj;
+    m_historyValid = true;
+  }
 
+  m_rayBudget.end(cmdBuf, getCurFrame());
   m_debug.endLabel(cmdBuf);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Resolution of the AO: the window size divided by the AO scale
+//
+VkExtent2D HelloVulkan::getAoSize() const
+{
+  const uint32_t scale = static_cast<uint32_t>(m_upsampleControl.ao_scale);
+  return {(m_size.width + scale - 1) / scale, (m_size.height + scale - 1) / scale};
+}
+
+//--------------------------------------------------------------------------------------------------
+// Full resolution AO displayed by the post shader
+//
+const nvvk::Texture& HelloVulkan::getAoOutput() const
+{
+  return m_upsampleControl.ao_scale > 1 ? m_aoUpsampled : m_aoBuffer;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reading back the displayed AO, waiting for the device to be idle. Only used for measurements.
+//
+std::vector<float> HelloVulkan::readAoOutput()
+{
+  vkDeviceWaitIdle(m_device);
+
+  const VkDeviceSize pixels  = static_cast<VkDeviceSize>(m_size.width) * m_size.height;
+  nvvk::Buffer       staging = m_alloc.createBuffer(pixels * sizeof(float), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  {
+    nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+    VkCommandBuffer   cmdBuf = genCmdBuf.createCommandBuffer();
+
+    // The AO was written by the compute shaders, or cleared when it is baked
+    VkImageMemoryBarrier toTransfer{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    toTransfer.srcAccessMask    = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    toTransfer.dstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer.image            = getAoOutput().image;
+    toTransfer.oldLayout        = VK_IMAGE_LAYOUT_GENERAL;
+    toTransfer.newLayout        = VK_IMAGE_LAYOUT_GENERAL;
+    toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 0, nullptr, 1,
+                         &toTransfer);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent      = {m_size.width, m_size.height, 1};
+    vkCmdCopyImageToBuffer(cmdBuf, getAoOutput().image, VK_IMAGE_LAYOUT_GENERAL, staging.buffer, 1, &region);
+    genCmdBuf.submitAndWait(cmdBuf);
+  }
+
+  std::vector<float> result(pixels);
+  auto*              data = static_cast<float*>(m_alloc.map(staging));
+  std::copy(data, data + pixels, result.begin());
+  m_alloc.unmap(staging);
+  m_alloc.destroy(staging);
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Keeping the displayed AO (usually a converged full resolution one) to compare against
+//
+void HelloVulkan::captureAoReference()
+{
+  m_aoReference = readAoOutput();
+  m_aoPsnr      = 0;
+}
+
+//--------------------------------------------------------------------------------------------------
+// PSNR of the displayed AO, in [0, 1], against the captured reference
+//
+void HelloVulkan::measureAoPsnr()
+{
+  std::vector<float> current = readAoOutput();
+  if(current.size() != m_aoReference.size())
+  {
+    m_aoPsnr = 0;
+    return;
+  }
+
+  double squaredError = 0;
+  for(size_t i = 0; i < current.size(); i++)
+  {
+    double diff = static_cast<double>(current[i]) - static_cast<double>(m_aoReference[i]);
+    squaredError += diff * diff;
+  }
+  double mse = squaredError / static_cast<double>(current.size());
+  m_aoPsnr   = mse > 0 ? static_cast<float>(10.0 * std::log10(1.0 / mse)) : 99.f;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Copying a full color image, both images in the general layout
+//
+void HelloVulkan::cmdCopyImage(VkCommandBuffer cmdBuf, VkImage src, VkImage dst, const VkExtent2D& size)
+{
+  VkImageCopy region{};
+  region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.extent         = {size.width, size.height, 1};
+  vkCmdCopyImage(cmdBuf, src, VK_IMAGE_LAYOUT_GENERAL, dst, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Reset from JITTER CAM tutorial
 //////////////////////////////////////////////////////////////////////////
@@ -850,9 +1298,13 @@ void HelloVulkan::updateFrame()
 
   auto& m = CameraManip.getMatrix();
   auto  f = CameraManip.getFov();
+  m_reproject = false;
   if(refCamMatrix != m || f != fov)
   {
+    // With temporal reprojection, the accumulation restarts from the reprojected history
+    bool keepHistory = m_useTemporal && m_historyValid;
     resetFrame();
+    m_reproject  = keepHistory;
     refCamMatrix = m;
     fov          = f;
   }
@@ -862,5 +1314,7 @@ void HelloVulkan::updateFrame()
 
 void HelloVulkan::resetFrame()
 {
-  m_frame = -1;
+  m_frame        = -1;
+  m_sampleCount  = 0;
+  m_historyValid = false;
 }
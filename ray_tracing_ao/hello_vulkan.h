@@ -25,18 +25,40 @@
 #include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
 #include "shaders/host_device.h"
+#include "ao_baker.h"
+#include "ray_budget.h"
+#include "sampler.h"
 
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
 
 struct AoControl
 {
-  float rtao_radius{2.0f};       // Length of the ray
-  int   rtao_samples{4};         // Nb samples at each iteration
-  float rtao_power{3.0f};        // Darkness is stronger for more hits
-  int   rtao_distance_based{1};  // Attenuate based on distance
-  int   frame{0};                // Current frame
-  int   max_samples{100'000};    // Max samples before it stops
+  float    rtao_radius{2.0f};                // Length of the ray
+  int      rtao_samples{4};                  // Nb samples at each iteration
+  float    rtao_power{3.0f};                 // Darkness is stronger for more hits
+  int      rtao_distance_based{1};           // Attenuate based on distance
+  int      frame{0};                         // Current frame
+  uint     seed_frame{0};                    // Frames computed since the start, never reset: seed of the random sampler
+  float    adaptive_threshold{0};            // Relative standard error below which a pixel stops, 0 disables
+  int      adaptive_min_samples{8};          // Frames a pixel accumulates before it can be considered converged
+  uint     stats_slot{0};                    // Entry of the active pixel counter written this frame
+  uint     sampler_type{SAMPLER_RANDOM};     // Sequence of the hemisphere directions
+  uint64_t sampler_tables{0};                // Address of the tables of common/shaders/sampler.glsl
+  mat4     prev_view_proj{1};                // Camera of the history, for the temporal reprojection
+  int      temporal_reproject{0};            // The history must be reprojected (the camera moved)
+  int      temporal_max_frames{32};          // Max frames of reprojected history, older samples fade out
+  float    temporal_depth_tolerance{0.01f};  // Max distance to the previous surface, relative to the depth
+  float    temporal_normal_tolerance{0.9f};  // Min cosine between the current and previous normals
+};
+
+// Push constant of ao_downsample.comp and ao_upsample.comp
+struct UpsampleControl
+{
+  int   ao_scale{1};         // Full resolution pixels per AO pixel, in each dimension
+  float depth_sigma{0.05f};  // Distance to the plane of the pixel (fraction of the AO radius) weighting e^-1
+  float normal_power{8.f};   // Exponent of the cosine between the normals
+  float rtao_radius{2.0f};   // Copy of AoControl::rtao_radius
 };
 
 
@@ -57,7 +79,9 @@ public:
   void updateDescriptorSet();
   void createUniformBuffer();
   void createObjDescriptionBuffer();
+  void createSamplerTables();
   void createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures);
+  void createBakedAoTexture(const VkCommandBuffer& cmdBuf, const BakedAo& baked);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
   void destroyResources();
@@ -72,6 +96,7 @@ public:
     nvvk::Buffer indexBuffer;     // Device buffer of the indices forming triangles
     nvvk::Buffer matColorBuffer;  // Device buffer of array of 'Wavefront material'
     nvvk::Buffer matIndexBuffer;  // Device buffer of array of 'Wavefront material'
+    nvvk::Buffer bakedAoBuffer;   // Device buffer of the baked AO of each vertex, if any
   };
 
   struct ObjInstance
@@ -87,7 +112,8 @@ public:
       {10.f, 15.f, 8.f},                                 // light position
       0,                                                 // instance Id
       100.f,                                             // light intensity
-      0                                                  // light type
+      0,                                                 // light type
+      0                                                  // use baked AO
   };
 
   // Array of objects and instances in the scene
@@ -107,6 +133,10 @@ public:
   nvvk::Buffer m_bGlobals;  // Device-Host of the camera matrices
   nvvk::Buffer m_bObjDesc;  // Device buffer of the OBJ descriptions
 
+  SamplerTables      m_samplerTables;       // Sobol directions and blue-noise tile
+  nvvk::Buffer       m_bSamplerTables;      // Device copy, see common/shaders/sampler.glsl
+  SamplerConvergence m_samplerConvergence;  // Result of the last convergence benchmark
+
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
 
@@ -135,6 +165,12 @@ public:
   VkFormat                    m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};
   nvvk::Texture               m_gBuffer;
   nvvk::Texture               m_aoBuffer;
+  nvvk::Texture               m_aoVariance;  // Per-pixel count, mean and M2 of the AO samples
+  nvvk::Texture               m_aoHistory;          // AO before the camera moved
+  nvvk::Texture               m_aoVarianceHistory;  // AO statistics before the camera moved
+  nvvk::Texture               m_gBufferPrev;        // G-Buffer of the last computed frame
+  nvvk::Texture               m_gBufferLow;         // G-Buffer at the AO resolution
+  nvvk::Texture               m_aoUpsampled;        // AO upsampled to full resolution
 
   // #Tuto_rayquery
   void initRayTracing();
@@ -152,6 +188,12 @@ public:
   void updateCompDescriptors();
   void createCompPipelines();
   void runCompute(VkCommandBuffer cmdBuf, AoControl& aoControl);
+  void cmdCopyImage(VkCommandBuffer cmdBuf, VkImage src, VkImage dst, const VkExtent2D& size);
+  VkExtent2D           getAoSize() const;
+  const nvvk::Texture& getAoOutput() const;
+  std::vector<float>   readAoOutput();
+  void                 captureAoReference();
+  void                 measureAoPsnr();
 
   nvvk::DescriptorSetBindings m_compDescSetLayoutBind;
   VkDescriptorPool            m_compDescPool;
@@ -160,8 +202,39 @@ public:
   VkPipeline                  m_compPipeline;
   VkPipelineLayout            m_compPipelineLayout;
 
+  // Adaptive sampling
+  nvvk::Buffer m_aoStats;  // One active pixel counter per frame in flight
+  bool         m_useAdaptive{false};
+  float        m_adaptiveThreshold{0.02f};
+  float        m_activeFraction{1.f};
+
+  // Reduced resolution AO
+  VkPipeline         m_downsamplePipeline{VK_NULL_HANDLE};
+  VkPipeline         m_upsamplePipeline{VK_NULL_HANDLE};
+  VkPipelineLayout   m_upsamplePipelineLayout{VK_NULL_HANDLE};
+  UpsampleControl    m_upsampleControl;
+  uint32_t           m_activePixels{0};  // AO pixels computed in the last frame
+  std::vector<float> m_aoReference;      // Full resolution AO captured for the PSNR
+  float              m_aoPsnr{0};        // PSNR of the displayed AO against m_aoReference, 0 if not measured
+
+  // Ray budget: rtao_samples chosen each frame from the GPU time of the AO passes
+  void      createRayBudget();
+  RayBudget m_rayBudget;
+  int       m_sampleCount{0};       // Samples per pixel since the last reset
+  int       m_maxSamples{100'000};  // Samples per pixel before the AO stops
+
+  // Temporal reprojection
+  bool      m_useTemporal{true};
+  bool      m_historyValid{false};  // The history images and m_prevViewProj match
+  bool      m_reproject{false};     // The camera moved this frame
+  glm::mat4 m_prevViewProj{1};
+
+  // AO baked offline (bake/main.cpp), loaded with the models
+  bool m_hasBakedAo{false};  // At least one model has baked AO
+
   // #Tuto_jitter_cam
-  void updateFrame();
-  void resetFrame();
-  int  m_frame{0};
+  void     updateFrame();
+  void     resetFrame();
+  int      m_frame{0};
+  uint32_t m_seedFrame{0};  // Unlike m_frame, not reset when the camera moves
 };
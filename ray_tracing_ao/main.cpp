@@ -171,6 +171,7 @@ int main(int argc, char** argv)
   helloVk.createGraphicsPipeline();
   helloVk.createUniformBuffer();
   helloVk.createObjDescriptionBuffer();
+  helloVk.createSamplerTables();
 
   // #VKRay
   helloVk.initRayTracing();
@@ -188,6 +189,7 @@ int main(int argc, char** argv)
   helloVk.createCompDescriptors();
   helloVk.updateCompDescriptors();
   helloVk.createCompPipelines();
+  helloVk.createRayBudget();
 
 
   glm::vec4 clearColor = glm::vec4(0, 0, 0, 0);
@@ -223,13 +225,98 @@ int main(int argc, char** argv)
         if(ImGui::CollapsingHeader("Ambient Occlusion"))
         {
           bool changed{false};
+          // AO baked offline with vk_ray_tracing_ao_KHR_bake, applied by the raster without tracing rays
+          if(helloVk.m_hasBakedAo)
+          {
+            bool useBakedAo = helloVk.m_pcRaster.useBakedAo != 0;
+            if(ImGui::Checkbox("Use baked AO", &useBakedAo))
+            {
+              helloVk.m_pcRaster.useBakedAo = useBakedAo ? 1 : 0;
+              changed                       = true;
+            }
+          }
           changed |= ImGui::SliderFloat("Radius", &aoControl.rtao_radius, 0, 5);
-          changed |= ImGui::SliderInt("Rays per Pixel", &aoControl.rtao_samples, 1, 64);
+          if(!helloVk.m_rayBudget.enabled)
+            changed |= ImGui::SliderInt("Rays per Pixel", &aoControl.rtao_samples, 1, 64);
           changed |= ImGui::SliderFloat("Power", &aoControl.rtao_power, 1, 5);
-          changed |= ImGui::InputInt("Max Samples", &aoControl.max_samples);
+          changed |= ImGui::InputInt("Max Samples", &helloVk.m_maxSamples);
           changed |= ImGui::Checkbox("Distanced Based", (bool*)&aoControl.rtao_distance_based);
+          changed |= ImGui::Checkbox("Adaptive sampling", &helloVk.m_useAdaptive);
+          if(helloVk.m_useAdaptive)
+          {
+            changed |= ImGui::SliderFloat("Error threshold", &helloVk.m_adaptiveThreshold, 0.001f, 0.1f, "%.3f");
+            changed |= ImGui::SliderInt("Min frames", &aoControl.adaptive_min_samples, 2, 256);
+            ImGui::Text("Active pixels: %.1f %%", helloVk.m_activeFraction * 100.f);
+          }
+          int aoScale = helloVk.m_upsampleControl.ao_scale == 1 ? 0 : helloVk.m_upsampleControl.ao_scale / 2;
+          if(ImGui::Combo("AO resolution", &aoScale, "Full\0Half\0Quarter\0"))
+          {
+            // The AO images are recreated at the new resolution
+            vkDeviceWaitIdle(helloVk.getDevice());
+            helloVk.m_upsampleControl.ao_scale = 1 << aoScale;
+            helloVk.onResize(helloVk.getSize().width, helloVk.getSize().height);
+          }
+          if(helloVk.m_upsampleControl.ao_scale > 1)
+          {
+            ImGui::SliderFloat("Depth sigma", &helloVk.m_upsampleControl.depth_sigma, 0.001f, 0.5f, "%.3f");
+            ImGui::SliderFloat("Normal power", &helloVk.m_upsampleControl.normal_power, 1.f, 64.f);
+          }
+          // Rays traced in the last frame, against the same number of rays at full resolution
+          const float fullRays = static_cast<float>(helloVk.getSize().width * helloVk.getSize().height) * aoControl.rtao_samples;
+          const float rays     = static_cast<float>(helloVk.m_activePixels) * aoControl.rtao_samples;
+          ImGui::Text("Rays: %.2f M/frame (%.1f %% of full resolution)", rays * 1e-6f, 100.f * rays / fullRays);
+          if(ImGui::Button("Capture reference"))
+            helloVk.captureAoReference();
+          ImGui::SameLine();
+          if(ImGui::Button("Measure PSNR") && !helloVk.m_aoReference.empty())
+            helloVk.measureAoPsnr();
+          if(helloVk.m_aoPsnr > 0)
+          {
+            ImGui::SameLine();
+            ImGui::Text("%.2f dB", helloVk.m_aoPsnr);
+          }
+          // Rays per pixel chosen each frame to meet a GPU time budget
+          RayBudget& budget = helloVk.m_rayBudget;
+          if(budget.supported())
+          {
+            ImGui::Checkbox("Ray budget", &budget.enabled);
+            if(budget.enabled)
+            {
+              ImGui::SliderFloat("Budget (ms)", &budget.targetMs, 0.5f, 50.f);
+              ImGui::SliderFloat("Hysteresis", &budget.hysteresis, 0.f, 0.5f);
+              ImGui::DragIntRange2("Rays range", &budget.minSamples, &budget.maxSamples, 1, 1, 64);
+            }
+            ImGui::Text("AO: %.2f ms (avg %.2f ms, %.3f ms/ray per pixel), %d rays per pixel", budget.lastMs,
+                        budget.avgMs, budget.avgSampleMs, aoControl.rtao_samples);
+          }
+          changed |= ImGui::Checkbox("Temporal reprojection", &helloVk.m_useTemporal);
+          if(helloVk.m_useTemporal)
+          {
+            // Only used when the camera moves, no need to restart the accumulation
+            ImGui::SliderInt("History frames", &aoControl.temporal_max_frames, 1, 256);
+            ImGui::SliderFloat("Depth tolerance", &aoControl.temporal_depth_tolerance, 0.001f, 0.1f, "%.3f");
+            ImGui::SliderFloat("Normal tolerance", &aoControl.temporal_normal_tolerance, 0.f, 1.f);
+          }
+          int samplerType = static_cast<int>(aoControl.sampler_type);
+          if(ImGui::Combo("Sequence", &samplerType, "Random\0Sobol (Owen)\0Blue noise\0"))
+          {
+            aoControl.sampler_type = static_cast<uint32_t>(samplerType);
+            changed                = true;
+          }
           if(changed)
             helloVk.resetFrame();
+
+          if(ImGui::Button("Measure convergence"))
+            helloVk.m_samplerConvergence = measureSamplerConvergence(helloVk.m_samplerTables, ConvergenceTest::eHemisphere);
+          // RMSE of the visibility of cosine-weighted directions against an occluder, per number of samples
+          const auto& result = helloVk.m_samplerConvergence;
+          if(!result.sampleCounts.empty())
+            ImGui::Text("RMSE      Random  Sobol   Blue noise");
+          for(size_t i = 0; i < result.sampleCounts.size(); i++)
+          {
+            ImGui::Text("%4u spp  %.4f  %.4f  %.4f", result.sampleCounts[i], result.rmse[SAMPLER_RANDOM][i],
+                        result.rmse[SAMPLER_SOBOL][i], result.rmse[SAMPLER_BLUE_NOISE][i]);
+          }
         }
 
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
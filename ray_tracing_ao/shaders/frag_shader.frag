@@ -41,6 +41,7 @@ layout(location = 1) in vec3 i_worldPos;
 layout(location = 2) in vec3 i_worldNrm;
 layout(location = 3) in vec3 i_viewDir;
 layout(location = 4) in vec2 i_texCoord;
+layout(location = 5) in float i_bakedAo;
 // Outgoing
 layout(location = 0) out vec4 o_color;
 layout(location = 1) out vec4 o_gbuffer;
@@ -103,5 +104,14 @@ void main()
 
   // Result
   o_color        = vec4(lightIntensity * (diffuse + specular), 1);
+
+  // AO baked offline: the lightmap if the model has one, else interpolated from the vertices
+  if(pcRaster.useBakedAo != 0)
+  {
+    float ao = i_bakedAo;
+    if(objResource.aoTextureId >= 0)
+      ao = texture(textureSamplers[nonuniformEXT(objResource.aoTextureId)], i_texCoord).x;
+    o_color.rgb *= ao;
+  }
   o_gbuffer.rgba = vec4(i_worldPos, uintBitsToFloat(CompressUnitVec(N)));
 }
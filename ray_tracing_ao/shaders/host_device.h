@@ -57,10 +57,12 @@ END_BINDING();
 struct ObjDesc
 {
   int      txtOffset;             // Texture index offset in the array of textures
+  int      aoTextureId;           // Baked AO lightmap in the array of textures, -1 if none
   uint64_t vertexAddress;         // Address of the Vertex buffer
   uint64_t indexAddress;          // Address of the index buffer
   uint64_t materialAddress;       // Address of the material buffer
   uint64_t materialIndexAddress;  // Address of the triangle material index buffer
+  uint64_t aoAddress;             // Address of the baked AO, one float per vertex, 0 if none
 };
 
 // Uniform buffer set at each frame
@@ -79,6 +81,7 @@ struct PushConstantRaster
   uint  objIndex;
   float lightIntensity;
   int   lightType;
+  int   useBakedAo;  // Applying the AO baked offline instead of the ray traced one
 };
 
 
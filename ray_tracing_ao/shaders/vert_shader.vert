@@ -23,6 +23,7 @@
 #extension GL_GOOGLE_include_directive : enable
 
 #extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+#extension GL_EXT_buffer_reference2 : require
 
 #include "wavefront.glsl"
 
@@ -36,6 +37,11 @@ layout(push_constant) uniform _PushConstantRaster
   PushConstantRaster pcRaster;
 };
 
+// clang-format off
+layout(buffer_reference, scalar) buffer BakedAo {float a[]; }; // Baked AO of each vertex
+layout(binding = eObjDescs, scalar) buffer ObjDesc_ { ObjDesc i[]; } objDesc;
+// clang-format on
+
 layout(location = 0) in vec3 i_position;
 layout(location = 1) in vec3 i_normal;
 layout(location = 2) in vec3 i_color;
@@ -46,6 +52,7 @@ layout(location = 1) out vec3 o_worldPos;
 layout(location = 2) out vec3 o_worldNrm;
 layout(location = 3) out vec3 o_viewDir;
 layout(location = 4) out vec2 o_texCoord;
+layout(location = 5) out float o_bakedAo;
 
 out gl_PerVertex
 {
@@ -62,5 +69,8 @@ void main()
   o_texCoord = i_texCoord;
   o_worldNrm = mat3(pcRaster.modelMatrix) * i_normal;
 
+  uint64_t aoAddress = objDesc.i[pcRaster.objIndex].aoAddress;
+  o_bakedAo          = pcRaster.useBakedAo != 0 && aoAddress != 0 ? BakedAo(aoAddress).a[gl_VertexIndex] : 1.0;
+
   gl_Position = uni.viewProj * vec4(o_worldPos, 1.0);
 }
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include "frame_writer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "nvh/nvprint.hpp"
+#include "stb_image_write.h"  // Implemented with tiny_gltf.h in hello_vulkan.cpp
+
+namespace {
+
+bool hasExtension(const std::string& filename, const char* extension)
+{
+  size_t length = strlen(extension);
+  return filename.size() >= length && filename.compare(filename.size() - length, length, extension) == 0;
+}
+
+bool writeExr(const std::string& filename, uint32_t width, uint32_t height, const float* pixels)
+{
+  const std::vector<uint8_t> header    = FrameWriter::exrHeader(width, height);
+  const uint32_t             lineBytes = width * 4 * sizeof(float);
+
+  FILE* file = fopen(filename.c_str(), "wb");
+  if(file == nullptr)
+    return false;
+
+  bool               ok = fwrite(header.data(), header.size(), 1, file) == 1;
+  std::vector<float> line(size_t(width) * 4);
+  for(uint32_t y = 0; y < height && ok; y++)
+  {
+    const float* row = pixels + size_t(y) * width * 4;
+    for(uint32_t x = 0; x < width; x++)
+    {
+      for(uint32_t c = 0; c < 4; c++)
+        line[c * width + x] = row[x * 4 + 3 - c];  // RGBA to planes A, B, G, R
+    }
+    const int32_t lineHeader[2] = {static_cast<int32_t>(y), static_cast<int32_t>(lineBytes)};
+    ok = fwrite(lineHeader, sizeof(lineHeader), 1, file) == 1 && fwrite(line.data(), lineBytes, 1, file) == 1;
+  }
+  ok = fclose(file) == 0 && ok;
+  return ok;
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Minimal OpenEXR writer: single part scanline image, without compression, with 32-bit float
+// channels. The channels of the file are sorted by name: A, B, G, R. Assumes a little-endian host.
+//
+std::vector<uint8_t> FrameWriter::exrHeader(uint32_t width, uint32_t height)
+{
+  std::vector<uint8_t> header;
+  auto put = [&](const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    header.insert(header.end(), bytes, bytes + size);
+  };
+  auto putString = [&](const char* text) { put(text, strlen(text) + 1); };
+  auto putInt    = [&](int32_t value) { put(&value, sizeof(value)); };
+  auto attribute = [&](const char* name, const char* type, int32_t size) {
+    putString(name);
+    putString(type);
+    putInt(size);
+  };
+
+  putInt(20000630);  // Magic number
+  putInt(2);         // Version 2, single part scanline file
+
+  attribute("channels", "chlist", 4 * 18 + 1);
+  for(const char* channel : {"A", "B", "G", "R"})
+  {
+    putString(channel);
+    putInt(2);  // FLOAT
+    putInt(0);  // pLinear and reserved
+    putInt(1);  // xSampling
+    putInt(1);  // ySampling
+  }
+  header.push_back(0);
+
+  const int32_t window[4] = {0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1};
+  const float   center[2] = {0.f, 0.f};
+  const float   one       = 1.f;
+  attribute("compression", "compression", 1);
+  header.push_back(0);  // NO_COMPRESSION
+  attribute("dataWindow", "box2i", sizeof(window));
+  put(window, sizeof(window));
+  attribute("displayWindow", "box2i", sizeof(window));
+  put(window, sizeof(window));
+  attribute("lineOrder", "lineOrder", 1);
+  header.push_back(0);  // INCREASING_Y
+  attribute("pixelAspectRatio", "float", sizeof(one));
+  put(&one, sizeof(one));
+  attribute("screenWindowCenter", "v2f", sizeof(center));
+  put(center, sizeof(center));
+  attribute("screenWindowWidth", "float", sizeof(one));
+  put(&one, sizeof(one));
+  header.push_back(0);  // End of the header
+
+  // Offset of each scanline in the file. A scanline is its y, its size, and each channel in turn.
+  const uint32_t lineBytes = width * 4 * sizeof(float);
+  uint64_t       offset    = header.size() + uint64_t(height) * sizeof(uint64_t);
+  for(uint32_t y = 0; y < height; y++)
+  {
+    put(&offset, sizeof(offset));
+    offset += 2 * sizeof(int32_t) + lineBytes;
+  }
+  return header;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// The buffers of the slots are created by the first image written in them
+//
+void FrameWriter::setup(VkDevice device, nvvk::ResourceAllocator* allocator, uint32_t queueFamily, uint32_t slotCount, uint32_t threadCount)
+{
+  m_device = device;
+  m_alloc  = allocator;
+  m_stop   = false;
+  m_stats  = {};
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_cmdPool);
+
+  m_slots.resize(std::max(slotCount, 1u));
+  std::vector<VkCommandBuffer> cmdBufs(m_slots.size());
+  VkCommandBufferAllocateInfo  allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocInfo.commandPool        = m_cmdPool;
+  allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = static_cast<uint32_t>(cmdBufs.size());
+  vkAllocateCommandBuffers(m_device, &allocInfo, cmdBufs.data());
+
+  for(size_t i = 0; i < m_slots.size(); i++)
+  {
+    VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    vkCreateFence(m_device, &fenceInfo, nullptr, &m_slots[i].fence);
+    m_slots[i].cmdBuf = cmdBufs[i];
+  }
+
+  for(uint32_t i = 0; i < std::max(threadCount, 1u); i++)
+    m_workers.emplace_back(&FrameWriter::workerLoop, this);
+}
+
+void FrameWriter::destroy()
+{
+  if(m_slots.empty())
+    return;
+
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_jobAdded.notify_all();
+  for(auto& worker : m_workers)
+    worker.join();
+  m_workers.clear();
+
+  for(auto& slot : m_slots)
+  {
+    if(slot.buffer.buffer != VK_NULL_HANDLE)
+    {
+      m_alloc->unmap(slot.buffer);
+      m_alloc->destroy(slot.buffer);
+    }
+    vkDestroyFence(m_device, slot.fence, nullptr);
+  }
+  m_slots.clear();
+  vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+  m_cmdPool = VK_NULL_HANDLE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Submits the copy of the image to a free slot. The copy is ordered after the work already
+// submitted to `queue`, and the work submitted after it does not overwrite the image before it is
+// copied.
+//
+bool FrameWriter::write(VkQueue queue, VkImage image, const VkExtent2D& size, const std::string& filename)
+{
+  size_t index = acquireSlot();
+  Slot&  slot  = m_slots[index];  // Free: no worker is using it
+
+  // The buffers grow to the largest image. Cached memory, as the workers read all of it.
+  VkDeviceSize bytes = VkDeviceSize(size.width) * size.height * 4 * sizeof(float);
+  if(bytes > slot.capacity)
+  {
+    if(slot.buffer.buffer != VK_NULL_HANDLE)
+    {
+      m_alloc->unmap(slot.buffer);
+      m_alloc->destroy(slot.buffer);
+    }
+    slot.buffer   = m_alloc->createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                              | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    slot.pixels   = static_cast<const float*>(m_alloc->map(slot.buffer));
+    slot.capacity = bytes;
+  }
+  slot.size     = size;
+  slot.filename = filename;
+
+  vkResetCommandBuffer(slot.cmdBuf, 0);
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(slot.cmdBuf, &beginInfo);
+
+  // The image stays in the GENERAL layout, only the writes of the rendering must be visible to the copy
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(slot.cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent      = {size.width, size.height, 1};
+  vkCmdCopyImageToBuffer(slot.cmdBuf, image, VK_IMAGE_LAYOUT_GENERAL, slot.buffer.buffer, 1, &region);
+
+  // The copy is visible to the host, and is done reading before the next commands write the image
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(slot.cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  vkEndCommandBuffer(slot.cmdBuf);
+
+  vkResetFences(m_device, 1, &slot.fence);
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &slot.cmdBuf;
+  if(vkQueueSubmit(queue, 1, &submitInfo, slot.fence) != VK_SUCCESS)
+  {
+    LOGE("Could not submit the copy of %s\n", filename.c_str());
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  slot.state = SlotState::eCopying;
+  return true;
+}
+
+void FrameWriter::poll()
+{
+  bool added = false;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(size_t i = 0; i < m_slots.size(); i++)
+    {
+      Slot& slot = m_slots[i];
+      if(slot.state == SlotState::eCopying && vkGetFenceStatus(m_device, slot.fence) == VK_SUCCESS)
+      {
+        slot.state = SlotState::eEncoding;
+        m_jobs.push_back(i);
+        added = true;
+      }
+    }
+  }
+  if(added)
+    m_jobAdded.notify_all();
+}
+
+void FrameWriter::flush()
+{
+  std::vector<VkFence> fences;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(const auto& slot : m_slots)
+    {
+      if(slot.state == SlotState::eCopying)
+        fences.push_back(slot.fence);
+    }
+  }
+  if(!fences.empty())
+    vkWaitForFences(m_device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+  poll();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_slotFreed.wait(lock, [&] {
+    return std::all_of(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.state == SlotState::eFree; });
+  });
+}
+
+FrameWriter::Stats FrameWriter::getStats()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  Stats stats   = m_stats;
+  stats.pending = static_cast<uint32_t>(
+      std::count_if(m_slots.begin(), m_slots.end(), [](const Slot& slot) { return slot.state != SlotState::eFree; }));
+  return stats;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Index of a free slot. When all are busy, waits for a copy to finish, or for a worker to be done
+// with its slot when all of them are encoding.
+//
+size_t FrameWriter::acquireSlot()
+{
+  bool stalled = false;
+  while(true)
+  {
+    poll();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(size_t i = 0; i < m_slots.size(); i++)
+    {
+      if(m_slots[i].state == SlotState::eFree)
+      {
+        m_stats.stalls += stalled ? 1 : 0;
+        return i;
+      }
+    }
+    stalled = true;
+
+    auto copying = std::find_if(m_slots.begin(), m_slots.end(),
+                                [](const Slot& slot) { return slot.state == SlotState::eCopying; });
+    if(copying != m_slots.end())
+    {
+      VkFence fence = copying->fence;
+      lock.unlock();
+      vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+    else
+    {
+      m_slotFreed.wait(lock);
+    }
+  }
+}
+
+void FrameWriter::workerLoop()
+{
+  while(true)
+  {
+    size_t index;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_jobAdded.wait(lock, [&] { return m_stop || !m_jobs.empty(); });
+      if(m_jobs.empty())
+        return;  // Stopping, and nothing left to write
+      index = m_jobs.front();
+      m_jobs.pop_front();
+    }
+
+    // The render thread does not touch the slot until it is free again
+    const Slot& slot = m_slots[index];
+    bool        ok   = encode(slot.filename, slot.size.width, slot.size.height, slot.pixels);
+    if(!ok)
+      LOGE("Could not write %s\n", slot.filename.c_str());
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_slots[index].state = SlotState::eFree;
+      if(ok)
+        m_stats.written++;
+      else
+        m_stats.failed++;
+    }
+    m_slotFreed.notify_all();
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// `.exr` and `.hdr` keep the floating point values, PNG gets the gamma of the post-process
+//
+bool FrameWriter::encode(const std::string& filename, uint32_t width, uint32_t height, const float* pixels)
+{
+  if(hasExtension(filename, ".exr"))
+    return writeExr(filename, width, height, pixels);
+
+  const int w = static_cast<int>(width);
+  const int h = static_cast<int>(height);
+  if(hasExtension(filename, ".hdr"))
+    return stbi_write_hdr(filename.c_str(), w, h, 4, pixels) != 0;
+
+  std::vector<uint8_t> ldr(size_t(width) * height * 4);
+  for(size_t i = 0; i < ldr.size(); i++)
+  {
+    float value = (i % 4 == 3) ? 1.f : std::pow(std::clamp(pixels[i], 0.f, 1.f), 1.f / 2.2f);
+    ldr[i]      = static_cast<uint8_t>(value * 255.f + 0.5f);
+  }
+  return stbi_write_png(filename.c_str(), w, h, 4, ldr.data(), w * 4) != 0;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nvvk/resourceallocator_vk.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// Writes RGBA32F images to disk without stalling the renderer.
+//
+// Each call to write() copies the image into a free slot of a ring of host-visible buffers, with
+// vkCmdCopyImageToBuffer in a command buffer submitted after the work already on the queue. The
+// fences of the slots are polled without blocking, and the slots whose copy is done are encoded by
+// worker threads. The render loop only waits when all the slots are busy (counted in `stalls`).
+//
+// Files ending with `.exr` are written as uncompressed 32-bit float OpenEXR, `.hdr` as Radiance
+// HDR, and any other name as a PNG with a 2.2 gamma.
+//
+// Usage:
+//   writer.setup(device, &alloc, queueFamily, 4, 8);
+//   ...
+//   vkQueueSubmit(queue, ...);                       // Rendering of the image
+//   writer.write(queue, image, size, "frame_0001.exr");
+//   ...
+//   writer.destroy();                                // Waits until every file is written
+//
+class FrameWriter
+{
+public:
+  void setup(VkDevice device, nvvk::ResourceAllocator* allocator, uint32_t queueFamily, uint32_t slotCount, uint32_t threadCount);
+  void destroy();
+
+  // The image must be in the GENERAL layout. Returns false if the copy could not be submitted.
+  bool write(VkQueue queue, VkImage image, const VkExtent2D& size, const std::string& filename);
+
+  void poll();   // Hands the slots whose copy is done to the workers
+  void flush();  // Waits until all the images given to write() are on disk
+
+  // Encodes `pixels` (RGBA32F, rows from the top) in the format given by the extension of `filename`
+  static bool encode(const std::string& filename, uint32_t width, uint32_t height, const float* pixels);
+
+  // Header and scanline offset table of the `.exr` files written by encode(). The scanlines follow,
+  // each one being its y, its size in bytes, then the planes A, B, G and R of 32-bit floats.
+  static std::vector<uint8_t> exrHeader(uint32_t width, uint32_t height);
+
+  struct Stats
+  {
+    uint32_t written{0};  // Files written
+    uint32_t failed{0};   // Files which could not be written
+    uint32_t pending{0};  // Images being copied or encoded
+    uint32_t stalls{0};   // Calls to write() which waited for a free slot
+  };
+  Stats getStats();
+
+private:
+  enum class SlotState
+  {
+    eFree,
+    eCopying,   // Submitted, fence not signaled yet
+    eEncoding,  // Owned by a worker
+  };
+  struct Slot
+  {
+    nvvk::Buffer    buffer;
+    const float*    pixels{nullptr};  // Persistently mapped `buffer`
+    VkDeviceSize    capacity{0};
+    VkCommandBuffer cmdBuf{VK_NULL_HANDLE};
+    VkFence         fence{VK_NULL_HANDLE};
+    VkExtent2D      size{};
+    std::string     filename;
+    SlotState       state{SlotState::eFree};
+  };
+
+  void   workerLoop();
+  size_t acquireSlot();
+
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  nvvk::ResourceAllocator* m_alloc{nullptr};
+  VkCommandPool            m_cmdPool{VK_NULL_HANDLE};
+  std::vector<Slot>        m_slots;
+  std::vector<std::thread> m_workers;
+
+  std::mutex              m_mutex;  // Guards the states of the slots, the jobs and the statistics
+  std::condition_variable m_jobAdded;
+  std::condition_variable m_slotFreed;
+  std::deque<size_t>      m_jobs;  // Slots to encode
+  bool                    m_stop{false};
+  Stats                   m_stats;
+};
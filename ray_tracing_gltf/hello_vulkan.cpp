@@ -18,10 +18,14 @@
  */
 
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
 
 
+#include "checkpoint.h"
+#include "frame_writer.hpp"
 #include "hello_vulkan.h"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/fileoperations.hpp"
@@ -62,8 +66,9 @@ void HelloVulkan::setup(const VkInstance& instance, const VkDevice& device, cons
 //
 void HelloVulkan::updateUniformBuffer(const VkCommandBuffer& cmdBuf)
 {
-  // Prepare new UBO contents on host.
-  const float    aspectRatio = m_size.width / static_cast<float>(m_size.height);
+  // Prepare new UBO contents on host. When tiling, the camera covers the whole image.
+  const VkExtent2D renderSize  = getRenderSize();
+  const float      aspectRatio = renderSize.width / static_cast<float>(renderSize.height);
   GlobalUniforms hostUBO     = {};
   const auto&    view        = CameraManip.getMatrix();
   glm::mat4      proj        = glm::perspectiveRH_ZO(glm::radians(CameraManip.getFov()), aspectRatio, 0.1f, 1000.0f);
@@ -239,6 +244,11 @@ void HelloVulkan::loadScene(const std::string& filename)
   }
   m_primInfo = m_alloc.createBuffer(cmdBuf, primLookup, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
 
+  // Emissive triangles sampled by the path tracer
+  createEmissiveTriangles(cmdBuf);
+  // Tables of the low-discrepancy samplers
+  createSamplerTables(cmdBuf);
+
 
   SceneDesc sceneDesc;
   sceneDesc.vertexAddress   = nvvk::getBufferDeviceAddress(m_device, m_vertexBuffer.buffer);
@@ -247,6 +257,7 @@ void HelloVulkan::loadScene(const std::string& filename)
   sceneDesc.uvAddress       = nvvk::getBufferDeviceAddress(m_device, m_uvBuffer.buffer);
   sceneDesc.materialAddress = nvvk::getBufferDeviceAddress(m_device, m_materialBuffer.buffer);
   sceneDesc.primInfoAddress = nvvk::getBufferDeviceAddress(m_device, m_primInfo.buffer);
+  sceneDesc.emissiveAddress = nvvk::getBufferDeviceAddress(m_device, m_emissiveBuffer.buffer);
   m_sceneDesc               = m_alloc.createBuffer(cmdBuf, sizeof(SceneDesc), &sceneDesc,
                                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
 
@@ -263,6 +274,104 @@ void HelloVulkan::loadScene(const std::string& filename)
   NAME_VK(m_materialBuffer.buffer);
   NAME_VK(m_primInfo.buffer);
   NAME_VK(m_sceneDesc.buffer);
+  NAME_VK(m_emissiveBuffer.buffer);
+  NAME_VK(m_samplerTablesBuffer.buffer);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Collecting all triangles with an emissive material, in world space, and building the alias table
+// used to pick them proportionally to their power (luminance * area) in constant time.
+// See Vose, "A Linear Algorithm For Generating Random Numbers With a Given Distribution"
+//
+void HelloVulkan::createEmissiveTriangles(const VkCommandBuffer& cmdBuf)
+{
+  auto luminance = [](const glm::vec3& c) { return glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f)); };
+
+  std::vector<EmissiveTriangle> triangles;
+  std::vector<float>            power;
+  for(auto& node : m_gltfScene.m_nodes)
+  {
+    auto& primMesh = m_gltfScene.m_primMeshes[node.primMesh];
+    if(primMesh.materialIndex < 0)
+      continue;
+    const glm::vec3& emission = m_gltfScene.m_materials[primMesh.materialIndex].emissiveFactor;
+    if(luminance(emission) <= 0.f)
+      continue;
+
+    for(uint32_t i = 0; i < primMesh.indexCount; i += 3)
+    {
+      EmissiveTriangle tri{};
+      glm::vec3*       v[3] = {&tri.v0, &tri.v1, &tri.v2};
+      for(uint32_t k = 0; k < 3; k++)
+      {
+        uint32_t vertexIndex = m_gltfScene.m_indices[primMesh.firstIndex + i + k] + primMesh.vertexOffset;
+        *v[k] = glm::vec3(node.worldMatrix * glm::vec4(m_gltfScene.m_positions[vertexIndex], 1.f));
+      }
+      tri.emission = emission;
+
+      float area = 0.5f * glm::length(glm::cross(tri.v1 - tri.v0, tri.v2 - tri.v0));
+      if(area <= 0.f)
+        continue;
+      triangles.push_back(tri);
+      power.push_back(luminance(emission) * area);
+    }
+  }
+
+  m_emissiveCount = static_cast<uint32_t>(triangles.size());
+  m_emissivePower = 0.f;
+  for(float p : power)
+    m_emissivePower += p;
+
+  // Alias table: each entry keeps its triangle with probability `prob`, and uses `alias` otherwise
+  std::vector<float>    scaled(power.size());
+  std::vector<uint32_t> small, large;
+  for(uint32_t i = 0; i < m_emissiveCount; i++)
+  {
+    scaled[i] = power[i] * static_cast<float>(m_emissiveCount) / m_emissivePower;
+    (scaled[i] < 1.f ? small : large).push_back(i);
+  }
+  while(!small.empty() && !large.empty())
+  {
+    uint32_t s = small.back();
+    uint32_t l = large.back();
+    small.pop_back();
+    large.pop_back();
+
+    triangles[s].prob  = scaled[s];
+    triangles[s].alias = l;
+    scaled[l]          = (scaled[l] + scaled[s]) - 1.f;
+    (scaled[l] < 1.f ? small : large).push_back(l);
+  }
+  // Remaining entries are (up to rounding) exactly at their average
+  for(auto list : {&small, &large})
+  {
+    for(uint32_t i : *list)
+    {
+      triangles[i].prob  = 1.f;
+      triangles[i].alias = i;
+    }
+  }
+
+  LOGI("Emissive triangles: %u, total power %f", m_emissiveCount, m_emissivePower);
+
+  // The buffer cannot be empty, a scene without emissive triangles just never samples it
+  if(triangles.empty())
+    triangles.push_back(EmissiveTriangle{});
+  m_emissiveBuffer = m_alloc.createBuffer(cmdBuf, triangles,
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Generating the Sobol direction numbers and the blue-noise tile, and uploading them. The path
+// tracer finds them through the address in the push constant.
+//
+void HelloVulkan::createSamplerTables(const VkCommandBuffer& cmdBuf)
+{
+  m_samplerTables.generate();
+  m_samplerTablesBuffer = m_alloc.createBuffer(cmdBuf, m_samplerTables.pack(),
+                                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  m_pcRay.samplerTables = nvvk::getBufferDeviceAddress(m_device, m_samplerTablesBuffer.buffer);
 }
 
 
@@ -350,6 +459,8 @@ void HelloVulkan::destroyResources()
   m_alloc.destroy(m_materialBuffer);
   m_alloc.destroy(m_primInfo);
   m_alloc.destroy(m_sceneDesc);
+  m_alloc.destroy(m_emissiveBuffer);
+  m_alloc.destroy(m_samplerTablesBuffer);
 
   for(auto& t : m_textures)
   {
@@ -359,6 +470,8 @@ void HelloVulkan::destroyResources()
   //#Post
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_offscreenDepth);
+  m_alloc.destroy(m_varianceImage);
+  m_alloc.destroy(m_activeTiles);
   vkDestroyPipeline(m_device, m_postPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_postPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_postDescPool, nullptr);
@@ -373,6 +486,10 @@ void HelloVulkan::destroyResources()
   vkDestroyPipelineLayout(m_device, m_rtPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_rtDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_rtDescSetLayout, nullptr);
+  m_alloc.destroy(m_pathStats);
+  m_rayBudget.deinit();
+  vkDestroyPipeline(m_device, m_adaptivePipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_adaptivePipelineLayout, nullptr);
 
 
   m_alloc.deinit();
@@ -425,6 +542,7 @@ void HelloVulkan::onResize(int /*w*/, int /*h*/)
   updatePostDescriptorSet();
   updateRtDescriptorSet();
   resetFrame();
+  m_rayBudget.reset();  // The cost of a sample depends on the resolution
 }
 
 
@@ -440,12 +558,14 @@ void HelloVulkan::createOffscreenRender()
 {
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_offscreenDepth);
+  m_alloc.destroy(m_varianceImage);
+  m_alloc.destroy(m_activeTiles);
 
   // Creating the color image
   {
     auto colorCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenColorFormat,
                                                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
-                                                           | VK_IMAGE_USAGE_STORAGE_BIT);
+                                                           | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 
 
     nvvk::Image           image  = m_alloc.createImage(colorCreateInfo);
@@ -455,6 +575,30 @@ void HelloVulkan::createOffscreenRender()
     m_offscreenColor.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
   }
 
+  // #Adaptive - Per-pixel statistics (rgba32f): sample count, luminance mean, M2
+  {
+    auto varianceCreateInfo = nvvk::makeImage2DCreateInfo(m_size, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT);
+
+    nvvk::Image           image            = m_alloc.createImage(varianceCreateInfo);
+    VkImageViewCreateInfo ivInfo           = nvvk::makeImageViewCreateInfo(image.image, varianceCreateInfo);
+    VkSamplerCreateInfo   sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    m_varianceImage                        = m_alloc.createTexture(image, ivInfo, sampler);
+    m_varianceImage.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    m_debug.setObjectName(m_varianceImage.image, "Variance");
+  }
+
+  // #Adaptive - Indirect trace command followed by the list of tiles, at most one entry per tile
+  {
+    uint32_t     nbTiles = ((m_size.width + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE)
+                       * ((m_size.height + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE);
+    VkDeviceSize size    = sizeof(AdaptiveDispatch) + nbTiles * sizeof(uint32_t);
+    m_activeTiles        = m_alloc.createBuffer(size,
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                                                    | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_debug.setObjectName(m_activeTiles.buffer, "ActiveTiles");
+  }
+
   // Creating the depth buffer
   auto depthCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
   {
@@ -475,6 +619,7 @@ void HelloVulkan::createOffscreenRender()
     nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
     auto              cmdBuf = genCmdBuf.createCommandBuffer();
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_varianceImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenDepth.image, VK_IMAGE_LAYOUT_UNDEFINED,
                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
 
@@ -679,6 +824,12 @@ void HelloVulkan::createRtDescriptorSet()
                                    VK_SHADER_STAGE_RAYGEN_BIT_KHR);  // Output image
   m_rtDescSetLayoutBind.addBinding(RtxBindings::ePrimLookup, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
                                    VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR);  // Primitive info
+  m_rtDescSetLayoutBind.addBinding(RtxBindings::ePathStats, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                   VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);  // Path statistics
+  m_rtDescSetLayoutBind.addBinding(RtxBindings::eVariance, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                                   VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);  // Pixel statistics
+  m_rtDescSetLayoutBind.addBinding(RtxBindings::eActiveTiles, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                   VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);  // Adaptive tiles
 
   m_rtDescPool      = m_rtDescSetLayoutBind.createPool(m_device);
   m_rtDescSetLayout = m_rtDescSetLayoutBind.createLayout(m_device);
@@ -697,11 +848,34 @@ void HelloVulkan::createRtDescriptorSet()
   VkDescriptorImageInfo  imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
   VkDescriptorBufferInfo primitiveInfoDesc{m_primInfo.buffer, 0, VK_WHOLE_SIZE};
 
+  // Path statistics are read back by the host, each frame in flight writes its own entry
+  std::vector<PathStats> pathStats(getFrameCount(), PathStats{0, 0, 0, 0});
+  m_statsSlots.resize(pathStats.size());
+  m_pathStats = m_alloc.createBuffer(sizeof(PathStats) * pathStats.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  void* mapped = m_alloc.map(m_pathStats);
+  memcpy(mapped, pathStats.data(), sizeof(PathStats) * pathStats.size());
+  m_alloc.unmap(m_pathStats);
+  m_debug.setObjectName(m_pathStats.buffer, "PathStats");
+  VkDescriptorBufferInfo pathStatsDesc{m_pathStats.buffer, 0, VK_WHOLE_SIZE};
+
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eTlas, &descASInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::ePrimLookup, &primitiveInfoDesc));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::ePathStats, &pathStatsDesc));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+  // Images and buffers depending on the size
+  updateRtDescriptorSet();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Timestamps of the ray budget, one pair per frame in flight
+//
+void HelloVulkan::createRayBudget()
+{
+  m_rayBudget.init(m_device, m_physicalDevice, m_graphicsQueueIndex, getFrameCount());
 }
 
 
@@ -713,8 +887,15 @@ void HelloVulkan::updateRtDescriptorSet()
 {
   // (1) Output buffer
   VkDescriptorImageInfo imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
-  VkWriteDescriptorSet  wds = m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo);
-  vkUpdateDescriptorSets(m_device, 1, &wds, 0, nullptr);
+  // (2) Adaptive sampling
+  VkDescriptorImageInfo  varianceInfo{{}, m_varianceImage.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
+  VkDescriptorBufferInfo activeTilesInfo{m_activeTiles.buffer, 0, VK_WHOLE_SIZE};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eVariance, &varianceInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eActiveTiles, &activeTilesInfo));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 
@@ -836,13 +1017,39 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
 {
   updateFrame();
 
-  m_debug.beginLabel(cmdBuf, "Ray trace");
   // Initializing push constant values
   m_pcRay.clearColor     = clearColor;
   m_pcRay.lightPosition  = m_pcRaster.lightPosition;
   m_pcRay.lightIntensity = m_pcRaster.lightIntensity;
   m_pcRay.lightType      = m_pcRaster.lightType;
+  m_pcRay.emissiveCount  = m_useNee ? static_cast<int>(m_emissiveCount) : 0;
+  m_pcRay.emissivePower  = m_emissivePower;
+
+  m_pcRay.adaptiveThreshold = m_useAdaptive ? m_adaptiveThreshold : 0.f;
+
+  // #Tiles - The launch covers the offscreen image, at its place in the rendered image
+  const VkExtent2D renderSize = getRenderSize();
+  m_pcRay.tileOffset          = {m_tileOffset.x, m_tileOffset.y};
+  m_pcRay.renderSize          = {static_cast<int>(renderSize.width), static_cast<int>(renderSize.height)};
+
+  // Deterministic seed: replaying the same frames gives the same image
+  m_pcRay.seed = m_seed * 0x9e3779b9u + static_cast<uint32_t>(m_pcRay.frame);
+
+  updatePathStats();
+
+  // Ray budget: timing of the last frame which used this slot, then the samples per pixel of this frame
+  m_rayBudget.update(getFrameIndex());
+  if(m_rayBudget.enabled)
+    m_pcRay.samplesPerFrame = m_rayBudget.samples;
+  else
+    m_rayBudget.samples = m_pcRay.samplesPerFrame;
+  m_rayBudget.begin(cmdBuf, getFrameIndex());
+
+  // #Adaptive - Building the list of tiles to trace, before the trace reads it
+  if(m_useAdaptive)
+    computeActiveTiles(cmdBuf);
 
+  m_debug.beginLabel(cmdBuf, "Ray trace");
 
   std::vector<VkDescriptorSet> descSets{m_rtDescSet, m_descSet};
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
@@ -854,10 +1061,20 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
 
 
   auto& regions = m_sbtWrapper.getRegions();
-  vkCmdTraceRaysKHR(cmdBuf, &regions[0], &regions[1], &regions[2], &regions[3], m_size.width, m_size.height, 1);
+  if(m_useAdaptive)
+  {
+    // Launch size (tile pixels, active tiles, 1) was written by computeActiveTiles()
+    VkDeviceAddress indirectAddress = nvvk::getBufferDeviceAddress(m_device, m_activeTiles.buffer);
+    vkCmdTraceRaysIndirectKHR(cmdBuf, &regions[0], &regions[1], &regions[2], &regions[3], indirectAddress);
+  }
+  else
+  {
+    vkCmdTraceRaysKHR(cmdBuf, &regions[0], &regions[1], &regions[2], &regions[3], m_size.width, m_size.height, 1);
+  }
 
 
   m_debug.endLabel(cmdBuf);
+  m_rayBudget.end(cmdBuf, getFrameIndex());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -884,4 +1101,263 @@ void HelloVulkan::updateFrame()
 void HelloVulkan::resetFrame()
 {
   m_pcRay.frame = -1;
+  m_resetCount++;
+  m_resetTime         = std::chrono::steady_clock::now();
+  m_timeToThreshold   = -1.f;
+  m_framesToThreshold = -1;
+  m_activeHistory.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reading the statistics of the last frame which used the current slot and resetting them.
+// The fence of the current frame was waited on in prepareFrame(), or the previous submission was
+// waited on in headless mode, so these values are complete.
+// They are a few frames late, which also delays the measured time-to-threshold by as much.
+//
+void HelloVulkan::updatePathStats()
+{
+  m_pcRay.statsSlot = getFrameIndex();
+  auto* pathStats   = static_cast<PathStats*>(m_alloc.map(m_pathStats));
+  auto& slotStats   = pathStats[m_pcRay.statsSlot];
+  auto& slotInfo    = m_statsSlots[m_pcRay.statsSlot];
+
+  if(slotStats.pathCount > 0)
+    m_avgPathLength = static_cast<float>(slotStats.rayCount) / static_cast<float>(slotStats.pathCount);
+
+  if(slotInfo.adaptive && slotInfo.resetCount == m_resetCount)
+  {
+    float activeFraction = static_cast<float>(slotStats.activePixels) / static_cast<float>(m_size.width * m_size.height);
+    m_activeHistory.push_back(activeFraction);
+    if(m_activeHistory.size() > 256)
+      m_activeHistory.erase(m_activeHistory.begin());
+
+    if(slotStats.activePixels == 0 && m_timeToThreshold < 0.f)
+    {
+      auto elapsed        = std::chrono::steady_clock::now() - m_resetTime;
+      m_timeToThreshold   = std::chrono::duration<float, std::milli>(elapsed).count();
+      m_framesToThreshold = slotInfo.frame;
+      LOGI("All pixels converged after %d frames, %.1f ms", m_framesToThreshold, m_timeToThreshold);
+    }
+  }
+
+  slotStats = {0, 0, 0, 0};
+  slotInfo  = {m_resetCount, m_pcRay.frame, m_useAdaptive};
+  m_alloc.unmap(m_pathStats);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// #Adaptive - Adaptive sampling
+//////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------------------------------
+// The compute shader finding the active tiles uses the ray tracing descriptor set, and the same
+// push constant as the ray tracer for the threshold and frame number.
+//
+void HelloVulkan::createAdaptivePipeline()
+{
+  VkPushConstantRange        pushConstant{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantRay)};
+  VkPipelineLayoutCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  createInfo.setLayoutCount         = 1;
+  createInfo.pSetLayouts            = &m_rtDescSetLayout;
+  createInfo.pushConstantRangeCount = 1;
+  createInfo.pPushConstantRanges    = &pushConstant;
+  vkCreatePipelineLayout(m_device, &createInfo, nullptr, &m_adaptivePipelineLayout);
+
+  VkComputePipelineCreateInfo cpCreateInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  cpCreateInfo.layout       = m_adaptivePipelineLayout;
+  cpCreateInfo.stage        = nvvk::createShaderStageInfo(m_device, nvh::loadFile("spv/adaptive.comp.spv", true, defaultSearchPaths, true),
+                                                          VK_SHADER_STAGE_COMPUTE_BIT);
+  vkCreateComputePipelines(m_device, {}, 1, &cpCreateInfo, nullptr, &m_adaptivePipeline);
+  vkDestroyShaderModule(m_device, cpCreateInfo.stage.module, nullptr);
+  m_debug.setObjectName(m_adaptivePipeline, "Adaptive");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Resetting the indirect command, then appending all tiles with pixels above the error threshold
+//
+void HelloVulkan::computeActiveTiles(const VkCommandBuffer& cmdBuf)
+{
+  m_debug.beginLabel(cmdBuf, "Adaptive tiles");
+
+  // The previous trace must be done reading the command and the tile list before they are rewritten
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  AdaptiveDispatch header{ADAPTIVE_TILE_SIZE * ADAPTIVE_TILE_SIZE, 0, 1, 0};
+  vkCmdUpdateBuffer(cmdBuf, m_activeTiles.buffer, 0, sizeof(AdaptiveDispatch), &header);
+
+  // The reset header and the pixel statistics written by the previous trace are read by the compute shader
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_adaptivePipeline);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_adaptivePipelineLayout, 0, 1, &m_rtDescSet, 0, nullptr);
+  vkCmdPushConstants(cmdBuf, m_adaptivePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantRay), &m_pcRay);
+  vkCmdDispatch(cmdBuf, (m_size.width + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE,
+                (m_size.height + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE, 1);
+
+  // The indirect command and the tile list are consumed by the trace
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
+
+  m_debug.endLabel(cmdBuf);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// #Headless - Rendering without window, surface nor swapchain
+//////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------------------------------
+// Replaces createSwapchain(): only the size is needed by the offscreen rendering. Frames are
+// submitted and waited on one at a time, so there is a single frame in flight.
+//
+void HelloVulkan::setupHeadless(const VkExtent2D& size)
+{
+  m_headless = true;
+  m_size     = size;
+}
+
+//--------------------------------------------------------------------------------------------------
+// onResize() without the post-process, which is not created in headless mode. Nothing is in
+// flight: the frames are waited on.
+//
+void HelloVulkan::resizeHeadless(const VkExtent2D& size)
+{
+  m_size = size;
+  createOffscreenRender();
+  updateRtDescriptorSet();
+  resetFrame();
+  m_rayBudget.reset();
+}
+
+uint32_t HelloVulkan::getFrameCount()
+{
+  return m_headless ? 1 : m_swapChain.getImageCount();
+}
+
+uint32_t HelloVulkan::getFrameIndex()
+{
+  return m_headless ? 0 : getCurFrame();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Copying the offscreen color image to a host visible buffer and writing it to disk, waiting for
+// both. The format is given by the extension, see FrameWriter::encode().
+//
+bool HelloVulkan::saveImage(const std::string& filename)
+{
+  const VkDeviceSize size     = VkDeviceSize(m_size.width) * m_size.height * 4 * sizeof(float);
+  nvvk::Buffer       readback = m_alloc.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  {
+    nvvk::CommandPool cmdPool(m_device, m_graphicsQueueIndex);
+    VkCommandBuffer   cmdBuf = cmdPool.createCommandBuffer();
+    copyOffscreenColor(cmdBuf, readback.buffer);
+    cmdPool.submitAndWait(cmdBuf);
+  }
+
+  const float* pixels = static_cast<const float*>(m_alloc.map(readback));
+  bool         result = FrameWriter::encode(filename, m_size.width, m_size.height, pixels);
+  m_alloc.unmap(readback);
+  m_alloc.destroy(readback);
+
+  if(!result)
+    LOGE("Could not write %s\n", filename.c_str());
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Recording the copy of the offscreen color image, RGBA32F rows from the top, to a host visible
+// buffer of at least m_size pixels. The copy is visible to the host once the commands completed.
+//
+void HelloVulkan::copyOffscreenColor(const VkCommandBuffer& cmdBuf, VkBuffer buffer)
+{
+  // The image stays in the GENERAL layout, only the writes of the trace must be visible to the copy
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0,
+                       nullptr, 0, nullptr);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent      = {m_size.width, m_size.height, 1};
+  vkCmdCopyImageToBuffer(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_GENERAL, buffer, 1, &region);
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// #Tiles - Rendering an image larger than the offscreen image
+//////////////////////////////////////////////////////////////////////////
+
+VkExtent2D HelloVulkan::getRenderSize() const
+{
+  return m_renderSize.width > 0 ? m_renderSize : m_size;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// #Checkpoint - Resuming the accumulation in another process
+//////////////////////////////////////////////////////////////////////////
+
+//--------------------------------------------------------------------------------------------------
+// Everything which changes the pixels of a frame: the geometry and the materials (not the content
+// of the textures), the camera, the size, and the settings of the path tracer. The seed is not
+// part of it, it is restored with the frame number.
+//
+uint64_t HelloVulkan::getAccumulationHash()
+{
+  uint64_t hash = Checkpoint::hashBytes(m_gltfScene.m_positions.data(), m_gltfScene.m_positions.size() * sizeof(glm::vec3));
+  hash = Checkpoint::hashBytes(m_gltfScene.m_indices.data(), m_gltfScene.m_indices.size() * sizeof(uint32_t), hash);
+  hash = Checkpoint::hashBytes(m_gltfScene.m_normals.data(), m_gltfScene.m_normals.size() * sizeof(glm::vec3), hash);
+  hash = Checkpoint::hashBytes(m_gltfScene.m_texcoords0.data(), m_gltfScene.m_texcoords0.size() * sizeof(glm::vec2), hash);
+  for(const auto& m : m_gltfScene.m_materials)
+  {
+    hash = Checkpoint::hashValue(m.baseColorFactor, hash);
+    hash = Checkpoint::hashValue(m.emissiveFactor, hash);
+    hash = Checkpoint::hashValue(m.baseColorTexture, hash);
+  }
+
+  hash = Checkpoint::hashValue(CameraManip.getMatrix(), hash);
+  hash = Checkpoint::hashValue(CameraManip.getFov(), hash);
+  hash = Checkpoint::hashValue(getRenderSize().width, hash);
+  hash = Checkpoint::hashValue(getRenderSize().height, hash);
+
+  hash = Checkpoint::hashValue(m_pcRaster.lightPosition, hash);
+  hash = Checkpoint::hashValue(m_pcRaster.lightIntensity, hash);
+  hash = Checkpoint::hashValue(m_pcRaster.lightType, hash);
+  hash = Checkpoint::hashValue(m_pcRay.maxDepth, hash);
+  hash = Checkpoint::hashValue(m_pcRay.rrMinDepth, hash);
+  hash = Checkpoint::hashValue(m_pcRay.rrMaxSurvival, hash);
+  hash = Checkpoint::hashValue(m_pcRay.adaptiveMinSamples, hash);
+  hash = Checkpoint::hashValue(m_pcRay.samplerType, hash);
+  hash = Checkpoint::hashValue(m_pcRay.samplesPerFrame, hash);
+  hash = Checkpoint::hashValue(m_useNee, hash);
+  hash = Checkpoint::hashValue(m_useAdaptive, hash);
+  hash = Checkpoint::hashValue(m_adaptiveThreshold, hash);
+  return hash;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The camera becomes the reference of updateFrame(), so the next frame continues the restored
+// accumulation instead of resetting it
+//
+void HelloVulkan::resumeFrame(int32_t frame)
+{
+  updateFrame();
+  m_pcRay.frame = frame;
 }
@@ -19,7 +19,11 @@
 
 #pragma once
 
+#include <chrono>
+
 #include "shaders/host_device.h"
+#include "ray_budget.h"
+#include "sampler.h"
 
 #include "nvvkhl/appbase_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
@@ -49,6 +53,8 @@ public:
   void updateDescriptorSet();
   void createUniformBuffer();
   void createTextureImages(const VkCommandBuffer& cmdBuf, tinygltf::Model& gltfModel);
+  void createEmissiveTriangles(const VkCommandBuffer& cmdBuf);
+  void createSamplerTables(const VkCommandBuffer& cmdBuf);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
   void destroyResources();
@@ -63,6 +69,15 @@ public:
   nvvk::Buffer   m_materialBuffer;
   nvvk::Buffer   m_primInfo;
   nvvk::Buffer   m_sceneDesc;
+  nvvk::Buffer   m_emissiveBuffer;  // EmissiveTriangle with their alias table, for next-event estimation
+
+  uint32_t m_emissiveCount{0};    // Number of emissive triangles in the scene
+  float    m_emissivePower{0.f};  // Sum of luminance * area of all emissive triangles
+  bool     m_useNee{true};        // Sample emissive triangles explicitly in the path tracer
+
+  SamplerTables      m_samplerTables;        // Sobol directions and blue-noise tile, also used by the CPU benchmark
+  nvvk::Buffer       m_samplerTablesBuffer;  // Same tables on the device, see common/shaders/sampler.glsl
+  SamplerConvergence m_samplerConvergence;   // Result of the last convergence benchmark
 
   // Information pushed at each draw call
   PushConstantRaster m_pcRaster{
@@ -106,6 +121,8 @@ public:
   VkFramebuffer               m_offscreenFramebuffer{VK_NULL_HANDLE};
   nvvk::Texture               m_offscreenColor;
   nvvk::Texture               m_offscreenDepth;
+  nvvk::Texture               m_varianceImage;  // Per-pixel sample count, luminance mean and M2
+  nvvk::Buffer                m_activeTiles;    // AdaptiveDispatch followed by the list of active tiles
   VkFormat                    m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
   VkFormat                    m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};
 
@@ -120,6 +137,7 @@ public:
   void raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clearColor);
   void updateFrame();
   void resetFrame();
+  void updatePathStats();
 
   VkPhysicalDeviceRayTracingPipelinePropertiesKHR m_rtProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR};
   nvvk::RaytracingBuilderKHR                        m_rtBuilder;
@@ -132,5 +150,80 @@ public:
   VkPipeline                                        m_rtPipeline;
   nvvk::SBTWrapper                                  m_sbtWrapper;
 
-  PushConstantRay m_pcRay{};
+  PushConstantRay m_pcRay{
+      {},     // clear color
+      {},     // light position
+      0.f,    // light intensity
+      0,      // light type
+      0,      // frame
+      10,     // max depth
+      3,      // Russian roulette starting depth
+      0.95f,  // Russian roulette max survival probability
+      0,      // stats slot
+      0,      // emissive triangle count
+      0.f,    // emissive power
+      0.f,    // adaptive threshold
+      16,     // adaptive min samples
+      0,      // sampler type
+      0,      // sampler tables
+      1,      // samples per frame
+      0       // seed
+  };
+
+  nvvk::Buffer m_pathStats;           // Host visible PathStats, one entry per frame in flight
+  float        m_avgPathLength{0.f};  // Average number of rays per path of the last completed frame
+
+  // Host side information on the frame each PathStats entry was recorded for
+  struct StatsSlot
+  {
+    uint32_t resetCount{~0u};  // Accumulation the frame belongs to
+    int      frame{0};         // Frame number in this accumulation
+    bool     adaptive{false};  // Adaptive sampling was used
+  };
+  std::vector<StatsSlot> m_statsSlots;
+  uint32_t               m_resetCount{0};
+  uint32_t               m_seed{0};  // Base of the seeds of the frames, the same seed gives the same image
+
+  void      createRayBudget();
+  RayBudget m_rayBudget;  // Samples per frame chosen from the GPU time of the trace
+
+  // #Adaptive - Only tracing tiles which still have pixels above the error threshold
+  void createAdaptivePipeline();
+  void computeActiveTiles(const VkCommandBuffer& cmdBuf);
+
+  VkPipelineLayout m_adaptivePipelineLayout{VK_NULL_HANDLE};
+  VkPipeline       m_adaptivePipeline{VK_NULL_HANDLE};
+  bool             m_useAdaptive{false};
+  float            m_adaptiveThreshold{0.02f};  // Relative standard error of the mean
+
+  std::chrono::steady_clock::time_point m_resetTime;              // Start of the current accumulation
+  std::vector<float>                    m_activeHistory;          // Fraction of active pixels of the last frames
+  float                                 m_timeToThreshold{-1.f};  // Milliseconds until all pixels converged
+  int                                   m_framesToThreshold{-1};  // Frames until all pixels converged
+
+  // #Headless - Rendering without window, surface nor swapchain, for batch jobs
+  void     setupHeadless(const VkExtent2D& size);
+  void     resizeHeadless(const VkExtent2D& size);  // New offscreen images, for the next job of the server
+  uint32_t getFrameCount();  // Frames in flight: images of the swapchain, or 1 in headless mode
+  uint32_t getFrameIndex();  // Frame in flight being recorded
+  bool     saveImage(const std::string& filename);
+  void     copyOffscreenColor(const VkCommandBuffer& cmdBuf, VkBuffer buffer);
+
+  bool m_headless{false};
+
+  // #Tiles - Rendering an image larger than the offscreen image, which is one tile of it
+  VkExtent2D getRenderSize() const;  // Size of the rendered image: m_renderSize, or m_size when not tiling
+
+  VkExtent2D m_renderSize{0, 0};  // Size of the tiled image, 0 when not tiling
+  VkOffset2D m_tileOffset{0, 0};  // Position of the offscreen image in the rendered image
+
+  // #Checkpoint - Saving the accumulation (m_offscreenColor and m_varianceImage) to resume it in another
+  // process, see common/checkpoint.h
+  struct AccumulationState
+  {
+    int32_t  frame;  // Last frame of the accumulation, m_pcRay.frame
+    uint32_t seed;   // Base of the random seeds, m_seed
+  };
+  uint64_t getAccumulationHash();      // Scene, camera and settings the accumulation depends on
+  void     resumeFrame(int32_t frame);  // Continuing an accumulation restored up to `frame`
 };
@@ -0,0 +1,619 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "job_server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "nvh/nvprint.hpp"
+
+// A job is rendered before the next one is read: the frames are capped so one job cannot hold the server
+static const int MAX_JOB_FRAMES = 65536;
+
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0  // A client which disconnected raises SIGPIPE instead of an error
+#endif
+
+// Source of jobs and destination of their replies: stdin and stdout, or one connection to the socket
+struct JobConnection
+{
+  int        fd{-1};  // -1: stdin and stdout
+  std::mutex mutex;   // The reader (errors) and the render loop (results) both reply
+
+  ~JobConnection()
+  {
+#ifndef _WIN32
+    if(fd >= 0)
+      close(fd);
+#endif
+  }
+};
+
+namespace {
+
+// The jobs are flat objects: strings, numbers, booleans and arrays of numbers
+class JsonReader
+{
+public:
+  explicit JsonReader(const std::string& text)
+      : m_text(text)
+  {
+  }
+
+  bool readObject(std::map<std::string, JsonValue>& members, std::string& error)
+  {
+    if(!expect('{'))
+      return fail("expected an object", error);
+    if(peek() == '}')
+      return expect('}') && end(error);
+    do
+    {
+      std::string key;
+      JsonValue   value;
+      if(!readString(key))
+        return fail("expected a member name", error);
+      if(!expect(':'))
+        return fail("expected ':' after \"" + key + "\"", error);
+      if(!readValue(value))
+        return fail("invalid value of \"" + key + "\"", error);
+      members[key] = std::move(value);
+    } while(expect(','));
+    if(!expect('}'))
+      return fail("expected ',' or '}'", error);
+    return end(error);
+  }
+
+private:
+  char peek()
+  {
+    while(m_pos < m_text.size() && isspace(static_cast<unsigned char>(m_text[m_pos])))
+      m_pos++;
+    return m_pos < m_text.size() ? m_text[m_pos] : '\0';
+  }
+
+  bool expect(char c)
+  {
+    if(peek() != c)
+      return false;
+    m_pos++;
+    return true;
+  }
+
+  bool end(std::string& error) { return peek() == '\0' || fail("unexpected characters after the object", error); }
+
+  bool fail(const std::string& message, std::string& error)
+  {
+    error = message + " at character " + std::to_string(m_pos);
+    return false;
+  }
+
+  bool readNumber(double& number)
+  {
+    peek();
+    const char* begin = m_text.c_str() + m_pos;
+    char*       end   = nullptr;
+    number            = strtod(begin, &end);
+    if(end == begin || !std::isfinite(number))
+      return false;
+    m_pos += end - begin;
+    return true;
+  }
+
+  bool readString(std::string& text)
+  {
+    if(!expect('"'))
+      return false;
+    while(m_pos < m_text.size())
+    {
+      char c = m_text[m_pos++];
+      if(c == '"')
+        return true;
+      if(c != '\\')
+      {
+        text += c;
+        continue;
+      }
+      if(m_pos >= m_text.size())
+        return false;
+      switch(c = m_text[m_pos++])
+      {
+        case 'n':
+          text += '\n';
+          break;
+        case 't':
+          text += '\t';
+          break;
+        case 'r':
+          text += '\r';
+          break;
+        case 'b':
+          text += '\b';
+          break;
+        case 'f':
+          text += '\f';
+          break;
+        case 'u': {
+          // Code points of the basic multilingual plane, as UTF-8
+          if(m_pos + 4 > m_text.size())
+            return false;
+          char*         end  = nullptr;
+          std::string   hex  = m_text.substr(m_pos, 4);
+          unsigned long code = strtoul(hex.c_str(), &end, 16);
+          if(end != hex.c_str() + 4)
+            return false;
+          m_pos += 4;
+          if(code < 0x80)
+            text += static_cast<char>(code);
+          else if(code < 0x800)
+          {
+            text += static_cast<char>(0xC0 | (code >> 6));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+          }
+          else
+          {
+            text += static_cast<char>(0xE0 | (code >> 12));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+          }
+          break;
+        }
+        default:  // '"', '\\', '/'
+          text += c;
+      }
+    }
+    return false;
+  }
+
+  bool readWord(const char* word)
+  {
+    peek();
+    size_t length = strlen(word);
+    if(m_text.compare(m_pos, length, word) != 0)
+      return false;
+    m_pos += length;
+    return true;
+  }
+
+  bool readValue(JsonValue& value)
+  {
+    char c = peek();
+    if(c == '"')
+    {
+      value.type = JsonValue::Type::eString;
+      return readString(value.text);
+    }
+    if(c == '[')
+    {
+      value.type = JsonValue::Type::eArray;
+      expect('[');
+      if(expect(']'))
+        return true;
+      do
+      {
+        double number;
+        if(!readNumber(number))
+          return false;
+        value.numbers.push_back(number);
+      } while(expect(','));
+      return expect(']');
+    }
+    if(readWord("true") || readWord("false"))
+    {
+      value.type    = JsonValue::Type::eBool;
+      value.boolean = c == 't';
+      return true;
+    }
+    if(readWord("null"))
+      return true;
+    value.type = JsonValue::Type::eNumber;
+    return readNumber(value.number);
+  }
+
+  const std::string& m_text;
+  size_t             m_pos{0};
+};
+
+bool sendLine(JobConnection& connection, const std::string& line)
+{
+  std::lock_guard<std::mutex> lock(connection.mutex);
+  if(connection.fd < 0)
+  {
+    bool ok = fwrite(line.data(), line.size(), 1, stdout) == 1 && fputc('\n', stdout) != EOF;
+    fflush(stdout);
+    return ok;
+  }
+#ifndef _WIN32
+  std::string data = line + "\n";
+  for(size_t sent = 0; sent < data.size();)
+  {
+    ssize_t result = send(connection.fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if(result <= 0)
+      return false;
+    sent += static_cast<size_t>(result);
+  }
+#endif
+  return true;
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// With an empty path, a single reader takes the lines of stdin. Otherwise the socket is created
+// (replacing a file left by a previous server) and a thread accepts the connections.
+//
+bool JobServer::start(const std::string& socketPath)
+{
+  m_socketPath = socketPath;
+  if(socketPath.empty())
+  {
+    auto connection = std::make_shared<JobConnection>();
+    m_readers.emplace_back(&JobServer::readLines, this, connection);
+    return true;
+  }
+
+#ifdef _WIN32
+  LOGE("Unix domain sockets are not supported on this platform, use stdin\n");
+  return false;
+#else
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if(socketPath.size() >= sizeof(address.sun_path))
+  {
+    LOGE("The socket path %s is too long\n", socketPath.c_str());
+    return false;
+  }
+  strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+  m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath.c_str());
+  if(m_listenFd < 0 || bind(m_listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+     || listen(m_listenFd, 16) != 0)
+  {
+    LOGE("Could not listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+    if(m_listenFd >= 0)
+      close(m_listenFd);
+    m_listenFd = -1;
+    return false;
+  }
+  m_acceptThread = std::thread(&JobServer::acceptLoop, this);
+  return true;
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+// The blocked accept() and recv() return once their sockets are shut down. The jobs still queued
+// are answered with an error.
+//
+void JobServer::stop()
+{
+  std::vector<std::shared_ptr<JobConnection>> connections;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    for(auto& weak : m_connections)
+      if(auto connection = weak.lock())
+        connections.push_back(connection);
+  }
+#ifndef _WIN32
+  if(m_listenFd >= 0)
+    shutdown(m_listenFd, SHUT_RDWR);
+  for(auto& connection : connections)
+    shutdown(connection->fd, SHUT_RD);
+#endif
+  connections.clear();
+
+  if(m_acceptThread.joinable())
+    m_acceptThread.join();
+  for(auto& reader : m_readers)
+    reader.join();
+  m_readers.clear();
+  m_finishedReaders.clear();
+
+#ifndef _WIN32
+  if(m_listenFd >= 0)
+  {
+    close(m_listenFd);
+    unlink(m_socketPath.c_str());
+  }
+  m_listenFd = -1;
+#endif
+
+  for(const auto& job : m_jobs)
+    reply(job, "{\"id\": " + quote(job.id) + ", \"status\": \"error\", \"error\": \"server stopped\"}");
+  m_jobs.clear();
+}
+
+bool JobServer::pop(RenderJob& job)
+{
+  job = RenderJob();  // Releases the connection of the previous job, closed once it has no reply pending
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_jobAdded.wait(lock, [&] { return !m_jobs.empty() || m_inputClosed || m_stop; });
+  if(m_jobs.empty() || m_stop)
+    return false;
+
+  job = std::move(m_jobs.front());
+  m_jobs.pop_front();
+  if(job.quit)
+  {
+    m_stop = true;
+    lock.unlock();
+    reply(job, "{\"id\": " + quote(job.id) + ", \"status\": \"stopped\"}");
+    return false;
+  }
+  return true;
+}
+
+void JobServer::reply(const RenderJob& job, const std::string& json)
+{
+  if(job.connection && !sendLine(*job.connection, json))
+    LOGW("Could not reply to job %s, the client disconnected\n", job.id.c_str());
+}
+
+//--------------------------------------------------------------------------------------------------
+// Members with the wrong type are errors, unknown members are ignored
+//
+bool JobServer::parseJob(const std::string& line, RenderJob& job, std::string& error)
+{
+  std::map<std::string, JsonValue> members;
+  if(!parseObject(line, members, error))
+    return false;
+
+  using Type = JsonValue::Type;
+  auto get   = [&](const char* name, Type type, size_t arraySize = 0) -> const JsonValue* {
+    auto found = members.find(name);
+    if(found == members.end() || found->second.type == Type::eNull)
+      return nullptr;
+    if(found->second.type != type || (type == Type::eArray && found->second.numbers.size() != arraySize))
+    {
+      error = std::string("invalid type of \"") + name + "\"";
+      return nullptr;
+    }
+    return &found->second;
+  };
+  // Numbers are checked before being converted, a double out of the range of the type is undefined
+  auto getNumber = [&](const char* name, double low, double high) -> const JsonValue* {
+    const JsonValue* member = get(name, Type::eNumber);
+    if(member != nullptr && (member->number < low || member->number > high))
+    {
+      error = std::string("\"") + name + "\" out of range";
+      return nullptr;
+    }
+    return member;
+  };
+  auto getInt = [&](const char* name, int& value) {
+    if(const JsonValue* member = getNumber(name, INT_MIN, INT_MAX))
+      value = static_cast<int>(member->number);
+  };
+  auto getVec3 = [&](const char* name, glm::vec3& value) {
+    const JsonValue* member = get(name, Type::eArray, 3);
+    if(member != nullptr)
+    {
+      for(double number : member->numbers)
+      {
+        if(std::abs(number) > FLT_MAX)
+        {
+          error = std::string("\"") + name + "\" out of range";
+          return false;
+        }
+      }
+      value = glm::vec3(member->numbers[0], member->numbers[1], member->numbers[2]);
+    }
+    return member != nullptr;
+  };
+
+  // The id is given back as a string, numbers included
+  auto id = members.find("id");
+  if(id != members.end() && id->second.type == Type::eString)
+    job.id = id->second.text;
+  else if(id != members.end() && id->second.type == Type::eNumber)
+  {
+    char text[32];
+    snprintf(text, sizeof(text), "%.17g", id->second.number);
+    job.id = text;
+  }
+
+  if(const JsonValue* member = get("quit", Type::eBool))
+    job.quit = member->boolean;
+  if(const JsonValue* member = get("ping", Type::eBool))
+    job.ping = member->boolean;
+  if(const JsonValue* member = get("output", Type::eString))
+    job.output = member->text;
+  getInt("width", job.width);
+  getInt("height", job.height);
+  getInt("frames", job.frames);
+  getInt("spp", job.spp);
+  getInt("tile", job.tile);
+  getInt("tileSize", job.tileSize);
+  job.hasCamera = getVec3("eye", job.eye) & getVec3("center", job.center);
+  getVec3("up", job.up);
+  if(const JsonValue* member = getNumber("fov", 0.0, 180.0))
+    job.fov = static_cast<float>(member->number);
+  if(const JsonValue* member = getNumber("seed", 0.0, UINT32_MAX))
+  {
+    job.hasSeed = true;
+    job.seed    = static_cast<uint32_t>(member->number);
+  }
+
+  if(!error.empty())
+    return false;
+  if(job.quit || job.ping)
+    return true;
+  if(job.output.empty())
+    error = "missing \"output\"";
+  else if(job.width < 0 || job.height < 0 || job.frames < 0 || job.spp < 0 || job.fov >= 180.f)
+    error = "negative size, frames or samples, or fov out of range";
+  else if(job.frames > MAX_JOB_FRAMES || job.spp > MAX_JOB_FRAMES)
+    error = "more than " + std::to_string(MAX_JOB_FRAMES) + " frames or samples";
+  else if(members.count("eye") != members.count("center"))
+    error = "\"eye\" and \"center\" go together";
+  else if(job.tile >= 0 && (job.width == 0 || job.height == 0 || job.tileSize <= 0))
+    error = "a \"tile\" needs \"width\", \"height\" and \"tileSize\"";
+  return error.empty();
+}
+
+bool JobServer::parseObject(const std::string& line, std::map<std::string, JsonValue>& members, std::string& error)
+{
+  return JsonReader(line).readObject(members, error);
+}
+
+std::string JobServer::quote(const std::string& text)
+{
+  std::string quoted = "\"";
+  for(char c : text)
+  {
+    if(c == '"' || c == '\\')
+    {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if(static_cast<unsigned char>(c) < 0x20)
+    {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+    }
+    else
+      quoted += c;
+  }
+  return quoted + "\"";
+}
+
+//--------------------------------------------------------------------------------------------------
+// One thread per input. A connection stays open while a reply is owed to it: the reader and the
+// queued jobs share it.
+//
+void JobServer::readLines(std::shared_ptr<JobConnection> connection)
+{
+  if(connection->fd < 0)
+  {
+    std::string line;
+    while(std::getline(std::cin, line))
+    {
+      push(line, connection);
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(m_stop || (!m_jobs.empty() && m_jobs.back().quit))
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inputClosed = true;
+    m_jobAdded.notify_all();
+    return;
+  }
+
+#ifndef _WIN32
+  std::string pending;
+  char        buffer[4096];
+  ssize_t     received;
+  while((received = recv(connection->fd, buffer, sizeof(buffer), 0)) > 0)
+  {
+    pending.append(buffer, static_cast<size_t>(received));
+    size_t newline;
+    while((newline = pending.find('\n')) != std::string::npos)
+    {
+      push(pending.substr(0, newline), connection);
+      pending.erase(0, newline + 1);
+    }
+  }
+  if(!pending.empty())
+    push(pending, connection);
+
+  // Joined by acceptLoop(), or by stop()
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_finishedReaders.push_back(std::this_thread::get_id());
+#endif
+}
+
+void JobServer::acceptLoop()
+{
+#ifndef _WIN32
+  int fd;
+  while((fd = accept(m_listenFd, nullptr, nullptr)) >= 0)
+  {
+    auto connection = std::make_shared<JobConnection>();
+    connection->fd  = fd;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_stop)
+      break;
+
+    // The readers of the connections closed since the last one have returned or are about to
+    for(std::thread::id id : m_finishedReaders)
+    {
+      auto reader = std::find_if(m_readers.begin(), m_readers.end(),
+                                 [&](const std::thread& thread) { return thread.get_id() == id; });
+      reader->join();
+      m_readers.erase(reader);
+    }
+    m_finishedReaders.clear();
+    m_connections.erase(std::remove_if(m_connections.begin(), m_connections.end(),
+                                       [](const std::weak_ptr<JobConnection>& weak) { return weak.expired(); }),
+                        m_connections.end());
+
+    m_connections.push_back(connection);
+    m_readers.emplace_back(&JobServer::readLines, this, connection);
+  }
+#endif
+}
+
+void JobServer::push(const std::string& line, const std::shared_ptr<JobConnection>& connection)
+{
+  if(line.find_first_not_of(" \t\r") == std::string::npos)
+    return;
+
+  RenderJob   job;
+  std::string error;
+  job.received   = std::chrono::steady_clock::now();
+  job.connection = connection;
+  if(!parseJob(line, job, error))
+  {
+    reply(job, "{\"id\": " + quote(job.id) + ", \"status\": \"error\", \"error\": " + quote(error) + "}");
+    return;
+  }
+  if(job.ping)
+  {
+    reply(job, "{\"id\": " + quote(job.id) + ", \"status\": \"ready\"}");
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if(m_stop)
+  {
+    reply(job, "{\"id\": " + quote(job.id) + ", \"status\": \"error\", \"error\": \"server stopped\"}");
+    return;
+  }
+  m_jobs.push_back(std::move(job));
+  m_jobAdded.notify_one();
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct JobConnection;
+
+//--------------------------------------------------------------------------------------------------
+// Render job, one JSON object on one line. Only `output` is required, the other members default to
+// the command line of the server:
+//   {"id": "shot_12", "output": "shot_12.exr", "width": 1920, "height": 1080, "frames": 64,
+//    "eye": [0, 2, 15], "center": [0, 1, 0], "up": [0, 1, 0], "fov": 45, "seed": 7}
+// "spp" can replace "frames": the frames are then the samples per pixel divided by the samples per
+// frame, rounded up; both are at most 65536. {"quit": true} stops the server once the jobs before it
+// are done, {"ping": true} is answered with {"status": "ready"} right away.
+//
+// With "tile" and "tileSize", the job renders one tile of an image of "width" x "height", in the
+// tiling of TileFile, and writes it in place in "output", which another process created with
+// TileFile::open(). See tile_coordinator.hpp.
+//
+struct RenderJob
+{
+  std::string id;      // Given back in the reply
+  std::string output;  // Image file, the format is given by the extension
+  int         width{0};
+  int         height{0};
+  int         frames{0};
+  int         spp{0};
+  bool        hasCamera{false};  // eye, center and up
+  glm::vec3   eye{0.f};
+  glm::vec3   center{0.f};
+  glm::vec3   up{0.f, 1.f, 0.f};
+  float       fov{0.f};  // Degrees, 0: the default camera
+  bool        hasSeed{false};
+  uint32_t    seed{0};
+  int         tile{-1};  // Index of the tile, -1: the whole image
+  int         tileSize{0};
+  bool        quit{false};
+  bool        ping{false};
+
+  std::chrono::steady_clock::time_point received;  // To report the time spent in the queue
+  std::shared_ptr<JobConnection>        connection;  // Where the reply goes
+};
+
+// Member of a flat JSON object, as the jobs and their replies
+struct JsonValue
+{
+  enum class Type
+  {
+    eNull,
+    eBool,
+    eNumber,
+    eString,
+    eArray,  // Of numbers
+  };
+  Type                type{Type::eNull};
+  bool                boolean{false};
+  double              number{0.0};
+  std::string         text;
+  std::vector<double> numbers;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Queue of render jobs read from stdin or from the connections to a Unix domain socket, for a
+// process which keeps the scene, the acceleration structures and the pipelines between images.
+//
+// Reader threads parse the lines and queue the jobs; the render loop takes them in order with
+// pop(). Each job gets one JSON line in reply, on stdout or on the connection it came from. A
+// line which is not a job is answered right away with an error. Log messages are also printed on
+// stdout: the replies are the lines starting with `{`.
+//
+// Usage:
+//   server.start("");  // stdin, or the path of a socket
+//   RenderJob job;
+//   while(server.pop(job))
+//   {
+//     ...
+//     server.reply(job, "{\"status\": \"done\"}");
+//   }
+//   server.stop();
+//
+class JobServer
+{
+public:
+  bool start(const std::string& socketPath);
+  void stop();
+
+  // Waits for the next job. Returns false once the input is closed (stdin) or after a quit job.
+  bool pop(RenderJob& job);
+  void reply(const RenderJob& job, const std::string& json);
+
+  static bool        parseJob(const std::string& line, RenderJob& job, std::string& error);
+  // One object of strings, numbers, booleans and arrays of numbers, on one line
+  static bool        parseObject(const std::string& line, std::map<std::string, JsonValue>& members, std::string& error);
+  static std::string quote(const std::string& text);  // JSON string
+
+private:
+  void readLines(std::shared_ptr<JobConnection> connection);
+  void acceptLoop();
+  void push(const std::string& line, const std::shared_ptr<JobConnection>& connection);
+
+  std::string              m_socketPath;
+  int                      m_listenFd{-1};
+  std::thread              m_acceptThread;
+  std::vector<std::thread> m_readers;
+
+  std::mutex                                m_mutex;  // Guards the queue, the connections, the flags and the readers
+  std::vector<std::thread::id>              m_finishedReaders;  // Readers of closed connections, to join
+  std::condition_variable                   m_jobAdded;
+  std::deque<RenderJob>                     m_jobs;
+  std::vector<std::weak_ptr<JobConnection>> m_connections;  // Closed by stop()
+  bool                                      m_inputClosed{false};
+  bool                                      m_stop{false};
+};
@@ -22,7 +22,16 @@
 // pipeline If you are new to ImGui, see examples/README.txt and documentation
 // at the top of imgui.cpp.
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "backends/imgui_impl_glfw.h"
@@ -30,13 +39,20 @@
 #include "imgui.h"
 #include "imgui/imgui_helper.h"
 
+#include "benchmark.h"
+#include "checkpoint.h"
+#include "frame_writer.hpp"
 #include "hello_vulkan.h"
 #include "imgui/imgui_camera_widget.h"
+#include "job_server.hpp"
 #include "nvh/cameramanipulator.hpp"
 #include "nvh/fileoperations.hpp"
+#include "nvh/nvprint.hpp"
 #include "nvpsystem.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/context_vk.hpp"
+#include "tile_coordinator.hpp"
+#include "tile_file.hpp"
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -66,13 +82,867 @@ void renderUI(HelloVulkan& helloVk, bool useRaytracer)
     ImGui::SliderFloat3("Position", &helloVk.m_pcRaster.lightPosition.x, -20.f, 20.f);
     ImGui::SliderFloat("Intensity", &helloVk.m_pcRaster.lightIntensity, 0.f, 150.f);
   }
+  if(useRaytracer && ImGui::CollapsingHeader("Path tracer"))
+  {
+    bool changed = false;
+    changed |= ImGui::SliderInt("Max depth", &helloVk.m_pcRay.maxDepth, 1, 32);
+    changed |= ImGui::SliderInt("Roulette start depth", &helloVk.m_pcRay.rrMinDepth, 0, 32);
+    changed |= ImGui::SliderFloat("Roulette max survival", &helloVk.m_pcRay.rrMaxSurvival, 0.5f, 1.f);
+    changed |= ImGui::Checkbox("Sample emissive triangles", &helloVk.m_useNee);
+    if(changed)
+      helloVk.resetFrame();
+    ImGui::Text("Average path length: %.2f rays", helloVk.m_avgPathLength);
+
+    // Samples per pixel chosen each frame to meet a GPU time budget
+    RayBudget& budget = helloVk.m_rayBudget;
+    if(!budget.enabled)
+      ImGui::SliderInt("Samples per frame", &helloVk.m_pcRay.samplesPerFrame, 1, 64);
+    if(budget.supported())
+    {
+      ImGui::Checkbox("Ray budget", &budget.enabled);
+      if(budget.enabled)
+      {
+        ImGui::SliderFloat("Budget (ms)", &budget.targetMs, 0.5f, 100.f);
+        ImGui::SliderFloat("Hysteresis", &budget.hysteresis, 0.f, 0.5f);
+        ImGui::DragIntRange2("Samples range", &budget.minSamples, &budget.maxSamples, 1, 1, 64);
+      }
+      ImGui::Text("Trace: %.2f ms (avg %.2f ms, %.3f ms/sample), %d samples per frame", budget.lastMs, budget.avgMs,
+                  budget.avgSampleMs, helloVk.m_pcRay.samplesPerFrame);
+    }
+  }
+  if(useRaytracer && ImGui::CollapsingHeader("Sampler"))
+  {
+    int samplerType = static_cast<int>(helloVk.m_pcRay.samplerType);
+    if(ImGui::Combo("Sequence", &samplerType, "Random\0Sobol (Owen)\0Blue noise\0"))
+    {
+      helloVk.m_pcRay.samplerType = static_cast<uint32_t>(samplerType);
+      helloVk.resetFrame();
+    }
+    if(ImGui::Button("Measure convergence"))
+      helloVk.m_samplerConvergence = measureSamplerConvergence(helloVk.m_samplerTables, ConvergenceTest::ePath);
+
+    // RMSE of a two-bounce visibility integral, per number of samples
+    const auto& result = helloVk.m_samplerConvergence;
+    if(!result.sampleCounts.empty())
+      ImGui::Text("RMSE      Random  Sobol   Blue noise");
+    for(size_t i = 0; i < result.sampleCounts.size(); i++)
+    {
+      ImGui::Text("%4u spp  %.4f  %.4f  %.4f", result.sampleCounts[i], result.rmse[SAMPLER_RANDOM][i],
+                  result.rmse[SAMPLER_SOBOL][i], result.rmse[SAMPLER_BLUE_NOISE][i]);
+    }
+  }
+  if(useRaytracer && ImGui::CollapsingHeader("Adaptive sampling"))
+  {
+    bool changed = false;
+    changed |= ImGui::Checkbox("Enable", &helloVk.m_useAdaptive);
+    changed |= ImGui::SliderFloat("Error threshold", &helloVk.m_adaptiveThreshold, 0.001f, 0.1f, "%.3f");
+    changed |= ImGui::SliderInt("Min samples", &helloVk.m_pcRay.adaptiveMinSamples, 2, 256);
+    if(changed)
+      helloVk.resetFrame();
+    if(helloVk.m_useAdaptive)
+    {
+      float active = helloVk.m_activeHistory.empty() ? 1.f : helloVk.m_activeHistory.back();
+      ImGui::PlotLines("Active pixels", helloVk.m_activeHistory.data(), static_cast<int>(helloVk.m_activeHistory.size()),
+                       0, nullptr, 0.f, 1.f, ImVec2(0, 60));
+      ImGui::Text("Active pixels: %.1f %%", active * 100.f);
+      if(helloVk.m_timeToThreshold >= 0.f)
+        ImGui::Text("Converged in %d frames, %.1f ms", helloVk.m_framesToThreshold, helloVk.m_timeToThreshold);
+    }
+  }
+}
+
+// Recording the camera of every frame, for the benchmark to replay
+void renderCameraPathUI(CameraPath& path, bool& recording)
+{
+  if(!ImGui::CollapsingHeader("Camera path"))
+    return;
+  ImGui::Checkbox("Record", &recording);
+  ImGui::SameLine();
+  if(ImGui::Button("Clear"))
+    path.cameras.clear();
+  ImGui::SameLine();
+  if(ImGui::Button("Save") && path.save("camera_path.txt"))
+    LOGI("Saved %zu cameras to camera_path.txt\n", path.cameras.size());
+  ImGui::Text("%zu frames recorded", path.cameras.size());
+}
+
+// Writing every frame to disk, in the background
+void renderFrameWriterUI(FrameWriter& writer, bool& recording, int& format)
+{
+  if(!ImGui::CollapsingHeader("Record frames"))
+    return;
+  ImGui::Checkbox("Record", &recording);
+  ImGui::SameLine();
+  ImGui::RadioButton("PNG", &format, 0);
+  ImGui::SameLine();
+  ImGui::RadioButton("EXR", &format, 1);
+
+  FrameWriter::Stats stats = writer.getStats();
+  ImGui::Text("%u written, %u pending, %u failed", stats.written, stats.pending, stats.failed);
+  ImGui::Text("%u frames waited for a free readback slot", stats.stalls);
 }
 
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////
-static int const SAMPLE_WIDTH  = 1280;
-static int const SAMPLE_HEIGHT = 720;
+static int const   SAMPLE_WIDTH  = 1280;
+static int const   SAMPLE_HEIGHT = 720;
+static const char* SCENE_FILE    = "media/scenes/cornellBox.gltf";  // Also reported by the benchmark
+
+
+//--------------------------------------------------------------------------------------------------
+// Command line options
+//   --headless       No window, surface nor swapchain: the path tracer renders offscreen and exits
+//   --frames <n>     Number of frames accumulated in headless mode
+//   --size <w> <h>   Size of the rendering
+//   --output <file>  Image written in headless mode, `.exr` or `.hdr` for floating point, PNG otherwise.
+//                    With a `%d` or `%0<width>d`, as `frame_%04d.png`, every frame is written.
+//   --seed <n>       Base of the random seeds of the path tracer
+//   --benchmark <f>  Headless benchmark replaying the camera path file <f> recorded from the UI, or
+//                    `orbit` for a turn around the scene. Measures --frames frames after the warm-up.
+//   --warmup <n>     Frames rendered before the benchmark measures
+//   --json <file>    Results of the benchmark
+//   --readback-slots <n>  Frames which can be copied back at the same time when writing every frame
+//   --writer-threads <n>  Threads encoding the written frames, 0 for one per hardware thread
+//   --tile <n>       Headless rendering in tiles of n x n pixels, each accumulating --frames frames,
+//                    streamed to the `.exr` output
+//   --resume         Continues the tiled rendering of the same output, size and tile size
+//   --checkpoint <f> Saves the accumulation of the headless rendering in f at intervals and on SIGINT
+//                    or SIGTERM, and continues it when f exists
+//   --checkpoint-interval <s>
+//                    Seconds between two checkpoints (300)
+//   --serve          Headless server rendering the JSON jobs read from stdin, one per line, with the
+//                    scene, acceleration structures and pipelines loaded once. See job_server.hpp.
+//   --socket <path>  Server reading the jobs from the connections to a Unix domain socket
+//   --workers <n>    Renders the tiles of --tile with n processes of this sample in server mode
+//   --connect <path> Also renders tiles with the server listening on the socket <path>, repeatable
+//   --scaling        Renders the image with 1, 2, 4... --workers workers and reports the speedup
+//
+struct Options
+{
+  bool                     headless{false};
+  int                      frames{64};
+  int                      width{SAMPLE_WIDTH};
+  int                      height{SAMPLE_HEIGHT};
+  std::string              output{"output.png"};
+  uint32_t                 seed{0};
+  std::string              benchmark;  // Camera path file, or "orbit"; empty when not benchmarking
+  int                      warmup{16};
+  std::string              json{"benchmark.json"};
+  int                      readbackSlots{4};
+  int                      writerThreads{0};
+  int                      tileSize{0};  // 0: the whole image at once
+  bool                     resume{false};
+  std::string              checkpoint;  // Empty: no checkpoint
+  float                    checkpointInterval{300.f};
+  bool                     serve{false};
+  std::string              socket;  // Empty: the server reads stdin
+  int                      workers{0};
+  std::vector<std::string> connect;
+  bool                     scaling{false};
+};
+
+//--------------------------------------------------------------------------------------------------
+// An output name is a frame sequence when it has a `%d` or `%0<width>d`, replaced by the number of
+// the frame. The name is never used as a printf format: any other `%` makes it invalid.
+//
+struct FrameSequence
+{
+  size_t pos{std::string::npos};  // Of the `%`, npos when the output is a single image
+  size_t length{0};               // Of the `%d` or `%0<width>d`
+  int    width{0};                // Digits the frame number is padded to with zeros
+};
+
+static bool parseFrameSequence(const std::string& output, FrameSequence& sequence)
+{
+  sequence = FrameSequence();
+  for(size_t i = output.find('%'); i != std::string::npos; i = output.find('%', i + 1))
+  {
+    if(sequence.pos != std::string::npos)
+      return false;  // A second `%`
+    size_t end = i + 1;
+    if(end < output.size() && output[end] == '0')
+    {
+      while(++end < output.size() && output[end] >= '0' && output[end] <= '9')
+        sequence.width = sequence.width * 10 + (output[end] - '0');
+      if(sequence.width == 0 || sequence.width > 9)
+        return false;
+    }
+    if(end >= output.size() || output[end] != 'd')
+      return false;
+    sequence.pos    = i;
+    sequence.length = end + 1 - i;
+  }
+  return true;
+}
+
+static std::string frameFileName(const std::string& output, const FrameSequence& sequence, int frame)
+{
+  std::string number = std::to_string(frame);
+  if(number.size() < static_cast<size_t>(sequence.width))
+    number.insert(0, sequence.width - number.size(), '0');
+  return std::string(output).replace(sequence.pos, sequence.length, number);
+}
+
+static void printUsage(const char* program)
+{
+  printf("Usage: %s [--headless] [--frames <n>] [--size <width> <height>] [--output <file>] [--seed <n>]\n"
+         "          [--benchmark <camera path|orbit>] [--warmup <n>] [--json <file>]\n"
+         "          [--readback-slots <n>] [--writer-threads <n>] [--tile <n>] [--resume]\n"
+         "          [--checkpoint <file>] [--checkpoint-interval <seconds>] [--serve] [--socket <path>]\n"
+         "          [--workers <n>] [--connect <path>] [--scaling]\n"
+         "The output of a sequence has one %%d or %%0<width>d, replaced by the frame number, and no other %%.\n",
+         program);
+}
+
+// Values which are not numbers, or out of range, are reported with the usage
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+  FrameSequence sequence;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string arg = argv[i];
+    try
+    {
+      if(arg == "--headless")
+        options.headless = true;
+      else if(arg == "--frames" && i + 1 < argc)
+        options.frames = std::stoi(argv[++i]);
+      else if(arg == "--size" && i + 2 < argc)
+      {
+        options.width  = std::stoi(argv[++i]);
+        options.height = std::stoi(argv[++i]);
+      }
+      else if(arg == "--output" && i + 1 < argc)
+      {
+        options.output = argv[++i];
+        if(!parseFrameSequence(options.output, sequence))
+          throw std::invalid_argument(options.output);
+      }
+      else if(arg == "--seed" && i + 1 < argc)
+      {
+        long long seed = std::stoll(argv[++i]);
+        if(seed < 0 || seed > static_cast<long long>(UINT32_MAX))
+          throw std::out_of_range(argv[i]);
+        options.seed = static_cast<uint32_t>(seed);
+      }
+      else if(arg == "--benchmark" && i + 1 < argc)
+      {
+        options.benchmark = argv[++i];
+        options.headless  = true;
+      }
+      else if(arg == "--warmup" && i + 1 < argc)
+        options.warmup = std::stoi(argv[++i]);
+      else if(arg == "--json" && i + 1 < argc)
+        options.json = argv[++i];
+      else if(arg == "--readback-slots" && i + 1 < argc)
+        options.readbackSlots = std::stoi(argv[++i]);
+      else if(arg == "--writer-threads" && i + 1 < argc)
+        options.writerThreads = std::stoi(argv[++i]);
+      else if(arg == "--tile" && i + 1 < argc)
+      {
+        options.tileSize = std::stoi(argv[++i]);
+        options.headless = true;
+      }
+      else if(arg == "--resume")
+        options.resume = true;
+      else if(arg == "--checkpoint" && i + 1 < argc)
+      {
+        options.checkpoint = argv[++i];
+        options.headless   = true;
+      }
+      else if(arg == "--checkpoint-interval" && i + 1 < argc)
+        options.checkpointInterval = std::stof(argv[++i]);
+      else if(arg == "--serve")
+      {
+        options.serve    = true;
+        options.headless = true;
+      }
+      else if(arg == "--socket" && i + 1 < argc)
+      {
+        options.socket   = argv[++i];
+        options.serve    = true;
+        options.headless = true;
+      }
+      else if(arg == "--workers" && i + 1 < argc)
+        options.workers = std::stoi(argv[++i]);
+      else if(arg == "--connect" && i + 1 < argc)
+        options.connect.push_back(argv[++i]);
+      else if(arg == "--scaling")
+        options.scaling = true;
+      else
+      {
+        printUsage(argv[0]);
+        return false;
+      }
+    }
+    catch(const std::logic_error&)  // std::invalid_argument and std::out_of_range
+    {
+      printf("Invalid value of %s: %s\n", arg.c_str(), argv[i]);
+      printUsage(argv[0]);
+      return false;
+    }
+  }
+  return options.frames > 0 && options.width > 0 && options.height > 0 && options.warmup >= 0
+         && options.readbackSlots > 0 && options.writerThreads >= 0 && options.tileSize >= 0
+         && options.checkpointInterval >= 0.f && options.workers >= 0
+         && (options.tileSize > 0 || (options.workers == 0 && options.connect.empty()))
+         && (!options.scaling || options.workers > 0);
+}
+
+
+static uint32_t writerThreadCount(const Options& options)
+{
+  if(options.writerThreads > 0)
+    return static_cast<uint32_t>(options.writerThreads);
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// #Checkpoint - Set by SIGINT and SIGTERM (e.g. the notice of a preemptible instance): the headless
+// rendering stops after the current frame and saves its checkpoint.
+//
+static volatile std::sig_atomic_t g_stopRequested = 0;
+
+static void onStopSignal(int)
+{
+  g_stopRequested = 1;
+}
+
+static std::vector<uint8_t> accumulationState(const HelloVulkan& helloVk)
+{
+  HelloVulkan::AccumulationState state{helloVk.m_pcRay.frame, helloVk.m_seed};
+  std::vector<uint8_t>           bytes(sizeof(state));
+  memcpy(bytes.data(), &state, sizeof(state));
+  return bytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Checkpoint - Continues the accumulation saved by a previous run. Returns the first frame to
+// render, or -1 if the checkpoint exists but cannot be used: the render is refused rather than
+// silently restarted or mixed with another configuration.
+//
+static int loadCheckpoint(HelloVulkan&                helloVk,
+                          Checkpoint&                 checkpoint,
+                          const std::vector<VkImage>& images,
+                          uint64_t                    hash,
+                          const std::string&          filename)
+{
+  std::vector<uint8_t>           bytes;
+  HelloVulkan::AccumulationState state{};
+  switch(checkpoint.load(filename, images, helloVk.getSize(), hash, bytes))
+  {
+    case Checkpoint::LoadResult::eMissing:
+      return 0;
+    case Checkpoint::LoadResult::eMismatch:
+      LOGE("%s was saved for another scene, camera, size or settings, not resuming it\n", filename.c_str());
+      return -1;
+    case Checkpoint::LoadResult::eInvalid:
+      LOGE("%s is not a valid checkpoint\n", filename.c_str());
+      return -1;
+    case Checkpoint::LoadResult::eLoaded:
+      break;
+  }
+  if(bytes.size() != sizeof(state))
+  {
+    LOGE("%s is not a valid checkpoint\n", filename.c_str());
+    return -1;
+  }
+  memcpy(&state, bytes.data(), sizeof(state));
+  helloVk.m_seed = state.seed;
+  helloVk.resumeFrame(state.frame);
+  LOGI("Resuming %s after %d frames\n", filename.c_str(), state.frame + 1);
+  return state.frame + 1;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Headless rendering: the frames accumulate in the offscreen image, each one submitted and waited
+// on. The last image is read back and written to disk, or with a sequence, every image is given to
+// the FrameWriter, which copies and encodes it while the next frames render.
+//
+// With a checkpoint, the accumulation is saved every checkpointInterval seconds, when the process
+// is asked to stop, and at the end, so a later run with more --frames continues it.
+//
+static int renderHeadless(HelloVulkan& helloVk, VkQueue queue, uint32_t queueFamily, const Options& options)
+{
+  glm::vec4 clearColor = glm::vec4(1, 1, 1, 1.00f);
+  auto      start      = std::chrono::steady_clock::now();
+
+  FrameSequence frameSequence;
+  parseFrameSequence(options.output, frameSequence);  // Validated by parseOptions
+  const bool sequence = frameSequence.pos != std::string::npos;
+
+  FrameWriter writer;
+  if(sequence)
+    writer.setup(helloVk.getDevice(), &helloVk.m_alloc, queueFamily, options.readbackSlots, writerThreadCount(options));
+
+  // #Checkpoint
+  const bool                 useCheckpoint = !options.checkpoint.empty();
+  const std::vector<VkImage> accumulation  = {helloVk.m_offscreenColor.image, helloVk.m_varianceImage.image};
+  const uint64_t             hash          = useCheckpoint ? helloVk.getAccumulationHash() : 0;
+  const auto                 interval      = std::chrono::duration<float>(options.checkpointInterval);
+  auto                       lastSave      = start;
+  int                        firstFrame    = 0;
+  Checkpoint                 checkpoint;
+  if(useCheckpoint)
+  {
+    checkpoint.setup(helloVk.getDevice(), &helloVk.m_alloc, queueFamily);
+    firstFrame = loadCheckpoint(helloVk, checkpoint, accumulation, hash, options.checkpoint);
+    if(firstFrame < 0)
+    {
+      checkpoint.destroy();
+      writer.destroy();
+      return 1;
+    }
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+  }
+
+  bool              ok = true;
+  nvvk::CommandPool cmdPool(helloVk.getDevice(), queueFamily);
+  for(int frame = firstFrame; frame < options.frames && ok && !g_stopRequested; frame++)
+  {
+    VkCommandBuffer cmdBuf = cmdPool.createCommandBuffer();
+    helloVk.updateUniformBuffer(cmdBuf);
+    helloVk.raytrace(cmdBuf, clearColor);
+    cmdPool.submitAndWait(cmdBuf);
+
+    if(sequence)
+    {
+      std::string filename = frameFileName(options.output, frameSequence, frame);
+      ok = writer.write(queue, helloVk.m_offscreenColor.image, helloVk.getSize(), filename);
+    }
+
+    // The copy runs after this frame, and the file is written while the next frames render. When the
+    // previous checkpoint is still being written, this one is tried again on the next frame.
+    if(useCheckpoint)
+    {
+      checkpoint.poll();
+      auto now = std::chrono::steady_clock::now();
+      if(now - lastSave >= interval
+         && checkpoint.save(queue, options.checkpoint, accumulation, helloVk.getSize(), hash, accumulationState(helloVk)))
+        lastSave = now;
+    }
+  }
+
+  if(useCheckpoint)
+  {
+    checkpoint.flush();
+    checkpoint.save(queue, options.checkpoint, accumulation, helloVk.getSize(), hash, accumulationState(helloVk));
+    ok = checkpoint.flush() && ok;
+    LOGI("%u checkpoints written to %s, %u failed\n", checkpoint.getSavedCount(), options.checkpoint.c_str(),
+         checkpoint.getFailedCount());
+    checkpoint.destroy();
+    if(g_stopRequested)
+    {
+      writer.flush();
+      writer.destroy();
+      LOGI("Stopped after %d frames, run again to continue\n", helloVk.m_pcRay.frame + 1);
+      return ok ? 2 : 1;
+    }
+  }
+
+  if(sequence)
+  {
+    writer.flush();  // Waits for the last files
+    FrameWriter::Stats stats = writer.getStats();
+    writer.destroy();
+    ok = ok && stats.failed == 0;
+    LOGI("%u frames written, %u waited for a free readback slot\n", stats.written, stats.stalls);
+  }
+  else
+  {
+    ok = helloVk.saveImage(options.output);
+  }
+  if(!ok)
+    return 1;
+
+  auto elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+  LOGI("Rendered %d frames of %dx%d in %.1f ms to %s\n", options.frames, options.width, options.height, elapsed,
+       options.output.c_str());
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// #Tiles - The offscreen image is one tile, and the image is rendered tile after tile, each one
+// accumulating all its frames before the next. Each frame is its own submission, which keeps the
+// GPU work of a submission small. A tile is written in place in the output file by another thread
+// while the next tile renders, so the memory used depends on the tile size, not the image size.
+//
+static int renderTiled(HelloVulkan& helloVk, uint32_t queueFamily, const Options& options)
+{
+  glm::vec4 clearColor = glm::vec4(1, 1, 1, 1.00f);
+  auto      start      = std::chrono::steady_clock::now();
+
+  const std::string& output = options.output;
+  if(output.size() < 4 || output.compare(output.size() - 4, 4, ".exr") != 0)
+  {
+    LOGE("Tiled rendering writes OpenEXR, the output must end with .exr\n");
+    return 1;
+  }
+  TileFile file;
+  if(!file.open(output, options.width, options.height, options.tileSize, options.resume))
+  {
+    LOGE("Could not open %s\n", output.c_str());
+    return 1;
+  }
+
+  // Two readback buffers: one is written to disk while the other receives the next tile
+  const VkExtent2D   tileExtent = helloVk.getSize();
+  const VkDeviceSize tileBytes  = VkDeviceSize(tileExtent.width) * tileExtent.height * 4 * sizeof(float);
+  nvvk::Buffer       readback[2];
+  const float*       pixels[2];
+  for(int i = 0; i < 2; i++)
+  {
+    readback[i] = helloVk.m_alloc.createBuffer(tileBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                                   | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+    pixels[i]   = static_cast<const float*>(helloVk.m_alloc.map(readback[i]));
+  }
+  std::future<bool> writing;  // Previous tile, from the other buffer
+
+  const auto&       tiles    = file.getTiles();
+  size_t            rendered = 0;
+  bool              ok       = true;
+  nvvk::CommandPool cmdPool(helloVk.getDevice(), queueFamily);
+  for(size_t tile = 0; tile < tiles.size() && ok; tile++)
+  {
+    if(file.isDone(tile))
+      continue;
+
+    const size_t slot    = rendered % 2;
+    helloVk.m_tileOffset = {static_cast<int32_t>(tiles[tile].x), static_cast<int32_t>(tiles[tile].y)};
+    helloVk.resetFrame();
+    for(int frame = 0; frame < options.frames; frame++)
+    {
+      VkCommandBuffer cmdBuf = cmdPool.createCommandBuffer();
+      helloVk.updateUniformBuffer(cmdBuf);
+      helloVk.raytrace(cmdBuf, clearColor);
+      if(frame == options.frames - 1)
+        helloVk.copyOffscreenColor(cmdBuf, readback[slot].buffer);
+      cmdPool.submitAndWait(cmdBuf);
+    }
+
+    // One tile written at a time: the file is not shared between threads
+    if(writing.valid())
+      ok = writing.get();
+    const float* tilePixels = pixels[slot];
+    writing = std::async(std::launch::async, [&file, tile, tilePixels, tileExtent]() {
+      return file.write(tile, tilePixels, tileExtent.width);
+    });
+    rendered++;
+    LOGI("Tile %zu of %zu rendered\n", tile + 1, tiles.size());
+  }
+  if(writing.valid())
+    ok = writing.get() && ok;
+
+  for(auto& buffer : readback)
+  {
+    helloVk.m_alloc.unmap(buffer);
+    helloVk.m_alloc.destroy(buffer);
+  }
+  ok = file.close() && ok;
+  if(!ok)
+  {
+    LOGE("Could not write %s, run again with --resume to render the missing tiles\n", output.c_str());
+    return 1;
+  }
+
+  auto elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+  LOGI("Rendered %zu tiles of %ux%u, %d frames each, for an image of %dx%d in %.1f ms to %s\n", rendered,
+       tileExtent.width, tileExtent.height, options.frames, options.width, options.height, elapsed, output.c_str());
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// Benchmark: the camera path is replayed with a fixed seed, and after the warm-up, the GPU time of
+// each pass and the CPU time of each frame are measured. Each frame is waited on, as in headless
+// mode, so the CPU time includes the submission and the wait.
+//
+static int runBenchmark(HelloVulkan& helloVk, VkPhysicalDevice physicalDevice, uint32_t queueFamily, const Options& options)
+{
+  glm::vec4 clearColor = glm::vec4(1, 1, 1, 1.00f);
+
+  Benchmark bench;
+  if(options.benchmark == "orbit")
+    bench.cameraPath = CameraPath::orbit(CameraManip.getCamera(), static_cast<uint32_t>(options.frames));
+  else if(!bench.cameraPath.load(options.benchmark))
+  {
+    LOGE("Could not read the camera path %s\n", options.benchmark.c_str());
+    return 1;
+  }
+
+  bench.init(helloVk.getDevice(), physicalDevice, queueFamily, static_cast<uint32_t>(options.warmup));
+  bench.setInfo("sample", PROJECT_NAME);
+  bench.setInfo("scene", SCENE_FILE);
+  bench.setInfo("cameraPath", options.benchmark);
+  bench.setInfo("width", options.width);
+  bench.setInfo("height", options.height);
+  bench.setInfo("seed", options.seed);
+  bench.setInfo("samplesPerFrame", helloVk.m_pcRay.samplesPerFrame);
+  bench.setInfo("maxDepth", helloVk.m_pcRay.maxDepth);
+
+  nvvk::CommandPool cmdPool(helloVk.getDevice(), queueFamily);
+  for(int frame = 0; frame < options.warmup + options.frames; frame++)
+  {
+    VkCommandBuffer cmdBuf = cmdPool.createCommandBuffer();
+    bench.beginFrame(cmdBuf);
+
+    bench.beginPass(cmdBuf, "Uniforms");
+    helloVk.updateUniformBuffer(cmdBuf);
+    bench.endPass(cmdBuf);
+
+    bench.beginPass(cmdBuf, "Ray trace");
+    helloVk.raytrace(cmdBuf, clearColor);
+    bench.endPass(cmdBuf);
+
+    cmdPool.submitAndWait(cmdBuf);
+    bench.endFrame();
+  }
+
+  bool written = bench.writeJson(options.json);
+  bench.deinit();
+  if(!written)
+  {
+    LOGE("Could not write %s\n", options.json.c_str());
+    return 1;
+  }
+  LOGI("Benchmark of %u frames written to %s\n", bench.measuredFrames(), options.json.c_str());
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// #Distributed - Reading back the offscreen image, one tile, and writing it in place
+//
+static bool saveTile(HelloVulkan& helloVk, nvvk::CommandPool& cmdPool, TileFile& file, size_t tile)
+{
+  const VkExtent2D   size     = helloVk.getSize();
+  const VkDeviceSize bytes    = VkDeviceSize(size.width) * size.height * 4 * sizeof(float);
+  nvvk::Buffer       readback = helloVk.m_alloc.createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                                                 | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+  VkCommandBuffer cmdBuf = cmdPool.createCommandBuffer();
+  helloVk.copyOffscreenColor(cmdBuf, readback.buffer);
+  cmdPool.submitAndWait(cmdBuf);
+
+  const float* pixels = static_cast<const float*>(helloVk.m_alloc.map(readback));
+  bool         ok     = file.write(tile, pixels, size.width);
+  helloVk.m_alloc.unmap(readback);
+  helloVk.m_alloc.destroy(readback);
+  return ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Distributed - The tiles of --tile are rendered by --workers processes of this sample started in
+// server mode, and by the servers given with --connect. This process does not use the GPU: it hands
+// out the tiles and keeps the journal. With --scaling, the image is rendered with 1, 2, 4... up to
+// --workers workers, and the speedup is measured against one worker; otherwise it is estimated
+// from the time the workers spent on their tiles.
+//
+static int renderDistributed(const Options& options, const char* program)
+{
+  const std::string& output = options.output;
+  if(output.size() < 4 || output.compare(output.size() - 4, 4, ".exr") != 0)
+  {
+    LOGE("Tiled rendering writes OpenEXR, the output must end with .exr\n");
+    return 1;
+  }
+
+  TileCoordinator::Settings settings;
+  settings.output   = output;
+  settings.width    = static_cast<uint32_t>(options.width);
+  settings.height   = static_cast<uint32_t>(options.height);
+  settings.tileSize = static_cast<uint32_t>(options.tileSize);
+  settings.frames   = options.frames;
+  settings.seed     = options.seed;
+  settings.sockets  = options.connect;
+  settings.command  = {program,
+                       "--serve",
+                       "--size",
+                       std::to_string(std::min(options.width, options.tileSize)),
+                       std::to_string(std::min(options.height, options.tileSize)),
+                       "--seed",
+                       std::to_string(options.seed)};
+
+  std::vector<uint32_t> workerCounts = {static_cast<uint32_t>(options.workers)};
+  if(options.scaling)
+  {
+    workerCounts.clear();
+    for(uint32_t count = 1; count < static_cast<uint32_t>(options.workers); count *= 2)
+      workerCounts.push_back(count);
+    workerCounts.push_back(static_cast<uint32_t>(options.workers));
+  }
+
+  std::vector<TileCoordinator::Result> results;
+  for(uint32_t count : workerCounts)
+  {
+    settings.spawnCount = count;
+    settings.resume     = options.resume && !options.scaling;  // Each run of the scaling renders all the tiles
+
+    TileCoordinator::Result result;
+    if(!TileCoordinator::run(settings, result))
+    {
+      LOGE("The distributed rendering of %s failed\n", output.c_str());
+      return 1;
+    }
+    for(const auto& worker : result.workers)
+      LOGI("  %-24s %5u tiles, busy %.1f ms\n", worker.name.c_str(), worker.tiles, worker.busyMs);
+    results.push_back(result);
+  }
+
+  LOGI("Workers  Startup (ms)  Wall (ms)  Speedup  Efficiency  Utilization\n");
+  for(const auto& result : results)
+  {
+    const double workers = static_cast<double>(result.workers.size());
+    const double base    = options.scaling ? results[0].wallMs : result.busyMs();
+    const double speedup = result.wallMs > 0.0 ? base / result.wallMs : 0.0;
+    LOGI("%7zu  %12.1f  %9.1f  %7.2f  %9.1f%%  %10.1f%%\n", result.workers.size(), result.startupMs, result.wallMs,
+         speedup, 100.0 * speedup / workers, 100.0 * result.utilization());
+  }
+  LOGI("Rendered %dx%d in tiles of %d to %s\n", options.width, options.height, options.tileSize, output.c_str());
+  return 0;
+}
+
+
+//--------------------------------------------------------------------------------------------------
+// #Server - Renders the queued jobs one after the other, with the scene, the acceleration structures
+// and the pipelines created once at startup. Each job starts from the default camera and the
+// settings of the command line, and only resizes the offscreen images when its size differs from
+// the previous job, which must fit in maxImageDimension2D. The image is written before the reply, so
+// the file is complete when the client reads it.
+//
+// #Distributed - A job with a tile renders it as renderTiled() does, the offscreen image being one
+// tile, and writes it in place in the output created by the coordinator (see tile_coordinator.hpp).
+//
+static int runServer(HelloVulkan&     helloVk,
+                     VkPhysicalDevice physicalDevice,
+                     uint32_t         queueFamily,
+                     const Options&   options,
+                     double           startupMs)
+{
+  glm::vec4 clearColor = glm::vec4(1, 1, 1, 1.00f);
+
+  // The offscreen image is the whole image, or one tile of it
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  const uint32_t maxImageSize = properties.limits.maxImageDimension2D;
+
+  JobServer server;
+  if(!server.start(options.socket))
+    return 1;
+  LOGI("Ready after %.1f ms, reading jobs from %s\n", startupMs, options.socket.empty() ? "stdin" : options.socket.c_str());
+
+  const nvh::CameraManipulator::Camera defaultCamera = CameraManip.getCamera();
+  nvvk::CommandPool                    cmdPool(helloVk.getDevice(), queueFamily);
+  RenderJob                            job;
+  uint32_t                             jobCount = 0;
+  TileFile                             tileFile;  // Output of the last tile job
+  std::string                          tileLayout;
+  while(server.pop(job))
+  {
+    auto start = std::chrono::steady_clock::now();
+
+    auto replyError = [&](const std::string& error) {
+      server.reply(job, "{\"id\": " + JobServer::quote(job.id) + ", \"output\": " + JobServer::quote(job.output)
+                            + ", \"status\": \"error\", \"error\": " + JobServer::quote(error) + "}");
+    };
+
+    const bool tiled = job.tile >= 0;
+    VkExtent2D renderSize{static_cast<uint32_t>(job.width > 0 ? job.width : options.width),
+                          static_cast<uint32_t>(job.height > 0 ? job.height : options.height)};
+    VkExtent2D size = tiled ? VkExtent2D{std::min(renderSize.width, static_cast<uint32_t>(job.tileSize)),
+                                         std::min(renderSize.height, static_cast<uint32_t>(job.tileSize))} :
+                              renderSize;
+    if(size.width > maxImageSize || size.height > maxImageSize)
+    {
+      replyError("larger than the maximum image size of the device, " + std::to_string(maxImageSize)
+                 + (tiled ? ", use a smaller tile size" : ", render it in tiles"));
+      continue;
+    }
+    if(tiled)
+    {
+      // The file stays open for the next tiles of the same image
+      const uint32_t    tileSize = static_cast<uint32_t>(job.tileSize);
+      const std::string layout   = job.output + " " + std::to_string(renderSize.width) + " "
+                                 + std::to_string(renderSize.height) + " " + std::to_string(tileSize);
+      if(layout != tileLayout)
+      {
+        tileFile.close();
+        tileLayout = tileFile.attach(job.output, renderSize.width, renderSize.height, tileSize) ? layout : "";
+      }
+      if(tileLayout.empty() || static_cast<size_t>(job.tile) >= tileFile.getTiles().size())
+      {
+        replyError("no such tile in the output");
+        continue;
+      }
+      const TileFile::Tile& tile = tileFile.getTiles()[job.tile];
+      helloVk.m_tileOffset       = {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)};
+    }
+    else
+    {
+      helloVk.m_tileOffset = {0, 0};
+    }
+    helloVk.m_renderSize = tiled ? renderSize : VkExtent2D{0, 0};
+    if(size.width != helloVk.getSize().width || size.height != helloVk.getSize().height)
+      helloVk.resizeHeadless(size);
+    CameraManip.setWindowSize(renderSize.width, renderSize.height);
+
+    nvh::CameraManipulator::Camera camera = defaultCamera;
+    if(job.hasCamera)
+    {
+      camera.eye = job.eye;
+      camera.ctr = job.center;
+      camera.up  = job.up;
+    }
+    CameraManip.setLookat(camera.eye, camera.ctr, camera.up, true);
+    CameraManip.setFov(job.fov > 0.f ? job.fov : camera.fov);
+
+    helloVk.m_seed = job.hasSeed ? job.seed : options.seed;
+    helloVk.resetFrame();
+
+    int frames = options.frames;
+    if(job.frames > 0)
+      frames = job.frames;
+    else if(job.spp > 0)
+      frames = (job.spp + helloVk.m_pcRay.samplesPerFrame - 1) / helloVk.m_pcRay.samplesPerFrame;
+
+    for(int frame = 0; frame < frames; frame++)
+    {
+      VkCommandBuffer cmdBuf = cmdPool.createCommandBuffer();
+      helloVk.updateUniformBuffer(cmdBuf);
+      helloVk.raytrace(cmdBuf, clearColor);
+      cmdPool.submitAndWait(cmdBuf);
+    }
+    auto renderEnd = std::chrono::steady_clock::now();
+    bool written   = tiled ? saveTile(helloVk, cmdPool, tileFile, job.tile) : helloVk.saveImage(job.output);
+    auto end       = std::chrono::steady_clock::now();
+
+    using Ms = std::chrono::duration<double, std::milli>;
+    char times[256];
+    snprintf(times, sizeof(times),
+             "\"width\": %u, \"height\": %u, \"frames\": %d, \"queueMs\": %.3f, \"renderMs\": %.3f, \"writeMs\": %.3f",
+             size.width, size.height, frames, Ms(start - job.received).count(), Ms(renderEnd - start).count(),
+             Ms(end - renderEnd).count());
+    if(written)
+    {
+      server.reply(job, "{\"id\": " + JobServer::quote(job.id) + ", \"output\": " + JobServer::quote(job.output)
+                            + ", \"status\": \"done\", " + times + "}");
+    }
+    else
+      replyError("could not write the image");
+    jobCount++;
+  }
+
+  server.stop();
+  tileFile.close();
+  LOGI("%u jobs rendered\n", jobCount);
+  return 0;
+}
 
 
 //--------------------------------------------------------------------------------------------------
@@ -80,23 +950,34 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
+  auto    startupStart = std::chrono::steady_clock::now();
+  Options options;
+  if(!parseOptions(argc, argv, options))
+    return 1;
 
-  // Setup GLFW window
-  glfwSetErrorCallback(onErrorCallback);
-  if(!glfwInit())
+  // #Distributed - The coordinator does not render
+  if(options.workers > 0 || !options.connect.empty())
+    return renderDistributed(options, argv[0]);
+
+  // Setup GLFW window, unless rendering headless
+  GLFWwindow* window = nullptr;
+  if(!options.headless)
   {
-    return 1;
+    glfwSetErrorCallback(onErrorCallback);
+    if(!glfwInit())
+    {
+      return 1;
+    }
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    window = glfwCreateWindow(options.width, options.height, PROJECT_NAME, nullptr, nullptr);
   }
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  GLFWwindow* window = glfwCreateWindow(SAMPLE_WIDTH, SAMPLE_HEIGHT, PROJECT_NAME, nullptr, nullptr);
 
   // Setup camera
-  CameraManip.setWindowSize(SAMPLE_WIDTH, SAMPLE_HEIGHT);
+  CameraManip.setWindowSize(options.width, options.height);
   CameraManip.setLookat(glm::vec3(0, 0, 15), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
 
   // Setup Vulkan
-  if(!glfwVulkanSupported())
+  if(!options.headless && !glfwVulkanSupported())
   {
     printf("GLFW: Vulkan Not Supported\n");
     return 1;
@@ -112,18 +993,19 @@ int main(int argc, char** argv)
       std::string(PROJECT_NAME),
   };
 
-  // Vulkan required extensions
-  assert(glfwVulkanSupported() == 1);
-  uint32_t count{0};
-  auto     reqExtensions = glfwGetRequiredInstanceExtensions(&count);
-
   // Requesting Vulkan extensions and layers
   nvvk::ContextCreateInfo contextInfo;
-  contextInfo.setVersion(1, 2);                       // Using Vulkan 1.2
-  for(uint32_t ext_id = 0; ext_id < count; ext_id++)  // Adding required extensions (surface, win32, linux, ..)
-    contextInfo.addInstanceExtension(reqExtensions[ext_id]);
+  contextInfo.setVersion(1, 2);  // Using Vulkan 1.2
+  if(!options.headless)
+  {
+    // Vulkan required extensions
+    uint32_t count{0};
+    auto     reqExtensions = glfwGetRequiredInstanceExtensions(&count);
+    for(uint32_t ext_id = 0; ext_id < count; ext_id++)  // Adding required extensions (surface, win32, linux, ..)
+      contextInfo.addInstanceExtension(reqExtensions[ext_id]);
+    contextInfo.addDeviceExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);  // Enabling ability to present rendering
+  }
   contextInfo.addInstanceExtension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, true);  // Allow debug names
-  contextInfo.addDeviceExtension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);            // Enabling ability to present rendering
 
   // #VKRay: Activate the ray tracing extension
   VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
@@ -133,36 +1015,54 @@ int main(int argc, char** argv)
   contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);  // Required by ray tracing pipeline
   contextInfo.addDeviceExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
 
-  VkPhysicalDeviceShaderClockFeaturesKHR clockFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR};
-  contextInfo.addDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME, false, &clockFeature);
-
   // Creating Vulkan base application
   nvvk::Context vkctx{};
   vkctx.initInstance(contextInfo);
   // Find all compatible devices
   auto compatibleDevices = vkctx.getCompatibleDevices(contextInfo);
-  assert(!compatibleDevices.empty());
+  if(compatibleDevices.empty())
+  {
+    LOGE("No Vulkan device supporting ray tracing\n");
+    return 1;
+  }
   // Use a compatible device
   vkctx.initDevice(compatibleDevices[0], contextInfo);
 
   // Create example
   HelloVulkan helloVk;
 
-  // Window need to be opened to get the surface on which to draw
-  const VkSurfaceKHR surface = helloVk.getVkSurface(vkctx.m_instance, window);
-  vkctx.setGCTQueueWithPresent(surface);
+  if(options.headless)
+  {
+    // No surface: any queue with graphics, compute and transfer
+    helloVk.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex);
+    VkExtent2D size{static_cast<uint32_t>(options.width), static_cast<uint32_t>(options.height)};
+    if(options.tileSize > 0)
+    {
+      // #Tiles - The offscreen image, and everything sized like it, is one tile
+      const uint32_t tileSize = static_cast<uint32_t>(options.tileSize);
+      helloVk.m_renderSize    = size;
+      size                    = {std::min(size.width, tileSize), std::min(size.height, tileSize)};
+    }
+    helloVk.setupHeadless(size);
+  }
+  else
+  {
+    // Window need to be opened to get the surface on which to draw
+    const VkSurfaceKHR surface = helloVk.getVkSurface(vkctx.m_instance, window);
+    vkctx.setGCTQueueWithPresent(surface);
 
-  helloVk.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex);
-  helloVk.createSwapchain(surface, SAMPLE_WIDTH, SAMPLE_HEIGHT);
-  helloVk.createDepthBuffer();
-  helloVk.createRenderPass();
-  helloVk.createFrameBuffers();
+    helloVk.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex);
+    helloVk.createSwapchain(surface, options.width, options.height);
+    helloVk.createDepthBuffer();
+    helloVk.createRenderPass();
+    helloVk.createFrameBuffers();
 
-  // Setup Imgui
-  helloVk.initGUI(0);  // Using sub-pass 0
+    // Setup Imgui
+    helloVk.initGUI(0);  // Using sub-pass 0
+  }
 
   // Creation of the example
-  helloVk.loadScene(nvh::findFile("media/scenes/cornellBox.gltf", defaultSearchPaths, true));
+  helloVk.loadScene(nvh::findFile(SCENE_FILE, defaultSearchPaths, true));
 
 
   helloVk.createOffscreenRender();
@@ -176,15 +1076,51 @@ int main(int argc, char** argv)
   helloVk.createBottomLevelAS();
   helloVk.createTopLevelAS();
   helloVk.createRtDescriptorSet();
+  helloVk.createAdaptivePipeline();
   helloVk.createRtPipeline();
+  helloVk.createRayBudget();
+
+  // Same seeds, same images
+  helloVk.m_seed = options.seed;
+
+  if(options.headless)
+  {
+    int result = 0;
+    if(options.serve)
+      result = runServer(helloVk, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex, options,
+                         std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count());
+    else if(!options.benchmark.empty())
+      result = runBenchmark(helloVk, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex, options);
+    else if(options.tileSize > 0)
+      result = renderTiled(helloVk, vkctx.m_queueGCT.familyIndex, options);
+    else
+      result = renderHeadless(helloVk, vkctx.m_queueGCT.queue, vkctx.m_queueGCT.familyIndex, options);
 
+    vkDeviceWaitIdle(helloVk.getDevice());
+    helloVk.destroyResources();
+    helloVk.destroy();
+    vkctx.deinit();
+    return result;
+  }
+
+  // The post-process draws in the swapchain render pass
   helloVk.createPostDescriptor();
   helloVk.createPostPipeline();
   helloVk.updatePostDescriptorSet();
 
 
-  glm::vec4 clearColor   = glm::vec4(1, 1, 1, 1.00f);
-  bool      useRaytracer = true;
+  glm::vec4  clearColor   = glm::vec4(1, 1, 1, 1.00f);
+  bool       useRaytracer = true;
+  CameraPath cameraPath;
+  bool       recordCamera = false;
+
+  // Recording every frame to disk
+  FrameWriter frameWriter;
+  bool        recordFrames = false;
+  int         frameFormat  = 0;  // PNG, EXR
+  int         frameIndex   = 0;
+  frameWriter.setup(helloVk.getDevice(), &helloVk.m_alloc, vkctx.m_queueGCT.familyIndex, options.readbackSlots,
+                    writerThreadCount(options));
 
 
   helloVk.setupGlfwCallbacks(window);
@@ -210,11 +1146,16 @@ int main(int argc, char** argv)
       if(ImGui::Checkbox("Ray Tracer mode", &useRaytracer))  // Switch between raster and ray tracing
         helloVk.resetFrame();
       renderUI(helloVk, useRaytracer);
+      renderCameraPathUI(cameraPath, recordCamera);
+      renderFrameWriterUI(frameWriter, recordFrames, frameFormat);
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
       ImGuiH::Control::Info("", "", "(F10) Toggle Pane", ImGuiH::Control::Flags::Disabled);
       ImGuiH::Panel::End();
     }
 
+    if(recordCamera)
+      cameraPath.cameras.push_back(CameraManip.getCamera());
+
     // Start rendering the scene
     helloVk.prepareFrame();
 
@@ -277,10 +1218,23 @@ int main(int argc, char** argv)
     // Submit for display
     vkEndCommandBuffer(cmdBuf);
     helloVk.submitFrame();
+
+    // Copying the image after the frame, encoded while the next ones render
+    if(recordFrames)
+    {
+      char filename[64];
+      snprintf(filename, sizeof(filename), "frame_%05d.%s", frameIndex++, frameFormat == 0 ? "png" : "exr");
+      frameWriter.write(vkctx.m_queueGCT.queue, helloVk.m_offscreenColor.image, helloVk.getSize(), filename);
+    }
+    else
+    {
+      frameWriter.poll();
+    }
   }
 
   // Cleanup
   vkDeviceWaitIdle(helloVk.getDevice());
+  frameWriter.destroy();
 
   helloVk.destroyResources();
   helloVk.destroy();
@@ -28,6 +28,7 @@
 using vec2 = glm::vec2;
 using vec3 = glm::vec3;
 using vec4 = glm::vec4;
+using ivec2 = glm::ivec2;
 using mat4 = glm::mat4;
 using uint = unsigned int;
 #endif
@@ -48,12 +49,18 @@ START_BINDING(SceneBindings)
 END_BINDING();
 
 START_BINDING(RtxBindings)
-  eTlas       = 0,  // Top-level acceleration structure
-  eOutImage   = 1,  // Ray tracer output image
-  ePrimLookup = 2   // Lookup of objects
+  eTlas        = 0,  // Top-level acceleration structure
+  eOutImage    = 1,  // Ray tracer output image
+  ePrimLookup  = 2,  // Lookup of objects
+  ePathStats   = 3,  // Path length counters, one entry per frame in flight
+  eVariance    = 4,  // Per-pixel sample count, luminance mean and M2
+  eActiveTiles = 5   // Indirect trace command and list of tiles not converged
 END_BINDING();
 // clang-format on
 
+// Size in pixels of the tiles of adaptive sampling (one work group of adaptive.comp)
+#define ADAPTIVE_TILE_SIZE 8
+
 // Scene buffer addresses
 struct SceneDesc
 {
@@ -63,6 +70,7 @@ struct SceneDesc
   uint64_t indexAddress;     // Address of the triangle indices buffer
   uint64_t materialAddress;  // Address of the Materials buffer (GltfShadeMaterial)
   uint64_t primInfoAddress;  // Address of the mesh primitives buffer (PrimMeshInfo)
+  uint64_t emissiveAddress;  // Address of the emissive triangles buffer (EmissiveTriangle)
 };
 
 // Uniform buffer set at each frame
@@ -88,11 +96,43 @@ struct PushConstantRaster
 // Push constant structure for the ray tracer
 struct PushConstantRay
 {
-  vec4  clearColor;
-  vec3  lightPosition;
-  float lightIntensity;
-  int   lightType;
-  int   frame;
+  vec4     clearColor;
+  vec3     lightPosition;
+  float    lightIntensity;
+  int      lightType;
+  int      frame;
+  int      maxDepth;            // Maximum number of segments of a path
+  int      rrMinDepth;          // Depth from which Russian roulette can terminate a path
+  float    rrMaxSurvival;       // Upper bound of the survival probability
+  uint     statsSlot;           // Entry of the PathStats buffer written this frame
+  int      emissiveCount;       // Number of emissive triangles sampled by next-event estimation, 0 to disable it
+  float    emissivePower;       // Sum of the power of all emissive triangles
+  float    adaptiveThreshold;   // Relative error under which a pixel stops receiving samples, 0 to disable
+  int      adaptiveMinSamples;  // Samples a pixel receives before it can be considered converged
+  uint     samplerType;         // SAMPLER_RANDOM, SAMPLER_SOBOL or SAMPLER_BLUE_NOISE
+  uint64_t samplerTables;       // Address of the tables of common/shaders/sampler.glsl
+  int      samplesPerFrame;     // Paths traced per pixel in one launch
+  uint     seed;                // Random seed of the frame, derived from a fixed base and the frame number
+  ivec2    tileOffset;          // Position of the output image in the rendered image, see #Tiles
+  ivec2    renderSize;          // Size of the rendered image, larger than the output image when tiling
+};
+
+// Counters filled by the path tracer, used to report the average path length
+struct PathStats
+{
+  uint rayCount;      // Number of rays traced (sum of all path lengths)
+  uint pathCount;     // Number of paths started
+  uint activePixels;  // Pixels above the error threshold
+  uint activeTiles;   // Tiles traced by adaptive sampling
+};
+
+// Header of the eActiveTiles buffer, followed by the list of active tiles (x | y << 16)
+struct AdaptiveDispatch
+{
+  uint width;   // VkTraceRaysIndirectCommandKHR: pixels of a tile
+  uint height;  // number of active tiles
+  uint depth;   // 1
+  uint pad;
 };
 
 // Structure used for retrieving the primitive information in the closest hit
@@ -110,4 +150,15 @@ struct GltfShadeMaterial
   int  pbrBaseColorTexture;
 };
 
+// Emissive triangle in world space, with its entry of the power-weighted alias table
+struct EmissiveTriangle
+{
+  vec3  v0;
+  vec3  v1;
+  vec3  v2;
+  vec3  emission;  // emissiveFactor of the material
+  float prob;      // Probability to keep this triangle when its entry is picked
+  uint  alias;     // Triangle to use otherwise
+};
+
 #endif
@@ -17,12 +17,15 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include "../../common/shaders/sampler.glsl"
+
 struct hitPayload
 {
-  vec3 hitValue;
-  uint seed;
-  uint depth;
-  vec3 rayOrigin;
-  vec3 rayDirection;
-  vec3 weight;
+  vec3         hitValue;
+  SamplerState rng;  // Random, Sobol or blue-noise numbers of the path
+  uint         depth;
+  vec3         rayOrigin;
+  vec3         rayDirection;
+  vec3         weight;
+  float        bsdfPdf;  // Solid angle pdf of the direction sampled at the previous hit
 };
@@ -57,14 +57,14 @@ float rnd(inout uint prev)
 // Sampling
 //-------------------------------------------------------------------------------------------------
 
-// Randomly samples from a cosine-weighted hemisphere oriented in the `z` direction.
+// Samples a cosine-weighted hemisphere oriented in the `z` direction, from two numbers in [0, 1).
 // From Ray Tracing Gems section 16.6.1, "Cosine-Weighted Hemisphere Oriented to the Z-Axis"
-vec3 samplingHemisphere(inout uint seed, in vec3 x, in vec3 y, in vec3 z)
+vec3 samplingHemisphere(in vec2 u, in vec3 x, in vec3 y, in vec3 z)
 {
 #define M_PI 3.14159265
 
-  float r1 = rnd(seed);
-  float r2 = rnd(seed);
+  float r1 = u.x;
+  float r2 = u.y;
   float sq = sqrt(r1);
 
   vec3 direction = vec3(cos(2 * M_PI * r2) * sq, sin(2 * M_PI * r2) * sq, sqrt(1. - r1));
@@ -73,6 +73,37 @@ vec3 samplingHemisphere(inout uint seed, in vec3 x, in vec3 y, in vec3 z)
   return direction;
 }
 
+// Uniformly samples a point on the triangle (v0, v1, v2), from two numbers in [0, 1).
+// From Ray Tracing Gems section 16.5.2.1, "Triangles"
+vec3 samplingTriangle(in vec2 u, in vec3 v0, in vec3 v1, in vec3 v2)
+{
+  float su0 = sqrt(u.x);
+  float b0  = 1.0 - su0;
+  float b1  = u.y * su0;
+
+  return v0 * b0 + v1 * b1 + v2 * (1.0 - b0 - b1);
+}
+
+// Power heuristic (beta = 2) of multiple importance sampling, weight of the strategy of pdf `pdfA`
+float powerHeuristic(float pdfA, float pdfB)
+{
+  float a = pdfA * pdfA;
+  float b = pdfB * pdfB;
+  return a / max(a + b, 1e-20);
+}
+
+// Luminance of a linear RGB color, used to weight the emissive triangles
+float luminance(vec3 color)
+{
+  return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+//-------------------------------------------------------------------------------------------------
+// Adaptive sampling: welfordUpdate() and isConverged()
+//-------------------------------------------------------------------------------------------------
+
+#include "../../common/shaders/adaptive_sampling.glsl"
+
 // Return the tangent and binormal from the incoming normal
 void createCoordinateSystem(in vec3 N, out vec3 Nt, out vec3 Nb)
 {
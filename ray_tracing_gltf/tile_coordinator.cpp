@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "tile_coordinator.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "job_server.hpp"
+#include "nvh/nvprint.hpp"
+#include "tile_file.hpp"
+
+#ifndef _WIN32
+extern char** environ;
+#endif
+
+double TileCoordinator::Result::busyMs() const
+{
+  double busy = 0.0;
+  for(const auto& worker : workers)
+    busy += worker.busyMs;
+  return busy;
+}
+
+double TileCoordinator::Result::utilization() const
+{
+  return workers.empty() || wallMs <= 0.0 ? 0.0 : busyMs() / (workers.size() * wallMs);
+}
+
+#ifdef _WIN32
+
+bool TileCoordinator::run(const Settings&, Result&)
+{
+  LOGE("Distributing the tiles to worker processes is not supported on this platform\n");
+  return false;
+}
+
+#else
+
+namespace {
+
+struct Worker
+{
+  std::string         name;
+  pid_t               pid{-1};
+  int                 in{-1};   // Jobs, written by the coordinator
+  int                 out{-1};  // Replies and log messages, read by the coordinator
+  std::string         pending;  // Start of a line not received completely
+  std::vector<size_t> tiles;    // Given and not done
+  bool                ready{false};
+  bool                alive{true};
+  uint32_t            done{0};
+  double              busyMs{0.0};
+};
+
+void closeWorker(Worker& worker)
+{
+  if(worker.in >= 0)
+    close(worker.in);
+  if(worker.out >= 0 && worker.out != worker.in)
+    close(worker.out);
+  worker.in    = -1;
+  worker.out   = -1;
+  worker.alive = false;
+}
+
+bool sendLine(Worker& worker, const std::string& line)
+{
+  std::string data = line + "\n";
+  for(size_t sent = 0; sent < data.size();)
+  {
+    ssize_t result = write(worker.in, data.data() + sent, data.size() - sent);
+    if(result <= 0)
+      return false;
+    sent += static_cast<size_t>(result);
+  }
+  return true;
+}
+
+// The pipes are not inherited by the workers started later, only by their own worker as 0 and 1
+bool spawnWorker(const std::vector<std::string>& command, Worker& worker)
+{
+  int toWorker[2], fromWorker[2];
+  if(pipe(toWorker) != 0)
+    return false;
+  if(pipe(fromWorker) != 0)
+  {
+    close(toWorker[0]);
+    close(toWorker[1]);
+    return false;
+  }
+  for(int fd : {toWorker[0], toWorker[1], fromWorker[0], fromWorker[1]})
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, toWorker[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, fromWorker[1], STDOUT_FILENO);
+
+  std::vector<char*> argv;
+  for(const auto& arg : command)
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+  int result = posix_spawnp(&worker.pid, argv[0], &actions, nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+
+  close(toWorker[0]);
+  close(fromWorker[1]);
+  worker.in  = toWorker[1];
+  worker.out = fromWorker[0];
+  if(result != 0)
+  {
+    LOGE("Could not start %s: %s\n", command[0].c_str(), strerror(result));
+    closeWorker(worker);
+    return false;
+  }
+  return true;
+}
+
+bool connectWorker(const std::string& path, Worker& worker)
+{
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+  {
+    LOGE("Could not connect to %s: %s\n", path.c_str(), strerror(errno));
+    if(fd >= 0)
+      close(fd);
+    return false;
+  }
+  worker.in  = fd;
+  worker.out = fd;
+  return true;
+}
+
+std::string tileJob(const TileCoordinator::Settings& settings, size_t tile)
+{
+  return "{\"id\": \"" + std::to_string(tile) + "\", \"output\": " + JobServer::quote(settings.output)
+         + ", \"width\": " + std::to_string(settings.width) + ", \"height\": " + std::to_string(settings.height)
+         + ", \"tileSize\": " + std::to_string(settings.tileSize) + ", \"tile\": " + std::to_string(tile)
+         + ", \"frames\": " + std::to_string(settings.frames) + ", \"seed\": " + std::to_string(settings.seed) + "}";
+}
+
+double number(const std::map<std::string, JsonValue>& members, const char* name)
+{
+  auto found = members.find(name);
+  return found != members.end() && found->second.type == JsonValue::Type::eNumber ? found->second.number : 0.0;
+}
+
+std::string text(const std::map<std::string, JsonValue>& members, const char* name)
+{
+  auto found = members.find(name);
+  return found != members.end() && found->second.type == JsonValue::Type::eString ? found->second.text : std::string();
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// All the workers are waited for before the first tile, so the wall time does not include the
+// loading of the scene. A tile which fails twice stops the rendering.
+//
+bool TileCoordinator::run(const Settings& settings, Result& result)
+{
+  using Clock = std::chrono::steady_clock;
+  using Ms    = std::chrono::duration<double, std::milli>;
+  result      = Result();
+
+  // A worker which exits while a job is written to it must not end the coordinator
+  std::signal(SIGPIPE, SIG_IGN);
+
+  TileFile file;
+  if(!file.open(settings.output, settings.width, settings.height, settings.tileSize, settings.resume))
+  {
+    LOGE("Could not open %s\n", settings.output.c_str());
+    return false;
+  }
+  std::deque<size_t> queue;
+  for(size_t tile = 0; tile < file.getTiles().size(); tile++)
+  {
+    if(!file.isDone(tile))
+      queue.push_back(tile);
+  }
+
+  auto                start = Clock::now();
+  std::vector<Worker> workers;
+  for(uint32_t i = 0; i < settings.spawnCount; i++)
+  {
+    Worker worker;
+    worker.name = "worker " + std::to_string(i);
+    if(spawnWorker(settings.command, worker))
+      workers.push_back(std::move(worker));
+  }
+  for(const auto& path : settings.sockets)
+  {
+    Worker worker;
+    worker.name = path;
+    if(connectWorker(path, worker))
+      workers.push_back(std::move(worker));
+  }
+  for(auto& worker : workers)
+  {
+    if(!sendLine(worker, "{\"id\": \"ping\", \"ping\": true}"))
+      closeWorker(worker);
+  }
+
+  std::map<size_t, int> failures;
+  bool                  ok        = true;
+  bool                  rendering = false;
+  size_t                given     = 0;  // Tiles given and not done
+  Clock::time_point     renderStart;
+
+  auto dropWorker = [&](Worker& worker) {
+    if(!worker.tiles.empty())
+      LOGW("%s stopped, %zu of its tiles given to the others\n", worker.name.c_str(), worker.tiles.size());
+    for(size_t tile : worker.tiles)
+      queue.push_front(tile);
+    given -= worker.tiles.size();
+    worker.tiles.clear();
+    closeWorker(worker);
+  };
+  while(ok && (!queue.empty() || given > 0))
+  {
+    std::vector<pollfd>  fds;
+    std::vector<Worker*> polled;
+    bool                 allReady = true;
+    for(auto& worker : workers)
+    {
+      if(!worker.alive)
+        continue;
+      fds.push_back({worker.out, POLLIN, 0});
+      polled.push_back(&worker);
+      allReady = allReady && worker.ready;
+    }
+    if(polled.empty())
+    {
+      LOGE("No worker left, %zu tiles not rendered\n", queue.size() + given);
+      ok = false;
+      break;
+    }
+
+    // Handing out the tiles, once every worker loaded the scene
+    if(allReady && !rendering)
+    {
+      rendering        = true;
+      renderStart      = Clock::now();
+      result.startupMs = Ms(renderStart - start).count();
+      LOGI("%zu workers ready in %.1f ms, rendering %zu tiles\n", polled.size(), result.startupMs, queue.size());
+    }
+    for(Worker* worker : polled)
+    {
+      while(rendering && worker->alive && worker->tiles.size() < settings.tilesInFlight && !queue.empty())
+      {
+        size_t tile = queue.front();
+        if(!sendLine(*worker, tileJob(settings, tile)))
+        {
+          dropWorker(*worker);
+          break;
+        }
+        queue.pop_front();
+        worker->tiles.push_back(tile);
+        given++;
+      }
+    }
+
+    if(poll(fds.data(), fds.size(), -1) < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      ok = false;
+      break;
+    }
+
+    for(size_t i = 0; i < fds.size(); i++)
+    {
+      Worker& worker = *polled[i];
+      if(!worker.alive || fds[i].revents == 0)
+        continue;
+
+      char    buffer[4096];
+      ssize_t received = read(worker.out, buffer, sizeof(buffer));
+      if(received <= 0)
+      {
+        if(received < 0 && errno == EINTR)
+          continue;
+        LOGW("%s exited\n", worker.name.c_str());
+        dropWorker(worker);
+        continue;
+      }
+      worker.pending.append(buffer, static_cast<size_t>(received));
+
+      size_t newline;
+      while((newline = worker.pending.find('\n')) != std::string::npos)
+      {
+        std::string line = worker.pending.substr(0, newline);
+        worker.pending.erase(0, newline + 1);
+        if(line.empty() || line[0] != '{')
+        {
+          LOGI("[%s] %s\n", worker.name.c_str(), line.c_str());  // Log message of the worker
+          continue;
+        }
+
+        std::map<std::string, JsonValue> members;
+        std::string                      error;
+        if(!JobServer::parseObject(line, members, error))
+        {
+          LOGW("[%s] Invalid reply: %s\n", worker.name.c_str(), error.c_str());
+          continue;
+        }
+        const std::string status = text(members, "status");
+        const std::string id     = text(members, "id");
+        if(status == "ready")
+        {
+          worker.ready = true;
+          continue;
+        }
+
+        auto found = std::find_if(worker.tiles.begin(), worker.tiles.end(),
+                                  [&](size_t tile) { return std::to_string(tile) == id; });
+        if(found == worker.tiles.end())
+        {
+          LOGW("[%s] Reply to a job it was not given: %s\n", worker.name.c_str(), line.c_str());
+          continue;
+        }
+        const size_t tile = *found;
+        worker.tiles.erase(found);
+        given--;
+
+        if(status == "done" && file.markDone(tile))
+        {
+          worker.done++;
+          worker.busyMs += number(members, "renderMs") + number(members, "writeMs");
+          result.tiles++;
+        }
+        else
+        {
+          LOGE("[%s] Tile %zu failed: %s\n", worker.name.c_str(), tile, text(members, "error").c_str());
+          if(++failures[tile] >= 2)
+            ok = false;
+          queue.push_back(tile);
+        }
+      }
+    }
+  }
+  result.wallMs = rendering ? Ms(Clock::now() - renderStart).count() : 0.0;
+
+  // The spawned workers end with their stdin, the servers keep running for other clients
+  for(auto& worker : workers)
+  {
+    closeWorker(worker);
+    if(worker.pid > 0)
+      waitpid(worker.pid, nullptr, 0);
+    result.workers.push_back({worker.name, worker.done, worker.busyMs});
+  }
+
+  ok = file.close() && ok;
+  if(ok && file.getDoneCount() != file.getTiles().size())
+    ok = false;
+  return ok;
+}
+
+#endif
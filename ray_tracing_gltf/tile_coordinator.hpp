@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Renders the tiles of a TileFile with several worker processes, each one a job server (--serve)
+// which loaded the scene once.
+//
+// The coordinator creates the output and its journal, and does not use the GPU. Workers are
+// started with their jobs on stdin and their replies on stdout, or are servers already listening
+// on a Unix domain socket. The tiles wait in one queue and each worker is given a new tile as soon
+// as one of its own is done, keeping `tilesInFlight` tiles per worker so it never waits for the
+// coordinator: fast workers and cheap tiles take more of the image. A worker writes its tiles in
+// place in the output; the coordinator records them in the journal, so an interrupted rendering can
+// be resumed. The tiles of a worker which exits are given to the others.
+//
+// Usage:
+//   TileCoordinator::Settings settings;  // Output, size, tile size, frames, workers
+//   TileCoordinator::Result   result;
+//   TileCoordinator::run(settings, result);
+//
+class TileCoordinator
+{
+public:
+  struct Settings
+  {
+    std::string              output;  // `.exr`
+    uint32_t                 width{0};
+    uint32_t                 height{0};
+    uint32_t                 tileSize{0};
+    int                      frames{0};
+    uint32_t                 seed{0};
+    bool                     resume{false};
+    std::vector<std::string> command;  // Program and arguments of a worker reading its jobs on stdin
+    uint32_t                 spawnCount{0};
+    std::vector<std::string> sockets;  // Paths of servers already running
+    uint32_t                 tilesInFlight{2};
+  };
+
+  struct WorkerStats
+  {
+    std::string name;
+    uint32_t    tiles{0};
+    double      busyMs{0.0};  // Render and write time of its tiles, as replied
+  };
+
+  struct Result
+  {
+    double                   startupMs{0.0};  // Until all the workers answered, scene loading included
+    double                   wallMs{0.0};     // From then to the last tile
+    uint32_t                 tiles{0};        // Rendered by this run, not the ones resumed
+    std::vector<WorkerStats> workers;
+
+    double busyMs() const;       // Of all the workers: the time of one worker without overhead
+    double utilization() const;  // busyMs / (workers * wallMs)
+  };
+
+  static bool run(const Settings& settings, Result& result);
+};
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+#include "tile_file.hpp"
+
+#include <algorithm>
+
+#include "frame_writer.hpp"
+#include "nvh/nvprint.hpp"
+
+namespace {
+
+// The files of large images exceed 2 GB: 64-bit offsets
+bool seek(FILE* file, uint64_t offset)
+{
+#ifdef _WIN32
+  return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+uint64_t getFileSize(FILE* file)
+{
+#ifdef _WIN32
+  _fseeki64(file, 0, SEEK_END);
+  return static_cast<uint64_t>(_ftelli64(file));
+#else
+  fseeko(file, 0, SEEK_END);
+  return static_cast<uint64_t>(ftello(file));
+#endif
+}
+
+}  // namespace
+
+
+//--------------------------------------------------------------------------------------------------
+// Tiles in rows from the top, so the tiles written one after the other share scanlines
+//
+void TileFile::layout(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize)
+{
+  m_filename   = filename;
+  m_width      = width;
+  m_height     = height;
+  m_tileSize   = tileSize;
+  m_dataOffset = FrameWriter::exrHeader(width, height).size();
+
+  m_tiles.clear();
+  for(uint32_t y = 0; y < height; y += tileSize)
+  {
+    for(uint32_t x = 0; x < width; x += tileSize)
+      m_tiles.push_back({x, y, std::min(tileSize, width - x), std::min(tileSize, height - y)});
+  }
+  m_done.assign(m_tiles.size(), 0);
+}
+
+uint64_t TileFile::fileSize() const
+{
+  return m_dataOffset + uint64_t(m_height) * (2 * sizeof(int32_t) + uint64_t(m_width) * 4 * sizeof(float));
+}
+
+bool TileFile::open(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize, bool resume)
+{
+  layout(filename, width, height, tileSize);
+  const std::vector<uint8_t> header = FrameWriter::exrHeader(width, height);
+
+  if(resume)
+  {
+    FILE* journal = fopen((m_filename + ".tiles").c_str(), "r");
+    if(journal != nullptr)
+      return reopen(journal);
+    LOGI("No tiles of %s to resume, starting the image\n", m_filename.c_str());
+  }
+  return create(header);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Writing the header and the header of every scanline. The pixels are left to the tiles: the
+// space between the scanline headers is not written (a sparse file on most file systems).
+//
+bool TileFile::create(const std::vector<uint8_t>& header)
+{
+  m_file = fopen(m_filename.c_str(), "w+b");
+  if(m_file == nullptr)
+    return false;
+
+  const uint32_t lineBytes = m_width * 4 * sizeof(float);
+  bool           ok        = fwrite(header.data(), header.size(), 1, m_file) == 1;
+  for(uint32_t y = 0; y < m_height && ok; y++)
+  {
+    const int32_t lineHeader[2] = {static_cast<int32_t>(y), static_cast<int32_t>(lineBytes)};
+    ok = seek(m_file, m_dataOffset + uint64_t(y) * (sizeof(lineHeader) + lineBytes))
+         && fwrite(lineHeader, sizeof(lineHeader), 1, m_file) == 1;
+  }
+
+  // Extending the file to its full size, with the last byte of the last scanline
+  ok = ok && seek(m_file, fileSize() - 1) && fputc(0, m_file) != EOF && fflush(m_file) == 0;
+
+  m_journal = fopen((m_filename + ".tiles").c_str(), "w");
+  ok        = ok && m_journal != nullptr && fprintf(m_journal, "TileFile %u %u %u\n", m_width, m_height, m_tileSize) > 0
+       && fflush(m_journal) == 0;
+  if(!ok)
+    close();
+  return ok;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The journal must describe the same tiling, and the file must have the size of the image
+//
+bool TileFile::reopen(FILE* journal)
+{
+  uint32_t width = 0, height = 0, tileSize = 0;
+  bool     same  = fscanf(journal, "TileFile %u %u %u", &width, &height, &tileSize) == 3 && width == m_width
+             && height == m_height && tileSize == m_tileSize;
+  size_t tile = 0;
+  while(same && fscanf(journal, "%zu", &tile) == 1)
+  {
+    if(tile < m_done.size())
+      m_done[tile] = 1;
+  }
+  fclose(journal);
+  if(!same)
+  {
+    LOGE("The tiles of %s are from a different size or tile size, cannot resume\n", m_filename.c_str());
+    return false;
+  }
+
+  m_file = fopen(m_filename.c_str(), "r+b");
+  if(m_file == nullptr || getFileSize(m_file) != fileSize())
+  {
+    LOGE("%s is missing or does not have the size of the image, cannot resume\n", m_filename.c_str());
+    close();
+    return false;
+  }
+
+  m_journal = fopen((m_filename + ".tiles").c_str(), "a");
+  if(m_journal == nullptr)
+  {
+    close();
+    return false;
+  }
+  LOGI("Resuming %s: %zu of %zu tiles already written\n", m_filename.c_str(), getDoneCount(), m_tiles.size());
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The file must have been created with the same size, the tiling gives the same tiles
+//
+bool TileFile::attach(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize)
+{
+  layout(filename, width, height, tileSize);
+  m_file = fopen(m_filename.c_str(), "r+b");
+  if(m_file == nullptr || getFileSize(m_file) != fileSize())
+  {
+    LOGE("%s is missing or does not have the size of the image\n", m_filename.c_str());
+    close();
+    return false;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// The tile is added to the journal only once its pixels are written
+//
+bool TileFile::write(size_t tile, const float* pixels, uint32_t rowLength)
+{
+  if(m_file == nullptr || tile >= m_tiles.size())
+    return false;
+
+  const Tile&        t         = m_tiles[tile];
+  const uint64_t     lineBytes = uint64_t(m_width) * 4 * sizeof(float);
+  std::vector<float> plane(t.width);
+  bool               ok = true;
+  for(uint32_t row = 0; row < t.height && ok; row++)
+  {
+    const float*   src    = pixels + size_t(row) * rowLength * 4;
+    const uint64_t planes = m_dataOffset + uint64_t(t.y + row) * (2 * sizeof(int32_t) + lineBytes) + 2 * sizeof(int32_t);
+    for(uint32_t c = 0; c < 4 && ok; c++)
+    {
+      for(uint32_t x = 0; x < t.width; x++)
+        plane[x] = src[x * 4 + 3 - c];  // RGBA to planes A, B, G, R
+      ok = seek(m_file, planes + (uint64_t(c) * m_width + t.x) * sizeof(float))
+           && fwrite(plane.data(), t.width * sizeof(float), 1, m_file) == 1;
+    }
+  }
+  ok = ok && fflush(m_file) == 0;
+  return ok && markDone(tile);
+}
+
+bool TileFile::markDone(size_t tile)
+{
+  if(tile >= m_tiles.size())
+    return false;
+  bool ok      = m_journal == nullptr || (fprintf(m_journal, "%zu\n", tile) > 0 && fflush(m_journal) == 0);
+  m_done[tile] = m_done[tile] != 0 || ok;
+  return ok;
+}
+
+size_t TileFile::getDoneCount() const
+{
+  return static_cast<size_t>(std::count(m_done.begin(), m_done.end(), uint8_t(1)));
+}
+
+//--------------------------------------------------------------------------------------------------
+// The journal is kept while tiles are missing, to resume later
+//
+bool TileFile::close()
+{
+  const bool journaled = m_journal != nullptr;
+  bool       ok        = true;
+  if(m_file != nullptr)
+    ok = fclose(m_file) == 0;
+  if(m_journal != nullptr)
+    ok = fclose(m_journal) == 0 && ok;
+  m_file    = nullptr;
+  m_journal = nullptr;
+
+  if(ok && journaled && !m_tiles.empty() && getDoneCount() == m_tiles.size())
+    remove((m_filename + ".tiles").c_str());
+  return ok;
+}
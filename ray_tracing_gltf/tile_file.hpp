@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Image written one tile at a time, for images too large to be held in memory.
+//
+// The file is an uncompressed OpenEXR of the full size (see FrameWriter::exrHeader), created with
+// all its scanlines when opened, and each tile is written in place: every row of every channel
+// with one seek. The tiles which reached the disk are appended to a journal, `<filename>.tiles`,
+// so a rendering which was interrupted can be resumed with the tiles missing from it. The journal
+// is removed once all the tiles are written.
+//
+// With several processes, one of them opens the file and keeps the journal, the others attach to
+// it and write the tiles they are given; markDone() records them in the journal.
+//
+// Usage:
+//   file.open("huge.exr", 16384, 16384, 1024, resume);
+//   for(size_t i = 0; i < file.getTiles().size(); i++)
+//     if(!file.isDone(i))
+//       file.write(i, pixels, tileSize);  // RGBA32F
+//   file.close();
+//
+class TileFile
+{
+public:
+  struct Tile
+  {
+    uint32_t x, y;           // Position in the image
+    uint32_t width, height;  // Smaller than the tile size on the last row and column
+  };
+
+  // Creates the file, or with `resume`, continues the file of the same size and tile size
+  bool open(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize, bool resume);
+  // Writes in the file created by open() in another process, without journal
+  bool attach(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize);
+  bool close();
+
+  // `pixels` are RGBA32F rows of `rowLength` pixels, of which the tile uses the top left corner
+  bool write(size_t tile, const float* pixels, uint32_t rowLength);
+  // Adds a tile written by another process to the journal
+  bool markDone(size_t tile);
+
+  const std::string&       getFilename() const { return m_filename; }
+  const std::vector<Tile>& getTiles() const { return m_tiles; }
+  bool                     isDone(size_t tile) const { return m_done[tile] != 0; }
+  size_t                   getDoneCount() const;
+
+private:
+  void     layout(const std::string& filename, uint32_t width, uint32_t height, uint32_t tileSize);
+  bool     create(const std::vector<uint8_t>& header);
+  bool     reopen(FILE* journal);
+  uint64_t fileSize() const;
+
+  std::string          m_filename;
+  uint32_t             m_width{0};
+  uint32_t             m_height{0};
+  uint32_t             m_tileSize{0};
+  uint64_t             m_dataOffset{0};  // Offset of the first scanline
+  std::vector<Tile>    m_tiles;
+  std::vector<uint8_t> m_done;  // Bytes, not bits: write() may mark a tile on a thread while others are read
+  FILE*                m_file{nullptr};
+  FILE*                m_journal{nullptr};
+};
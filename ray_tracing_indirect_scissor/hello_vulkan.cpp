@@ -18,6 +18,8 @@
  */
 
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 
@@ -403,8 +405,20 @@ void HelloVulkan::destroyResources()
   vkDestroyDescriptorPool(m_device, m_lanternIndirectDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_lanternIndirectDescSetLayout, nullptr);
   vkDestroyPipeline(m_device, m_lanternIndirectCompPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_lanternTilesCompPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_lanternResolveCompPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_lanternIndirectCompPipelineLayout, nullptr);
+  vkDestroyPipeline(m_device, m_lanternHiZCompPipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_lanternHiZCompPipelineLayout, nullptr);
   m_alloc.destroy(m_lanternIndirectBuffer);
+  m_alloc.destroy(m_lanternTileCounts);
+  m_alloc.destroy(m_lanternTileLists);
+  m_alloc.destroy(m_lanternTileReadback);
+  m_alloc.destroy(m_lanternBatchBuffer);
+  m_alloc.destroy(m_lanternBlockBuffer);
+  m_alloc.destroy(m_lanternLightBuffer);
+  m_alloc.destroy(m_lanternBatchReadback);
+  m_alloc.destroy(m_lanternHiZBuffer);
   m_alloc.destroy(m_lanternVertexBuffer);
   m_alloc.destroy(m_lanternIndexBuffer);
 
@@ -449,8 +463,10 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
 void HelloVulkan::onResize(int /*w*/, int /*h*/)
 {
   createOffscreenRender();
+  createLanternScreenBuffers();
   updatePostDescriptorSet();
   updateRtDescriptorSet();
+  updateLanternIndirectDescriptorSet();
 }
 
 
@@ -877,6 +893,15 @@ void HelloVulkan::createRtDescriptorSet()
   // Lantern buffer
   m_rtDescSetLayoutBind.addBinding(eLanterns, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
                                    VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  // Lanterns of each screen tile
+  m_rtDescSetLayoutBind.addBinding(eLanternTileCounts, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  m_rtDescSetLayoutBind.addBinding(eLanternTileLists, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  // Blocks of the batched lantern pass, and the light it accumulates
+  m_rtDescSetLayoutBind.addBinding(eLanternBlocks, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                   VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  m_rtDescSetLayoutBind.addBinding(eLanternLight, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR);
+  // Level 0 of the depth pyramid, written by the full-screen pass
+  m_rtDescSetLayoutBind.addBinding(eLanternHiZ, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR);
   assert(m_lanternCount > 0);
 
   m_rtDescPool      = m_rtDescSetLayoutBind.createPool(m_device);
@@ -895,11 +920,21 @@ void HelloVulkan::createRtDescriptorSet()
   descASInfo.pAccelerationStructures    = &tlas;
   VkDescriptorImageInfo imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
   VkDescriptorBufferInfo lanternBufferInfo{m_lanternIndirectBuffer.buffer, 0, m_lanternCount * sizeof(LanternIndirectEntry)};
+  VkDescriptorBufferInfo tileCountsInfo{m_lanternTileCounts.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo tileListsInfo{m_lanternTileLists.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo blocksInfo{m_lanternBlockBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo lightInfo{m_lanternLightBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo hizInfo{m_lanternHiZBuffer.buffer, 0, VK_WHOLE_SIZE};
 
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eTlas, &descASInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanterns, &lanternBufferInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternTileCounts, &tileCountsInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternTileLists, &tileListsInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternBlocks, &blocksInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternLight, &lightInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternHiZ, &hizInfo));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -912,8 +947,21 @@ void HelloVulkan::updateRtDescriptorSet()
 {
   // (1) Output buffer
   VkDescriptorImageInfo imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
-  VkWriteDescriptorSet  wds = m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo);
-  vkUpdateDescriptorSets(m_device, 1, &wds, 0, nullptr);
+  // (2) Lantern tiles, blocks, light and depth pyramid, sized with the screen
+  VkDescriptorBufferInfo tileCountsInfo{m_lanternTileCounts.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo tileListsInfo{m_lanternTileLists.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo blocksInfo{m_lanternBlockBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo lightInfo{m_lanternLightBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo hizInfo{m_lanternHiZBuffer.buffer, 0, VK_WHOLE_SIZE};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternTileCounts, &tileCountsInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternTileLists, &tileListsInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternBlocks, &blocksInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternLight, &lightInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, eLanternHiZ, &hizInfo));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 
@@ -1189,11 +1237,23 @@ void HelloVulkan::createRtShaderBindingTable()
 
 
 //--------------------------------------------------------------------------------------------------
-// The compute shader just needs read/write access to the buffer of LanternIndirectEntry.
+// The compute shaders need read/write access to the buffer of LanternIndirectEntry, the tile
+// binning to the lantern tile buffers, the batched pass to its header, blocks and depth pyramid,
+// and the resolve of its light to the output image.
 void HelloVulkan::createLanternIndirectDescriptorSet()
 {
   // Lantern buffer (binding = 0)
   m_lanternIndirectDescSetLayoutBind.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  // Lantern tile counters and lists (binding = 1, 2)
+  m_lanternIndirectDescSetLayoutBind.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  m_lanternIndirectDescSetLayoutBind.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  // Batch header with the visible lanterns, and blocks (binding = 3, 4)
+  m_lanternIndirectDescSetLayoutBind.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  m_lanternIndirectDescSetLayoutBind.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  // Depth pyramid, lantern light and output image (binding = 5, 6, 7)
+  m_lanternIndirectDescSetLayoutBind.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  m_lanternIndirectDescSetLayoutBind.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  m_lanternIndirectDescSetLayoutBind.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
 
   m_lanternIndirectDescPool      = m_lanternIndirectDescSetLayoutBind.createPool(m_device);
   m_lanternIndirectDescSetLayout = m_lanternIndirectDescSetLayoutBind.createLayout(m_device);
@@ -1207,9 +1267,34 @@ void HelloVulkan::createLanternIndirectDescriptorSet()
 
   assert(m_lanternIndirectBuffer.buffer);
   VkDescriptorBufferInfo lanternBufferInfo{m_lanternIndirectBuffer.buffer, 0, m_lanternCount * sizeof(LanternIndirectEntry)};
+  VkDescriptorBufferInfo batchInfo{m_lanternBatchBuffer.buffer, 0, VK_WHOLE_SIZE};
 
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 0, &lanternBufferInfo));
+  writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 3, &batchInfo));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+  updateLanternIndirectDescriptorSet();
+}
+
+// Writes the lantern buffers and output image, recreated when changing resolution.
+void HelloVulkan::updateLanternIndirectDescriptorSet()
+{
+  assert(m_lanternTileCounts.buffer && m_lanternTileLists.buffer && m_lanternBlockBuffer.buffer);
+  VkDescriptorBufferInfo tileCountsInfo{m_lanternTileCounts.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo tileListsInfo{m_lanternTileLists.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo blocksInfo{m_lanternBlockBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo hizInfo{m_lanternHiZBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo lightInfo{m_lanternLightBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorImageInfo  imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 1, &tileCountsInfo));
+  writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 2, &tileListsInfo));
+  writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 4, &blocksInfo));
+  writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 5, &hizInfo));
+  writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 6, &lightInfo));
+  writes.emplace_back(m_lanternIndirectDescSetLayoutBind.makeWrite(m_lanternIndirectDescSet, 7, &imageInfo));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -1241,8 +1326,29 @@ void HelloVulkan::createLanternIndirectCompPipeline()
   pipelineInfo.stage  = stageInfo;
   pipelineInfo.layout = m_lanternIndirectCompPipelineLayout;
   vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_lanternIndirectCompPipeline);
-
   vkDestroyShaderModule(m_device, computeShader, nullptr);
+
+  // Tile binning, same descriptor set and push constants.
+  pipelineInfo.stage.module =
+      nvvk::createShaderModule(m_device, nvh::loadFile("spv/lanternTiles.comp.spv", true, defaultSearchPaths, true));
+  vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_lanternTilesCompPipeline);
+  vkDestroyShaderModule(m_device, pipelineInfo.stage.module, nullptr);
+
+  // Resolve of the batched lantern light, same descriptor set and push constants.
+  pipelineInfo.stage.module =
+      nvvk::createShaderModule(m_device, nvh::loadFile("spv/lanternResolve.comp.spv", true, defaultSearchPaths, true));
+  vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_lanternResolveCompPipeline);
+  vkDestroyShaderModule(m_device, pipelineInfo.stage.module, nullptr);
+
+  // Depth pyramid levels, same descriptor set, the level to build in push constant.
+  VkPushConstantRange hizPushRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LanternHiZPushConstants)};
+  layoutInfo.pPushConstantRanges   = &hizPushRange;
+  vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_lanternHiZCompPipelineLayout);
+  pipelineInfo.layout = m_lanternHiZCompPipelineLayout;
+  pipelineInfo.stage.module =
+      nvvk::createShaderModule(m_device, nvh::loadFile("spv/lanternHiZ.comp.spv", true, defaultSearchPaths, true));
+  vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_lanternHiZCompPipeline);
+  vkDestroyShaderModule(m_device, pipelineInfo.stage.module, nullptr);
 }
 
 // Allocate the buffer used to pass lantern info + ray trace indirect parameters to ray tracer.
@@ -1259,18 +1365,119 @@ void HelloVulkan::createLanternIndirectBuffer()
   nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
   VkCommandBuffer   cmdBuf = cmdBufGet.createCommandBuffer();
 
-  using Usage             = VkBufferUsageFlagBits;
-  m_lanternIndirectBuffer = m_alloc.createBuffer(sizeof(LanternIndirectEntry) * m_lanternCount,
-                                                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-                                                     | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
+  // Uploaded through a staging buffer: vkCmdUpdateBuffer is limited to 64 KB, about 1200 lanterns.
   std::vector<LanternIndirectEntry> entries(m_lanternCount);
   for(size_t i = 0; i < m_lanternCount; ++i)
     entries[i].lantern = m_lanterns[i];
-  vkCmdUpdateBuffer(cmdBuf, m_lanternIndirectBuffer.buffer, 0, entries.size() * sizeof entries[0], entries.data());
+  m_lanternIndirectBuffer = m_alloc.createBuffer(cmdBuf, entries,
+                                                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                                                     | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
   cmdBufGet.submitAndWait(cmdBuf);
+  m_alloc.finalizeAndReleaseStaging();
+
+  // Batched lantern pass: the header, reset each frame, and room for all the lanterns being visible.
+  m_lanternBatchBuffer = m_alloc.createBuffer(sizeof(LanternBatch) + sizeof(uint32_t) * m_lanternCount,
+                                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                                  | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                                                  | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_debug.setObjectName(m_lanternBatchBuffer.buffer, "LanternBatch");
+
+  // Header copied back at each frame, read when the frame comes back.
+  VkDeviceSize          readbackSize = sizeof(LanternBatch) * m_swapChain.getImageCount();
+  VkMemoryPropertyFlags hostFlags    = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  m_lanternBatchReadback = m_alloc.createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostFlags);
+  memset(m_alloc.map(m_lanternBatchReadback), 0, readbackSize);
+  m_alloc.unmap(m_lanternBatchReadback);
+}
+
+// Allocate the lantern buffers sized with the resolution:
+// - the tiled lantern culling: a counter per screen tile (cleared each frame), its copy for the
+//   host, and room for LANTERN_TILE_MAX lantern indices per tile,
+// - the batched lantern pass: the blocks of the visible lanterns, and the light they add to each
+//   pixel, cleared here and then by lanternResolve.comp once added,
+// - the depth pyramid the lanterns are tested against.
+void HelloVulkan::createLanternScreenBuffers()
+{
+  m_alloc.destroy(m_lanternTileCounts);
+  m_alloc.destroy(m_lanternTileLists);
+  m_alloc.destroy(m_lanternTileReadback);
+  m_alloc.destroy(m_lanternBlockBuffer);
+  m_alloc.destroy(m_lanternLightBuffer);
+  m_alloc.destroy(m_lanternHiZBuffer);
+
+  uint32_t tilesX    = (m_size.width + LANTERN_TILE_SIZE - 1) / LANTERN_TILE_SIZE;
+  uint32_t tilesY    = (m_size.height + LANTERN_TILE_SIZE - 1) / LANTERN_TILE_SIZE;
+  m_lanternTileTotal = tilesX * tilesY;
+
+  m_lanternTileCounts = m_alloc.createBuffer(sizeof(uint32_t) * m_lanternTileTotal,
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                                                 | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_lanternTileLists  = m_alloc.createBuffer(sizeof(uint32_t) * m_lanternTileTotal * LANTERN_TILE_MAX,
+                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_debug.setObjectName(m_lanternTileCounts.buffer, "LanternTileCounts");
+  m_debug.setObjectName(m_lanternTileLists.buffer, "LanternTileLists");
+
+  VkDeviceSize          tileReadbackSize = sizeof(uint32_t) * m_lanternTileTotal * m_swapChain.getImageCount();
+  VkMemoryPropertyFlags hostFlags        = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  m_lanternTileReadback = m_alloc.createBuffer(tileReadbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostFlags);
+  memset(m_alloc.map(m_lanternTileReadback), 0, tileReadbackSize);
+  m_alloc.unmap(m_lanternTileReadback);
+  m_debug.setObjectName(m_lanternTileReadback.buffer, "LanternTileReadback");
+
+  // Lanterns overlapping each pixel 16 times on average before blocks are dropped. The launch height
+  // is clamped to the capacity, which keeps the rays of the lantern pass within the device limit.
+  uint32_t blocksX       = (m_size.width + LANTERN_BLOCK_SIZE - 1) / LANTERN_BLOCK_SIZE;
+  uint32_t blocksY       = (m_size.height + LANTERN_BLOCK_SIZE - 1) / LANTERN_BLOCK_SIZE;
+  m_lanternBlockCapacity = std::min(16 * blocksX * blocksY, m_rtProperties.maxRayDispatchInvocationCount
+                                                                / (LANTERN_BLOCK_SIZE * LANTERN_BLOCK_SIZE));
+
+  VkDeviceSize blockSize = sizeof(uint32_t) * 2 * m_lanternBlockCapacity;
+  VkDeviceSize lightSize = sizeof(uint32_t) * 3 * m_size.width * m_size.height;
+  m_lanternBlockBuffer   = m_alloc.createBuffer(blockSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_lanternLightBuffer   = m_alloc.createBuffer(lightSize,  //
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_debug.setObjectName(m_lanternBlockBuffer.buffer, "LanternBlocks");
+  m_debug.setObjectName(m_lanternLightBuffer.buffer, "LanternLight");
+
+  // Depth pyramid, each level half the previous one rounded up, down to 1x1 (LanternHiZ.glsl).
+  VkDeviceSize hizTexels = 0;
+  m_lanternHiZLevels     = 0;
+  for(uint32_t level = 0;; level++)
+  {
+    uint32_t levelX = std::max(1u, (m_size.width + (1u << level) - 1) >> level);
+    uint32_t levelY = std::max(1u, (m_size.height + (1u << level) - 1) >> level);
+    hizTexels += levelX * levelY;
+    m_lanternHiZLevels++;
+    if(levelX == 1 && levelY == 1)
+      break;
+  }
+  m_lanternHiZBuffer = m_alloc.createBuffer(sizeof(glm::vec2) * hizTexels, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_debug.setObjectName(m_lanternHiZBuffer.buffer, "LanternHiZ");
+
+  nvvk::CommandPool cmdBufGet(m_device, m_graphicsQueueIndex);
+  VkCommandBuffer   cmdBuf = cmdBufGet.createCommandBuffer();
+  vkCmdFillBuffer(cmdBuf, m_lanternLightBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+  cmdBufGet.submitAndWait(cmdBuf);
+}
+
+// Barrier on a whole buffer, without queue family transfer
+static VkBufferMemoryBarrier makeBufferBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+  VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = buffer;
+  barrier.offset              = 0;
+  barrier.size                = VK_WHOLE_SIZE;
+  return barrier;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -1279,35 +1486,39 @@ void HelloVulkan::createLanternIndirectBuffer()
 // The raytracing is split into multiple passes:
 //
 // First pass fills in the initial values for every pixel in the output image.
-// Illumination and shadow rays come from the main light.
+// Illumination and shadow rays come from the main light. It also writes the
+// depth of the pixels receiving the lantern light, the base of a depth pyramid.
 //
-// Subsequently, one lantern pass is run for each lantern in the scene. We run
-// a compute shader to calculate a bounding scissor rectangle for each lantern's light
-// effect. This is stored in m_lanternIndirectBuffer. Then an indirect trace rays command
-// is run for every lantern within its scissor rectangle. The lanterns' light
-// contribution is additively blended into the output image.
+// Then traceLanternBatch() runs a compute shader to calculate a bounding scissor
+// rectangle for each lantern's light effect, tightened against the depth pyramid,
+// and a single indirect trace rays command adds the light of all the lanterns.
+//
+// With m_lanternTiles, the same rectangles are instead used to bin the lanterns in screen
+// tiles, and the first pass adds the lanterns of each pixel's tile: a single trace pass.
 void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clearColor)
 {
-  // Before tracing rays, we need to dispatch the compute shaders that
-  // fill in the ray trace indirect parameters for each lantern pass.
-
-  // First, barrier before, ensure writes aren't visible to previous frame.
-  VkBufferMemoryBarrier bufferBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-  bufferBarrier.srcAccessMask       = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
-  bufferBarrier.dstAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
-  bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-  bufferBarrier.buffer              = m_lanternIndirectBuffer.buffer;
-  bufferBarrier.offset              = 0;
-  bufferBarrier.size                = m_lanternCount * sizeof m_lanterns[0];
-  vkCmdPipelineBarrier(cmdBuf,
-                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,   //
-                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
-                       VkDependencyFlags(0),                  //
-                       0, nullptr, 1, &bufferBarrier, 0, nullptr);
+  // Statistics of the batch recorded the last time this frame was used, now complete.
+  auto* readback      = static_cast<LanternBatch*>(m_alloc.map(m_lanternBatchReadback));
+  m_lanternBatchStats = readback[getCurFrame()];
+  m_alloc.unmap(m_lanternBatchReadback);
+
+  // Same for the tile counters, cleared once read: a slot not written since is not reported again.
+  auto* tileCounts       = static_cast<uint32_t*>(m_alloc.map(m_lanternTileReadback));
+  tileCounts += getCurFrame() * m_lanternTileTotal;
+  m_lanternTileOverflows = 0;
+  m_lanternTileDropped   = 0;
+  for(uint32_t tile = 0; tile < m_lanternTileTotal; tile++)
+  {
+    if(tileCounts[tile] > LANTERN_TILE_MAX)
+    {
+      m_lanternTileOverflows++;
+      m_lanternTileDropped += tileCounts[tile] - LANTERN_TILE_MAX;
+    }
+    tileCounts[tile] = 0;
+  }
+  m_alloc.unmap(m_lanternTileReadback);
 
-  // Bind compute shader, update push constant and descriptors, dispatch compute.
-  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternIndirectCompPipeline);
+  // Camera and screen for the lantern compute shaders.
   glm::mat4 view                              = getViewMatrix();
   m_lanternIndirectPushConstants.viewRowX     = glm::row(view, 0);
   m_lanternIndirectPushConstants.viewRowY     = glm::row(view, 1);
@@ -1317,34 +1528,83 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
   m_lanternIndirectPushConstants.screenX      = m_size.width;
   m_lanternIndirectPushConstants.screenY      = m_size.height;
   m_lanternIndirectPushConstants.lanternCount = int32_t(m_lanternCount);
-  vkCmdPushConstants(cmdBuf, m_lanternIndirectCompPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
-                     sizeof(LanternIndirectPushConstants), &m_lanternIndirectPushConstants);
-  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternIndirectCompPipelineLayout, 0, 1,
-                          &m_lanternIndirectDescSet, 0, nullptr);
-  vkCmdDispatch(cmdBuf, 1, 1, 1);
 
-  // Ensure compute results are visible when doing indirect ray trace.
-  bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-  bufferBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
-  vkCmdPipelineBarrier(cmdBuf,
-                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
-                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,   //
-                       VkDependencyFlags(0),                  //
-                       0, nullptr, 1, &bufferBarrier, 0, nullptr);
+  if(m_lanternTiles)
+  {
+    m_debug.beginLabel(cmdBuf, "Lantern tiles");
+
+    // The previous frame must be done reading the tiles, and copying the counters, before
+    // clearing the counters and writing the lists.
+    std::array<VkBufferMemoryBarrier, 2> tileBarriers{};
+    for(auto& barrier : tileBarriers)
+    {
+      barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+      barrier.srcAccessMask       = VK_ACCESS_SHADER_READ_BIT;
+      barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.size                = VK_WHOLE_SIZE;
+    }
+    tileBarriers[0].buffer = m_lanternTileCounts.buffer;
+    tileBarriers[1].buffer = m_lanternTileLists.buffer;
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT,  //
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,          //
+                         VkDependencyFlags(0),                                                   //
+                         0, nullptr, uint32_t(tileBarriers.size()), tileBarriers.data(), 0, nullptr);
+
+    vkCmdFillBuffer(cmdBuf, m_lanternTileCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+    tileBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    tileBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,        //
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
+                         VkDependencyFlags(0),                  //
+                         0, nullptr, 1, &tileBarriers[0], 0, nullptr);
+
+    // One thread per lantern, appending the lantern to the tiles covered by its rectangle.
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternTilesCompPipeline);
+    vkCmdPushConstants(cmdBuf, m_lanternIndirectCompPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(LanternIndirectPushConstants), &m_lanternIndirectPushConstants);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternIndirectCompPipelineLayout, 0, 1,
+                            &m_lanternIndirectDescSet, 0, nullptr);
+    vkCmdDispatch(cmdBuf, uint32_t((m_lanternCount + 63) / 64), 1, 1);
+
+    // Ensure the tiles are complete when the closest hit shader reads them, and the counters when
+    // they are copied for the host.
+    for(auto& barrier : tileBarriers)
+    {
+      barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+      barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    tileBarriers[0].dstAccessMask |= VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,                                          //
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_TRANSFER_BIT,  //
+                         VkDependencyFlags(0),                                                          //
+                         0, nullptr, uint32_t(tileBarriers.size()), tileBarriers.data(), 0, nullptr);
+
+    VkDeviceSize countsSize = sizeof(uint32_t) * m_lanternTileTotal;
+    VkBufferCopy countsCopy{0, countsSize * getCurFrame(), countsSize};
+    vkCmdCopyBuffer(cmdBuf, m_lanternTileCounts.buffer, m_lanternTileReadback.buffer, 1, &countsCopy);
+
+    m_debug.endLabel(cmdBuf);
+  }
 
 
   // Now move on to the actual ray tracing.
   m_debug.beginLabel(cmdBuf, "Ray trace");
 
   // Initialize push constant values
-  m_pcRay.clearColor        = clearColor;
-  m_pcRay.lightPosition     = m_pcRaster.lightPosition;
-  m_pcRay.lightIntensity    = m_pcRaster.lightIntensity;
-  m_pcRay.lightType         = m_pcRaster.lightType;
-  m_pcRay.lanternPassNumber = -1;  // Global non-lantern pass
-  m_pcRay.screenX           = m_size.width;
-  m_pcRay.screenY           = m_size.height;
-  m_pcRay.lanternDebug      = m_lanternDebug;
+  m_pcRay.clearColor     = clearColor;
+  m_pcRay.lightPosition  = m_pcRaster.lightPosition;
+  m_pcRay.lightIntensity = m_pcRaster.lightIntensity;
+  m_pcRay.lightType      = m_pcRaster.lightType;
+  m_pcRay.lanternPass    = 0;  // Full-screen pass
+  m_pcRay.screenX        = m_size.width;
+  m_pcRay.screenY        = m_size.height;
+  m_pcRay.lanternDebug   = m_lanternDebug;
+  m_pcRay.lanternTiles   = m_lanternTiles ? 1 : 0;
 
   std::vector<VkDescriptorSet> descSets{m_rtDescSet, m_descSet};
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
@@ -1354,44 +1614,176 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
                      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
                      0, sizeof(PushConstantRay), &m_pcRay);
 
+  // The depth pyramid of the previous frame must have been read before writing its level 0.
+  if(!m_lanternTiles)
+  {
+    VkBufferMemoryBarrier hizBarrier =
+        makeBufferBarrier(m_lanternHiZBuffer.buffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,          //
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,  //
+                         VkDependencyFlags(0),                          //
+                         0, nullptr, 1, &hizBarrier, 0, nullptr);
+  }
 
   vkCmdTraceRaysKHR(cmdBuf, &m_rgenRegion, &m_missRegion, &m_hitRegion, &m_callRegion, m_size.width, m_size.height, 1);
 
+  m_debug.endLabel(cmdBuf);
 
-  // Lantern passes, ensure previous pass completed, then add light contribution from each lantern.
-  for(int i = 0; i < static_cast<int>(m_lanternCount); ++i)
+  // Lantern pass, not needed with the tiles: the first pass already added the lanterns.
+  if(!m_lanternTiles)
   {
-    // Barrier to ensure previous pass finished.
-    VkImage offscreenImage{m_offscreenColor.image};
-    VkImageSubresourceRange colorRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
-    VkImageMemoryBarrier imageBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
-    imageBarrier.oldLayout           = VK_IMAGE_LAYOUT_GENERAL;
-    imageBarrier.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
-    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageBarrier.image               = offscreenImage;
-    imageBarrier.subresourceRange    = colorRange;
-    imageBarrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
-    imageBarrier.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT;
+    traceLanternBatch(cmdBuf);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Adds the light of the lanterns to the output image of the full-screen pass:
+// - the depth pyramid of the light receivers is built from the level 0 written by that pass,
+// - lanternIndirect.comp appends the visible lanterns and the blocks of pixels covering their
+//   rectangles, skipping the blocks without a receiver in the depth range of the light,
+// - a single indirect trace rays command traces all the blocks, the height of the launch being
+//   the number of blocks, and sums the light of the lanterns in m_lanternLightBuffer,
+// - lanternResolve.comp adds that sum to the output image.
+//
+void HelloVulkan::traceLanternBatch(const VkCommandBuffer& cmdBuf)
+{
+  if(m_lanternHiZ)
+  {
+    m_debug.beginLabel(cmdBuf, "Lantern Hi-Z");
+
+    // Level 0 comes from the full-screen pass, each other level from the previous one.
+    VkBufferMemoryBarrier hizBarrier = makeBufferBarrier(m_lanternHiZBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT,
+                                                         VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
     vkCmdPipelineBarrier(cmdBuf,
                          VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,  //
-                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,  //
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,          //
                          VkDependencyFlags(0),                          //
-                         0, nullptr, 0, nullptr, 1, &imageBarrier);
+                         0, nullptr, 1, &hizBarrier, 0, nullptr);
 
-    // Set lantern pass number.
-    m_pcRay.lanternPassNumber = i;
-    vkCmdPushConstants(cmdBuf, m_rtPipelineLayout,
-                       VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
-                       0, sizeof(PushConstantRay), &m_pcRay);
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternHiZCompPipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternHiZCompPipelineLayout, 0, 1,
+                            &m_lanternIndirectDescSet, 0, nullptr);
+    LanternHiZPushConstants hizPush{0, int32_t(m_size.width), int32_t(m_size.height)};
+    for(uint32_t level = 1; level < m_lanternHiZLevels; level++)
+    {
+      hizPush.level   = int32_t(level);
+      uint32_t levelX = std::max(1u, (m_size.width + (1u << level) - 1) >> level);
+      uint32_t levelY = std::max(1u, (m_size.height + (1u << level) - 1) >> level);
+      vkCmdPushConstants(cmdBuf, m_lanternHiZCompPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                         sizeof(LanternHiZPushConstants), &hizPush);
+      vkCmdDispatch(cmdBuf, (levelX + 15) / 16, (levelY + 15) / 16, 1);
+      vkCmdPipelineBarrier(cmdBuf,
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
+                           VkDependencyFlags(0),                  //
+                           0, nullptr, 1, &hizBarrier, 0, nullptr);
+    }
+
+    m_debug.endLabel(cmdBuf);
+  }
 
+  m_debug.beginLabel(cmdBuf, "Lantern batch");
 
-    VkDeviceAddress indirectDeviceAddress =
-        nvvk::getBufferDeviceAddress(m_device, m_lanternIndirectBuffer.buffer) + i * sizeof(LanternIndirectEntry);
+  // Before tracing rays, we need to dispatch the compute shader that fills in the
+  // lantern rectangles, the visible lanterns and their blocks.
 
-    // Execute lantern pass.
-    vkCmdTraceRaysIndirectKHR(cmdBuf, &m_rgenRegion, &m_missRegion, &m_hitRegion, &m_callRegion, indirectDeviceAddress);
+  // First, barrier before, ensure the previous frame is done reading the batch.
+  std::array<VkBufferMemoryBarrier, 3> batchBarriers{
+      makeBufferBarrier(m_lanternBatchBuffer.buffer, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+                        VK_ACCESS_TRANSFER_WRITE_BIT),
+      makeBufferBarrier(m_lanternBlockBuffer.buffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT),
+      makeBufferBarrier(m_lanternIndirectBuffer.buffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT)};
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR
+                           | VK_PIPELINE_STAGE_TRANSFER_BIT,                                    //
+                       VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
+                       VkDependencyFlags(0),                                                   //
+                       0, nullptr, uint32_t(batchBarriers.size()), batchBarriers.data(), 0, nullptr);
+
+  // Reset the header: no block and no visible lantern, and whether to test the depth pyramid.
+  LanternBatch emptyBatch;
+  emptyBatch.hizLevels = m_lanternHiZ ? m_lanternHiZLevels : 0;
+  vkCmdUpdateBuffer(cmdBuf, m_lanternBatchBuffer.buffer, 0, sizeof(LanternBatch), &emptyBatch);
+  batchBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  batchBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,        //
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
+                       VkDependencyFlags(0),                  //
+                       0, nullptr, 1, &batchBarriers[0], 0, nullptr);
+
+  // Bind compute shader, update push constant and descriptors, dispatch compute: one thread per lantern.
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternIndirectCompPipeline);
+  vkCmdPushConstants(cmdBuf, m_lanternIndirectCompPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(LanternIndirectPushConstants), &m_lanternIndirectPushConstants);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternIndirectCompPipelineLayout, 0, 1,
+                          &m_lanternIndirectDescSet, 0, nullptr);
+  vkCmdDispatch(cmdBuf, uint32_t((m_lanternCount + 127) / 128), 1, 1);
+
+  // Ensure compute results are visible when doing indirect ray trace, and to the copy of the header.
+  for(auto& barrier : batchBarriers)
+  {
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask =
+        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
   }
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,  //
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR
+                           | VK_PIPELINE_STAGE_TRANSFER_BIT,  //
+                       VkDependencyFlags(0),                  //
+                       0, nullptr, uint32_t(batchBarriers.size()), batchBarriers.data(), 0, nullptr);
+
+  VkBufferCopy statsCopy{0, sizeof(LanternBatch) * getCurFrame(), sizeof(LanternBatch)};
+  vkCmdCopyBuffer(cmdBuf, m_lanternBatchBuffer.buffer, m_lanternBatchReadback.buffer, 1, &statsCopy);
+
+  // Lantern pass: one launch row per block, the height is in the batch header. The light sum
+  // must have been cleared by the resolve of the previous frame.
+  VkBufferMemoryBarrier lightBarrier = makeBufferBarrier(m_lanternLightBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT,
+                                                         VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,          //
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,  //
+                       VkDependencyFlags(0),                          //
+                       0, nullptr, 1, &lightBarrier, 0, nullptr);
+
+  m_pcRay.lanternPass = 1;
+  vkCmdPushConstants(cmdBuf, m_rtPipelineLayout,
+                     VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
+                     0, sizeof(PushConstantRay), &m_pcRay);
+  VkDeviceAddress indirectDeviceAddress = nvvk::getBufferDeviceAddress(m_device, m_lanternBatchBuffer.buffer);
+  vkCmdTraceRaysIndirectKHR(cmdBuf, &m_rgenRegion, &m_missRegion, &m_hitRegion, &m_callRegion, indirectDeviceAddress);
+
+  // Resolve: the light summed by the lantern pass, and the image of the full-screen pass.
+  VkImageMemoryBarrier imageBarrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  imageBarrier.oldLayout           = VK_IMAGE_LAYOUT_GENERAL;
+  imageBarrier.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+  imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  imageBarrier.image               = m_offscreenColor.image;
+  imageBarrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  imageBarrier.srcAccessMask       = VK_ACCESS_SHADER_WRITE_BIT;
+  imageBarrier.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,  //
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,          //
+                       VkDependencyFlags(0),                          //
+                       0, nullptr, 1, &lightBarrier, 1, &imageBarrier);
+
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_lanternResolveCompPipeline);
+  vkCmdPushConstants(cmdBuf, m_lanternIndirectCompPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                     sizeof(LanternIndirectPushConstants), &m_lanternIndirectPushConstants);
+  vkCmdDispatch(cmdBuf, (m_size.width + 15) / 16, (m_size.height + 15) / 16, 1);
+
+  // The post-processing samples the image.
+  imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,   //
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,  //
+                       VkDependencyFlags(0),                   //
+                       0, nullptr, 0, nullptr, 1, &imageBarrier);
 
   m_debug.endLabel(cmdBuf);
 }
@@ -178,11 +178,14 @@ public:
   void updateRtDescriptorSet();
   void createRtPipeline();
   void createLanternIndirectDescriptorSet();
+  void updateLanternIndirectDescriptorSet();
   void createLanternIndirectCompPipeline();
   void createRtShaderBindingTable();
   void createLanternIndirectBuffer();
+  void createLanternScreenBuffers();
 
   void raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clearColor);
+  void traceLanternBatch(const VkCommandBuffer& cmdBuf);
 
   // Used to store lantern model, generated at runtime.
   const float                           m_lanternModelRadius = 0.125;
@@ -208,6 +211,10 @@ public:
   VkDescriptorSet                                   m_lanternIndirectDescSet;
   VkPipelineLayout                                  m_lanternIndirectCompPipelineLayout;
   VkPipeline                                        m_lanternIndirectCompPipeline;
+  VkPipeline                                        m_lanternTilesCompPipeline;
+  VkPipeline                                        m_lanternResolveCompPipeline;
+  VkPipelineLayout                                  m_lanternHiZCompPipelineLayout;
+  VkPipeline                                        m_lanternHiZCompPipeline;
 
   nvvk::Buffer                    m_rtSBTBuffer;
   VkStridedDeviceAddressRegionKHR m_rgenRegion{};
@@ -221,6 +228,46 @@ public:
   VkDeviceSize m_lanternCount = 0;  // Set to actual lantern count after TLAS build, as
                                     // that is the point no more lanterns may be added.
 
+  // Tiled lantern culling: instead of one ray trace pass per lantern, lanternTiles.comp bins
+  // the lanterns in screen tiles and the full-screen pass adds the lanterns of each pixel's tile.
+  // The buffers hold one counter, and LANTERN_TILE_MAX lantern indices, per tile of the screen.
+  // The counters go on past LANTERN_TILE_MAX, and are copied back to report the lanterns dropped.
+  bool         m_lanternTiles = true;
+  nvvk::Buffer m_lanternTileCounts;
+  nvvk::Buffer m_lanternTileLists;
+  nvvk::Buffer m_lanternTileReadback;       // m_lanternTileCounts of each frame in flight
+  uint32_t     m_lanternTileTotal     = 0;  // Number of tiles at the current resolution
+  uint32_t     m_lanternTileOverflows = 0;  // Tiles over LANTERN_TILE_MAX in the last frame read back
+  uint32_t     m_lanternTileDropped   = 0;  // Lanterns dropped from those tiles
+
+  // Batched lantern pass, without m_lanternTiles: lanternIndirect.comp appends the visible lanterns
+  // and the LANTERN_BLOCK_SIZE² blocks covering their rectangles, and a single indirect trace
+  // launches one row per block. Off-screen lanterns add neither a pass nor a barrier.
+  struct LanternBatch  // Header of m_lanternBatchBuffer, followed by visibleCount lantern indices
+  {
+    VkTraceRaysIndirectCommandKHR traceCommand{LANTERN_BLOCK_SIZE * LANTERN_BLOCK_SIZE, 0, 1};  // height: blocks
+    uint32_t                      visibleCount{0};
+    uint32_t                      hizLevels{0};        // Levels of m_lanternHiZBuffer to test, 0 without Hi-Z
+    uint32_t                      rectPixels{0};       // Pixels of the rectangles of the projected spheres
+    uint32_t                      tracedPixels{0};     // Pixels left to trace after the Hi-Z test
+    uint32_t                      hizCulled{0};        // Lanterns on screen rejected by the Hi-Z test
+    uint32_t                      requestedBlocks{0};  // Before clamping traceCommand.height to the capacity
+    uint32_t                      groupsDone{0};       // Work groups of lanternIndirect.comp finished
+  };
+  nvvk::Buffer m_lanternBatchBuffer;
+  nvvk::Buffer m_lanternBlockBuffer;          // Per block: lantern index, block x | y << 16
+  nvvk::Buffer m_lanternLightBuffer;          // Per pixel: RGB lantern light, fixed point
+  nvvk::Buffer m_lanternBatchReadback;        // LanternBatch of each frame in flight
+  uint32_t     m_lanternBlockCapacity = 0;    // Blocks of the batch, 16 times the blocks of the screen
+  LanternBatch m_lanternBatchStats;           // Last LanternBatch read back, for the UI
+
+  // Depth pyramid of the pixels receiving the lantern light, level 0 written by the full-screen
+  // pass, which now runs first in the batched mode. lanternIndirect.comp tests the lanterns against
+  // it to skip the blocks with nothing to light, and lanternResolve.comp adds the lantern light.
+  bool         m_lanternHiZ = true;
+  nvvk::Buffer m_lanternHiZBuffer;      // Min and max linear depth per texel, all levels (LanternHiZ.glsl)
+  uint32_t     m_lanternHiZLevels = 0;  // Down to 1x1 at the current resolution
+
   // Push constant for ray tracer.
   PushConstantRay m_pcRay{};
 
@@ -249,4 +296,12 @@ public:
     // Length of the LanternIndirectEntry array.
     int32_t lanternCount{};
   } m_lanternIndirectPushConstants;
+
+  // Push constant of lanternHiZ.comp, building one level of the depth pyramid.
+  struct LanternHiZPushConstants
+  {
+    int32_t level{};  // >= 1, level 0 comes from the full-screen pass
+    int32_t screenX{};
+    int32_t screenY{};
+  };
 };
@@ -22,7 +22,11 @@
 // pipeline If you are new to ImGui, see examples/README.txt and documentation
 // at the top of imgui.cpp.
 
+#include <algorithm>
 #include <array>
+#include <cstdlib>
+#include <cstring>
+#include <random>
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "backends/imgui_impl_glfw.h"
@@ -67,6 +71,42 @@ void renderUI(HelloVulkan& helloVk)
     ImGui::SliderFloat("Intensity", &helloVk.m_pcRaster.lightIntensity, 0.f, 150.f);
     ImGui::Checkbox("Lantern Debug", &helloVk.m_lanternDebug);
   }
+  if(ImGui::CollapsingHeader("Lanterns"))
+  {
+    ImGui::Text("%d lanterns", int(helloVk.m_lanternCount));
+    ImGui::Checkbox("Tiled culling", &helloVk.m_lanternTiles);  // Single pass, or a batched lantern pass
+    if(helloVk.m_lanternTiles && helloVk.m_lanternTileOverflows > 0)
+      ImGui::TextColored({1, 0.5f, 0, 1}, "%u tiles over %d lanterns, %u dropped", helloVk.m_lanternTileOverflows,
+                         LANTERN_TILE_MAX, helloVk.m_lanternTileDropped);
+    if(!helloVk.m_lanternTiles)
+    {
+      const HelloVulkan::LanternBatch& batch  = helloVk.m_lanternBatchStats;
+      uint32_t                         blocks = batch.requestedBlocks;
+      ImGui::Checkbox("Hi-Z occlusion", &helloVk.m_lanternHiZ);  // Test the lanterns against the depth pyramid
+      ImGui::Text("%u visible, %u blocks (%u launched)", batch.visibleCount, blocks,
+                  batch.traceCommand.height * batch.traceCommand.width);
+      if(blocks > helloVk.m_lanternBlockCapacity)
+        ImGui::TextColored({1, 0.5f, 0, 1}, "%u blocks dropped", blocks - helloVk.m_lanternBlockCapacity);
+
+      // Rays per lantern on screen, from the rectangles of the spheres, and after the Hi-Z test
+      uint32_t onScreen = std::max(1u, batch.visibleCount + batch.hizCulled);
+      ImGui::Text("%u culled by Hi-Z", batch.hizCulled);
+      ImGui::Text("Rays per lantern: %u -> %u", batch.rectPixels / onScreen, batch.tracedPixels / onScreen);
+    }
+  }
+}
+
+// Scattering `count` small random lanterns over the scene, to test the scaling with the number of lanterns
+void addRandomLanterns(HelloVulkan& helloVk, int count)
+{
+  std::mt19937                          rng(42);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  for(int i = 0; i < count; i++)
+  {
+    glm::vec3 position(uniform(rng) * 20.f - 10.f, 0.08f + uniform(rng) * 5.f, uniform(rng) * 20.f - 10.f);
+    glm::vec3 color(uniform(rng), uniform(rng), uniform(rng));
+    helloVk.addLantern(position, color, 0.2f + 0.3f * uniform(rng), 0.5f + 1.5f * uniform(rng));
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -81,7 +121,13 @@ static int const SAMPLE_HEIGHT = 720;
 //
 int main(int argc, char** argv)
 {
-  UNUSED(argc);
+  // --lanterns N : adds N random lanterns to the scene
+  int randomLanterns = 0;
+  for(int i = 1; i < argc - 1; i++)
+  {
+    if(strcmp(argv[i], "--lanterns") == 0)
+      randomLanterns = atoi(argv[++i]);
+  }
 
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
@@ -173,6 +219,7 @@ int main(int argc, char** argv)
   helloVk.addLantern({1.948f, 0.080f, 0.598f}, {1.0f, 1.0f, 1.0f}, 0.6f, 6.0f);
   helloVk.addLantern({-2.300f, 0.080f, 2.100f}, {0.0f, 0.7f, 0.0f}, 0.6f, 6.0f);
   helloVk.addLantern({-1.400f, 4.300f, 0.150f}, {1.0f, 1.0f, 0.0f}, 0.7f, 7.0f);
+  addRandomLanterns(helloVk, randomLanterns);
 
   helloVk.createOffscreenRender();
   helloVk.createDescriptorSetLayout();
@@ -186,6 +233,7 @@ int main(int argc, char** argv)
   helloVk.createBottomLevelAS();
   helloVk.createTopLevelAS();
   helloVk.createLanternIndirectBuffer();
+  helloVk.createLanternScreenBuffers();
   helloVk.createRtDescriptorSet();
   helloVk.createRtPipeline();
   helloVk.createLanternIndirectDescriptorSet();
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2019-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Depth pyramid (Hi-Z) of the pixels receiving the lantern light, stored in a buffer: level 0 has
+// one texel per pixel, written by the full-screen pass, and each level halves the previous one,
+// rounding up, until 1x1 (lanternHiZ.comp). A texel of level L covers 2^L x 2^L pixels and holds
+// the min and max linear depths of the receivers there. Texels without any receiver hold
+// HIZ_EMPTY, which overlaps no depth range and is neutral for the min and max.
+
+#ifndef LANTERN_HIZ_GLSL
+#define LANTERN_HIZ_GLSL
+
+#include "../../common/shaders/hiz_pyramid.glsl"
+
+const vec2 HIZ_EMPTY = vec2(1e30, -1e30);
+
+// True if depths in [depthLow, depthHigh] may be found in a texel holding `minMax`
+bool hizOverlaps(vec2 minMax, float depthLow, float depthHigh)
+{
+  return minMax.x <= depthHigh && minMax.y >= depthLow;
+}
+
+#endif
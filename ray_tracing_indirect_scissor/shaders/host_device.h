@@ -47,12 +47,30 @@ START_BINDING(SceneBindings)
 END_BINDING();
 
 START_BINDING(RtxBindings)
-  eTlas     = 0,  // Top-level acceleration structure
-  eOutImage = 1,  // Ray tracer output image
-  eLanterns = 2   // All lanterns
+  eTlas              = 0,  // Top-level acceleration structure
+  eOutImage          = 1,  // Ray tracer output image
+  eLanterns          = 2,  // All lanterns
+  eLanternTileCounts = 3,  // Lanterns binned in each screen tile
+  eLanternTileLists  = 4,  // LANTERN_TILE_MAX lantern indices per tile
+  eLanternBlocks     = 5,  // Screen blocks of the visible lanterns (batched lantern pass)
+  eLanternLight      = 6,  // Lantern light accumulated by the batched pass, in fixed point
+  eLanternHiZ        = 7   // Depth pyramid of the lantern light receivers
 END_BINDING();
 // clang-format on
 
+// Tiled lantern culling (lanternTiles.comp): the lanterns lighting each tile of
+// LANTERN_TILE_SIZE x LANTERN_TILE_SIZE pixels, at most LANTERN_TILE_MAX per tile
+#define LANTERN_TILE_SIZE 16
+#define LANTERN_TILE_MAX 128
+
+// Batched lantern pass (lanternIndirect.comp): the screen rectangle of each visible lantern is
+// split in blocks of LANTERN_BLOCK_SIZE x LANTERN_BLOCK_SIZE pixels, all traced by a single
+// indirect dispatch. The overlapping lanterns add their light with integer atomics, in fixed
+// point of 1 / LANTERN_LIGHT_SCALE, and lanternResolve.comp adds the sum to the image.
+#define LANTERN_BLOCK_SIZE 8
+#define LANTERN_BLOCK_LEVEL 3  // log2(LANTERN_BLOCK_SIZE): Hi-Z level with one texel per block
+#define LANTERN_LIGHT_SCALE 65536.0
+
 
 // Information of a obj model when referenced in a shader
 struct ObjDesc
@@ -91,10 +109,9 @@ struct PushConstantRay
   float lightIntensity;
   int   lightType;
 
-  // -1 if this is the full-screen pass. Otherwise, this pass is to add light
-  // from lantern number lanternPassNumber. We use this to lookup trace indirect
-  // parameters in m_lanternIndirectBuffer.
-  int lanternPassNumber;
+  // 0 if this is the full-screen pass, 1 for the batched pass adding the light
+  // of the visible lanterns, one launch row per block in m_lanternBlockBuffer.
+  int lanternPass;
 
   // Pixel dimensions of the output image.
   int screenX;
@@ -102,6 +119,10 @@ struct PushConstantRay
 
   // See m_lanternDebug.
   int lanternDebug;
+
+  // 1 if the full-screen pass also adds the light of the lanterns binned in the
+  // tile of each pixel (see m_lanternTiles), instead of one pass per lantern.
+  int lanternTiles;
 };
 
 struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for device
@@ -21,6 +21,7 @@
 
 struct hitPayload
 {
-  vec3 hitValue;
-  bool additiveBlending;
+  vec3  hitValue;
+  bool  additiveBlending;
+  float hitT;  // Distance of the OBJ hit, when additiveBlending
 };
@@ -18,10 +18,13 @@
  */
 
 
+#include <algorithm>
+#include <array>
 #include <sstream>
 
 
 #define STB_IMAGE_IMPLEMENTATION
+#include "cpu_profiler.h"
 #include "obj_loader.h"
 #include "stb_image.h"
 
@@ -52,6 +55,21 @@ void HelloVulkan::setup(const VkInstance& instance, const VkDevice& device, cons
   m_alloc.init(instance, device, physicalDevice);
   m_debug.setup(m_device);
   m_offscreenDepthFormat = nvvk::findDepthFormat(physicalDevice);
+
+  // The raster draws all instances with vkCmdDrawIndexedIndirect, as many per call as the device allows,
+  // and culls them with vkCmdDrawIndexedIndirectCount. The indirect draws index the instance data with
+  // their firstInstance, which needs drawIndirectFirstInstance: without it, each instance is a direct draw.
+  // nvvk::Context enables all the supported features, including multiDrawIndirect and drawIndirectCount.
+  VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2        features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  VkPhysicalDeviceProperties       properties{};
+  features.pNext = &features12;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  m_maxDrawIndirectCount  = features.features.multiDrawIndirect == VK_TRUE ? properties.limits.maxDrawIndirectCount : 1;
+  m_indirectFirstInstance = features.features.drawIndirectFirstInstance == VK_TRUE;
+  m_gpuCulling            = features.features.multiDrawIndirect == VK_TRUE && features12.drawIndirectCount == VK_TRUE
+                            && m_indirectFirstInstance;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -69,10 +87,12 @@ void HelloVulkan::updateUniformBuffer(const VkCommandBuffer& cmdBuf)
   hostUBO.viewProj    = proj * view;
   hostUBO.viewInverse = glm::inverse(view);
   hostUBO.projInverse = glm::inverse(proj);
+  m_viewProj          = hostUBO.viewProj;
 
   // UBO on the device, and what stages access it.
   VkBuffer deviceUBO      = m_bGlobals.buffer;
-  auto     uboUsageStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+  auto     uboUsageStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+                        | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
 
   // Ensure that the modified UBO is not visible to previous frames.
   VkBufferMemoryBarrier beforeBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
@@ -116,6 +136,8 @@ void HelloVulkan::createDescriptorSetLayout()
   // Textures
   m_descSetLayoutBind.addBinding(SceneBindings::eTextures, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nbTxt,
                                  VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+  // Raster instances
+  m_descSetLayoutBind.addBinding(SceneBindings::eInstances, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT);
 
 
   m_descSetLayout = m_descSetLayoutBind.createLayout(m_device);
@@ -137,6 +159,9 @@ void HelloVulkan::updateDescriptorSet()
   VkDescriptorBufferInfo dbiSceneDesc{m_bObjDesc.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eObjDescs, &dbiSceneDesc));
 
+  VkDescriptorBufferInfo dbiInstances{m_bRasterInstances.buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eInstances, &dbiInstances));
+
   // All texture samplers
   std::vector<VkDescriptorImageInfo> diit;
   for(auto& texture : m_textures)
@@ -155,7 +180,7 @@ void HelloVulkan::updateDescriptorSet()
 //
 void HelloVulkan::createGraphicsPipeline()
 {
-  VkPushConstantRange pushConstantRanges = {VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantRaster)};
+  VkPushConstantRange pushConstantRanges = {VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantRaster)};
 
   // Creating the Pipeline Layout
   VkPipelineLayoutCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
@@ -189,6 +214,7 @@ void HelloVulkan::createGraphicsPipeline()
 //
 void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
 {
+  CPU_ZONE("loadModel");
   LOGI("Loading File:  %s \n", filename.c_str());
   ObjLoader loader;
   loader.loadModel(filename);
@@ -204,6 +230,7 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   ObjModel model;
   model.nbIndices  = static_cast<uint32_t>(loader.m_indices.size());
   model.nbVertices = static_cast<uint32_t>(loader.m_vertices.size());
+  model.bounds     = glm::vec4(loader.m_boundsCenter, loader.m_boundsRadius);
 
   // Create the buffers on Device and copy vertices, indices and materials
   nvvk::CommandPool  cmdBufGet(m_device, m_graphicsQueueIndex);
@@ -211,8 +238,9 @@ void HelloVulkan::loadModel(const std::string& filename, glm::mat4 transform)
   VkBufferUsageFlags flag            = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
   VkBufferUsageFlags rayTracingFlags =  // used also for building acceleration structures
       flag | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-  model.vertexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_vertices, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | rayTracingFlags);
-  model.indexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_indices, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | rayTracingFlags);
+  VkBufferUsageFlags rasterFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;  // copied in the raster arena
+  model.vertexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_vertices, rasterFlags | rayTracingFlags);
+  model.indexBuffer  = m_alloc.createBuffer(cmdBuf, loader.m_indices, rasterFlags | rayTracingFlags);
   model.matColorBuffer = m_alloc.createBuffer(cmdBuf, loader.m_materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
   model.matIndexBuffer = m_alloc.createBuffer(cmdBuf, loader.m_matIndx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | flag);
   // Creates all textures found and find the offset for this model
@@ -275,11 +303,112 @@ void HelloVulkan::createObjDescriptionBuffer()
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Creating the buffers of the multi-draw-indirect raster
+// - The vertices and indices of all models are copied in one arena, so that a single
+//   vkCmdDrawIndexedIndirect draws all instances, whatever their model
+// - The transform and model of each instance are read by the vertex shader with gl_InstanceIndex
+//
+void HelloVulkan::createRasterDrawBuffers()
+{
+  // Location of each model in the arena
+  std::vector<uint32_t> firstIndex(m_objModel.size());
+  std::vector<int32_t>  vertexOffset(m_objModel.size());
+  uint32_t              nbIndices{0};
+  uint32_t              nbVertices{0};
+  for(size_t i = 0; i < m_objModel.size(); i++)
+  {
+    firstIndex[i]   = nbIndices;
+    vertexOffset[i] = static_cast<int32_t>(nbVertices);
+    nbIndices += m_objModel[i].nbIndices;
+    nbVertices += m_objModel[i].nbVertices;
+  }
+
+  // Bounding spheres, for the culling
+  std::vector<glm::vec4> bounds;
+  bounds.reserve(m_objModel.size());
+  for(const ObjModel& model : m_objModel)
+    bounds.push_back(model.bounds);
+
+  // One draw per instance, its firstInstance is the index of the instance data
+  std::vector<RasterInstance>               instances;
+  std::vector<VkDrawIndexedIndirectCommand> draws;
+  instances.reserve(m_instances.size());
+  draws.reserve(m_instances.size());
+  for(const HelloVulkan::ObjInstance& inst : m_instances)
+  {
+    VkDrawIndexedIndirectCommand draw{};
+    draw.indexCount    = m_objModel[inst.objIndex].nbIndices;
+    draw.instanceCount = 1;
+    draw.firstIndex    = firstIndex[inst.objIndex];
+    draw.vertexOffset  = vertexOffset[inst.objIndex];
+    draw.firstInstance = static_cast<uint32_t>(instances.size());
+    draws.push_back(draw);
+    instances.push_back({inst.transform, inst.objIndex});
+  }
+  m_rasterDrawCount = static_cast<uint32_t>(draws.size());
+  m_gpuCulling      = m_gpuCulling && m_rasterDrawCount <= m_maxDrawIndirectCount;
+  if(!m_indirectFirstInstance)
+    m_rasterDrawList = draws;
+
+  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+  auto              cmdBuf = cmdGen.createCommandBuffer();
+
+  // Copying the geometry of the models, already on the device, in the arena
+  VkDeviceSize vertexBytes = std::max<VkDeviceSize>(nbVertices, 1) * sizeof(VertexObj);
+  VkDeviceSize indexBytes  = std::max<VkDeviceSize>(nbIndices, 1) * sizeof(uint32_t);
+  m_bRasterVertices = m_alloc.createBuffer(vertexBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_bRasterIndices  = m_alloc.createBuffer(indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  for(size_t i = 0; i < m_objModel.size(); i++)
+  {
+    const ObjModel& model = m_objModel[i];
+    if(model.nbIndices == 0 || model.nbVertices == 0)
+      continue;
+    VkBufferCopy vertexCopy{0, vertexOffset[i] * sizeof(VertexObj), model.nbVertices * sizeof(VertexObj)};
+    VkBufferCopy indexCopy{0, firstIndex[i] * sizeof(uint32_t), model.nbIndices * sizeof(uint32_t)};
+    vkCmdCopyBuffer(cmdBuf, model.vertexBuffer.buffer, m_bRasterVertices.buffer, 1, &vertexCopy);
+    vkCmdCopyBuffer(cmdBuf, model.indexBuffer.buffer, m_bRasterIndices.buffer, 1, &indexCopy);
+  }
+
+  m_bRasterInstances = m_alloc.createBuffer(cmdBuf, instances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_bRasterDraws     = m_alloc.createBuffer(cmdBuf, draws, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_bRasterBounds    = m_alloc.createBuffer(cmdBuf, bounds, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  cmdGen.submitAndWait(cmdBuf);
+  m_alloc.finalizeAndReleaseStaging();
+
+  // Culling output, the draws of the visible instances and their count
+  VkDeviceSize drawBytes = std::max<size_t>(draws.size(), 1) * sizeof(VkDrawIndexedIndirectCommand);
+  m_bRasterVisibleDraws  = m_alloc.createBuffer(drawBytes,
+                                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  m_bRasterDrawCount = m_alloc.createBuffer(sizeof(uint32_t),
+                                            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                                | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  uint32_t frames       = m_swapChain.getImageCount();
+  m_bRasterCullReadback = m_alloc.createBuffer(frames * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  auto* readback = static_cast<uint32_t*>(m_alloc.map(m_bRasterCullReadback));
+  std::fill_n(readback, frames, m_rasterDrawCount);
+  m_alloc.unmap(m_bRasterCullReadback);
+
+  m_debug.setObjectName(m_bRasterVertices.buffer, "RasterVertices");
+  m_debug.setObjectName(m_bRasterIndices.buffer, "RasterIndices");
+  m_debug.setObjectName(m_bRasterInstances.buffer, "RasterInstances");
+  m_debug.setObjectName(m_bRasterDraws.buffer, "RasterDraws");
+  m_debug.setObjectName(m_bRasterBounds.buffer, "RasterBounds");
+  m_debug.setObjectName(m_bRasterVisibleDraws.buffer, "RasterVisibleDraws");
+  m_debug.setObjectName(m_bRasterDrawCount.buffer, "RasterDrawCount");
+}
+
 //--------------------------------------------------------------------------------------------------
 // Creating all textures and samplers
 //
 void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures)
 {
+  CPU_ZONE("createTextureImages");
   VkSamplerCreateInfo samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
   samplerCreateInfo.minFilter  = VK_FILTER_LINEAR;
   samplerCreateInfo.magFilter  = VK_FILTER_LINEAR;
@@ -317,7 +446,9 @@ void HelloVulkan::createTextureImages(const VkCommandBuffer& cmdBuf, const std::
       o << "media/textures/" << texture;
       std::string txtFile = nvh::findFile(o.str(), defaultSearchPaths, true);
 
+      CpuProfiler::begin("Texture decode");
       stbi_uc* stbi_pixels = stbi_load(txtFile.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+      CpuProfiler::end();
 
       std::array<stbi_uc, 4> color{255u, 0u, 255u, 255u};
 
@@ -360,6 +491,21 @@ void HelloVulkan::destroyResources()
 
   m_alloc.destroy(m_bGlobals);
   m_alloc.destroy(m_bObjDesc);
+  m_alloc.destroy(m_bRasterVertices);
+  m_alloc.destroy(m_bRasterIndices);
+  m_alloc.destroy(m_bRasterInstances);
+  m_alloc.destroy(m_bRasterDraws);
+  m_alloc.destroy(m_bRasterBounds);
+  m_alloc.destroy(m_bRasterVisibleDraws);
+  m_alloc.destroy(m_bRasterDrawCount);
+  m_alloc.destroy(m_bRasterCullReadback);
+  m_alloc.destroy(m_bHiZ);
+  vkDestroyPipeline(m_device, m_cullPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_hizPipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_cullPipelineLayout, nullptr);
+  vkDestroyPipelineLayout(m_device, m_hizPipelineLayout, nullptr);
+  vkDestroyDescriptorPool(m_device, m_cullDescPool, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_cullDescSetLayout, nullptr);
 
   for(auto& m : m_objModel)
   {
@@ -413,18 +559,264 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descSet, 0, nullptr);
 
 
-  for(const HelloVulkan::ObjInstance& inst : m_instances)
+  vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantRaster), &m_pcRaster);
+  vkCmdBindVertexBuffers(cmdBuf, 0, 1, &m_bRasterVertices.buffer, &offset);
+  vkCmdBindIndexBuffer(cmdBuf, m_bRasterIndices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+  const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  if(m_gpuCulling)
+  {
+    // The visible instances, compacted by cullRaster()
+    vkCmdDrawIndexedIndirectCount(cmdBuf, m_bRasterVisibleDraws.buffer, 0, m_bRasterDrawCount.buffer, 0,
+                                  m_rasterDrawCount, stride);
+  }
+  else if(!m_indirectFirstInstance)
+  {
+    // The indirect draws would all start at instance 0: the same draws, recorded one by one
+    for(const VkDrawIndexedIndirectCommand& draw : m_rasterDrawList)
+    {
+      vkCmdDrawIndexed(cmdBuf, draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset,
+                       draw.firstInstance);
+    }
+  }
+  else
+  {
+    // All instances in one call, unless the device limits the number of draws per call
+    for(uint32_t first = 0; first < m_rasterDrawCount; first += m_maxDrawIndirectCount)
+    {
+      uint32_t count = std::min(m_rasterDrawCount - first, m_maxDrawIndirectCount);
+      vkCmdDrawIndexedIndirect(cmdBuf, m_bRasterDraws.buffer, VkDeviceSize(first) * stride, count, stride);
+    }
+  }
+  m_debug.endLabel(cmdBuf);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// #Cull - GPU culling of the raster instances
+//////////////////////////////////////////////////////////////////////////
+
+static VkBufferMemoryBarrier makeBufferBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+  VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = buffer;
+  barrier.offset              = 0;
+  barrier.size                = VK_WHOLE_SIZE;
+  return barrier;
+}
+
+static VkImageMemoryBarrier makeDepthBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout,
+                                             VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+  VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = dstAccess;
+  barrier.oldLayout           = oldLayout;
+  barrier.newLayout           = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image               = image;
+  barrier.subresourceRange    = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
+  return barrier;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Creating the compute pipelines of the culling (raster_cull.comp) and of the Hi-Z (raster_hiz.comp),
+// sharing one descriptor set
+//
+void HelloVulkan::createCullPipelines()
+{
+  auto& bind = m_cullDescSetLayoutBind;
+  bind.addBinding(CullBindings::eCullGlobals, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  bind.addBinding(CullBindings::eCullInstances, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  bind.addBinding(CullBindings::eCullBounds, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  bind.addBinding(CullBindings::eCullDraws, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  bind.addBinding(CullBindings::eCullVisibleDraws, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  bind.addBinding(CullBindings::eCullDrawCount, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  bind.addBinding(CullBindings::eCullHiZ, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  bind.addBinding(CullBindings::eCullDepth, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+  m_cullDescSetLayout = bind.createLayout(m_device);
+  m_cullDescPool      = bind.createPool(m_device, 1);
+  m_cullDescSet       = nvvk::allocateDescriptorSet(m_device, m_cullDescPool, m_cullDescSetLayout);
+  updateCullDescriptorSet();
+
+  // Culling
+  VkPushConstantRange        cullPushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantCull)};
+  VkPipelineLayoutCreateInfo layoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  layoutInfo.setLayoutCount         = 1;
+  layoutInfo.pSetLayouts            = &m_cullDescSetLayout;
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges    = &cullPushRange;
+  vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_cullPipelineLayout);
+
+  VkComputePipelineCreateInfo pipelineInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.stage.module =
+      nvvk::createShaderModule(m_device, nvh::loadFile("spv/raster_cull.comp.spv", true, defaultSearchPaths, true));
+  pipelineInfo.layout = m_cullPipelineLayout;
+  vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_cullPipeline);
+  vkDestroyShaderModule(m_device, pipelineInfo.stage.module, nullptr);
+  m_debug.setObjectName(m_cullPipeline, "Cull");
+
+  // Hi-Z levels, the level to build in push constant
+  VkPushConstantRange hizPushRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantHiZ)};
+  layoutInfo.pPushConstantRanges = &hizPushRange;
+  vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_hizPipelineLayout);
+  pipelineInfo.stage.module =
+      nvvk::createShaderModule(m_device, nvh::loadFile("spv/raster_hiz.comp.spv", true, defaultSearchPaths, true));
+  pipelineInfo.layout = m_hizPipelineLayout;
+  vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_hizPipeline);
+  vkDestroyShaderModule(m_device, pipelineInfo.stage.module, nullptr);
+  m_debug.setObjectName(m_hizPipeline, "HiZ");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Writing the buffers of the culling, the depth buffer and the Hi-Z change with the resolution
+//
+void HelloVulkan::updateCullDescriptorSet()
+{
+  if(m_cullDescSet == VK_NULL_HANDLE)
+    return;
+
+  VkDescriptorBufferInfo globalsInfo{m_bGlobals.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo instancesInfo{m_bRasterInstances.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo boundsInfo{m_bRasterBounds.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo drawsInfo{m_bRasterDraws.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo visibleDrawsInfo{m_bRasterVisibleDraws.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo drawCountInfo{m_bRasterDrawCount.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo hizInfo{m_bHiZ.buffer, 0, VK_WHOLE_SIZE};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullGlobals, &globalsInfo));
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullInstances, &instancesInfo));
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullBounds, &boundsInfo));
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullDraws, &drawsInfo));
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullVisibleDraws, &visibleDrawsInfo));
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullDrawCount, &drawCountInfo));
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullHiZ, &hizInfo));
+  writes.emplace_back(m_cullDescSetLayoutBind.makeWrite(m_cullDescSet, CullBindings::eCullDepth, &m_offscreenDepth.descriptor));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compacting the draws of the instances in the view frustum and not hidden in the Hi-Z of the last
+// raster frame. Recorded before the raster render pass.
+//
+void HelloVulkan::cullRaster(const VkCommandBuffer& cmdBuf)
+{
+  if(!m_gpuCulling)
+    return;
+
+  // Count of the last frame which used this command buffer, it has completed
+  auto* readback       = static_cast<uint32_t*>(m_alloc.map(m_bRasterCullReadback));
+  m_rasterVisibleCount = readback[getCurFrame()];
+  m_alloc.unmap(m_bRasterCullReadback);
+
+  m_debug.beginLabel(cmdBuf, "Cull");
+
+  // The count and the draws may still be read by the previous frame
+  VkBufferMemoryBarrier countBarrier = makeBufferBarrier(m_bRasterDrawCount.buffer, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                                                         VK_ACCESS_TRANSFER_WRITE_BIT);
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &countBarrier, 0, nullptr);
+  vkCmdFillBuffer(cmdBuf, m_bRasterDrawCount.buffer, 0, sizeof(uint32_t), 0);
+
+  std::array<VkBufferMemoryBarrier, 3> beforeBarriers{
+      makeBufferBarrier(m_bRasterDrawCount.buffer, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+      makeBufferBarrier(m_bRasterVisibleDraws.buffer, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT),
+      makeBufferBarrier(m_bHiZ.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT)};
+  VkPipelineStageFlags beforeStages =
+      VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  vkCmdPipelineBarrier(cmdBuf, beforeStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr,
+                       static_cast<uint32_t>(beforeBarriers.size()), beforeBarriers.data(), 0, nullptr);
+
+  // Occlusion is tested with the camera of the Hi-Z, which is valid as the instances are static
+  PushConstantCull pcCull{};
+  pcCull.hizViewProj    = m_hizViewProj;
+  pcCull.instanceCount  = m_rasterDrawCount;
+  pcCull.hizLevels      = m_occlusionCulling && m_hizValid ? m_hizLevels : 0;
+  pcCull.hizWidth       = static_cast<int>(m_size.width);
+  pcCull.hizHeight      = static_cast<int>(m_size.height);
+  pcCull.frustumCulling = m_frustumCulling ? 1 : 0;
+
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1, &m_cullDescSet, 0, nullptr);
+  vkCmdPushConstants(cmdBuf, m_cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantCull), &pcCull);
+  vkCmdDispatch(cmdBuf, (m_rasterDrawCount + 63) / 64, 1, 1);
+
+  // Visible draws to the indirect draw, count to the indirect draw and the statistics
+  std::array<VkBufferMemoryBarrier, 2> afterBarriers{
+      makeBufferBarrier(m_bRasterDrawCount.buffer, VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT),
+      makeBufferBarrier(m_bRasterVisibleDraws.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT)};
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                       static_cast<uint32_t>(afterBarriers.size()), afterBarriers.data(), 0, nullptr);
+
+  VkBufferCopy region{0, getCurFrame() * sizeof(uint32_t), sizeof(uint32_t)};
+  vkCmdCopyBuffer(cmdBuf, m_bRasterDrawCount.buffer, m_bRasterCullReadback.buffer, 1, &region);
+  VkBufferMemoryBarrier hostBarrier =
+      makeBufferBarrier(m_bRasterCullReadback.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0,
+                       nullptr);
+
+  m_debug.endLabel(cmdBuf);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Building the Hi-Z from the depth buffer of the raster, for the culling of the next frames.
+// Recorded after the raster render pass.
+//
+void HelloVulkan::buildHiZ(const VkCommandBuffer& cmdBuf)
+{
+  if(!m_gpuCulling)
+    return;
+
+  m_debug.beginLabel(cmdBuf, "Hi-Z");
+
+  // Depth buffer written by the raster, Hi-Z read by the culling of this frame
+  VkImageMemoryBarrier depthBarrier = makeDepthBarrier(m_offscreenDepth.image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                                       VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+  VkBufferMemoryBarrier hizBarrier = makeBufferBarrier(m_bHiZ.buffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &hizBarrier, 1, &depthBarrier);
+
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_hizPipeline);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_hizPipelineLayout, 0, 1, &m_cullDescSet, 0, nullptr);
+
+  PushConstantHiZ pcHiZ{0, static_cast<int>(m_size.width), static_cast<int>(m_size.height)};
+  for(pcHiZ.level = 0; pcHiZ.level < m_hizLevels; pcHiZ.level++)
   {
-    auto& model            = m_objModel[inst.objIndex];
-    m_pcRaster.objIndex    = inst.objIndex;  // Telling which object is drawn
-    m_pcRaster.modelMatrix = inst.transform;
-
-    vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0,
-                       sizeof(PushConstantRaster), &m_pcRaster);
-    vkCmdBindVertexBuffers(cmdBuf, 0, 1, &model.vertexBuffer.buffer, &offset);
-    vkCmdBindIndexBuffer(cmdBuf, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(cmdBuf, model.nbIndices, 1, 0, 0, 0);
+    // Each level reads the previous one
+    if(pcHiZ.level > 0)
+    {
+      hizBarrier = makeBufferBarrier(m_bHiZ.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+      vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1,
+                           &hizBarrier, 0, nullptr);
+    }
+    uint32_t width  = std::max(1u, (m_size.width + (1u << pcHiZ.level) - 1) >> pcHiZ.level);
+    uint32_t height = std::max(1u, (m_size.height + (1u << pcHiZ.level) - 1) >> pcHiZ.level);
+    vkCmdPushConstants(cmdBuf, m_hizPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantHiZ), &pcHiZ);
+    vkCmdDispatch(cmdBuf, (width + 15) / 16, (height + 15) / 16, 1);
   }
+
+  // Back to the depth attachment for the next raster frame
+  depthBarrier = makeDepthBarrier(m_offscreenDepth.image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                  VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+                                  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &depthBarrier);
+
+  m_hizViewProj = m_viewProj;
+  m_hizValid    = true;
+
   m_debug.endLabel(cmdBuf);
 }
 
@@ -436,6 +828,7 @@ void HelloVulkan::onResize(int /*w*/, int /*h*/)
   createOffscreenRender();
   updatePostDescriptorSet();
   updateRtDescriptorSet();
+  updateCullDescriptorSet();
 }
 
 
@@ -467,7 +860,8 @@ void HelloVulkan::createOffscreenRender()
   }
 
   // Creating the depth buffer
-  auto depthCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+  auto depthCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenDepthFormat,
+                                                     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
   {
     nvvk::Image image = m_alloc.createImage(depthCreateInfo);
 
@@ -478,7 +872,27 @@ void HelloVulkan::createOffscreenRender()
     depthStencilView.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1};
     depthStencilView.image            = image.image;
 
-    m_offscreenDepth = m_alloc.createTexture(image, depthStencilView);
+    // Sampled by the build of the Hi-Z
+    VkSamplerCreateInfo sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    m_offscreenDepth                        = m_alloc.createTexture(image, depthStencilView, sampler);
+    m_offscreenDepth.descriptor.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  }
+
+  // Depth pyramid of the raster, one float per texel, all levels down to 1x1 (shaders/hiz.glsl)
+  {
+    m_alloc.destroy(m_bHiZ);
+    VkDeviceSize texels = 0;
+    VkExtent2D   level  = m_size;
+    for(m_hizLevels = 1;; m_hizLevels++)
+    {
+      texels += VkDeviceSize(level.width) * level.height;
+      if(level.width == 1 && level.height == 1)
+        break;
+      level = {(level.width + 1) / 2, (level.height + 1) / 2};
+    }
+    m_bHiZ = m_alloc.createBuffer(texels * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_debug.setObjectName(m_bHiZ.buffer, "HiZ");
+    m_hizValid = false;
   }
 
   // Setting the image layout for both color and depth
@@ -647,6 +1061,7 @@ auto HelloVulkan::objectToVkGeometryKHR(const ObjModel& model)
 //
 void HelloVulkan::createBottomLevelAS()
 {
+  CPU_ZONE("createBottomLevelAS");
   // BLAS - Storing each primitive in a geometry
   std::vector<nvvk::RaytracingBuilderKHR::BlasInput> allBlas;
   allBlas.reserve(m_objModel.size());
@@ -665,6 +1080,7 @@ void HelloVulkan::createBottomLevelAS()
 //
 void HelloVulkan::createTopLevelAS()
 {
+  CPU_ZONE("createTopLevelAS");
   std::vector<VkAccelerationStructureInstanceKHR> tlas;
   tlas.reserve(m_instances.size());
   for(const HelloVulkan::ObjInstance& inst : m_instances)
@@ -734,6 +1150,7 @@ void HelloVulkan::updateRtDescriptorSet()
 //
 void HelloVulkan::createRtPipeline()
 {
+  CPU_ZONE("createRtPipeline");
   enum StageIndices
   {
     eRaygen,
@@ -828,9 +1245,15 @@ void HelloVulkan::createRtPipeline()
   rayPipelineInfo.maxPipelineRayRecursionDepth = 2;  // Ray depth
   rayPipelineInfo.layout                       = m_rtPipelineLayout;
 
-  vkCreateRayTracingPipelinesKHR(m_device, {}, {}, 1, &rayPipelineInfo, nullptr, &m_rtPipeline);
+  {
+    CPU_ZONE("vkCreateRayTracingPipelinesKHR");
+    vkCreateRayTracingPipelinesKHR(m_device, {}, {}, 1, &rayPipelineInfo, nullptr, &m_rtPipeline);
+  }
 
-  m_sbtWrapper.create(m_rtPipeline, rayPipelineInfo);
+  {
+    CPU_ZONE("createRtShaderBindingTable");
+    m_sbtWrapper.create(m_rtPipeline, rayPipelineInfo);
+  }
 
   // Spec only guarantees 1 level of "recursion". Check for that sad possibility here.
   if(m_rtProperties.maxRayRecursionDepth <= 1)
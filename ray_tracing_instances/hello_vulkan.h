@@ -64,6 +64,7 @@ public:
   void updateDescriptorSet();
   void createUniformBuffer();
   void createObjDescriptionBuffer();
+  void createRasterDrawBuffers();
   void createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
@@ -79,6 +80,7 @@ public:
     nvvk::Buffer indexBuffer;     // Device buffer of the indices forming triangles
     nvvk::Buffer matColorBuffer;  // Device buffer of array of 'Wavefront material'
     nvvk::Buffer matIndexBuffer;  // Device buffer of array of 'Wavefront material'
+    glm::vec4    bounds{0.f};     // Bounding sphere in object space: center and radius
   };
 
   struct ObjInstance
@@ -90,11 +92,9 @@ public:
 
   // Information pushed at each draw call
   PushConstantRaster m_pcRaster{
-      {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1},  // Identity matrix
-      {10.f, 15.f, 8.f},                                 // light position
-      0,                                                 // instance Id
-      100.f,                                             // light intensity
-      0                                                  // light type
+      {10.f, 15.f, 8.f},  // light position
+      100.f,              // light intensity
+      0                   // light type
   };
 
   // Array of objects and instances in the scene
@@ -114,6 +114,20 @@ public:
   nvvk::Buffer m_bGlobals;  // Device-Host of the camera matrices
   nvvk::Buffer m_bObjDesc;  // Device buffer of the OBJ descriptions
 
+  // Multi-draw-indirect raster: the geometry of all models is copied back to back in one arena, and
+  // each instance is one indirect draw whose firstInstance indexes m_bRasterInstances
+  nvvk::Buffer m_bRasterVertices;   // Vertices of all models
+  nvvk::Buffer m_bRasterIndices;    // Indices of all models, relative to the first vertex of their model
+  nvvk::Buffer m_bRasterInstances;  // One RasterInstance per instance
+  nvvk::Buffer m_bRasterDraws;      // One VkDrawIndexedIndirectCommand per instance
+  uint32_t     m_rasterDrawCount{0};
+  uint32_t     m_maxDrawIndirectCount{1};      // 1 when multiDrawIndirect is not supported
+  bool         m_indirectFirstInstance{false};  // drawIndirectFirstInstance, else each draw is a direct one
+  glm::mat4    m_viewProj{1};                  // Camera of the frame being recorded
+
+  // Host copy of m_bRasterDraws, drawn one by one without drawIndirectFirstInstance
+  std::vector<VkDrawIndexedIndirectCommand> m_rasterDrawList;
+
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
   // Allocator for buffer, images, acceleration structures
@@ -142,6 +156,34 @@ public:
   VkFormat                    m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
   VkFormat                    m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};
 
+  // #Cull - GPU culling of the raster instances, against the view frustum and the depth pyramid (Hi-Z)
+  // of the last raster frame. The visible draws are compacted for vkCmdDrawIndexedIndirectCount.
+  void createCullPipelines();
+  void updateCullDescriptorSet();
+  void cullRaster(const VkCommandBuffer& cmdBuf);
+  void buildHiZ(const VkCommandBuffer& cmdBuf);
+
+  bool                        m_gpuCulling{false};  // Needs drawIndirectCount, multiDrawIndirect, drawIndirectFirstInstance
+  bool                        m_frustumCulling{true};
+  bool                        m_occlusionCulling{true};
+  uint32_t                    m_rasterVisibleCount{0};  // Drawn instances, read back from a previous frame
+  nvvk::Buffer                m_bRasterBounds;          // Bounding sphere of each model
+  nvvk::Buffer                m_bRasterVisibleDraws;    // Draws of the instances passing the culling
+  nvvk::Buffer                m_bRasterDrawCount;       // Number of visible draws
+  nvvk::Buffer                m_bRasterCullReadback;    // Number of visible draws, one per swapchain image
+  nvvk::Buffer                m_bHiZ;                   // Depth pyramid, see shaders/hiz.glsl
+  int                         m_hizLevels{0};
+  bool                        m_hizValid{false};  // Built since the last resize
+  glm::mat4                   m_hizViewProj{1};   // Camera of the frame which built the Hi-Z
+  nvvk::DescriptorSetBindings m_cullDescSetLayoutBind;
+  VkDescriptorPool            m_cullDescPool{VK_NULL_HANDLE};
+  VkDescriptorSetLayout       m_cullDescSetLayout{VK_NULL_HANDLE};
+  VkDescriptorSet             m_cullDescSet{VK_NULL_HANDLE};
+  VkPipelineLayout            m_cullPipelineLayout{VK_NULL_HANDLE};
+  VkPipeline                  m_cullPipeline{VK_NULL_HANDLE};
+  VkPipelineLayout            m_hizPipelineLayout{VK_NULL_HANDLE};
+  VkPipeline                  m_hizPipeline{VK_NULL_HANDLE};
+
   // #VKRay
   void initRayTracing();
   auto objectToVkGeometryKHR(const ObjModel& model);
@@ -31,6 +31,7 @@
 #include "imgui.h"
 #include "imgui/imgui_helper.h"
 
+#include "cpu_profiler.h"
 #include "hello_vulkan.h"
 #include "imgui/imgui_camera_widget.h"
 #include "nvh/cameramanipulator.hpp"
@@ -94,6 +95,17 @@ void renderUI(HelloVulkan& helloVk)
     ImGui::SliderFloat3("Position", &helloVk.m_pcRaster.lightPosition.x, -20.f, 20.f);
     ImGui::SliderFloat("Intensity", &helloVk.m_pcRaster.lightIntensity, 0.f, 150.f);
   }
+  if(ImGui::CollapsingHeader("Raster culling"))
+  {
+    if(!helloVk.m_gpuCulling)
+    {
+      ImGui::Text("Needs drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance");
+      return;
+    }
+    ImGui::Checkbox("Frustum", &helloVk.m_frustumCulling);
+    ImGui::Checkbox("Occlusion (Hi-Z)", &helloVk.m_occlusionCulling);
+    ImGui::Text("Drawn instances: %u / %u", helloVk.m_rasterVisibleCount, helloVk.m_rasterDrawCount);
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -189,6 +201,7 @@ int main(int argc, char** argv)
   MilliTimer timer;
 
   // Creation of the example
+  CpuProfiler::begin("Scene loading");
   std::random_device              rd;         //Will be used to obtain a seed for the random number engine
   std::mt19937                    gen(rd());  //Standard mersenne_twister_engine seeded with rd()
   std::normal_distribution<float> dis(1.0f, 1.0f);
@@ -204,28 +217,39 @@ int main(int argc, char** argv)
   }
 
   helloVk.loadModel(nvh::findFile("media/scenes/plane.obj", defaultSearchPaths, true));
+  CpuProfiler::end();
 
   double time_elapse = timer.elapse();
   LOGI(" --> (%f)", time_elapse);
 
+  CpuProfiler::begin("Resources");
   helloVk.createOffscreenRender();
   helloVk.createDescriptorSetLayout();
   helloVk.createGraphicsPipeline();
   helloVk.createUniformBuffer();
   helloVk.createObjDescriptionBuffer();
+  helloVk.createRasterDrawBuffers();
+  helloVk.createCullPipelines();
   helloVk.updateDescriptorSet();
+  CpuProfiler::end();
 
   // #VKRay
+  CpuProfiler::begin("Ray tracing setup");
   helloVk.initRayTracing();
   helloVk.createBottomLevelAS();
   helloVk.createTopLevelAS();
   helloVk.createRtDescriptorSet();
   helloVk.createRtPipeline();
+  CpuProfiler::end();
 
   helloVk.createPostDescriptor();
   helloVk.createPostPipeline();
   helloVk.updatePostDescriptorSet();
 
+  // The startup profile is written once the first frame was submitted
+  bool firstFrame = true;
+  CpuProfiler::begin("First frame");
+
 
   glm::vec4 clearColor   = glm::vec4(1, 1, 1, 1.00f);
   bool      useRaytracer = true;
@@ -294,9 +318,11 @@ int main(int argc, char** argv)
       }
       else
       {
+        helloVk.cullRaster(cmdBuf);
         vkCmdBeginRenderPass(cmdBuf, &offscreenRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
         helloVk.rasterize(cmdBuf);
         vkCmdEndRenderPass(cmdBuf);
+        helloVk.buildHiZ(cmdBuf);
       }
     }
 
@@ -321,6 +347,15 @@ int main(int argc, char** argv)
     // Submit for display
     vkEndCommandBuffer(cmdBuf);
     helloVk.submitFrame();
+
+    if(firstFrame)
+    {
+      CpuProfiler::end();
+      LOGI("Time to first frame: %.1f ms\n", CpuProfiler::elapsedMs());
+      if(CpuProfiler::writeChromeTrace("startup_trace.json"))
+        LOGI("Startup profile written to startup_trace.json\n");
+      firstFrame = false;
+    }
   }
 
   // Cleanup
@@ -40,6 +40,7 @@ layout(location = 1) in vec3 i_worldPos;
 layout(location = 2) in vec3 i_worldNrm;
 layout(location = 3) in vec3 i_viewDir;
 layout(location = 4) in vec2 i_texCoord;
+layout(location = 5) flat in uint i_objIndex;
 // Outgoing
 layout(location = 0) out vec4 o_color;
 
@@ -56,7 +57,7 @@ layout(binding = eTextures) uniform sampler2D[] textureSamplers;
 void main()
 {
   // Material of the object
-  ObjDesc    objResource = objDesc.i[pcRaster.objIndex];
+  ObjDesc    objResource = objDesc.i[i_objIndex];
   MatIndices matIndices  = MatIndices(objResource.materialIndexAddress);
   Materials  materials   = Materials(objResource.materialAddress);
 
@@ -85,7 +86,7 @@ void main()
   vec3 diffuse = computeDiffuse(mat, L, N);
   if(mat.textureId >= 0)
   {
-    int  txtOffset  = objDesc.i[pcRaster.objIndex].txtOffset;
+    int  txtOffset  = objDesc.i[i_objIndex].txtOffset;
     uint txtId      = txtOffset + mat.textureId;
     vec3 diffuseTxt = texture(textureSamplers[nonuniformEXT(txtId)], i_texCoord).xyz;
     diffuse *= diffuseTxt;
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2019-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Depth pyramid (Hi-Z) of the raster, stored in a buffer: level 0 is a copy of the depth buffer,
+// and each level halves the previous one, rounding up, until 1x1 (raster_hiz.comp). A texel of
+// level L covers 2^L x 2^L pixels and holds their farthest depth.
+
+#ifndef HIZ_GLSL
+#define HIZ_GLSL
+
+#include "../../common/shaders/hiz_pyramid.glsl"
+
+#endif
@@ -41,9 +41,21 @@ using uint = unsigned int;
 #endif
 
 START_BINDING(SceneBindings)
-  eGlobals  = 0,  // Global uniform containing camera matrices
-  eObjDescs = 1,  // Access to the object descriptions
-  eTextures = 2   // Access to textures
+  eGlobals   = 0,  // Global uniform containing camera matrices
+  eObjDescs  = 1,  // Access to the object descriptions
+  eTextures  = 2,  // Access to textures
+  eInstances = 3   // Instances drawn by the raster
+END_BINDING();
+
+START_BINDING(CullBindings)
+  eCullGlobals      = 0,  // Camera matrices
+  eCullInstances    = 1,  // All raster instances
+  eCullBounds       = 2,  // Bounding sphere of each model
+  eCullDraws        = 3,  // Indirect draw of each instance
+  eCullVisibleDraws = 4,  // Compacted indirect draws of the instances passing the tests
+  eCullDrawCount    = 5,  // Number of visible draws
+  eCullHiZ          = 6,  // Depth pyramid of the last raster frame
+  eCullDepth        = 7   // Depth buffer, level 0 of the pyramid
 END_BINDING();
 
 START_BINDING(RtxBindings)
@@ -71,16 +83,39 @@ struct GlobalUniforms
   mat4 projInverse;  // Camera inverse projection matrix
 };
 
+// Instance drawn by the raster, read with gl_InstanceIndex
+struct RasterInstance
+{
+  mat4 transform;  // Matrix of the instance
+  uint objIndex;   // Model index reference
+};
+
 // Push constant structure for the raster
 struct PushConstantRaster
 {
-  mat4  modelMatrix;  // matrix of the instance
   vec3  lightPosition;
-  uint  objIndex;
   float lightIntensity;
   int   lightType;
 };
 
+// Push constant structure for the culling of the raster instances
+struct PushConstantCull
+{
+  mat4 hizViewProj;     // Camera view * projection of the frame which rendered the Hi-Z
+  uint instanceCount;   // Number of raster instances
+  int  hizLevels;       // Number of levels in the Hi-Z, 0 disables the occlusion culling
+  int  hizWidth;        // Size of level 0 of the Hi-Z
+  int  hizHeight;       //
+  int  frustumCulling;  // 0 disables the frustum culling
+};
+
+// Push constant structure for the build of the Hi-Z levels
+struct PushConstantHiZ
+{
+  int level;   // Level to build, 0 is copied from the depth buffer
+  int width;   // Size of level 0
+  int height;  //
+};
 
 // Push constant structure for the ray tracer
 struct PushConstantRay
@@ -31,10 +31,11 @@ layout(binding = 0) uniform _GlobalUniforms
   GlobalUniforms uni;
 };
 
-layout(push_constant) uniform _PushConstantRaster
+layout(binding = eInstances, scalar) readonly buffer RasterInstances_
 {
-  PushConstantRaster pcRaster;
-};
+  RasterInstance i[];
+}
+instances;
 
 layout(location = 0) in vec3 i_position;
 layout(location = 1) in vec3 i_normal;
@@ -46,6 +47,7 @@ layout(location = 1) out vec3 o_worldPos;
 layout(location = 2) out vec3 o_worldNrm;
 layout(location = 3) out vec3 o_viewDir;
 layout(location = 4) out vec2 o_texCoord;
+layout(location = 5) flat out uint o_objIndex;
 
 out gl_PerVertex
 {
@@ -55,12 +57,15 @@ out gl_PerVertex
 
 void main()
 {
-  vec3 origin = vec3(uni.viewInverse * vec4(0, 0, 0, 1));
+  // Each indirect draw sets firstInstance to the index of its instance
+  RasterInstance inst   = instances.i[gl_InstanceIndex];
+  vec3           origin = vec3(uni.viewInverse * vec4(0, 0, 0, 1));
 
-  o_worldPos = vec3(pcRaster.modelMatrix * vec4(i_position, 1.0));
+  o_worldPos = vec3(inst.transform * vec4(i_position, 1.0));
   o_viewDir  = vec3(o_worldPos - origin);
   o_texCoord = i_texCoord;
-  o_worldNrm = mat3(pcRaster.modelMatrix) * i_normal;
+  o_worldNrm = mat3(inst.transform) * i_normal;
+  o_objIndex = inst.objIndex;
 
   gl_Position = uni.viewProj * vec4(o_worldPos, 1.0);
 }
@@ -273,6 +273,25 @@ void HelloVulkan::createObjDescriptionBuffer()
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Generating and uploading the tables of the low-discrepancy samplers, used for the sub-pixel jitter
+//
+void HelloVulkan::createSamplerTables()
+{
+  m_samplerTables.generate();
+
+  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+
+  auto cmdBuf      = cmdGen.createCommandBuffer();
+  m_bSamplerTables = m_alloc.createBuffer(cmdBuf, m_samplerTables.pack(),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  cmdGen.submitAndWait(cmdBuf);
+  m_alloc.finalizeAndReleaseStaging();
+  m_debug.setObjectName(m_bSamplerTables.buffer, "SamplerTables");
+
+  m_pcRay.samplerTables = nvvk::getBufferDeviceAddress(m_device, m_bSamplerTables.buffer);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Creating all textures and samplers
 //
@@ -358,6 +377,7 @@ void HelloVulkan::destroyResources()
 
   m_alloc.destroy(m_bGlobals);
   m_alloc.destroy(m_bObjDesc);
+  m_alloc.destroy(m_bSamplerTables);
 
   for(auto& m : m_objModel)
   {
@@ -375,6 +395,7 @@ void HelloVulkan::destroyResources()
   //#Post
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_offscreenDepth);
+  m_alloc.destroy(m_varianceImage);
   vkDestroyPipeline(m_device, m_postPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_postPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_postDescPool, nullptr);
@@ -390,6 +411,7 @@ void HelloVulkan::destroyResources()
   vkDestroyDescriptorPool(m_device, m_rtDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_rtDescSetLayout, nullptr);
   m_alloc.destroy(m_rtSBTBuffer);
+  m_alloc.destroy(m_activePixels);
 
   m_alloc.deinit();
 }
@@ -450,6 +472,7 @@ void HelloVulkan::createOffscreenRender()
 {
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_offscreenDepth);
+  m_alloc.destroy(m_varianceImage);
 
   // Creating the color image
   {
@@ -465,6 +488,17 @@ void HelloVulkan::createOffscreenRender()
     m_offscreenColor.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
   }
 
+  // Per-pixel statistics for adaptive sampling
+  {
+    auto varianceCreateInfo = nvvk::makeImage2DCreateInfo(m_size, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT);
+
+    nvvk::Image           image            = m_alloc.createImage(varianceCreateInfo);
+    VkImageViewCreateInfo ivInfo           = nvvk::makeImageViewCreateInfo(image.image, varianceCreateInfo);
+    VkSamplerCreateInfo   sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    m_varianceImage                        = m_alloc.createTexture(image, ivInfo, sampler);
+    m_varianceImage.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
   // Creating the depth buffer
   auto depthCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_offscreenDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
   {
@@ -485,6 +519,7 @@ void HelloVulkan::createOffscreenRender()
     nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
     auto              cmdBuf = genCmdBuf.createCommandBuffer();
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_varianceImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenDepth.image, VK_IMAGE_LAYOUT_UNDEFINED,
                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
 
@@ -690,6 +725,10 @@ void HelloVulkan::createRtDescriptorSet()
                                    VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);  // TLAS
   m_rtDescSetLayoutBind.addBinding(RtxBindings::eOutImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
                                    VK_SHADER_STAGE_RAYGEN_BIT_KHR);  // Output image
+  m_rtDescSetLayoutBind.addBinding(RtxBindings::eVariance, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                                   VK_SHADER_STAGE_RAYGEN_BIT_KHR);  // Pixel statistics
+  m_rtDescSetLayoutBind.addBinding(RtxBindings::eStats, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                   VK_SHADER_STAGE_RAYGEN_BIT_KHR);  // Active pixel counters
 
   m_rtDescPool      = m_rtDescSetLayoutBind.createPool(m_device);
   m_rtDescSetLayout = m_rtDescSetLayoutBind.createLayout(m_device);
@@ -706,10 +745,23 @@ void HelloVulkan::createRtDescriptorSet()
   descASInfo.accelerationStructureCount = 1;
   descASInfo.pAccelerationStructures    = &tlas;
   VkDescriptorImageInfo imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
+  VkDescriptorImageInfo varianceInfo{{}, m_varianceImage.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
+
+  // The active pixels are read back by the host, each frame in flight counts in its own entry
+  std::vector<uint32_t> activePixels(m_swapChain.getImageCount(), 0);
+  m_statsSlots.resize(activePixels.size());
+  m_activePixels = m_alloc.createBuffer(sizeof(uint32_t) * activePixels.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  memcpy(m_alloc.map(m_activePixels), activePixels.data(), sizeof(uint32_t) * activePixels.size());
+  m_alloc.unmap(m_activePixels);
+  m_debug.setObjectName(m_activePixels.buffer, "ActivePixels");
+  VkDescriptorBufferInfo statsInfo{m_activePixels.buffer, 0, VK_WHOLE_SIZE};
 
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eTlas, &descASInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eVariance, &varianceInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eStats, &statsInfo));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -722,8 +774,13 @@ void HelloVulkan::updateRtDescriptorSet()
 {
   // (1) Output buffer
   VkDescriptorImageInfo imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
-  VkWriteDescriptorSet  wds = m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo);
-  vkUpdateDescriptorSets(m_device, 1, &wds, 0, nullptr);
+  // (2) Pixel statistics
+  VkDescriptorImageInfo varianceInfo{{}, m_varianceImage.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eVariance, &varianceInfo));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 
@@ -927,6 +984,9 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
   m_pcRay.lightIntensity = m_pcRaster.lightIntensity;
   m_pcRay.lightType      = m_pcRaster.lightType;
 
+  m_pcRay.adaptiveThreshold = m_useAdaptive ? m_adaptiveThreshold : 0.f;
+  updateAdaptiveStats();
+
 
   std::vector<VkDescriptorSet> descSets{m_rtDescSet, m_descSet};
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
@@ -968,4 +1028,38 @@ void HelloVulkan::updateFrame()
 void HelloVulkan::resetFrame()
 {
   m_pcRay.frame = -1;
+  m_resetCount++;
+  m_resetTime         = std::chrono::steady_clock::now();
+  m_activeFraction    = 1.f;
+  m_timeToThreshold   = -1.f;
+  m_framesToThreshold = -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Reading the active pixels of the last frame which used the current slot and resetting them. The
+// fence of the current frame was waited on in prepareFrame(), so the count is complete, but a few
+// frames late: the time-to-threshold is delayed by as much.
+//
+void HelloVulkan::updateAdaptiveStats()
+{
+  m_pcRay.statsSlot  = getCurFrame();
+  auto*     counters = static_cast<uint32_t*>(m_alloc.map(m_activePixels));
+  uint32_t& active   = counters[m_pcRay.statsSlot];
+  auto&     slotInfo = m_statsSlots[m_pcRay.statsSlot];
+
+  if(slotInfo.adaptive && slotInfo.resetCount == m_resetCount)
+  {
+    m_activeFraction = static_cast<float>(active) / static_cast<float>(m_size.width * m_size.height);
+    if(active == 0 && m_timeToThreshold < 0.f)
+    {
+      auto elapsed        = std::chrono::steady_clock::now() - m_resetTime;
+      m_timeToThreshold   = std::chrono::duration<float, std::milli>(elapsed).count();
+      m_framesToThreshold = slotInfo.frame;
+      LOGI("All pixels converged after %d frames, %.1f ms\n", m_framesToThreshold, m_timeToThreshold);
+    }
+  }
+
+  active   = 0;
+  slotInfo = {m_resetCount, m_pcRay.frame, m_useAdaptive};
+  m_alloc.unmap(m_activePixels);
 }
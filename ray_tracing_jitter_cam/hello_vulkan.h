@@ -19,12 +19,15 @@
 
 #pragma once
 
+#include <chrono>
+
 #include "nvvkhl/appbase_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
 #include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
 #include "shaders/host_device.h"
+#include "sampler.h"
 
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
@@ -46,6 +49,7 @@ public:
   void updateDescriptorSet();
   void createUniformBuffer();
   void createObjDescriptionBuffer();
+  void createSamplerTables();
   void createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
@@ -96,6 +100,10 @@ public:
   nvvk::Buffer m_bGlobals;  // Device-Host of the camera matrices
   nvvk::Buffer m_bObjDesc;  // Device buffer of the OBJ descriptions
 
+  SamplerTables      m_samplerTables;        // Sobol directions and blue-noise tile
+  nvvk::Buffer       m_bSamplerTables;       // Device copy, see common/shaders/sampler.glsl
+  SamplerConvergence m_samplerConvergence;   // Result of the last convergence benchmark
+
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
 
@@ -120,6 +128,7 @@ public:
   VkFramebuffer               m_offscreenFramebuffer{VK_NULL_HANDLE};
   nvvk::Texture               m_offscreenColor;
   nvvk::Texture               m_offscreenDepth;
+  nvvk::Texture               m_varianceImage;  // Adaptive sampling statistics
   VkFormat                    m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
   VkFormat                    m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};
 
@@ -152,8 +161,27 @@ public:
   VkStridedDeviceAddressRegionKHR m_hitRegion{};
   VkStridedDeviceAddressRegionKHR m_callRegion{};
 
-  int m_maxFrames{10};
+  int   m_maxFrames{10};
+  bool  m_useAdaptive{false};
+  float m_adaptiveThreshold{0.02f};
+
+  // Adaptive sampling statistics, read back from the frame which last used the same slot
+  void updateAdaptiveStats();
+
+  struct StatsSlot  // Host side information on the frame each counter was recorded for
+  {
+    uint32_t resetCount{~0u};  // Accumulation the frame belongs to
+    int      frame{0};         // Frame number in this accumulation
+    bool     adaptive{false};  // Adaptive sampling was used
+  };
+  nvvk::Buffer                          m_activePixels;           // Host visible, one counter per frame in flight
+  std::vector<StatsSlot>                m_statsSlots;
+  uint32_t                              m_resetCount{0};
+  std::chrono::steady_clock::time_point m_resetTime;              // Start of the current accumulation
+  float                                 m_activeFraction{1.f};    // Of the last frame read back
+  float                                 m_timeToThreshold{-1.f};  // Milliseconds until all pixels converged
+  int                                   m_framesToThreshold{-1};  // Frames until all pixels converged
 
   // Push constant for ray tracer
-  PushConstantRay m_pcRay{};
+  PushConstantRay m_pcRay{{}, {}, 0.f, 0, 0, 0.f, 4};
 };
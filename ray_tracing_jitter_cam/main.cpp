@@ -71,6 +71,39 @@ void renderUI(HelloVulkan& helloVk)
 
 
   changed |= ImGui::SliderInt("Max Frames", &helloVk.m_maxFrames, 1, 100);
+  if(ImGui::CollapsingHeader("Adaptive sampling"))
+  {
+    changed |= ImGui::Checkbox("Enable", &helloVk.m_useAdaptive);
+    changed |= ImGui::SliderFloat("Error threshold", &helloVk.m_adaptiveThreshold, 0.001f, 0.1f, "%.3f");
+    changed |= ImGui::SliderInt("Min samples", &helloVk.m_pcRay.adaptiveMinSamples, 2, 100);
+    if(helloVk.m_useAdaptive)
+    {
+      ImGui::Text("Active pixels: %.1f %%", 100.f * helloVk.m_activeFraction);
+      if(helloVk.m_framesToThreshold >= 0)
+        ImGui::Text("Converged in %d frames, %.1f ms", helloVk.m_framesToThreshold, helloVk.m_timeToThreshold);
+    }
+  }
+  if(ImGui::CollapsingHeader("Sampler"))
+  {
+    int samplerType = static_cast<int>(helloVk.m_pcRay.samplerType);
+    if(ImGui::Combo("Sequence", &samplerType, "Random\0Sobol (Owen)\0Blue noise\0"))
+    {
+      helloVk.m_pcRay.samplerType = static_cast<uint32_t>(samplerType);
+      changed                     = true;
+    }
+    if(ImGui::Button("Measure convergence"))
+      helloVk.m_samplerConvergence = measureSamplerConvergence(helloVk.m_samplerTables, ConvergenceTest::ePixelFootprint);
+
+    // RMSE of the coverage of a disk edge by the sub-pixel jitter, per number of samples
+    const auto& result = helloVk.m_samplerConvergence;
+    if(!result.sampleCounts.empty())
+      ImGui::Text("RMSE      Random  Sobol   Blue noise");
+    for(size_t i = 0; i < result.sampleCounts.size(); i++)
+    {
+      ImGui::Text("%4u spp  %.4f  %.4f  %.4f", result.sampleCounts[i], result.rmse[SAMPLER_RANDOM][i],
+                  result.rmse[SAMPLER_SOBOL][i], result.rmse[SAMPLER_BLUE_NOISE][i]);
+    }
+  }
   if(changed)
     helloVk.resetFrame();
 }
@@ -174,6 +207,7 @@ int main(int argc, char** argv)
   helloVk.createGraphicsPipeline();
   helloVk.createUniformBuffer();
   helloVk.createObjDescriptionBuffer();
+  helloVk.createSamplerTables();
   helloVk.updateDescriptorSet();
 
   // #VKRay
@@ -48,7 +48,9 @@ END_BINDING();
 
 START_BINDING(RtxBindings)
   eTlas     = 0,  // Top-level acceleration structure
-  eOutImage = 1   // Ray tracer output image
+  eOutImage = 1,  // Ray tracer output image
+  eVariance = 2,  // Per-pixel sample count, luminance mean and M2 (Welford)
+  eStats    = 3   // Pixels traced, one counter per frame in flight
 END_BINDING();
 // clang-format on
 
@@ -85,11 +87,16 @@ struct PushConstantRaster
 // Push constant structure for the ray tracer
 struct PushConstantRay
 {
-  vec4  clearColor;
-  vec3  lightPosition;
-  float lightIntensity;
-  int   lightType;
-  int   frame;
+  vec4     clearColor;
+  vec3     lightPosition;
+  float    lightIntensity;
+  int      lightType;
+  int      frame;
+  float    adaptiveThreshold;   // Relative standard error below which a pixel stops sampling, 0 disables
+  int      adaptiveMinSamples;  // Samples a pixel receives before it can be considered converged
+  uint     samplerType;         // SAMPLER_RANDOM, SAMPLER_SOBOL or SAMPLER_BLUE_NOISE
+  uint     statsSlot;           // Counter of eStats written this frame
+  uint64_t samplerTables;       // Address of the tables of common/shaders/sampler.glsl
 };
 
 struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for device
@@ -273,6 +273,25 @@ void HelloVulkan::createObjDescriptionBuffer()
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
 }
 
+//--------------------------------------------------------------------------------------------------
+// Generating and uploading the tables of the low-discrepancy samplers, used for the jitter and the time
+//
+void HelloVulkan::createSamplerTables()
+{
+  m_samplerTables.generate();
+
+  nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
+
+  auto cmdBuf      = cmdGen.createCommandBuffer();
+  m_bSamplerTables = m_alloc.createBuffer(cmdBuf, m_samplerTables.pack(),
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  cmdGen.submitAndWait(cmdBuf);
+  m_alloc.finalizeAndReleaseStaging();
+  m_debug.setObjectName(m_bSamplerTables.buffer, "SamplerTables");
+
+  m_pcRay.samplerTables = nvvk::getBufferDeviceAddress(m_device, m_bSamplerTables.buffer);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Creating all textures and samplers
 //
@@ -358,6 +377,7 @@ void HelloVulkan::destroyResources()
 
   m_alloc.destroy(m_bGlobals);
   m_alloc.destroy(m_bObjDesc);
+  m_alloc.destroy(m_bSamplerTables);
 
   for(auto& m : m_objModel)
   {
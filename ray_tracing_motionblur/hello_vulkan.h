@@ -25,6 +25,7 @@
 #include "nvvk/memallocator_dma_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
 #include "shaders/host_device.h"
+#include "sampler.h"
 
 // #VKRay
 #include "nvvk/raytraceKHR_vk.hpp"
@@ -46,6 +47,7 @@ public:
   void updateDescriptorSet();
   void createUniformBuffer();
   void createObjDescriptionBuffer();
+  void createSamplerTables();
   void createTextureImages(const VkCommandBuffer& cmdBuf, const std::vector<std::string>& textures);
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void onResize(int /*w*/, int /*h*/) override;
@@ -97,6 +99,10 @@ public:
   nvvk::Buffer m_bGlobals;  // Device-Host of the camera matrices
   nvvk::Buffer m_bObjDesc;  // Device buffer of the OBJ descriptions
 
+  SamplerTables      m_samplerTables;       // Sobol directions and blue-noise tile
+  nvvk::Buffer       m_bSamplerTables;      // Device copy, see common/shaders/sampler.glsl
+  SamplerConvergence m_samplerConvergence;  // Result of the last convergence benchmark
+
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
 
@@ -71,6 +71,27 @@ void renderUI(HelloVulkan& helloVk)
 
 
   changed |= ImGui::SliderInt("Max Frames", &helloVk.m_maxFrames, 1, 100);
+  if(ImGui::CollapsingHeader("Sampler"))
+  {
+    int samplerType = static_cast<int>(helloVk.m_pcRay.samplerType);
+    if(ImGui::Combo("Sequence", &samplerType, "Random\0Sobol (Owen)\0Blue noise\0"))
+    {
+      helloVk.m_pcRay.samplerType = static_cast<uint32_t>(samplerType);
+      changed                     = true;
+    }
+    if(ImGui::Button("Measure convergence"))
+      helloVk.m_samplerConvergence = measureSamplerConvergence(helloVk.m_samplerTables, ConvergenceTest::eMotion);
+
+    // RMSE of the coverage of a moving disk edge over the pixel and the shutter time, per number of samples
+    const auto& result = helloVk.m_samplerConvergence;
+    if(!result.sampleCounts.empty())
+      ImGui::Text("RMSE      Random  Sobol   Blue noise");
+    for(size_t i = 0; i < result.sampleCounts.size(); i++)
+    {
+      ImGui::Text("%4u spp  %.4f  %.4f  %.4f", result.sampleCounts[i], result.rmse[SAMPLER_RANDOM][i],
+                  result.rmse[SAMPLER_SOBOL][i], result.rmse[SAMPLER_BLUE_NOISE][i]);
+    }
+  }
   if(changed)
     helloVk.resetFrame();
 }
@@ -194,6 +215,7 @@ int main(int argc, char** argv)
   helloVk.createGraphicsPipeline();
   helloVk.createUniformBuffer();
   helloVk.createObjDescriptionBuffer();
+  helloVk.createSamplerTables();
   helloVk.updateDescriptorSet();
 
   // #VKRay
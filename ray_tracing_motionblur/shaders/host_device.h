@@ -85,11 +85,13 @@ struct PushConstantRaster
 // Push constant structure for the ray tracer
 struct PushConstantRay
 {
-  vec4  clearColor;
-  vec3  lightPosition;
-  float lightIntensity;
-  int   lightType;
-  int   frame;
+  vec4     clearColor;
+  vec3     lightPosition;
+  float    lightIntensity;
+  int      lightType;
+  int      frame;
+  uint     samplerType;    // SAMPLER_RANDOM, SAMPLER_SOBOL or SAMPLER_BLUE_NOISE
+  uint64_t samplerTables;  // Address of the tables of common/shaders/sampler.glsl
 };
 
 struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for device
@@ -18,6 +18,7 @@
  */
 
 
+#include <array>
 #include <sstream>
 
 
@@ -70,7 +71,7 @@ void HelloVulkan::updateUniformBuffer(const VkCommandBuffer& cmdBuf)
 
   // UBO on the device, and what stages access it.
   VkBuffer deviceUBO      = m_bGlobals.buffer;
-  auto     uboUsageStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+  auto     uboUsageStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
   // Ensure that the modified UBO is not visible to previous frames.
   VkBufferMemoryBarrier beforeBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
@@ -107,16 +108,22 @@ void HelloVulkan::createDescriptorSetLayout()
 
   // Camera matrices
   m_descSetLayoutBind.addBinding(SceneBindings::eGlobals, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1,
-                                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR);
+                                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
   // Obj descriptions
   m_descSetLayoutBind.addBinding(SceneBindings::eObjDescs, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
-                                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+                                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR
+                                     | VK_SHADER_STAGE_COMPUTE_BIT);
   // Textures
   m_descSetLayoutBind.addBinding(SceneBindings::eTextures, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nbTxt,
-                                 VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);
+                                 VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT);
 
   // The top level acceleration structure
-  m_descSetLayoutBind.addBinding(eTlas, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
+  m_descSetLayoutBind.addBinding(eTlas, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1,
+                                 VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+
+  // Instances, for the visibility buffer
+  m_descSetLayoutBind.addBinding(SceneBindings::eInstances, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                 VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
 
   m_descSetLayout = m_descSetLayoutBind.createLayout(m_device);
   m_descPool      = m_descSetLayoutBind.createPool(m_device, 1);
@@ -137,6 +144,9 @@ void HelloVulkan::updateDescriptorSet()
   VkDescriptorBufferInfo dbiSceneDesc{m_bObjDesc.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eObjDescs, &dbiSceneDesc));
 
+  VkDescriptorBufferInfo dbiInstances{m_bInstances.buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(m_descSetLayoutBind.makeWrite(m_descSet, SceneBindings::eInstances, &dbiInstances));
+
   // All texture samplers
   std::vector<VkDescriptorImageInfo> diit;
   for(auto& texture : m_textures)
@@ -275,11 +285,19 @@ void HelloVulkan::createObjDescriptionBuffer()
 {
   nvvk::CommandPool cmdGen(m_device, m_graphicsQueueIndex);
 
-  auto cmdBuf = cmdGen.createCommandBuffer();
-  m_bObjDesc  = m_alloc.createBuffer(cmdBuf, m_objDesc, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  // Instances, indexed by the visibility buffer
+  std::vector<RasterInstance> instances;
+  instances.reserve(m_instances.size());
+  for(const HelloVulkan::ObjInstance& inst : m_instances)
+    instances.push_back({inst.transform, inst.objIndex});
+
+  auto cmdBuf  = cmdGen.createCommandBuffer();
+  m_bObjDesc   = m_alloc.createBuffer(cmdBuf, m_objDesc, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_bInstances = m_alloc.createBuffer(cmdBuf, instances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
   cmdGen.submitAndWait(cmdBuf);
   m_alloc.finalizeAndReleaseStaging();
   m_debug.setObjectName(m_bObjDesc.buffer, "ObjDescs");
+  m_debug.setObjectName(m_bInstances.buffer, "Instances");
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -367,6 +385,7 @@ void HelloVulkan::destroyResources()
 
   m_alloc.destroy(m_bGlobals);
   m_alloc.destroy(m_bObjDesc);
+  m_alloc.destroy(m_bInstances);
 
   for(auto& m : m_objModel)
   {
@@ -391,6 +410,17 @@ void HelloVulkan::destroyResources()
   vkDestroyRenderPass(m_device, m_offscreenRenderPass, nullptr);
   vkDestroyFramebuffer(m_device, m_offscreenFramebuffer, nullptr);
 
+  // #Visibility
+  m_alloc.destroy(m_visibility);
+  vkDestroyRenderPass(m_device, m_visibilityRenderPass, nullptr);
+  vkDestroyFramebuffer(m_device, m_visibilityFramebuffer, nullptr);
+  vkDestroyPipeline(m_device, m_visibilityPipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_visibilityPipelineLayout, nullptr);
+  vkDestroyPipeline(m_device, m_shadePipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_shadePipelineLayout, nullptr);
+  vkDestroyDescriptorPool(m_device, m_shadeDescPool, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_shadeDescSetLayout, nullptr);
+
 
   // #VKRay
   m_rtBuilder.destroy();
@@ -436,8 +466,212 @@ void HelloVulkan::onResize(int /*w*/, int /*h*/)
 {
   createOffscreenRender();
   updatePostDescriptorSet();
+  createVisibilityRender();
+  updateVisibilityDescriptorSet();
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// #Visibility - Visibility buffer and deferred shading
+//////////////////////////////////////////////////////////////////////////
+
+static VkImageMemoryBarrier makeImageBarrier(VkImage image, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+  VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = dstAccess;
+  barrier.oldLayout           = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image               = image;
+  barrier.subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  return barrier;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Creating the visibility buffer and its render pass, sharing the depth buffer of the offscreen.
+// Must be called after createOffscreenRender().
+//
+void HelloVulkan::createVisibilityRender()
+{
+  m_alloc.destroy(m_visibility);
+
+  // 64 bits per pixel: instance + 1 and primitive
+  {
+    auto visibilityCreateInfo = nvvk::makeImage2DCreateInfo(m_size, m_visibilityFormat,
+                                                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+    nvvk::Image           image  = m_alloc.createImage(visibilityCreateInfo);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, visibilityCreateInfo);
+    VkSamplerCreateInfo   sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    m_visibility                        = m_alloc.createTexture(image, ivInfo, sampler);
+    m_visibility.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    m_debug.setObjectName(m_visibility.image, "Visibility");
+  }
+
+  {
+    nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+    auto              cmdBuf = genCmdBuf.createCommandBuffer();
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_visibility.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    genCmdBuf.submitAndWait(cmdBuf);
+  }
+
+  if(!m_visibilityRenderPass)
+  {
+    m_visibilityRenderPass = nvvk::createRenderPass(m_device, {m_visibilityFormat}, m_offscreenDepthFormat, 1, true, true,
+                                                    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+  }
+
+  std::vector<VkImageView> attachments = {m_visibility.descriptor.imageView, m_offscreenDepth.descriptor.imageView};
+
+  vkDestroyFramebuffer(m_device, m_visibilityFramebuffer, nullptr);
+  VkFramebufferCreateInfo info{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+  info.renderPass      = m_visibilityRenderPass;
+  info.attachmentCount = 2;
+  info.pAttachments    = attachments.data();
+  info.width           = m_size.width;
+  info.height          = m_size.height;
+  info.layers          = 1;
+  vkCreateFramebuffer(m_device, &info, nullptr, &m_visibilityFramebuffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Creating the raster pipeline writing the visibility buffer, and the compute pipeline shading it
+//
+void HelloVulkan::createVisibilityPipelines()
+{
+  // Visibility: only the scene set, the instance is the firstInstance of the draw
+  VkPipelineLayoutCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  createInfo.setLayoutCount = 1;
+  createInfo.pSetLayouts    = &m_descSetLayout;
+  vkCreatePipelineLayout(m_device, &createInfo, nullptr, &m_visibilityPipelineLayout);
+
+  std::vector<std::string>                paths = defaultSearchPaths;
+  nvvk::GraphicsPipelineGeneratorCombined gpb(m_device, m_visibilityPipelineLayout, m_visibilityRenderPass);
+  gpb.depthStencilState.depthTestEnable = true;
+  gpb.addShader(nvh::loadFile("spv/visibility.vert.spv", true, paths, true), VK_SHADER_STAGE_VERTEX_BIT);
+  gpb.addShader(nvh::loadFile("spv/visibility.frag.spv", true, paths, true), VK_SHADER_STAGE_FRAGMENT_BIT);
+  gpb.addBindingDescription({0, sizeof(VertexObj)});
+  gpb.addAttributeDescriptions({
+      {0, 0, VK_FORMAT_R32G32B32_SFLOAT, static_cast<uint32_t>(offsetof(VertexObj, pos))},
+  });
+  m_visibilityPipeline = gpb.createPipeline();
+  m_debug.setObjectName(m_visibilityPipeline, "Visibility");
+
+  // Shading: the scene set, and the visibility buffer and output image in set 1
+  m_shadeDescSetLayoutBind.addBinding(VisibilityBindings::eVisibility, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+                                      VK_SHADER_STAGE_COMPUTE_BIT);
+  m_shadeDescSetLayoutBind.addBinding(VisibilityBindings::eShadedImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                                      VK_SHADER_STAGE_COMPUTE_BIT);
+  m_shadeDescSetLayout = m_shadeDescSetLayoutBind.createLayout(m_device);
+  m_shadeDescPool      = m_shadeDescSetLayoutBind.createPool(m_device, 1);
+  m_shadeDescSet       = nvvk::allocateDescriptorSet(m_device, m_shadeDescPool, m_shadeDescSetLayout);
+  updateVisibilityDescriptorSet();
+
+  std::vector<VkDescriptorSetLayout> shadeSetLayouts = {m_descSetLayout, m_shadeDescSetLayout};
+  VkPushConstantRange                pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantRay)};
+  createInfo.setLayoutCount         = static_cast<uint32_t>(shadeSetLayouts.size());
+  createInfo.pSetLayouts            = shadeSetLayouts.data();
+  createInfo.pushConstantRangeCount = 1;
+  createInfo.pPushConstantRanges    = &pushConstantRange;
+  vkCreatePipelineLayout(m_device, &createInfo, nullptr, &m_shadePipelineLayout);
+
+  VkComputePipelineCreateInfo pipelineInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  pipelineInfo.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.pName  = "main";
+  pipelineInfo.stage.module = nvvk::createShaderModule(m_device, nvh::loadFile("spv/visibility_shade.comp.spv", true, paths, true));
+  pipelineInfo.layout       = m_shadePipelineLayout;
+  vkCreateComputePipelines(m_device, {}, 1, &pipelineInfo, nullptr, &m_shadePipeline);
+  vkDestroyShaderModule(m_device, pipelineInfo.stage.module, nullptr);
+  m_debug.setObjectName(m_shadePipeline, "VisibilityShade");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Writing the visibility buffer and the output image, recreated when changing resolution
+//
+void HelloVulkan::updateVisibilityDescriptorSet()
+{
+  if(m_shadeDescSet == VK_NULL_HANDLE)
+    return;
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_shadeDescSetLayoutBind.makeWrite(m_shadeDescSet, VisibilityBindings::eVisibility, &m_visibility.descriptor));
+  writes.emplace_back(m_shadeDescSetLayoutBind.makeWrite(m_shadeDescSet, VisibilityBindings::eShadedImage, &m_offscreenColor.descriptor));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Rasterizing the instance and primitive of each pixel, in its own render pass
+//
+void HelloVulkan::rasterizeVisibility(const VkCommandBuffer& cmdBuf)
+{
+  VkDeviceSize offset{0};
+
+  m_debug.beginLabel(cmdBuf, "Visibility");
+
+  // 0 is the background
+  std::array<VkClearValue, 2> clearValues{};
+  clearValues[1].depthStencil = {1.0f, 0};
+
+  VkRenderPassBeginInfo renderPassBeginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  renderPassBeginInfo.clearValueCount = 2;
+  renderPassBeginInfo.pClearValues    = clearValues.data();
+  renderPassBeginInfo.renderPass      = m_visibilityRenderPass;
+  renderPassBeginInfo.framebuffer     = m_visibilityFramebuffer;
+  renderPassBeginInfo.renderArea      = {{0, 0}, m_size};
+  vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  setViewport(cmdBuf);
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_visibilityPipeline);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_visibilityPipelineLayout, 0, 1, &m_descSet, 0, nullptr);
+
+  for(uint32_t i = 0; i < static_cast<uint32_t>(m_instances.size()); i++)
+  {
+    auto& model = m_objModel[m_instances[i].objIndex];
+    vkCmdBindVertexBuffers(cmdBuf, 0, 1, &model.vertexBuffer.buffer, &offset);
+    vkCmdBindIndexBuffer(cmdBuf, model.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(cmdBuf, model.nbIndices, 1, 0, 0, i);  // firstInstance: gl_InstanceIndex in the shader
+  }
+
+  vkCmdEndRenderPass(cmdBuf);
+  m_debug.endLabel(cmdBuf);
 }
 
+//--------------------------------------------------------------------------------------------------
+// Shading each pixel of the visibility buffer into the offscreen color image, read by the post
+//
+void HelloVulkan::shadeVisibility(const VkCommandBuffer& cmdBuf, const glm::vec4& clearColor)
+{
+  m_debug.beginLabel(cmdBuf, "Visibility shading");
+
+  // Visibility buffer written by the raster, offscreen image read by the post of the previous frame
+  std::array<VkImageMemoryBarrier, 2> beforeBarriers{
+      makeImageBarrier(m_visibility.image, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+      makeImageBarrier(m_offscreenColor.image, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT)};
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                       static_cast<uint32_t>(beforeBarriers.size()), beforeBarriers.data());
+
+  m_pcRay.clearColor     = clearColor;
+  m_pcRay.lightPosition  = m_pcRaster.lightPosition;
+  m_pcRay.lightIntensity = m_pcRaster.lightIntensity;
+  m_pcRay.lightType      = m_pcRaster.lightType;
+
+  std::array<VkDescriptorSet, 2> descSets{m_descSet, m_shadeDescSet};
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_shadePipeline);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_shadePipelineLayout, 0,
+                          static_cast<uint32_t>(descSets.size()), descSets.data(), 0, nullptr);
+  vkCmdPushConstants(cmdBuf, m_shadePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantRay), &m_pcRay);
+  vkCmdDispatch(cmdBuf, (m_size.width + 15) / 16, (m_size.height + 15) / 16, 1);
+
+  // Shaded image to the post
+  VkImageMemoryBarrier afterBarrier = makeImageBarrier(m_offscreenColor.image, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &afterBarrier);
+
+  m_debug.endLabel(cmdBuf);
+}
 
 //////////////////////////////////////////////////////////////////////////
 // Post-processing
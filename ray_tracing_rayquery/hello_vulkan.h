@@ -93,8 +93,9 @@ public:
   VkDescriptorSetLayout       m_descSetLayout;
   VkDescriptorSet             m_descSet;
 
-  nvvk::Buffer m_bGlobals;  // Device-Host of the camera matrices
-  nvvk::Buffer m_bObjDesc;  // Device buffer of the OBJ descriptions
+  nvvk::Buffer m_bGlobals;    // Device-Host of the camera matrices
+  nvvk::Buffer m_bObjDesc;    // Device buffer of the OBJ descriptions
+  nvvk::Buffer m_bInstances;  // Device buffer of the RasterInstance of each instance
 
   std::vector<nvvk::Texture> m_textures;  // vector of all textures of the scene
 
@@ -123,6 +124,29 @@ public:
   VkFormat                    m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
   VkFormat                    m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};
 
+  // #Visibility - Deferred shading from a visibility buffer: the raster only writes the instance and the
+  // primitive of each pixel, then a compute pass shades each visible pixel once, with one shadow ray query
+  void createVisibilityRender();
+  void createVisibilityPipelines();
+  void updateVisibilityDescriptorSet();
+  void rasterizeVisibility(const VkCommandBuffer& cmdBuf);
+  void shadeVisibility(const VkCommandBuffer& cmdBuf, const glm::vec4& clearColor);
+
+  bool                        m_useVisibilityBuffer{true};
+  nvvk::Texture               m_visibility;  // Instance + 1 and primitive of each pixel, 0 for the background
+  VkFormat                    m_visibilityFormat{VK_FORMAT_R32G32_UINT};
+  VkRenderPass                m_visibilityRenderPass{VK_NULL_HANDLE};
+  VkFramebuffer               m_visibilityFramebuffer{VK_NULL_HANDLE};
+  VkPipelineLayout            m_visibilityPipelineLayout{VK_NULL_HANDLE};
+  VkPipeline                  m_visibilityPipeline{VK_NULL_HANDLE};
+  nvvk::DescriptorSetBindings m_shadeDescSetLayoutBind;
+  VkDescriptorPool            m_shadeDescPool{VK_NULL_HANDLE};
+  VkDescriptorSetLayout       m_shadeDescSetLayout{VK_NULL_HANDLE};
+  VkDescriptorSet             m_shadeDescSet{VK_NULL_HANDLE};
+  VkPipelineLayout            m_shadePipelineLayout{VK_NULL_HANDLE};
+  VkPipeline                  m_shadePipeline{VK_NULL_HANDLE};
+  PushConstantRay             m_pcRay{};
+
   // #VKRay
   void initRayTracing();
   auto objectToVkGeometryKHR(const ObjModel& model);
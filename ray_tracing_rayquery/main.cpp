@@ -66,6 +66,7 @@ void renderUI(HelloVulkan& helloVk)
     ImGui::SliderFloat3("Position", &helloVk.m_pcRaster.lightPosition.x, -20.f, 20.f);
     ImGui::SliderFloat("Intensity", &helloVk.m_pcRaster.lightIntensity, 0.f, 150.f);
   }
+  ImGui::Checkbox("Visibility buffer", &helloVk.m_useVisibilityBuffer);
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -164,6 +165,7 @@ int main(int argc, char** argv)
 
 
   helloVk.createOffscreenRender();
+  helloVk.createVisibilityRender();
   helloVk.createDescriptorSetLayout();
   helloVk.createGraphicsPipeline();
   helloVk.createUniformBuffer();
@@ -176,6 +178,7 @@ int main(int argc, char** argv)
 
   // Need the Top level AS
   helloVk.updateDescriptorSet();
+  helloVk.createVisibilityPipelines();
 
   helloVk.createPostDescriptor();
   helloVk.createPostPipeline();
@@ -240,6 +243,12 @@ int main(int argc, char** argv)
       offscreenRenderPassBeginInfo.renderArea      = {{0, 0}, helloVk.getSize()};
 
       // Rendering Scene
+      if(helloVk.m_useVisibilityBuffer)
+      {
+        helloVk.rasterizeVisibility(cmdBuf);
+        helloVk.shadeVisibility(cmdBuf, clearColor);
+      }
+      else
       {
         vkCmdBeginRenderPass(cmdBuf, &offscreenRenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
         helloVk.rasterize(cmdBuf);
@@ -41,10 +41,16 @@ using uint = unsigned int;
 #endif
 
 START_BINDING(SceneBindings)
-  eGlobals  = 0,  // Global uniform containing camera matrices
-  eObjDescs = 1,  // Access to the object descriptions
-  eTextures = 2,  // Access to textures
-  eTlas     = 3   // Top-level acceleration structure
+  eGlobals   = 0,  // Global uniform containing camera matrices
+  eObjDescs  = 1,  // Access to the object descriptions
+  eTextures  = 2,  // Access to textures
+  eTlas      = 3,  // Top-level acceleration structure
+  eInstances = 4   // Transform and model of each instance
+END_BINDING();
+
+START_BINDING(VisibilityBindings)
+  eVisibility  = 0,  // Visibility buffer: instance + 1 and primitive of each pixel
+  eShadedImage = 1  // Output of the shading
 END_BINDING();
 // clang-format on
 
@@ -78,7 +84,14 @@ struct PushConstantRaster
 };
 
 
-// Push constant structure for the ray tracer
+// Instance of the scene, indexed by the visibility buffer
+struct RasterInstance
+{
+  mat4 transform;  // Matrix of the instance
+  uint objIndex;   // Model index reference
+};
+
+// Push constant structure for the shading of the visibility buffer
 struct PushConstantRay
 {
   vec4  clearColor;
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2019-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Visibility buffer: instance + 1 (0 is the background) and primitive of the visible triangle
+
+layout(location = 0) flat in uint i_instance;
+
+layout(location = 0) out uvec2 o_visibility;
+
+
+void main()
+{
+  o_visibility = uvec2(i_instance + 1, gl_PrimitiveID);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2019-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_scalar_block_layout : enable
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+// Visibility buffer: only the position is transformed, firstInstance of the draw is the instance
+
+#include "host_device.h"
+
+// clang-format off
+layout(binding = eGlobals) uniform _GlobalUniforms { GlobalUniforms uni; };
+layout(binding = eInstances, scalar) readonly buffer Instances_ { RasterInstance i[]; } instances;
+// clang-format on
+
+layout(location = 0) in vec3 i_position;
+
+layout(location = 0) flat out uint o_instance;
+
+out gl_PerVertex
+{
+  vec4 gl_Position;
+};
+
+
+void main()
+{
+  o_instance  = gl_InstanceIndex;
+  gl_Position = uni.viewProj * (instances.i[gl_InstanceIndex].transform * vec4(i_position, 1.0));
+}
@@ -18,6 +18,7 @@
  */
 
 
+#include <algorithm>
 #include <numeric>
 #include <sstream>
 
@@ -376,6 +377,8 @@ void HelloVulkan::destroyResources()
   //#Post
   m_alloc.destroy(m_offscreenColor);
   m_alloc.destroy(m_offscreenDepth);
+  m_alloc.destroy(m_bRayStats);
+  m_alloc.destroy(m_bRayStatsReadback);
   vkDestroyPipeline(m_device, m_postPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_postPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_postDescPool, nullptr);
@@ -386,8 +389,10 @@ void HelloVulkan::destroyResources()
 
   // #VKRay
   m_sbtWrapper.destroy();
+  m_sbtStatsWrapper.destroy();
   m_rtBuilder.destroy();
   vkDestroyPipeline(m_device, m_rtPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_rtStatsPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_rtPipelineLayout, nullptr);
   vkDestroyDescriptorPool(m_device, m_rtDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_rtDescSetLayout, nullptr);
@@ -403,6 +408,7 @@ void HelloVulkan::rasterize(const VkCommandBuffer& cmdBuf)
   VkDeviceSize offset{0};
 
   m_debug.beginLabel(cmdBuf, "Rasterize");
+  m_rayStatsFilled = false;
 
   // Dynamic Viewport
   setViewport(cmdBuf);
@@ -511,6 +517,8 @@ void HelloVulkan::createOffscreenRender()
   info.height          = m_size.height;
   info.layers          = 1;
   vkCreateFramebuffer(m_device, &info, nullptr, &m_offscreenFramebuffer);
+
+  createRayStatsBuffers();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -519,7 +527,7 @@ void HelloVulkan::createOffscreenRender()
 void HelloVulkan::createPostPipeline()
 {
   // Push constants in the fragment shader
-  VkPushConstantRange pushConstantRanges = {VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(float)};
+  VkPushConstantRange pushConstantRanges = {VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantPost)};
 
   // Creating the pipeline layout
   VkPipelineLayoutCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
@@ -546,6 +554,7 @@ void HelloVulkan::createPostPipeline()
 void HelloVulkan::createPostDescriptor()
 {
   m_postDescSetLayoutBind.addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
+  m_postDescSetLayoutBind.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);  // Heatmap
   m_postDescSetLayout = m_postDescSetLayoutBind.createLayout(m_device);
   m_postDescPool      = m_postDescSetLayoutBind.createPool(m_device);
   m_postDescSet       = nvvk::allocateDescriptorSet(m_device, m_postDescPool, m_postDescSetLayout);
@@ -557,8 +566,12 @@ void HelloVulkan::createPostDescriptor()
 //
 void HelloVulkan::updatePostDescriptorSet()
 {
-  VkWriteDescriptorSet writeDescriptorSets = m_postDescSetLayoutBind.makeWrite(m_postDescSet, 0, &m_offscreenColor.descriptor);
-  vkUpdateDescriptorSets(m_device, 1, &writeDescriptorSets, 0, nullptr);
+  VkDescriptorBufferInfo statsInfo{m_bRayStats.buffer, 0, VK_WHOLE_SIZE};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_postDescSetLayoutBind.makeWrite(m_postDescSet, 0, &m_offscreenColor.descriptor));
+  writes.emplace_back(m_postDescSetLayoutBind.makeWrite(m_postDescSet, 1, &statsInfo));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -570,8 +583,14 @@ void HelloVulkan::drawPost(VkCommandBuffer cmdBuf)
 
   setViewport(cmdBuf);
 
-  auto aspectRatio = static_cast<float>(m_size.width) / static_cast<float>(m_size.height);
-  vkCmdPushConstants(cmdBuf, m_postPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(float), &aspectRatio);
+  // The heatmap is scaled by the maximum of the last statistics read back
+  uint32_t maxValue = m_heatmap == 1 ? m_rayStatsSummary.maxRays : m_rayStatsSummary.maxTicks;
+
+  PushConstantPost pcPost{};
+  pcPost.aspectRatio  = static_cast<float>(m_size.width) / static_cast<float>(m_size.height);
+  pcPost.heatmap      = m_rayStatsFilled ? m_heatmap : 0;
+  pcPost.heatmapScale = 1.f / static_cast<float>(std::max(maxValue, 1u));
+  vkCmdPushConstants(cmdBuf, m_postPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstantPost), &pcPost);
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_postPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_postPipelineLayout, 0, 1, &m_postDescSet, 0, nullptr);
   vkCmdDraw(cmdBuf, 3, 1, 0, 0);
@@ -595,6 +614,7 @@ void HelloVulkan::initRayTracing()
 
   m_rtBuilder.setup(m_device, &m_alloc, m_graphicsQueueIndex);
   m_sbtWrapper.setup(m_device, m_graphicsQueueIndex, &m_alloc, m_rtProperties);
+  m_sbtStatsWrapper.setup(m_device, m_graphicsQueueIndex, &m_alloc, m_rtProperties);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -680,6 +700,80 @@ void HelloVulkan::createTopLevelAS()
   m_rtBuilder.buildTlas(tlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
 }
 
+//--------------------------------------------------------------------------------------------------
+// One RayStats per pixel of the offscreen image, and the host-visible buffer it is copied to.
+// - Required when changing resolution
+//
+void HelloVulkan::createRayStatsBuffers()
+{
+  m_alloc.destroy(m_bRayStats);
+  m_alloc.destroy(m_bRayStatsReadback);
+
+  VkDeviceSize size = sizeof(RayStats) * m_size.width * m_size.height;
+  m_bRayStats = m_alloc.createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                                               | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  m_bRayStatsReadback = m_alloc.createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  m_debug.setObjectName(m_bRayStats.buffer, "rayStats");
+  m_debug.setObjectName(m_bRayStatsReadback.buffer, "rayStatsReadback");
+
+  // The counters of the previous size are gone
+  m_rayStatsFilled        = false;
+  m_rayStatsReadbackFrame = -1;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Summing the counters copied by raytrace(). The frame which copied them must be done: this is
+// called after prepareFrame(), which waited on the fence of the current frame.
+//
+void HelloVulkan::updateRayStatsSummary()
+{
+  if(m_rayStatsReadbackFrame != static_cast<int>(getCurFrame()))
+    return;
+  m_rayStatsReadbackFrame = -1;
+
+  RayStatsSummary summary;
+  uint64_t        ticks  = 0;
+  size_t          pixels = static_cast<size_t>(m_size.width) * m_size.height;
+  const auto*     stats  = static_cast<const RayStats*>(m_alloc.map(m_bRayStatsReadback));
+  for(size_t i = 0; i < pixels; i++)
+  {
+    const RayStats& s = stats[i];
+    summary.primary += s.primary;
+    summary.shadow += s.shadow;
+    summary.closestHit += s.closestHit;
+    summary.miss += s.miss;
+    summary.maxRays  = std::max(summary.maxRays, s.primary + s.shadow);
+    summary.maxTicks = std::max(summary.maxTicks, s.clockTicks);
+    ticks += s.clockTicks;
+  }
+  m_alloc.unmap(m_bRayStatsReadback);
+
+  summary.avgTicks  = pixels > 0 ? static_cast<double>(ticks) / static_cast<double>(pixels) : 0.0;
+  m_rayStatsSummary = summary;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Dependency on the whole buffer of ray statistics
+//
+static void rayStatsBarrier(VkCommandBuffer      cmdBuf,
+                            VkBuffer             buffer,
+                            VkPipelineStageFlags srcStage,
+                            VkAccessFlags        srcAccess,
+                            VkPipelineStageFlags dstStage,
+                            VkAccessFlags        dstAccess)
+{
+  VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  barrier.srcAccessMask       = srcAccess;
+  barrier.dstAccessMask       = dstAccess;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = buffer;
+  barrier.offset              = 0;
+  barrier.size                = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(cmdBuf, srcStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
 //--------------------------------------------------------------------------------------------------
 // This descriptor set holds the Acceleration structure and the output image
 //
@@ -691,6 +785,9 @@ void HelloVulkan::createRtDescriptorSet()
                                    VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR);  // TLAS
   m_rtDescSetLayoutBind.addBinding(RtxBindings::eOutImage, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
                                    VK_SHADER_STAGE_RAYGEN_BIT_KHR);  // Output image
+  m_rtDescSetLayoutBind.addBinding(RtxBindings::eRayStats, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                                   VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR
+                                       | VK_SHADER_STAGE_MISS_BIT_KHR);  // Ray statistics
 
   m_rtDescPool      = m_rtDescSetLayoutBind.createPool(m_device);
   m_rtDescSetLayout = m_rtDescSetLayoutBind.createLayout(m_device);
@@ -706,11 +803,13 @@ void HelloVulkan::createRtDescriptorSet()
   VkWriteDescriptorSetAccelerationStructureKHR descASInfo{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR};
   descASInfo.accelerationStructureCount = 1;
   descASInfo.pAccelerationStructures    = &tlas;
-  VkDescriptorImageInfo imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
+  VkDescriptorImageInfo  imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
+  VkDescriptorBufferInfo statsInfo{m_bRayStats.buffer, 0, VK_WHOLE_SIZE};
 
   std::vector<VkWriteDescriptorSet> writes;
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eTlas, &descASInfo));
   writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eRayStats, &statsInfo));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -723,8 +822,13 @@ void HelloVulkan::updateRtDescriptorSet()
 {
   // (1) Output buffer
   VkDescriptorImageInfo imageInfo{{}, m_offscreenColor.descriptor.imageView, VK_IMAGE_LAYOUT_GENERAL};
-  VkWriteDescriptorSet  wds = m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo);
-  vkUpdateDescriptorSets(m_device, 1, &wds, 0, nullptr);
+  // (2) Ray statistics, sized like the output
+  VkDescriptorBufferInfo statsInfo{m_bRayStats.buffer, 0, VK_WHOLE_SIZE};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eOutImage, &imageInfo));
+  writes.emplace_back(m_rtDescSetLayoutBind.makeWrite(m_rtDescSet, RtxBindings::eRayStats, &statsInfo));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
 
@@ -780,14 +884,21 @@ void HelloVulkan::createRtPipeline()
     eShaderGroupCount = 11
   };
 
-  // Specialization - set 8 permutations of the 3 constant
-  std::vector<Specialization> specializations(8);
-  for(int i = 0; i < 8; i++)
+  // Specialization - set 8 permutations of the 3 constant, for each value of RAY_STATS (constant 3).
+  // The stages other than the closest hit only have RAY_STATS.
+  std::array<std::vector<Specialization>, 2> specializations;
+  std::array<Specialization, 2>              rayStatsSpecializations;
+  for(int rayStats = 0; rayStats < 2; rayStats++)
   {
-    int a = ((i >> 2) % 2) == 1;
-    int b = ((i >> 1) % 2) == 1;
-    int c = ((i >> 0) % 2) == 1;
-    specializations[i].add({{0, a}, {1, b}, {2, c}});
+    specializations[rayStats].resize(8);
+    for(int i = 0; i < 8; i++)
+    {
+      int a = ((i >> 2) % 2) == 1;
+      int b = ((i >> 1) % 2) == 1;
+      int c = ((i >> 0) % 2) == 1;
+      specializations[rayStats][i].add({{0, a}, {1, b}, {2, c}, {3, rayStats}});
+    }
+    rayStatsSpecializations[rayStats].add(3, rayStats);
   }
 
 
@@ -795,10 +906,16 @@ void HelloVulkan::createRtPipeline()
   std::array<VkPipelineShaderStageCreateInfo, eShaderGroupCount> stages{};
   VkPipelineShaderStageCreateInfo stage{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
   stage.pName = "main";  // All the same entry point
-  // Raygen
+  // Raygen, and the one of the ray statistics reading the shader clock
   stage.module = nvvk::createShaderModule(m_device, nvh::loadFile("spv/raytrace.rgen.spv", true, defaultSearchPaths, true));
   stage.stage     = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
   stages[eRaygen] = stage;
+  std::array<VkShaderModule, 2> raygenModules{stage.module, VK_NULL_HANDLE};
+  if(m_shaderClock)
+  {
+    std::string clockCode = nvh::loadFile("spv/raytrace_clock.rgen.spv", true, defaultSearchPaths, true);
+    raygenModules[1]      = nvvk::createShaderModule(m_device, clockCode);
+  }
   // Miss
   stage.module = nvvk::createShaderModule(m_device, nvh::loadFile("spv/raytrace.rmiss.spv", true, defaultSearchPaths, true));
   stage.stage   = VK_SHADER_STAGE_MISS_BIT_KHR;
@@ -811,12 +928,11 @@ void HelloVulkan::createRtPipeline()
 
   // Hit Group - Closest Hit
   // Create many variation of the closest hit
-  for(uint32_t s = 0; s < (uint32_t)specializations.size(); s++)
+  for(uint32_t s = 0; s < 8; s++)
   {
     stage.module = nvvk::createShaderModule(m_device, nvh::loadFile("spv/raytrace.rchit.spv", true, defaultSearchPaths, true));
-    stage.stage               = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-    stage.pSpecializationInfo = specializations[s].getSpecialization();
-    stages[eClosestHit + s]   = stage;
+    stage.stage             = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+    stages[eClosestHit + s] = stage;
   }
 
   // Shader groups
@@ -843,7 +959,7 @@ void HelloVulkan::createRtPipeline()
 
   // Hit Group - Closest Hit + AnyHit
   // Creating many Hit groups, one for each specialization
-  for(uint32_t s = 0; s < (uint32_t)specializations.size(); s++)
+  for(uint32_t s = 0; s < 8; s++)
   {
     group.type             = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
     group.generalShader    = VK_SHADER_UNUSED_KHR;
@@ -885,9 +1001,24 @@ void HelloVulkan::createRtPipeline()
   rayPipelineInfo.maxPipelineRayRecursionDepth = 2;  // Ray depth
   rayPipelineInfo.layout                       = m_rtPipelineLayout;
 
-  vkCreateRayTracingPipelinesKHR(m_device, {}, {}, 1, &rayPipelineInfo, nullptr, &m_rtPipeline);
-
-  m_sbtWrapper.create(m_rtPipeline, rayPipelineInfo);
+  // The same stages and groups, specialized without and with the ray statistics. In the first
+  // pipeline the counters are dead code, removed when the pipeline is compiled. The second one
+  // needs VK_KHR_shader_clock and is not created without it.
+  const int pipelineCount = m_shaderClock ? 2 : 1;
+  for(int rayStats = 0; rayStats < pipelineCount; rayStats++)
+  {
+    stages[eRaygen].module              = raygenModules[rayStats];
+    stages[eRaygen].pSpecializationInfo = rayStatsSpecializations[rayStats].getSpecialization();
+    stages[eMiss].pSpecializationInfo   = rayStatsSpecializations[rayStats].getSpecialization();
+    stages[eMiss2].pSpecializationInfo  = rayStatsSpecializations[rayStats].getSpecialization();
+    for(uint32_t s = 0; s < 8; s++)
+      stages[eClosestHit + s].pSpecializationInfo = specializations[rayStats][s].getSpecialization();
+
+    VkPipeline&       pipeline   = rayStats == 1 ? m_rtStatsPipeline : m_rtPipeline;
+    nvvk::SBTWrapper& sbtWrapper = rayStats == 1 ? m_sbtStatsWrapper : m_sbtWrapper;
+    vkCreateRayTracingPipelinesKHR(m_device, {}, {}, 1, &rayPipelineInfo, nullptr, &pipeline);
+    sbtWrapper.create(pipeline, rayPipelineInfo);
+  }
 
   // Spec only guarantees 1 level of "recursion". Check for that sad possibility here.
   if(m_rtProperties.maxRayRecursionDepth <= 1)
@@ -895,8 +1026,11 @@ void HelloVulkan::createRtPipeline()
     throw std::runtime_error("Device fails to support ray recursion (m_rtProperties.maxRayRecursionDepth <= 1)");
   }
 
+  stages[eRaygen].module = VK_NULL_HANDLE;
   for(auto& s : stages)
     vkDestroyShaderModule(m_device, s.module, nullptr);
+  for(auto& module : raygenModules)
+    vkDestroyShaderModule(m_device, module, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -911,16 +1045,46 @@ void HelloVulkan::raytrace(const VkCommandBuffer& cmdBuf, const glm::vec4& clear
   m_pcRay.lightIntensity = m_pcRaster.lightIntensity;
   m_pcRay.lightType      = m_pcRaster.lightType;
 
+  // Clearing the counters, once the previous frame is done reading them
+  if(m_rayStats)
+  {
+    rayStatsBarrier(cmdBuf, m_bRayStats.buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(cmdBuf, m_bRayStats.buffer, 0, VK_WHOLE_SIZE, 0);
+    rayStatsBarrier(cmdBuf, m_bRayStats.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
   std::vector<VkDescriptorSet> descSets{m_rtDescSet, m_descSet};
-  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
+  vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rayStats ? m_rtStatsPipeline : m_rtPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipelineLayout, 0,
                           (uint32_t)descSets.size(), descSets.data(), 0, nullptr);
   vkCmdPushConstants(cmdBuf, m_rtPipelineLayout,
                      VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
                      0, sizeof(PushConstantRay), &m_pcRay);
 
-  auto& regions = m_sbtWrapper.getRegions();
+  auto& regions = m_rayStats ? m_sbtStatsWrapper.getRegions() : m_sbtWrapper.getRegions();
   vkCmdTraceRaysKHR(cmdBuf, &regions[0], &regions[1], &regions[2], &regions[3], m_size.width, m_size.height, 1);
 
+  // The counters are shown by the post-process, and copied for the host a few times per second
+  m_rayStatsFilled = m_rayStats;
+  if(m_rayStats)
+  {
+    rayStatsBarrier(cmdBuf, m_bRayStats.buffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+
+    auto now = std::chrono::steady_clock::now();
+    if(m_rayStatsReadbackFrame < 0 && now - m_rayStatsReadbackTime > std::chrono::milliseconds(250))
+    {
+      VkBufferCopy region{0, 0, sizeof(RayStats) * m_size.width * m_size.height};
+      vkCmdCopyBuffer(cmdBuf, m_bRayStats.buffer, m_bRayStatsReadback.buffer, 1, &region);
+      rayStatsBarrier(cmdBuf, m_bRayStatsReadback.buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+      m_rayStatsReadbackFrame = static_cast<int>(getCurFrame());
+      m_rayStatsReadbackTime  = now;
+    }
+  }
+
   m_debug.endLabel(cmdBuf);
 }
@@ -18,6 +18,7 @@
  */
 
 #pragma once
+#include <chrono>
 
 #include "nvvkhl/appbase_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
@@ -145,7 +146,36 @@ public:
   VkPipelineLayout                                  m_rtPipelineLayout;
   VkPipeline                                        m_rtPipeline;
   nvvk::SBTWrapper                                  m_sbtWrapper;
+  VkPipeline                                        m_rtStatsPipeline{VK_NULL_HANDLE};  // Variant with RAY_STATS
+  nvvk::SBTWrapper                                  m_sbtStatsWrapper;
 
   // Push constant for ray tracer
   PushConstantRay m_pcRay{{}, {}, 0, 0, 7};
+
+  // #RayStats - Per-pixel ray counters, filled by the instrumented variant of the pipeline
+  void createRayStatsBuffers();
+  void updateRayStatsSummary();
+
+  // Sums over the pixels of the last frame read back
+  struct RayStatsSummary
+  {
+    uint64_t primary{0};
+    uint64_t shadow{0};
+    uint64_t closestHit{0};
+    uint64_t miss{0};
+    uint32_t maxRays{0};   // Rays of the busiest pixel
+    uint32_t maxTicks{0};  // Clock ticks of the slowest pixel
+    double   avgTicks{0};
+  };
+
+  bool            m_shaderClock{false};  // VK_KHR_shader_clock is enabled, needed by the instrumented pipeline
+  bool            m_rayStats{false};     // Tracing with the instrumented pipeline
+  int             m_heatmap{0};          // See PushConstantPost::heatmap
+  RayStatsSummary m_rayStatsSummary;
+
+  nvvk::Buffer                          m_bRayStats;                  // Device buffer of one RayStats per pixel
+  nvvk::Buffer                          m_bRayStatsReadback;          // Host copy of m_bRayStats
+  bool                                  m_rayStatsFilled{false};      // m_bRayStats holds the statistics of the image
+  int                                   m_rayStatsReadbackFrame{-1};  // Frame copying to m_bRayStatsReadback, or -1
+  std::chrono::steady_clock::time_point m_rayStatsReadbackTime;       // Last copy
 };
@@ -77,6 +77,33 @@ void renderUI(HelloVulkan& helloVk)
   ImGui::Checkbox("Use Specular", (bool*)&b);
   ImGui::Checkbox("Trace shadow", (bool*)&c);
   helloVk.m_pcRay.specialization = (a << 2) + (b << 1) + c;
+
+  // Ray statistics
+  if(ImGui::CollapsingHeader("Ray Statistics"))
+  {
+    if(!helloVk.m_shaderClock)
+    {
+      ImGui::Text("Not available without VK_KHR_shader_clock");
+      return;
+    }
+    ImGui::Checkbox("Instrumented pipeline", &helloVk.m_rayStats);
+    ImGui::RadioButton("Image", &helloVk.m_heatmap, 0);
+    ImGui::SameLine();
+    ImGui::RadioButton("Rays heatmap", &helloVk.m_heatmap, 1);
+    ImGui::SameLine();
+    ImGui::RadioButton("Clock heatmap", &helloVk.m_heatmap, 2);
+
+    if(helloVk.m_rayStats)
+    {
+      const auto& stats = helloVk.m_rayStatsSummary;
+      double      rays  = static_cast<double>(stats.primary + stats.shadow);
+      ImGui::Text("Rays/frame: %.3f M (primary %.3f M, shadow %.3f M)", rays * 1e-6, stats.primary * 1e-6, stats.shadow * 1e-6);
+      ImGui::Text("Rays/s: %.1f M", rays * ImGui::GetIO().Framerate * 1e-6);
+      ImGui::Text("Closest hit: %.3f M, miss: %.3f M", stats.closestHit * 1e-6, stats.miss * 1e-6);
+      ImGui::Text("Rays/pixel max: %u", stats.maxRays);
+      ImGui::Text("Clock ticks/pixel: avg %.0f, max %u", stats.avgTicks, stats.maxTicks);
+    }
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -144,6 +171,8 @@ int main(int argc, char** argv)
   VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtPipelineFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR};
   contextInfo.addDeviceExtension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, false, &rtPipelineFeature);  // To use vkCmdTraceRaysKHR
   contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);  // Required by ray tracing pipeline
+  VkPhysicalDeviceShaderClockFeaturesKHR clockFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME, true, &clockFeature);  // clockARB of the ray statistics
 
   // Creating Vulkan base application
   nvvk::Context vkctx{};
@@ -182,6 +211,8 @@ int main(int argc, char** argv)
   helloVk.updateDescriptorSet();
 
   // #VKRay
+  helloVk.m_shaderClock =
+      vkctx.hasDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME) && clockFeature.shaderSubgroupClock == VK_TRUE;
   helloVk.initRayTracing();
   helloVk.createBottomLevelAS();
   helloVk.createTopLevelAS();
@@ -227,6 +258,7 @@ int main(int argc, char** argv)
 
     // Start rendering the scene
     helloVk.prepareFrame();
+    helloVk.updateRayStatsSummary();  // The fence of the frame was waited on
 
     // Start command buffer of this frame
     auto                   curFrame = helloVk.getCurFrame();
@@ -48,7 +48,8 @@ END_BINDING();
 
 START_BINDING(RtxBindings)
   eTlas     = 0,  // Top-level acceleration structure
-  eOutImage = 1   // Ray tracer output image
+  eOutImage = 1,  // Ray tracer output image
+  eRayStats = 2   // Per-pixel ray statistics
 END_BINDING();
 // clang-format on
 
@@ -92,6 +93,24 @@ struct PushConstantRay
   int   specialization;
 };
 
+// Push constant structure for the post-process
+struct PushConstantPost
+{
+  float aspectRatio;
+  int   heatmap;       // 0: image, 1: rays per pixel, 2: clock ticks per pixel
+  float heatmapScale;  // Inverse of the value shown with the hottest color
+};
+
+// Per-pixel ray statistics, written by the RAY_STATS variant of the ray tracing pipeline
+struct RayStats
+{
+  uint primary;     // Rays traced from the camera
+  uint shadow;      // Shadow rays
+  uint closestHit;  // Closest-hit invocations
+  uint miss;        // Miss invocations, of both miss shaders
+  uint clockTicks;  // Time spent in the ray generation shader (clockARB)
+};
+
 struct Vertex  // See ObjLoader, copy of VertexObj, could be compressed for device
 {
   vec3 pos;
@@ -18,20 +18,44 @@
  */
 
 #version 450
+#extension GL_GOOGLE_include_directive : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+
+#include "host_device.h"
+
 layout(location = 0) in vec2 outUV;
 layout(location = 0) out vec4 fragColor;
 
 layout(set = 0, binding = 0) uniform sampler2D noisyTxt;
+layout(set = 0, binding = 1) readonly buffer _RayStats { RayStats rayStats[]; };
+
+layout(push_constant) uniform _PushConstantPost
+{
+  PushConstantPost pcPost;
+};
 
-layout(push_constant) uniform shaderInformation
+// Blue (cold) to red (hot)
+vec3 heatmapColor(float t)
 {
-  float aspectRatio;
+  t = clamp(t, 0.0, 1.0);
+  return clamp(vec3(1.5 - abs(4.0 * t - 3.0), 1.5 - abs(4.0 * t - 2.0), 1.5 - abs(4.0 * t - 1.0)), 0.0, 1.0);
 }
-pushc;
 
 void main()
 {
-  vec2  uv    = outUV;
+  vec2 uv = outUV;
+
+  // Ray statistics of the pixel, instead of the image
+  if(pcPost.heatmap != 0)
+  {
+    ivec2    size  = textureSize(noisyTxt, 0);
+    ivec2    pixel = min(ivec2(uv * vec2(size)), size - 1);
+    RayStats stats = rayStats[pixel.y * size.x + pixel.x];
+    float    value = pcPost.heatmap == 1 ? float(stats.primary + stats.shadow) : float(stats.clockTicks);
+    fragColor      = vec4(heatmapColor(value * pcPost.heatmapScale), 1.0);
+    return;
+  }
+
   float gamma = 1. / 2.2;
   fragColor   = pow(texture(noisyTxt, uv).rgba, vec4(gamma));
 }
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2019-2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2019-2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Per-pixel ray statistics, see RayStats in host_device.h
+// - Requires GL_EXT_ray_tracing, and host_device.h included before
+// - With RAY_STATS == 0 (default), every counter is dead code and is removed when the pipeline is compiled
+
+layout(constant_id = 3) const int RAY_STATS = 0;
+
+layout(set = 0, binding = eRayStats, std430) buffer _RayStats { RayStats rayStats[]; };
+
+uint rayStatsPixel()
+{
+  return gl_LaunchIDEXT.y * gl_LaunchSizeEXT.x + gl_LaunchIDEXT.x;
+}
+
+// The shaders called for a pixel are separate invocations: the counters are updated atomically
+#define RAY_STATS_ADD(field)                        \
+  if(RAY_STATS == 1)                                \
+  {                                                 \
+    atomicAdd(rayStats[rayStatsPixel()].field, 1u); \
+  }